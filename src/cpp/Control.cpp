@@ -3,19 +3,28 @@
 #include "robotino/headers/_Odometry.h"
 #include "robotino/headers/_CompactBha.h"
 #include "robotino/headers/_LaserRangeFinder.h"
+#include "robotino/headers/Behaviour.h"
 
 #include "geometry/All.h"
 
 #include "kinect/KinectReader.h"
+#include "kinect/TrackerTable.h"
+
+#include "tcp/TelemetryServer.h"
+#include "tcp/CommandServer.h"
 
 #include <stdlib.h>
 #include <iostream>
 #include <string>
 #include <unistd.h> // Needed by usleep()
 #include <math.h>	// Needed by fabs()
+#include <cmath>	// Needed by std::isfinite()
 #include <vector>
 #include <stdexcept>
 #include <thread>
+#include <mutex>
+#include <ostream>
+#include <sstream>
 
 
 /// The maximum height of a coordinate from Kinect that will be considered for fetching
@@ -24,8 +33,737 @@
 /// The distance between the tip of the gripper and Robotinos center, relative to the floor, when in the calibration position
 #define CONTROL_CALIBRATE_ARM_DISPLACEMENT 0.42
 
-/// Microseconds to wait before checking Kinect for a new coordinate
-#define CONTROL_KINECT_WAIT	50000
+/// The maximum age of a coordinate from Kinect in milliseconds to act on
+#define CONTROL_KINECT_MAX_AGE	200
+
+	// Results of execute()
+/// The command was executed
+#define CONTROL_OK	0
+/// The command could not be executed, like with invalid arguments
+#define CONTROL_FAILED	1
+/// The command is not known
+#define CONTROL_UNKNOWN	2
+/// The command ends the program
+#define CONTROL_EXIT	3
+
+
+/**
+ * Base for behaviours following a hand tracked by Kinect. Each behaviour
+ * keeps track of the samples it has used, so that behaviours running side
+ * by side do not take updates from each other.
+ *
+ * With several Kinects, the hand is the primary joint of the first reader
+ * as merged from all cameras by TrackerTable::fuse(), and a sample from any
+ * camera is an update.
+ */
+class KinectBehaviour : public Behaviour
+{
+ public:
+	/**
+	 * Constructor, see Behaviour
+	 */
+	KinectBehaviour( Brain * pBrain, const char * name, unsigned int resources )
+		: Behaviour( pBrain, name, resources )
+	{
+		this->sampleTime = 0;
+	}
+
+ protected:
+	/**
+	 * Checks if Kinect has a sample not yet used by this behaviour, marking
+	 * it used
+	 *
+	 * @return	If there is a new sample
+	 */
+	bool kinectUpdated()
+	{
+		Brain * pBrain = this->brain();
+
+		unsigned int time = pBrain->kinect()->dataTime();
+		for ( unsigned int i = 1; i < pBrain->kinects(); i++ )
+			if ( (int) ( pBrain->kinect( i )->dataTime() - time ) > 0 )
+				time = pBrain->kinect( i )->dataTime();
+
+		if ( time == this->sampleTime ) return false;
+		this->sampleTime = time;
+		return true;
+	}
+
+	/**
+	 * Gets the age of the freshest sample from any Kinect
+	 *
+	 * @return	The age in milliseconds
+	 */
+	unsigned int kinectAge()
+	{
+		Brain * pBrain = this->brain();
+
+		unsigned int age = pBrain->kinect()->dataAge();
+		for ( unsigned int i = 1; i < pBrain->kinects(); i++ )
+			if ( pBrain->kinect( i )->dataAge() < age )
+				age = pBrain->kinect( i )->dataAge();
+
+		return age;
+	}
+
+	/**
+	 * Gets the age of the latest "Click" from any Kinect
+	 *
+	 * @return	The age in milliseconds
+	 */
+	unsigned int kinectClickAge()
+	{
+		Brain * pBrain = this->brain();
+
+		unsigned int age = pBrain->kinect()->clickAge();
+		for ( unsigned int i = 1; i < pBrain->kinects(); i++ )
+			if ( pBrain->kinect( i )->clickAge() < age )
+				age = pBrain->kinect( i )->clickAge();
+
+		return age;
+	}
+
+	/**
+	 * Gets the hand coordinate, see KinectReader::getCoordinate(). Merged
+	 * samples are projected to now, as by kinectPredictedCoordinate().
+	 *
+	 * @return	The coordinate
+	 */
+	VolumeCoordinate kinectCoordinate()
+	{
+		VolumeCoordinate vc;
+		if ( this->fusedCoordinate( vc ) ) return vc;
+		return this->brain()->kinect()->getCoordinate();
+	}
+
+	/**
+	 * Gets the hand coordinate projected to now, see
+	 * KinectReader::getPredictedCoordinate()
+	 *
+	 * @return	The coordinate
+	 */
+	VolumeCoordinate kinectPredictedCoordinate()
+	{
+		VolumeCoordinate vc;
+		if ( this->fusedCoordinate( vc ) ) return vc;
+		return this->brain()->kinect()->getPredictedCoordinate();
+	}
+
+ private:
+	unsigned int
+	/// The time of the last sample used, see KinectReader::dataTime()
+		sampleTime;
+
+	/**
+	 * Merges the hand coordinate from all Kinects, when there are several
+	 *
+	 * @param	vc	Output, the merged coordinate
+	 *
+	 * @return	@c false with one Kinect, or if no camera has a fresh sample
+	 */
+	bool fusedCoordinate( VolumeCoordinate & vc )
+	{
+		Brain * pBrain = this->brain();
+		if ( pBrain->kinects() < 2 ) return false;
+
+		TrackedSample sample;
+		if ( pBrain->trackers()->fuse( pBrain->kinect()->getPrimaryJoint(), sample, CONTROL_KINECT_MAX_AGE ) == 0 )
+			return false;
+
+		vc = VolumeCoordinate( sample.x, sample.y, sample.z );
+		return true;
+	}
+};
+
+
+	// States of FetchBehaviour
+/// Starting a fetch or delivery
+#define FETCH_STARTING	0
+/// Following the hand until the object has changed hands
+#define FETCH_APPROACHING	1
+/// Returning to the start position, letting Robotino get up to speed
+#define FETCH_RETURNING	2
+/// Waiting for Robotino to stop before the next round
+#define FETCH_WAITING	3
+
+/**
+ * Makes Robotino go to fetch an object from a persons hand, or deliver the
+ * object it is holding. The persons hand must be tracked by Kinect.
+ *
+ * The functionality demonstrated here was the initial benchmark Brain was
+ * built to solve.
+ */
+class FetchBehaviour : public KinectBehaviour
+{
+ public:
+	/**
+	 * Constructor
+	 *
+	 * @param	pBrain	Pointer to Brain object
+	 * @param	deliver	Deliver the object held instead of fetching one
+	 * @param	serial	Keep alternating fetching and delivering, after
+	 * returning to the start position each time
+	 */
+	FetchBehaviour( Brain * pBrain, bool deliver, bool serial )
+		: KinectBehaviour( pBrain, ( serial ) ? "serialfetch" : ( deliver ) ? "deliver" : "fetch",
+				BEHAVIOUR_ALL )
+	{
+		this->deliver = deliver;
+		this->serial = serial;
+		this->stopped = false;
+		this->high = false;
+
+		// A serial fetch waits until Robotino has stopped before starting
+		if ( serial ) this->setState( FETCH_WAITING );
+	}
+
+	bool step()
+	{
+		Brain * pBrain = this->brain();
+
+		switch ( this->state() )
+		{
+			case FETCH_STARTING:
+				this->initialPosition = pBrain->odom()->getPosition();
+				pBrain->drive()->setStopWithin( pBrain->cbha()->gripperReach() );
+				this->stopped = false;
+				this->high = false;
+				this->setState( FETCH_APPROACHING );
+				return true;
+
+			case FETCH_APPROACHING:
+				if ( ( ! this->deliver && pBrain->cbha()->isHolding() )
+						|| ( this->deliver && ! pBrain->cbha()->isHolding() ) )
+				{
+					this->returnToStart();
+					if ( ! this->serial ) return false;
+
+					this->setState( FETCH_RETURNING );
+					return true;
+				}
+
+				this->approach();
+				return true;
+
+			case FETCH_RETURNING:
+				// Let Robotino get up to speed before waiting for it to stop
+				if ( this->stateMsecs() >= 1000 ) this->setState( FETCH_WAITING );
+				return true;
+
+			case FETCH_WAITING:
+				// Wait til Robotino has stopped (assuming it is currently returning)
+				if ( pBrain->odom()->currentAbsSpeed() > 0.01 || pBrain->odom()->currentAbsOmega() > 0.01 )
+					return true;
+
+				this->deliver = pBrain->cbha()->isHolding();
+				this->setState( FETCH_STARTING );
+				return true;
+		}
+
+		return false;
+	}
+
+	void cancel()
+	{
+		this->brain()->cbha()->setMaxArmSpeed( 0.01 );
+		this->brain()->cbha()->armRelax();
+		this->brain()->drive()->stopPointing();
+		this->brain()->drive()->niceStop();
+	}
+
+ private:
+	bool
+	/// If delivering instead of fetching
+		deliver,
+	/// If alternating fetching and delivering
+		serial,
+	/// If stopped for lack of coordinates
+		stopped,
+	/// If stopped because the hand is above pickup level
+		high;
+
+	/// The position to return to
+	AngularCoordinate
+		initialPosition;
+
+	/**
+	 * Follows the hand for one cycle, stopping while it is out of reach
+	 */
+	void approach()
+	{
+		Brain * pBrain = this->brain();
+
+		if ( this->kinectUpdated() && this->kinectAge() < CONTROL_KINECT_MAX_AGE )
+		{
+			this->stopped = false;
+
+			// Aim where the hand is now, not where it was captured
+			VolumeCoordinate vc = this->kinectPredictedCoordinate();
+
+			if ( vc.z() < CONTROL_FETCH_HEIGHT_LIMIT )
+			{
+				this->high = false;
+				std::cout << "Pickup at Coordinate: " << (Coordinate) vc << std::endl;
+				pBrain->drive()->setStopWithin( pBrain->cbha()->gripperReach() );
+				pBrain->drive()->setDestination( vc );
+				pBrain->drive()->setPointAt( vc );
+				pBrain->drive()->go();
+
+				// Hold arm up a bit (mostly for show :) )
+				pBrain->cbha()->setMaxArmSpeed( 0.1 );
+				pBrain->cbha()->innerToCoordinate( Coordinate( 0.0, 0.3 ) );
+				pBrain->cbha()->outerToCoordinate( Coordinate( 0.0, 0.2 ) );
+			}
+			else
+			{
+				if ( ! this->high )
+				{
+					std::cout << "Stopping, above pickup level" << std::endl;
+					this->high = true;
+				}
+				pBrain->cbha()->setMaxArmSpeed( 0.01 );
+				pBrain->cbha()->armRelax();
+				pBrain->drive()->niceStop();
+			}
+		}
+		else if ( this->kinectAge() > CONTROL_KINECT_MAX_AGE )
+		{
+			if ( ! this->stopped )
+			{
+				std::cout << "Stopping, no coordinate" << std::endl;
+				this->stopped = true;
+			}
+
+			pBrain->drive()->niceStop();
+		}
+	}
+
+	/**
+	 * Relaxes the arm and heads back to the start position
+	 */
+	void returnToStart()
+	{
+		Brain * pBrain = this->brain();
+
+		std::cout << ( ( this->deliver ) ? "Delivery" : "Pickup" ) << " done! Returning..." << std::endl;
+
+		pBrain->cbha()->setMaxArmSpeed( 0.01 );
+		pBrain->cbha()->armRelax();
+		pBrain->drive()->setPointAt( Coordinate( 1.0, 0.0 ) );
+		pBrain->drive()->setStopWithin( 0 );
+		pBrain->drive()->setDestination( (Coordinate) this->initialPosition );
+		pBrain->drive()->go();
+	}
+};
+
+
+/**
+ * Makes Robotino continuosly drive to, or turn to, the coordinate of a hand
+ * tracked by a Kinect. One of each may run at the same time.
+ */
+class FollowKinectBehaviour : public KinectBehaviour
+{
+ public:
+	/**
+	 * Constructor
+	 *
+	 * @param	pBrain	Pointer to Brain object
+	 * @param	point	Turn to point at the hand instead of driving to it
+	 */
+	FollowKinectBehaviour( Brain * pBrain, bool point )
+		: KinectBehaviour( pBrain, ( point ) ? "pointatkinect" : "gotokinect",
+				( point ) ? BEHAVIOUR_POINT : BEHAVIOUR_DRIVE )
+	{
+		this->point = point;
+	}
+
+	bool step()
+	{
+		if ( ! this->kinectUpdated() ) return true;
+
+		VolumeCoordinate vc = this->kinectCoordinate();
+		if ( this->point )
+			this->brain()->drive()->setPointAt( vc );
+		else
+			this->brain()->drive()->setDestination( vc );
+		return true;
+	}
+
+ private:
+	/// If pointing instead of driving
+	bool
+		point;
+};
+
+
+/**
+ * Makes Robotinos cBHA mimic the motions of a hand tracked by a Kinect. A
+ * "Click" from Kinect sets the position of the hand mapped to the relaxed
+ * arm.
+ */
+class MimicBehaviour : public KinectBehaviour
+{
+ public:
+	/**
+	 * Constructor
+	 *
+	 * @param	pBrain	Pointer to Brain object
+	 * @param	mirror	Robotino will mirror the hands motions. If you have
+	 * Robotino facing away from you, set this to false.
+	 */
+	MimicBehaviour( Brain * pBrain, bool mirror = true )
+		: KinectBehaviour( pBrain, "mimic", BEHAVIOUR_ARM ),
+		zero( 1.5, 0, 1.0 ) // Provide a relatively central point if Click-calibration does not work
+	{
+		this->mirror = mirror;
+		this->earliestNewCalibration = 0;
+	}
+
+	bool step()
+	{
+		Brain * pBrain = this->brain();
+
+		if ( ! this->kinectUpdated() ) return true;
+
+		if ( this->kinectClickAge() < 500
+				&& pBrain->msecsElapsed() > this->earliestNewCalibration )
+		{
+			this->zero = this->kinectCoordinate();
+			this->earliestNewCalibration = pBrain->msecsElapsed() + 1000;
+			return true;
+		}
+
+		VolumeCoordinate vc = this->kinectCoordinate();
+
+		float x = vc.x() - this->zero.x();
+		float y = vc.y() - this->zero.y();
+		float z = vc.z() - this->zero.z();
+
+		if ( ! this->mirror ) y *= -1;
+
+		pBrain->cbha()->outerToCoordinate( Coordinate( y * 2.0, z * 2.0 ) );
+		pBrain->cbha()->innerToCoordinate( Coordinate( y * 1.5, z * 1.5 ) );
+
+		if ( x > 0.1 )
+			pBrain->cbha()->rotateHorisontal();
+		else if (x < -0.1 )
+			pBrain->cbha()->rotateVertical();
+		else
+			pBrain->cbha()->rotateRelax();
+
+		if ( fabs( x ) > 0.2 )
+			pBrain->cbha()->grip();
+		else
+			pBrain->cbha()->release();
+
+		return true;
+	}
+
+	void cancel()
+	{
+		this->brain()->cbha()->rotateRelax();
+		this->brain()->cbha()->armRelax();
+		this->brain()->cbha()->release();
+	}
+
+ private:
+	/// If mirroring the hand
+	bool
+		mirror;
+
+	/// The hand position mapped to the relaxed arm
+	VolumeCoordinate
+		zero;
+
+	/// The earliest time a click may set a new zero
+	unsigned int
+		earliestNewCalibration;
+};
+
+
+	// States of CalibrationBehaviour
+/// Gripping and stopping
+#define CALIBRATION_STARTING	0
+/// Letting Robotino come to a halt
+#define CALIBRATION_STOPPING	1
+/// Waiting for Robotino to stop
+#define CALIBRATION_SETTLING	2
+/// Waiting for the arm to reach the first touch position
+#define CALIBRATION_RAISING	3
+/// Waiting for the first touch
+#define CALIBRATION_FIRST_TOUCH	4
+/// Lowering the arm before driving
+#define CALIBRATION_LOWERING	5
+/// Driving 1 meter forward
+#define CALIBRATION_DRIVING	6
+/// Waiting for Robotino to reach the second position
+#define CALIBRATION_ARRIVING	7
+/// Waiting for the arm to reach the second touch position
+#define CALIBRATION_RERAISING	8
+/// Waiting for the second touch
+#define CALIBRATION_SECOND_TOUCH	9
+/// Letting the new position take effect
+#define CALIBRATION_APPLYING	10
+
+/**
+ * Maps the Kinect coordinate system to Robotino, from two touches of the
+ * gripper by a hand tracked by Kinect, one meter apart.
+ */
+class CalibrationBehaviour : public Behaviour
+{
+ public:
+	/**
+	 * Constructor, see Behaviour
+	 */
+	CalibrationBehaviour( Brain * pBrain )
+		: Behaviour( pBrain, "calibrate", BEHAVIOUR_ALL )
+	{
+		this->touchTicket = 0;
+		this->watching = false;
+		this->calibrated = false;
+	}
+
+	bool step()
+	{
+		Brain * pBrain = this->brain();
+
+		switch ( this->state() )
+		{
+			case CALIBRATION_STARTING:
+				pBrain->drive()->setStopWithin( 0 );
+
+				std::cerr << "Performing odometry calibration, please wait..." << std::endl;
+
+				pBrain->cbha()->grip();
+				pBrain->drive()->niceStop();
+				this->setState( CALIBRATION_STOPPING );
+				return true;
+
+			case CALIBRATION_STOPPING:
+				if ( this->stateMsecs() >= 4000 ) this->setState( CALIBRATION_SETTLING );
+				return true;
+
+			case CALIBRATION_SETTLING:
+				// Make sure Robotino is not driving
+				if ( this->isMoving() ) return true;
+
+				/// @todo Improvement: Use current coordinate system, so this is not lost if calibration is aborted (not currently applicable).
+				pBrain->odom()->set( 0.0, 0.0, 0.0 );
+
+				pBrain->cbha()->innerToCoordinate( 0.0, 0.4 );
+				pBrain->cbha()->outerToCoordinate( 0.0, 0.4 );
+
+				std::cerr << "Wait for arm to reach position..." << std::endl;
+				this->setState( CALIBRATION_RAISING );
+				return true;
+
+			case CALIBRATION_RAISING:
+				if ( pBrain->cbha()->armTotalPressureDiff() > 0.1 ) return true;
+
+				std::cerr
+					<< "Stand beside Robotino and make sure Kinect is reading your hand.\n"
+					<< "Then, using your wrist, slightly push down on the tip of Robotinos gripper.\n"
+					<< "Robotino will, after a slight pause, drive 1 meter forward"
+					<< std::endl;
+
+				this->watchTouch();
+				this->setState( CALIBRATION_FIRST_TOUCH );
+				return true;
+
+			case CALIBRATION_FIRST_TOUCH:
+				if ( ! this->touched( this->kinectCoordinate0 ) ) return true;
+
+				std::cerr << "First coordinate stored : " << this->kinectCoordinate0 << "\nGet out of my way!" << std::endl;
+
+				pBrain->cbha()->innerToCoordinate( 0.0, 0.2 );
+				pBrain->cbha()->outerToCoordinate( 0.0, 0.2 );
+				this->setState( CALIBRATION_LOWERING );
+				return true;
+
+			case CALIBRATION_LOWERING:
+				if ( this->stateMsecs() < 500 ) return true;
+
+				pBrain->drive()->setDestination( Coordinate( 1.0, 0.0 ) );
+				pBrain->drive()->go();
+				pBrain->drive()->setPointAt( Coordinate( 1000.0, 0.0 ) );
+				this->setState( CALIBRATION_DRIVING );
+				return true;
+
+			case CALIBRATION_DRIVING:
+				if ( this->stateMsecs() < 2000 ) return true;
+
+				pBrain->cbha()->innerToCoordinate( 0.0, 0.4 );
+				pBrain->cbha()->outerToCoordinate( 0.0, 0.4 );
+				this->setState( CALIBRATION_ARRIVING );
+				return true;
+
+			case CALIBRATION_ARRIVING:
+				// Wait until Robotino is in position
+				if ( this->isMoving() ) return true;
+
+				pBrain->drive()->niceStop();
+
+				std::cerr << "Wait for arm to reach position..." << std::endl;
+				this->setState( CALIBRATION_RERAISING );
+				return true;
+
+			case CALIBRATION_RERAISING:
+				if ( pBrain->cbha()->armTotalPressureDiff() > 0.1 ) return true;
+
+				std::cerr
+					<< "Again, using your wrist tracked by Kinect, slightly push down on the tip of Robotinos gripper."
+					<< std::endl;
+
+				this->watchTouch();
+				this->setState( CALIBRATION_SECOND_TOUCH );
+				return true;
+
+			case CALIBRATION_SECOND_TOUCH:
+				if ( ! this->touched( this->kinectCoordinate1 ) ) return true;
+
+				std::cerr << "Second coordinate stored: " << this->kinectCoordinate1 << std::endl;
+
+				this->calibrated = this->applyCalibration();
+				this->setState( CALIBRATION_APPLYING );
+				return true;
+
+			case CALIBRATION_APPLYING:
+				// Give set a moment to take effect
+				if ( this->calibrated && this->stateMsecs() < 200 ) return true;
+
+				if ( this->calibrated )
+					std::cerr << "Calibration completed, new position set: " << pBrain->odom()->getPosition() << std::endl;
+
+				pBrain->cbha()->armRelax();
+				pBrain->cbha()->release();
+				pBrain->drive()->setDestination( pBrain->odom()->getPosition() );
+				pBrain->drive()->stopPointing();
+				return false;
+		}
+
+		return false;
+	}
+
+	void cancel()
+	{
+		if ( this->watching ) this->brain()->cbha()->unwatchTouch();
+
+		this->brain()->cbha()->armRelax();
+		this->brain()->cbha()->release();
+		this->brain()->drive()->niceStop();
+		this->brain()->drive()->stopPointing();
+	}
+
+ private:
+	/// The Kinect coordinates of the first and second touch
+	VolumeCoordinate
+		kinectCoordinate0,
+		kinectCoordinate1;
+
+	/// The ticket of the touch watched, see _CompactBha::watchTouch()
+	unsigned long
+		touchTicket;
+
+	bool
+	/// If a touch is watched
+		watching,
+	/// If the new position was set
+		calibrated;
+
+	/**
+	 * Checks if Robotino is driving or turning
+	 *
+	 * @return	Boolean indicating status
+	 */
+	bool isMoving()
+	{
+		return ( this->brain()->odom()->currentAbsSpeed() > 0.01
+				|| this->brain()->odom()->currentAbsOmega() > 0.01 );
+	}
+
+	/**
+	 * Starts watching for a touch of the gripper
+	 */
+	void watchTouch()
+	{
+		this->touchTicket = this->brain()->cbha()->watchTouch();
+		this->watching = true;
+	}
+
+	/**
+	 * Checks if the gripper has been touched
+	 *
+	 * @param	coordinate	Output, the Kinect coordinate of the touch
+	 *
+	 * @return	If touched
+	 */
+	bool touched( VolumeCoordinate & coordinate )
+	{
+		if ( ! this->brain()->cbha()->pollTouchCoordinate( this->touchTicket, coordinate ) )
+			return false;
+
+		this->watching = false;
+		return true;
+	}
+
+	/**
+	 * Calculates Robotinos position in the Kinect coordinate system from the
+	 * two touches, and sets the odometry to it
+	 *
+	 * @return	Success of setting the odometry
+	 */
+	bool applyCalibration()
+	{
+		Brain * pBrain = this->brain();
+
+		// Get current odom position
+		AngularCoordinate odomPos1 = pBrain->odom()->getPosition();
+
+		// Calculate actual heading and position:
+		// This is done using the now known travel direction of Robotino, and
+		// the distance between the touched arm and Robotinos center.
+		Vector odomDeviation = Coordinate( 0.0, 1.0 ).getVector( odomPos1 );
+		Angle phi;
+		Coordinate kinectCoordinate0Adjusted = this->kinectCoordinate0;
+		float kinectAngleDiff = 99.0;
+
+		while ( true )
+		{
+			Vector kinectVector = kinectCoordinate0Adjusted.getVector( this->kinectCoordinate1 );
+			kinectAngleDiff -= fabs( kinectVector.phi() );
+
+			kinectAngleDiff = fabs( kinectAngleDiff );
+
+			phi = Angle( kinectVector.phi() + odomPos1.phi() );
+
+			Coordinate convertedOdomDeviation = Vector( odomDeviation.magnitude(), phi.phi() ).cartesian();
+
+			kinectCoordinate0Adjusted = Coordinate(
+					this->kinectCoordinate0.x() + convertedOdomDeviation.x(),
+					this->kinectCoordinate0.y() + convertedOdomDeviation.y() );
+
+			if ( kinectAngleDiff > 0.01 ) break;
+			kinectAngleDiff = fabs( kinectVector.phi() );
+		}
+
+		// Calculate the arm offset to apply to the second kinect position, from
+		// the gripper position given by the string potentiometers if the
+		// kinematic model is in use
+		Coordinate armVector = Vector( CONTROL_CALIBRATE_ARM_DISPLACEMENT, phi.phi() ).cartesian();
+		if ( CBHA_USE_KINEMATICS )
+		{
+			VolumeCoordinate gripper = pBrain->cbha()->gripperPosition();
+			armVector = Coordinate(
+					( gripper.x() * cos( phi.phi() ) ) - ( gripper.y() * sin( phi.phi() ) ),
+					( gripper.x() * sin( phi.phi() ) ) + ( gripper.y() * cos( phi.phi() ) ) );
+		}
+
+		// Calculate and apply coordinates and vector
+		float x = this->kinectCoordinate1.x() - armVector.x();
+		float y = this->kinectCoordinate1.y() - armVector.y();
+		return pBrain->odom()->set( x, y, phi.phi() );
+	}
+};
 
 
 /**
@@ -44,19 +782,35 @@ class Control
 	Control( Brain * pBrain )
 	{
 		this->pBrain = pBrain;
+
+		// Execute commands from the network, if enabled
+		if ( this->pBrain->commands() != NULL )
+			this->tCommands = std::thread( & Control::serveCommands, this );
 	}
 
 	/**
-	 * Provides a simple command interpreter
+	 * Destructor, stops taking commands from the network and cancels any
+	 * running behaviours
+	 */
+	~Control()
+	{
+		if ( this->tCommands.joinable() )
+		{
+			this->pBrain->commands()->stop();
+			this->tCommands.join();
+		}
+
+		this->pBrain->cancelBehaviours( BEHAVIOUR_ALL );
+	}
+
+	/**
+	 * Provides a simple command interpreter on the terminal. If the input is
+	 * closed while commands are taken from the network, keeps serving them.
 	 */
 	bool prompt()
 	{
 		std::string
-			input = "",
-			command = "";
-
-		size_t
-			separator = 0;
+			input = "";
 
 		sleep( 1 );
 		std::cerr << std::endl;
@@ -65,223 +819,520 @@ class Control
 		{
 			input = "";
 			std::cerr << "Brain $ ";
-			std::getline( std::cin, input );
+			if ( ! std::getline( std::cin, input ) )
+			{
+				if ( this->tCommands.joinable() )
+				{
+					std::cerr << "Input closed, taking commands from the network only" << std::endl;
+					this->tCommands.join();
+				}
+				break;
+			}
 
-			separator = input.find_first_of( " " );
+			if ( this->execute( input, std::cerr ) == CONTROL_EXIT ) break;
+		}
 
-			this->_stop = true;
-			if ( this->tWorker.joinable() )
-				this->tWorker.join();
-			this->_stop = false;
+		std::cerr << "Ending program" << std::endl;
+		return true;
+	}
 
-			command = input.substr( 0, separator );
+	/**
+	 * Executes one command, as typed at the prompt. Cancels the running
+	 * behaviours using the resources of the command first, see
+	 * commandResources(). Commands from the prompt and the network are
+	 * executed one at a time, without waiting for the behaviours they
+	 * start.
+	 *
+	 * @param	input	The command and its arguments
+	 * @param	out	Stream for the output of the command
+	 *
+	 * @return	CONTROL_OK, or CONTROL_FAILED, CONTROL_UNKNOWN or CONTROL_EXIT
+	 */
+	int execute( const std::string & input, std::ostream & out )
+	{
+		std::lock_guard<std::mutex> lock( this->executing );
 
-			if ( command == "goto" )
-			{
-				std::cerr << "Going to " << input.substr( ++separator ) << std::endl;
-				this->goTo( input.substr( separator ) );
-			}
-			else if ( command == "stop" )
-			{
-				std::cerr << "Stopping" << std::endl;
-				this->pBrain->drive()->niceStop();
-			}
-			else if ( command == "go" )
-			{
-				std::cerr << "Continuing (unless I'm already there :) )" << std::endl;
-				this->pBrain->drive()->go();
-			}
-			else if ( command == "pointat" )
-			{
-				std::cerr << "Pointing at " << input.substr( ++separator ) << std::endl;
-				this->pointAt( input.substr( separator ) );
-			}
-			else if ( command == "stoppointing" )
-			{
-				this->pBrain->drive()->stopPointing();
-				std::cerr << "Pointing stopped" << std::endl;
-			}
+		std::string
+			command = "";
 
-			else if ( command == "speed" )
-			{
-				float s[] = { 0.0, 0.0, 0.0 };
+		size_t
+			separator = input.find_first_of( " " );
 
-				for ( int i = 0; i < 3; i++ )
-				{
-					if ( separator == input.npos ) break;
-					size_t start = ++separator;
-					separator = input.find( ' ', start );
-					s[i] = atof( input.substr( start, separator).c_str() );
-				}
+		command = input.substr( 0, separator );
 
-			std::cerr << "Setting speeds " << s[0] << ", " << s[1] << ", " << s[2] << std::endl;
-				this->pBrain->drive()->setVelocity( s[0], s[1], s[2] );
-			}
+		this->pBrain->cancelBehaviours( this->commandResources( command ) );
 
-			else if ( command == "resetodometry" )
-			{
-				this->pBrain->drive()->fullStop();
-				usleep( 200000 );
-				this->pBrain->odom()->set( 0.0, 0.0, 0.0 );
-				this->pBrain->drive()->setDestination( Coordinate( 0.0, 0.0 ) );
-				this->pBrain->drive()->stopPointing();
-				std::cerr << "Odometry set to 0, 0 ø0" << std::endl;
-			}
-			else if ( command == "printposition" )
+		if ( command == "goto" )
+		{
+			out << "Going to " << input.substr( ++separator ) << std::endl;
+			if ( ! this->goTo( input.substr( separator ), out ) ) return CONTROL_FAILED;
+		}
+		else if ( command == "stop" )
+		{
+			out << "Stopping" << std::endl;
+			this->pBrain->drive()->niceStop();
+		}
+		else if ( command == "go" )
+		{
+			out << "Continuing (unless I'm already there :) )" << std::endl;
+			this->pBrain->drive()->go();
+		}
+		else if ( command == "pointat" )
+		{
+			out << "Pointing at " << input.substr( ++separator ) << std::endl;
+			if ( ! this->pointAt( input.substr( separator ), out ) ) return CONTROL_FAILED;
+		}
+		else if ( command == "stoppointing" )
+		{
+			this->pBrain->drive()->stopPointing();
+			out << "Pointing stopped" << std::endl;
+		}
+
+		else if ( command == "speed" )
+		{
+			float s[] = { 0.0, 0.0, 0.0 };
+
+			for ( int i = 0; i < 3; i++ )
 			{
-				std::cerr << "Current position: " << this->pBrain->odom()->getPosition() << std::endl;
+				if ( separator == input.npos ) break;
+				size_t start = ++separator;
+				separator = input.find( ' ', start );
+				s[i] = atof( input.substr( start, separator).c_str() );
 			}
 
+			out << "Setting speeds " << s[0] << ", " << s[1] << ", " << s[2] << std::endl;
+			this->pBrain->drive()->setVelocity( s[0], s[1], s[2] );
+		}
+
+		else if ( command == "resetodometry" )
+		{
+			this->pBrain->drive()->fullStop();
+			usleep( 200000 );
+			this->pBrain->odom()->set( 0.0, 0.0, 0.0 );
+			this->pBrain->drive()->setDestination( Coordinate( 0.0, 0.0 ) );
+			this->pBrain->drive()->stopPointing();
+			out << "Odometry set to 0, 0 ø0" << std::endl;
+		}
+		else if ( command == "printposition" )
+		{
+			out << "Current position: " << this->pBrain->odom()->getPosition() << std::endl;
+		}
+
 /*			else if ( command == "inner" )
-			{
-			//	[coordinate]\n"
-			}
-			else if ( command == "outer" )
-			{
-			//	[coordinate]\n"
-			}
+		{
+		//	[coordinate]\n"
+		}
+		else if ( command == "outer" )
+		{
+		//	[coordinate]\n"
+		}
 */			else if ( command == "relaxarm" )
+		{
+			out << "Relaxing arm" << std::endl;
+			this->pBrain->cbha()->armRelax();
+		}
+		else if ( command == "horisontal" )
+		{
+			out << "Rotate horisontal" << std::endl;
+			this->pBrain->cbha()->rotateHorisontal();
+		}
+		else if ( command == "vertical" )
+		{
+			out << "Rotate vertical" << std::endl;
+			this->pBrain->cbha()->rotateVertical();
+		}
+		else if ( command == "norotate" )
+		{
+			out << "Relaxing rotation" << std::endl;
+			this->pBrain->cbha()->rotateRelax();
+		}
+		else if ( command == "grip" )
+		{
+			out << "Gripping" << std::endl;
+			this->pBrain->cbha()->grip();
+		}
+		else if ( command == "release" )
+		{
+			out << "Releasing" << std::endl;
+			this->pBrain->cbha()->release();
+		}
+		else if ( command == "cbhatest" )
+		{
+			out << "cBHA test procedure started" << std::endl;
+			this->pBrain->cbha()->play( this->cbhaTestTrajectory() );
+		}
+		else if ( command == "recordarm" )
+		{
+			out << "Recording arm" << std::endl;
+			this->pBrain->cbha()->startRecording();
+		}
+		else if ( command == "stoprecording" )
+		{
+			this->armRecording = this->pBrain->cbha()->stopRecording();
+			out
+				<< "Recorded " << this->armRecording.frames() << " frames, "
+				<< this->armRecording.duration() << " msecs" << std::endl;
+			if ( separator != input.npos )
+				this->armRecording.save( input.substr( ++separator ) );
+		}
+		else if ( command == "playarm" )
+		{
+			if ( separator != input.npos
+					&& ! this->armRecording.load( input.substr( ++separator ) ) )
+				return CONTROL_FAILED;
+			out << "Playing arm recording" << std::endl;
+			this->pBrain->cbha()->play( this->armRecording );
+		}
+
+		else if ( command == "calibrate" )
+		{
+			if ( ! this->checkKinect( "CalibratePositionToKinect", out ) ) return CONTROL_FAILED;
+			out << "Calibrate to Kinect coordinate system" << std::endl;
+			if ( ! this->start( new CalibrationBehaviour( this->pBrain ) ) ) return CONTROL_FAILED;
+		}
+		else if ( command == "fetch" )
+		{
+			if ( ! this->checkKinect( "Fetch", out ) ) return CONTROL_FAILED;
+			out << "Fetching" << std::endl;
+			if ( ! this->start( new FetchBehaviour( this->pBrain, false, false ) ) ) return CONTROL_FAILED;
+		}
+		else if ( command == "deliver" )
+		{
+			if ( ! this->checkKinect( "Deliver", out ) ) return CONTROL_FAILED;
+			out << "Delivering" << std::endl;
+			if ( ! this->start( new FetchBehaviour( this->pBrain, true, false ) ) ) return CONTROL_FAILED;
+		}
+		else if ( command == "serialfetch" )
+		{
+			if ( ! this->checkKinect( "Serialfetch", out ) ) return CONTROL_FAILED;
+			out << "Looping fetch and deliver" << std::endl;
+			if ( ! this->start( new FetchBehaviour( this->pBrain, false, true ) ) ) return CONTROL_FAILED;
+		}
+		else if ( command == "mimic" )
+		{
+			if ( ! this->checkKinect( "Mimic", out ) ) return CONTROL_FAILED;
+			out << "cBHA mimicking" << std::endl;
+			if ( ! this->start( new MimicBehaviour( this->pBrain, true ) ) ) return CONTROL_FAILED;
+		}
+		else if ( command == "gotokinect" )
+		{
+			if ( ! this->checkKinect( "DriveToKinectPos", out ) ) return CONTROL_FAILED;
+			out << "Following Kinect position" << std::endl;
+			if ( ! this->start( new FollowKinectBehaviour( this->pBrain, false ) ) ) return CONTROL_FAILED;
+		}
+		else if ( command == "pointatkinect" )
+		{
+			if ( ! this->checkKinect( "TurnToKinectPos", out ) ) return CONTROL_FAILED;
+			out << "Pointing to Kinect position" << std::endl;
+			if ( ! this->start( new FollowKinectBehaviour( this->pBrain, true ) ) ) return CONTROL_FAILED;
+		}
+		else if ( command == "cancel" )
+		{
+			out << "Cancelled " << this->pBrain->cancelBehaviours( BEHAVIOUR_ALL ) << " running commands" << std::endl;
+		}
+		else if ( command == "printlaser" )
+		{
+			if ( this->pBrain->hasLRF() )
 			{
-				std::cerr << "Relaxing arm" << std::endl;
-				this->pBrain->cbha()->armRelax();
-			}
-			else if ( command == "horisontal" )
-			{
-				std::cerr << "Rotate horisontal" << std::endl;
-				this->pBrain->cbha()->rotateHorisontal();
+				this->pBrain->lrf()->readingsToString( out );
 			}
-			else if ( command == "vertical" )
+			else
 			{
-				std::cerr << "Rotate vertical" << std::endl;
-				this->pBrain->cbha()->rotateVertical();
+				out << "LaserRangeFinder not available" << std::endl;
+				return CONTROL_FAILED;
 			}
-			else if ( command == "norotate" )
+		}
+		else if ( command == "behaviours" )
+		{
+			this->pBrain->behavioursToString( out );
+		}
+		else if ( command == "cbhasettling" )
+		{
+			this->pBrain->cbha()->settlingToString( out );
+		}
+		else if ( command == "cbhatable" )
+		{
+			this->pBrain->cbha()->armPressureTable()->compare( out );
+		}
+		else if ( command == "kinectstats" )
+		{
+			if ( this->pBrain->kinect() != NULL )
 			{
-				std::cerr << "Relaxing rotation" << std::endl;
-				this->pBrain->cbha()->rotateRelax();
+				for ( unsigned int i = 0; i < this->pBrain->kinects(); i++ )
+					this->pBrain->kinect( i )->connectionToString( out );
 			}
-			else if ( command == "grip" )
+			else
 			{
-				std::cerr << "Gripping" << std::endl;
-				this->pBrain->cbha()->grip();
+				out << "Kinect not enabled" << std::endl;
+				return CONTROL_FAILED;
 			}
-			else if ( command == "release" )
+		}
+		else if ( command == "trackers" )
+		{
+			this->pBrain->trackers()->tableToString( out );
+
+			// Merge the joints seen by several Kinects
+			unsigned int sources[ TRACKERTABLE_SIZE ];
+			unsigned int count = this->pBrain->trackers()->sources( sources, TRACKERTABLE_SIZE );
+			bool fused[ 256 ] = { false };
+			for ( unsigned int i = 0; i < count; i++ )
 			{
-				std::cerr << "Releasing" << std::endl;
-				this->pBrain->cbha()->release();
+				unsigned int joint = TRACKERTABLE_JOINT( sources[ i ] );
+				if ( fused[ joint ] ) continue;
+				fused[ joint ] = true;
+
+				TrackedSample sample;
+				unsigned int merged = this->pBrain->trackers()->fuse( joint, sample );
+				if ( merged > 0 )
+					out
+						<< "Joint " << joint << " from " << merged << " cameras: "
+						<< VolumeCoordinate( sample.x, sample.y, sample.z ) << std::endl;
 			}
-			else if ( command == "cbhatest" )
+		}
+		else if ( command == "kinecttransform" )
+		{
+			if ( this->pBrain->kinect() == NULL )
 			{
-				std::cerr << "cBHA test procedure, please wait..." << std::endl;
-				this->cbhaTest();
-				std::cerr << "Test completed" << std::endl;
+				out << "Kinect not enabled" << std::endl;
+				return CONTROL_FAILED;
 			}
 
-			else if ( command == "calibrate" )
+			// yaw pitch roll x y z, angles in degrees
+			float t[] = { 0.0, 0.0, 0.0, 0.0, 0.0, 0.0 };
+			int values = 0;
+			for ( ; values < 6; values++ )
 			{
-				std::cerr << "Calibrate to Kinect coordinate system" << std::endl;
-				this->calibratePositionToKinect();
+				if ( separator == input.npos ) break;
+				size_t start = ++separator;
+				separator = input.find( ' ', start );
+				t[ values ] = atof( input.substr( start, separator ).c_str() );
 			}
-			else if ( command == "fetch" )
+
+			if ( values == 6 )
+				this->pBrain->kinect()->setTransform( RigidTransform(
+						t[ 0 ] * ( M_PI / 180.0 ), t[ 1 ] * ( M_PI / 180.0 ), t[ 2 ] * ( M_PI / 180.0 ),
+						t[ 3 ], t[ 4 ], t[ 5 ] ) );
+			else
+				out << "Kinect transform: " << this->pBrain->kinect()->getTransform() << std::endl;
+		}
+		else if ( command == "kinectfilter" )
+		{
+			if ( this->pBrain->kinect() == NULL )
 			{
-				std::cerr << "Fetching" << std::endl;
-				this->tWorker = std::thread( & Control::fetch, this, false );
+				out << "Kinect not enabled" << std::endl;
+				return CONTROL_FAILED;
 			}
-			else if ( command == "deliver" )
+
+			// mincutoff beta [derivativecutoff], mincutoff 0 disables
+			float f[] = { 0.0, 0.0, ONEEUROFILTER_DERIVATIVE_CUTOFF };
+			int values = 0;
+			for ( ; values < 3; values++ )
 			{
-				std::cerr << "Delivering" << std::endl;
-				this->tWorker = std::thread( & Control::fetch, this, true );
+				if ( separator == input.npos ) break;
+				size_t start = ++separator;
+				separator = input.find( ' ', start );
+				f[ values ] = atof( input.substr( start, separator ).c_str() );
 			}
-			else if ( command == "serialfetch" )
+
+			if ( values >= 1 )
 			{
-				std::cerr << "Looping fetch and deliver" << std::endl;
-				this->tWorker = std::thread( & Control::serialfetch, this );
+				this->pBrain->kinect()->setFilter( f[ 0 ], f[ 1 ], f[ 2 ] );
+				out << "Kinect filter set" << std::endl;
 			}
-			else if ( command == "mimic" )
+			else
+				this->pBrain->kinect()->connectionToString( out );
+		}
+		else if ( command == "telemetry" )
+		{
+			if ( this->pBrain->telemetry() != NULL )
+				this->pBrain->telemetry()->serverToString( out );
+			else
 			{
-				std::cerr << "cBHA mimicking" << std::endl;
-				this->tWorker = std::thread( & Control::cbhaMimic, this, true );
+				out << "Telemetry not enabled" << std::endl;
+				return CONTROL_FAILED;
 			}
-			else if ( command == "gotokinect" )
+		}
+		else if ( command == "commands" )
+		{
+			if ( this->pBrain->commands() != NULL )
+				this->pBrain->commands()->serverToString( out );
+			else
 			{
-				std::cerr << "Following Kinect position" << std::endl;
-				this->tWorker = std::thread( & Control::driveToKinectPos, this );
+				out << "Commands not enabled" << std::endl;
+				return CONTROL_FAILED;
 			}
-			else if ( command == "pointatkinect" )
+		}
+		else if ( command == "printfeatures" )
+		{
+			if ( this->pBrain->hasLRF() )
 			{
-				std::cerr << "Pointing to Kinect position" << std::endl;
-				this->tWorker = std::thread( & Control::turnToKinectPos, this );
+				this->pBrain->lrf()->featuresToString( out );
 			}
-			else if ( command == "printlaser" )
+			else
 			{
-				if ( this->pBrain->hasLRF() )
-				{
-					this->pBrain->lrf()->readingsToString();
-				}
-				else
-				{
-					std::cerr << "LaserRangeFinder not available" << std::endl;
-				}
+				out << "LaserRangeFinder not available" << std::endl;
+				return CONTROL_FAILED;
 			}
+		}
 
-			else if ( command == "brainstop" )
-			{
-				this->pBrain->stop();
-			}
-			else if ( command == "brainstart" )
+		else if ( command == "brainstop" )
+		{
+			this->pBrain->stop();
+		}
+		else if ( command == "brainstart" )
+		{
+			this->pBrain->start();
+		}
+
+		else if ( command == "nobrain" )
+		{
+			if ( this->pBrain->isRunning() )
 			{
-				this->pBrain->start();
+				out << "Brain loop must be stopped first!" << std::endl;
+				return CONTROL_FAILED;
 			}
+			this->aheadAndBack( 1.5 );
+		}
 
-			else if ( command == "nobrain" )
+		else if ( command == "help" )
+		{
+			this->printInstructions( out );
+		}
+		else if ( command == "exit" )
+		{
+			return CONTROL_EXIT;
+		}
+		else
+		{
+			out << "I am sorry, I am not familiar with the command \"" << command << "\"."
+				<< "\nPlease try again. For help, use the command \"help\"." << std::endl;
+			return CONTROL_UNKNOWN;
+		}
+
+		return CONTROL_OK;
+	}
+
+
+ private:
+	Brain *
+	/// The pointer to the Brain object
+		pBrain;
+
+	std::thread
+	/// A thread executing the commands from the network
+		tCommands;
+
+	/// Lets one command execute at a time
+	std::mutex
+		executing;
+
+	/// The last arm recording, see _CompactBha::stopRecording()
+	CbhaTrajectory
+		armRecording;
+
+	/**
+	 * Executes the commands from the CommandServer of the Brain until it is
+	 * stopped, answering each with the status OK, FAILED or UNKNOWN and the
+	 * output of the command. Ending the program is left to the prompt.
+	 */
+	void serveCommands()
+	{
+		Command command;
+
+		while ( this->pBrain->commands()->next( command ) )
+		{
+			std::ostringstream out;
+			const char * status;
+			int result;
+
+			// An exception leaving the thread would end the program, a
+			// command from the network may only fail
+			try
 			{
-				if ( this->pBrain->isRunning() )
-				{
-					std::cerr << "Brain loop must be stopped first!" << std::endl;
-					continue;
-				}
-				this->aheadAndBack( 1.5 );
+				result = this->execute( command.text, out );
 			}
-
-			else if ( command == "help" )
+			catch ( std::runtime_error * e )
 			{
-				this->printInstructions();
+				out << "Error: " << e->what() << std::endl;
+				delete e;
+				result = CONTROL_FAILED;
 			}
-			else if ( command == "exit" )
+			catch ( const std::exception & e )
 			{
-				std::cerr << "Ending program" << std::endl;
-				break;
+				out << "Error: " << e.what() << std::endl;
+				result = CONTROL_FAILED;
 			}
-			else
+
+			switch ( result )
 			{
-				std::cerr << "I am sorry, I am not familiar with the command \"" << command << "\"."
-					<< "\nPlease try again. For help, use the command \"help\"." << std::endl;
+				case CONTROL_OK:
+					status = "OK";
+					break;
+				case CONTROL_UNKNOWN:
+					status = "UNKNOWN";
+					break;
+				case CONTROL_EXIT:
+					out << "Exit is only available at the prompt" << std::endl;
+					status = "FAILED";
+					break;
+				default:
+					status = "FAILED";
 			}
+
+			this->pBrain->commands()->reply( command, status, out.str() );
 		}
-		
-		return true;
 	}
 
+	/**
+	 * Gets the resources used by a command, the running behaviours using
+	 * any of them are cancelled before the command is executed, as is arm
+	 * playback for BEHAVIOUR_ARM, see Brain::cancelBehaviours(). Commands
+	 * starting a behaviour cancel the behaviours it conflicts with when
+	 * started, see Brain::startBehaviour().
+	 *
+	 * @param	command	The command, without arguments
+	 *
+	 * @return	A combination of the BEHAVIOUR_ flags
+	 */
+	unsigned int commandResources( const std::string & command )
+	{
+		if ( command == "goto" || command == "resetodometry" || command == "nobrain" )
+			return BEHAVIOUR_DRIVE | BEHAVIOUR_POINT;
 
- private:
-	Brain *
-	/// The pointer to the Brain object
-		pBrain;
+		if ( command == "stop" || command == "go" || command == "speed" )
+			return BEHAVIOUR_DRIVE;
 
-	bool
-	/// A parameter used to stop function loops
-		_stop;
+		if ( command == "pointat" || command == "stoppointing" )
+			return BEHAVIOUR_POINT;
 
-	std::thread
-	/// A thread for executing looping function without losing control through the promt
-		tWorker;
+		if ( command == "relaxarm" || command == "horisontal" || command == "vertical"
+				|| command == "norotate" || command == "grip" || command == "release"
+				|| command == "cbhatest" || command == "playarm" )
+			return BEHAVIOUR_ARM;
+
+		return 0;
+	}
+
+	/**
+	 * Starts a behaviour on the Brain
+	 *
+	 * @param	pBehaviour	The behaviour, owned by Brain
+	 *
+	 * @return	Success of starting
+	 */
+	bool start( Behaviour * pBehaviour )
+	{
+		return ( this->pBrain->startBehaviour( pBehaviour ) != 0 );
+	}
 
 	/**
 	 * Prints usage instructions
+	 *
+	 * @param	out	Stream to print to
 	 */
-	void printInstructions()
+	void printInstructions( std::ostream & out )
 	{
-		std::cerr
+		out
 			<< "\nWhat I can do for you:\n"
 
 			<< "\nDriving:\n"
@@ -302,148 +1353,56 @@ class Control
 			<< "norotate\n"
 			<< "grip\n"
 			<< "release\n"
-			<< "cbhatest\tA cbha test routine\n";
+			<< "cbhatest\tA cbha test routine\n"
+			<< "recordarm\tStart recording the arm pressures\n"
+			<< "stoprecording [file]\tStop recording, and save the recording to the file if given\n"
+			<< "playarm [file]\tPlay the last recording, or the recording in the file if given\n";
 
 		if ( this->pBrain->kinectIsAvailable() )
 		{
-			std::cerr
+			out
 			<< "\nWith kinect:\n"
-			<< "calibrate\tWill perform a calibration routine, mapping the Kinect coordinate system to Robotino. The prompt will be disabled during calibration.\n"
+			<< "calibrate\tWill perform a calibration routine, mapping the Kinect coordinate system to Robotino. Other commands will cancel the calibration.\n"
 			<< "fetch\tI will fetch item from your hand (requires Kinect)\n"
 			<< "deliver\tThe same as fetch, only I will deliver any item I am currently holding (requires Kinect)\n"
 			<< "mimic\tMy arm will mimic you arm (requires Kinect)\n"
-			<< "gotokinect\n"
-			<< "pointatkinect\n";
+			<< "gotokinect\tI will follow your hand (requires Kinect)\n"
+			<< "pointatkinect\tI will point at your hand, also while following it (requires Kinect)\n";
 		}
 		else
 		{
-			std::cerr
+			out
 			<< "\n(Kinect unavailable, commands hidden)\n";
 		}
 
-		std::cerr
+		out
 			<< "Brain controls:\n"
 			<< "brainstop\tStops the brain loop\n"
 			<< "brainstart\tStarts the brain loop\n"
 
 			<< "Meta functions:\n"
+			<< "cancel\tCancel all running commands\n"
 			<< "help\tDisplay this help text\n"
 			<< "exit\tExit the program\n"
 
-			<< "\nA new command will cancel any running command\n"
+			<< "\nA new command will cancel any running command using the same parts of me\n"
+			<< "Commands may also be sent over the network, see CommandServer\n"
 			<< std::endl;	
 	}
 
 	/**
-	 * The fetch function makes Robotino go to fetch an object from a persons
-	 * hand. The persons hand must be tracked by Kinect.
-	 * 
-	 * The functionality demonstrated here was the initial benchmark Brain was
-	 * built to solve.
+	 * Checks that a Kinect is available for a command
+	 *
+	 * @param	requesterName	The name of the command, for the message
+	 * @param	out	Stream for messages
 	 *
-	 * @param	deliver	Boolean to make Robotino deliver an object instead of
-	 * fetching it.
+	 * @return	If a Kinect is available
 	 */
-	void fetch( bool deliver = false )
-	{
-		if ( ! this->checkKinect( ( deliver ) ? "Deliver" : "Fetch" ) ) return;
-
-		AngularCoordinate initialPosition = this->pBrain->odom()->getPosition();
-
-		this->pBrain->drive()->setStopWithin( CBHA_ARM_RELAXED_DISTANCE_FROM_CENTER );
-
-		bool stopped = false;
-		bool high = false;
-
-		while ( ! this->_stop
-				&& ( ( ! deliver && ! this->pBrain->cbha()->isHolding() )
-					|| ( deliver && this->pBrain->cbha()->isHolding() ) ) )
-		{
-			if ( this->pBrain->kinect()->isUpdated() && this->pBrain->kinect()->dataAge() < 200 )
-			{
-				stopped = false;
-				VolumeCoordinate vc = this->pBrain->kinect()->getCoordinate();
-
-				if ( vc.z() < CONTROL_FETCH_HEIGHT_LIMIT ) 
-				{
-					high = false;
-					std::cout << "Pickup at Coordinate: " << (Coordinate) vc << std::endl;
-					this->pBrain->drive()->setDestination( vc );
-					this->pBrain->drive()->setPointAt( vc );
-					this->pBrain->drive()->go();
-
-					// Hold arm up a bit (mostly for show :) )
-					this->pBrain->cbha()->setMaxArmSpeed( 0.1 );
-					this->pBrain->cbha()->innerToCoordinate( Coordinate( 0.0, 0.3 ) );
-					this->pBrain->cbha()->outerToCoordinate( Coordinate( 0.0, 0.2 ) );
-				}
-				else
-				{
-					if ( ! high )
-					{
-						std::cout << "Stopping, above pickup level" << std::endl;
-						high = true;
-					}
-					this->pBrain->cbha()->setMaxArmSpeed( 0.01 );
-					this->pBrain->cbha()->armRelax();
-					this->pBrain->drive()->niceStop();
-					usleep( 50000 );
-				}
-			}
-			else
-			{
-				if ( this->pBrain->kinect()->dataAge() > 200 )
-				{
-					if ( ! stopped )
-					{
-						std::cout << "Stopping, no coordinate" << std::endl;
-						stopped = true;
-					}
-
-					this->pBrain->drive()->niceStop();
-				}
-				usleep( CONTROL_KINECT_WAIT );
-			}
-		}
-		
-		if ( this->_stop )
-		{
-			// Recieved stop signal before completing, do cleanup.
-			this->pBrain->cbha()->setMaxArmSpeed( 0.01 );
-			this->pBrain->cbha()->armRelax();
-			this->pBrain->drive()->stopPointing();
-			this->pBrain->drive()->niceStop();
-			return;
-		}
-
-		std::cout << ( ( deliver ) ? "Delivery" : "Pickup" ) << " done! Returning..." << std::endl;
-
-		this->pBrain->cbha()->setMaxArmSpeed( 0.01 );
-		this->pBrain->cbha()->armRelax();
-		this->pBrain->drive()->setPointAt( Coordinate( 1.0, 0.0 ) );
-		this->pBrain->drive()->setStopWithin( 0 );
-		this->pBrain->drive()->setDestination( (Coordinate) initialPosition );
-		this->pBrain->drive()->go();
-	}
-
-	void serialfetch()
-	{
-		while ( ! this->_stop )
-		{
-			// Wait til Robotino has stopped (assuming it is currently running fetch/deliver)
-			while ( this->pBrain->odom()->currentAbsSpeed() > 0.01 || this->pBrain->odom()->currentAbsOmega() > 0.01 )
-				usleep( 100000 );
-
-			this->fetch( this->pBrain->cbha()->isHolding() );
-			sleep( 1 ); // Let Robotino get up to speed
-		}
-	}
-
-	bool checkKinect( std::string requesterName )
+	bool checkKinect( std::string requesterName, std::ostream & out )
 	{
 		if ( ! this->pBrain->kinectIsAvailable() )
 		{
-			std::cerr << requesterName  << " requires Kinect!" << std::endl;
+			out << requesterName  << " requires Kinect!" << std::endl;
 			return false;
 		}
 		return true;
@@ -454,18 +1413,19 @@ class Control
 	 * Robotino drive to this coordinate.
 	 *
 	 * @param	input	A string parsable to a coordinate
+	 * @param	out	Stream for messages
 	 */
-	bool goTo( std::string input )
+	bool goTo( std::string input, std::ostream & out )
 	{
 		this->pBrain->drive()->stopPointing();
 		Coordinate * destination = this->parseCoordinate( input );
 		if ( destination == NULL )
 		{
-			std::cerr << "Unable to parse coordinate, try again" << std::endl;
+			out << "Unable to parse coordinate, try again" << std::endl;
 			return false;
 		}
 
-		std::cerr << "Driving to coordinate " << * destination << std::endl;
+		out << "Driving to coordinate " << * destination << std::endl;
 		this->pBrain->drive()->setDestination( * destination );
 		this->pBrain->drive()->go();
 		delete destination;
@@ -477,17 +1437,18 @@ class Control
 	 * Robotino turn to point at the coordinate.
 	 *
 	 * @param	input	A string parsable to a coordinate
+	 * @param	out	Stream for messages
 	 */
-	bool pointAt( std::string input )
+	bool pointAt( std::string input, std::ostream & out )
 	{
 		Coordinate * target = this->parseCoordinate( input );
 		if ( target == NULL )
 		{
-			std::cerr << "Unable to parse coordinate, try again" << std::endl;
+			out << "Unable to parse coordinate, try again" << std::endl;
 			return false;
 		}
 
-		std::cerr << "Pointing to coordinate " << * target << std::endl;
+		out << "Pointing to coordinate " << * target << std::endl;
 		this->pBrain->drive()->setPointAt( * target );
 		delete target;
 		return true;
@@ -518,248 +1479,65 @@ class Control
 			std::cerr << "Could not aquire floats from \"" << input << "\"" << std::endl;
 			return NULL;
 		}
-
-		return new Coordinate( x, y );
-	}
-
-	/**
-	 * Make Robotino continuosly drive to the coordinate of a hand tracked
-	 * by a Kinect.
-	 */
-	void driveToKinectPos()
-	{
-		if ( ! this->checkKinect( "DriveToKinectPos" ) ) return;
-
-		while ( ! this->_stop )
+		catch ( const std::out_of_range & ex )
 		{
-			if ( this->pBrain->kinect()->isUpdated() )
-			{
-				VolumeCoordinate vc = this->pBrain->kinect()->getCoordinate();
-				this->pBrain->drive()->setDestination( vc );
-				usleep ( CONTROL_KINECT_WAIT );
-			}
-			else
-			{
-				usleep( CONTROL_KINECT_WAIT );
-			}
+			std::cerr << "Coordinate out of range in \"" << input << "\"" << std::endl;
+			return NULL;
 		}
-	}
-
-	/**
-	 * Make Robotino continuosly turn to the coordinate of a hand tracked
-	 * by a Kinect.
-	 */
-	void turnToKinectPos()
-	{
-		if ( ! this->checkKinect( "TurnToKinectPos" ) ) return;
 
-		while ( ! this->_stop )
+		// Also reachable from the network, inf and nan must not become
+		// targets
+		if ( ! std::isfinite( x ) || ! std::isfinite( y ) )
 		{
-			if ( this->pBrain->kinect()->isUpdated() )
-			{
-				VolumeCoordinate vc = this->pBrain->kinect()->getCoordinate();
-				this->pBrain->drive()->setPointAt( vc );
-				usleep ( CONTROL_KINECT_WAIT );
-			}
-			else
-			{
-				usleep( CONTROL_KINECT_WAIT );
-			}
+			std::cerr << "Coordinate out of range in \"" << input << "\"" << std::endl;
+			return NULL;
 		}
-	}
 
-	/**
-	 * A test routine to verify that the cBHA is operational
-	 */
-	void cbhaTest()
-	{
-		this->pBrain->cbha()->rotateHorisontal();
-		sleep( 4 );
-		this->pBrain->cbha()->rotateVertical();
-		sleep( 4 );
-		this->pBrain->cbha()->rotateRelax();
-		sleep( 5 );
-		this->pBrain->cbha()->innerToCoordinate( Coordinate( 0.0, 1.0 ) );
-		this->pBrain->cbha()->outerToCoordinate( Coordinate( 0.0, 1.0 ) );
-		sleep( 10 );
-		this->pBrain->cbha()->armRelax();
+		return new Coordinate( x, y );
 	}
-	
+
 	/**
-	 * Make Robotinos cBHA mimic the motions of a hand tracket by a Kinect.
+	 * Builds a test routine to verify that the cBHA is operational, played by
+	 * the Brain without blocking the prompt
 	 *
-	 * @param	mirror	(default) Robotino will mirror the hans motions. If you
-	 * have Robotino facing away from you, set this to false.
+	 * @return	The test trajectory
 	 */
-	void cbhaMimic( bool mirror = true )
+	CbhaTrajectory cbhaTestTrajectory()
 	{
-		if ( ! this->checkKinect( "Mimic" ) ) return;
-
-		VolumeCoordinate
-			zero( 1.5, 0, 1.0 ); // Provide a relatively central point if Click-calibration does not work
-
-		unsigned int
-			earliestNewCalibration = 0;
-
-		while ( ! this->_stop )
-		{
-			if ( this->pBrain->kinect()->isUpdated()  )
-			{
-				if ( this->pBrain->kinect()->clickAge() < 500
-						&& this->pBrain->msecsElapsed() > earliestNewCalibration )
-				{
-					zero = this->pBrain->kinect()->getCoordinate();
-					earliestNewCalibration = this->pBrain->msecsElapsed() + 1000;
-					continue;
-				}
-
-				VolumeCoordinate vc = this->pBrain->kinect()->getCoordinate();
-
-				float x = vc.x() - zero.x();
-				float y = vc.y() - zero.y();
-				float z = vc.z() - zero.z();
-				
-				if ( ! mirror ) y *= -1;
-
-				this->pBrain->cbha()->outerToCoordinate( Coordinate( y * 2.0, z * 2.0 ) );
-				this->pBrain->cbha()->innerToCoordinate( Coordinate( y * 1.5, z * 1.5 ) );
-
-				if ( x > 0.1 )
-					this->pBrain->cbha()->rotateHorisontal();
-				else if (x < -0.1 )
-					this->pBrain->cbha()->rotateVertical();
-				else
-					this->pBrain->cbha()->rotateRelax();
-
-				if ( fabs( x ) > 0.2 )
-					this->pBrain->cbha()->grip();
-				else
-					this->pBrain->cbha()->release();
-			}
-			else
-				usleep( CONTROL_KINECT_WAIT );
-		}
-
-		this->pBrain->cbha()->rotateRelax();
-		this->pBrain->cbha()->armRelax();
-		this->pBrain->cbha()->release();
+		float p[ CBHA_BELLOWS_COUNT ] = { 0.0, 0.0, 0.0, 0.0, 0.0, 0.0, 0.0, 0.0 };
+		CbhaTrajectory trajectory;
+
+		// Rotate horisontal
+		p[ CBHA_ROTATE_HORISONTAL ] = CBHA_MAX_PRESSURE;
+		trajectory.addFrame( 0, p );
+		trajectory.addFrame( 3999, p );
+
+		// Rotate vertical
+		p[ CBHA_ROTATE_HORISONTAL ] = 0.0;
+		p[ CBHA_ROTATE_VERTICAL ] = CBHA_MAX_PRESSURE;
+		trajectory.addFrame( 4000, p );
+		trajectory.addFrame( 7999, p );
+
+		// Relax rotation
+		p[ CBHA_ROTATE_VERTICAL ] = 0.0;
+		trajectory.addFrame( 8000, p );
+		trajectory.addFrame( 12999, p );
+
+		// Both arm segments to ( 0, 1 )
+		const CbhaPressureTable * table = this->pBrain->cbha()->armPressureTable();
+		table->lookup( 0.0, 1.0, & p[ CBHA_INNER_OVER ], & p[ CBHA_INNER_LEFT ], & p[ CBHA_INNER_RIGHT ] );
+		table->lookup( 0.0, 1.0, & p[ CBHA_OUTER_OVER ], & p[ CBHA_OUTER_LEFT ], & p[ CBHA_OUTER_RIGHT ] );
+		trajectory.addFrame( 13000, p );
+		trajectory.addFrame( 22999, p );
+
+		// Relax arm
+		for ( unsigned int i = 0; i < CBHA_BELLOWS_COUNT; i++ )
+			p[ i ] = 0.0;
+		trajectory.addFrame( 23000, p );
+
+		return trajectory;
 	}
-
-
-	void calibratePositionToKinect()
-	{
-		if ( ! this->checkKinect( "CalibratePositionToKinect" ) ) return;
-
-		this->pBrain->drive()->setStopWithin( 0 );
-
-		std::cerr << "Performing odometry calibration, please wait..." << std::endl;
-
-		this->pBrain->cbha()->grip();
-		this->pBrain->drive()->niceStop();
-		sleep( 4 );
-
-		// Make sure Robotino is not driving
-		while ( this->pBrain->odom()->currentAbsSpeed() > 0.01 || this->pBrain->odom()->currentAbsOmega() > 0.01 )
-			usleep( 100000 );
-
-		/// @todo Improvement: Use current coordinate system, so this is not lost if calibration is aborted (not currently applicable).
-		this->pBrain->odom()->set( 0.0, 0.0, 0.0 );
 	
-		this->pBrain->cbha()->innerToCoordinate( 0.0, 0.4 );
-		this->pBrain->cbha()->outerToCoordinate( 0.0, 0.4 );
-		
-		std::cerr << "Wait for arm to reach position..." << std::endl;
-		while ( this->pBrain->cbha()->armTotalPressureDiff() > 0.1 )
-			usleep( 100000 );
-
-		std::cerr
-			<< "Stand beside Robotino and make sure Kinect is reading your hand.\n"
-			<< "Then, using your wrist, slightly push down on the tip of Robotinos gripper.\n"
-			<< "Robotino will, after a slight pause, drive 1 meter forward"
-			<< std::endl;
-
-		VolumeCoordinate kinectCoordinate0 = this->pBrain->cbha()->getTouchCoordinate();
-
-		std::cerr << "First coordinate stored : " << kinectCoordinate0 << "\nGet out of my way!" << std::endl;
-
-		this->pBrain->cbha()->innerToCoordinate( 0.0, 0.2 );
-		this->pBrain->cbha()->outerToCoordinate( 0.0, 0.2 );
-		usleep ( 500000 );
-
-		this->pBrain->drive()->setDestination( Coordinate( 1.0, 0.0 ) );
-		this->pBrain->drive()->go();
-		this->pBrain->drive()->setPointAt( Coordinate( 1000.0, 0.0 ) );
-		sleep ( 2 );
-
-		this->pBrain->cbha()->innerToCoordinate( 0.0, 0.4 );
-		this->pBrain->cbha()->outerToCoordinate( 0.0, 0.4 );
-
-		// Wait until Robotino is in position
-		while ( this->pBrain->odom()->currentAbsSpeed() > 0.01 || this->pBrain->odom()->currentAbsOmega() > 0.01 )
-			usleep( 100000 );
-
-		this->pBrain->drive()->niceStop();
-
-		std::cerr << "Wait for arm to reach position..." << std::endl;
-		while ( this->pBrain->cbha()->armTotalPressureDiff() > 0.1 )
-			usleep( 100000 );
-
-		std::cerr
-			<< "Again, using your wrist tracked by Kinect, slightly push down on the tip of Robotinos gripper."
-			<< std::endl;
-
-		VolumeCoordinate kinectCoordinate1 = this->pBrain->cbha()->getTouchCoordinate();
-		std::cerr << "Second coordinate stored: " << kinectCoordinate1 << std::endl;
-
-		// Get current odom position
-		AngularCoordinate odomPos1 = this->pBrain->odom()->getPosition();
-
-			// Calculate actual heading and position:
-		// This is done using the now known travel direction of Robotino, and
-		// the approximate distance between the touched arm and Robotinos
-		// center.
-		Vector odomDeviation = Coordinate( 0.0, 1.0 ).getVector( odomPos1 );
-		Angle phi;
-		Coordinate kinectCoordinate0Adjusted = kinectCoordinate0;
-		float kinectAngleDiff = 99.0;
-
-		while ( true )
-		{
-			Vector kinectVector = kinectCoordinate0Adjusted.getVector( kinectCoordinate1 );
-			kinectAngleDiff -= fabs( kinectVector.phi() );
-
-			kinectAngleDiff = fabs( kinectAngleDiff );
-
-			phi = Angle( kinectVector.phi() + odomPos1.phi() );
-
-			Coordinate convertedOdomDeviation = Vector( odomDeviation.magnitude(), phi.phi() ).cartesian();
-
-			kinectCoordinate0Adjusted = Coordinate(
-					kinectCoordinate0.x() + convertedOdomDeviation.x(),
-					kinectCoordinate0.y() + convertedOdomDeviation.y() );
-
-			if ( kinectAngleDiff > 0.01 ) break;
-			kinectAngleDiff = fabs( kinectVector.phi() );
-		}
-
-		// Calculate the arm offset to apply to the second kinect position
-		Coordinate armVector = Vector( CONTROL_CALIBRATE_ARM_DISPLACEMENT, phi.phi() ).cartesian();
-
-		// Calculate and apply coordinates and vector
-		float x = kinectCoordinate1.x() - armVector.x();
-		float y = kinectCoordinate1.y() - armVector.y();
-		if ( this->pBrain->odom()->set( x, y, phi.phi() ) )
-		{
-			usleep( 200000 );	// Give set a moment to take effect
-			std::cerr << "Calibration completed, new position set: " << this->pBrain->odom()->getPosition() << std::endl;
-		}
-
-		this->pBrain->cbha()->armRelax();
-		this->pBrain->cbha()->release();
-		this->pBrain->drive()->setDestination( this->pBrain->odom()->getPosition() );
-		this->pBrain->drive()->stopPointing();
-	}
-
 	void aheadAndBack( float distance )
 	{
 		if ( this->pBrain->isRunning() )
@@ -0,0 +1,480 @@
+/**
+ * @file	cbhaPatternReplay.cpp
+ * @brief	Replay test of the cBHA interaction patterns
+ *
+ * Simulates the string potentiometers and pressures of the cBHA through a
+ * sequence of interactions: an object pushed down into the gripper, the arm
+ * settling with the object after the grip, the object held and then lifted
+ * out, touches, and the arm moving by its own pressure. The signals are
+ * calculated once per Brain cycle by CbhaPatterns::signals(), and evaluated
+ * by a CbhaPatternEngine with the patterns of CbhaPatterns::define(), as
+ * _CompactBha does. The gripper follows the detections as
+ * _CompactBha::apply() does.
+ *
+ * Each interaction is labeled with the event it should give, if any, and
+ * the detections are compared with the labels. The hits, misses, false
+ * detections and the delay of the hits are printed, followed by the
+ * throughput of the engine on the replayed samples.
+ *
+ * The signals may be written to a file with -w, and a recorded file of
+ * signals, one sample per line as "time signal0 ... signal5", replayed with
+ * -f, printing the detections.
+ *
+ * Needs the RobotinoAPI2 headers for the constants in _CompactBha.h, but not
+ * the library.
+ *
+ * Usage: cbhaPatternReplay [options]
+ *	-n rounds	Number of rounds of the interactions, default 100
+ *	-s sigma	Noise of the potentiometer readings, default 0.001
+ *	-w file	Write the simulated signals to a file
+ *	-f file	Replay recorded signals from a file instead of simulating
+ */
+
+#include "../robotino/headers/_CompactBha.h"
+#include "../robotino/headers/CbhaPatternEngine.h"
+#include "../robotino/headers/CbhaPatterns.h"
+#include "../robotino/headers/RingWindow.h"
+#include "../robotino/headers/Brain.h"
+
+#include <stdlib.h>
+#include <unistd.h>
+#include <math.h>
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <random>
+
+
+	// Interactions
+
+/// Change of each over potentiometer per cycle when the arm is pushed down
+/// or lifted, about twice the grip threshold
+#define REPLAY_PUSH_RATE	0.006
+/// Cycles of pushing or lifting
+#define REPLAY_PUSH_CYCLES	8
+/// Change of the over potentiometers per cycle while the arm settles with
+/// the weight of a gripped object, upwards like a lift
+#define REPLAY_SETTLE_RATE	-0.005
+/// Cycles of settling after a grip
+#define REPLAY_SETTLE_CYCLES	4
+/// Change of an inner and outer potentiometer pair in the cycle of a touch
+#define REPLAY_TOUCH_STEP	0.015
+/// Pressure error while the arm moves by its own pressure, in bar
+#define REPLAY_MOVING_ERROR	0.3
+/// Milliseconds after the end of an interaction a detection is still
+/// counted as a hit
+#define REPLAY_TOLERANCE	500
+
+
+/// No event is expected
+#define REPLAY_NONE	-1
+
+
+/**
+ * A simulated interaction
+ */
+struct Interaction
+{
+	/// What happens, for printing
+	const char * name;
+	/// The number of cycles
+	unsigned int cycles;
+	/// The change of the over potentiometers per cycle
+	float downRate;
+	/// The change of a potentiometer pair in the first cycle
+	float touchStep;
+	/// The pressure error during the interaction
+	float pressureError;
+	/// The CBHA_EVENT_ expected, or REPLAY_NONE
+	int expected;
+	/// If the arm is moved by hand, which is also detected as touches
+	bool handled;
+};
+
+/**
+ * A sample of the signals, labeled with the event expected
+ */
+struct Sample
+{
+	unsigned int time;
+	float signals[ CBHA_SIGNAL_COUNT ];
+	/// The CBHA_EVENT_ expected in this interaction, or REPLAY_NONE
+	int expected;
+	/// The index of the interaction
+	unsigned int interaction;
+	/// If the arm is moved by hand in this interaction
+	bool handled;
+	/// The events detected, a bit for each CBHA_EVENT_ index
+	unsigned int detected;
+};
+
+/**
+ * A simulated interaction in a sequence, for scoring the detections
+ */
+struct Labeled
+{
+	/// The CBHA_EVENT_ index expected, or REPLAY_NONE
+	int expected;
+	/// The time of the first and last sample of the interaction
+	unsigned int start, end;
+	/// If the arm is moved by hand in the interaction
+	bool handled;
+	/// If the expected event has been detected
+	bool hit;
+};
+
+
+/**
+ * Gets the name of an event
+ *
+ * @param	event	The index of the event, or REPLAY_NONE
+ *
+ * @return	The name
+ */
+const char * eventName( int event )
+{
+	switch ( event )
+	{
+		case 0: return "touch";
+		case 1: return "recieve";
+		case 2: return "deliver";
+		default: return "none";
+	}
+}
+
+/**
+ * Simulates the interactions, with the gripper following the detections
+ *
+ * @param	interactions	The interactions of a round
+ * @param	rounds	The number of rounds
+ * @param	sigma	The noise of the potentiometers
+ * @param	samples	Output, the samples
+ */
+void simulate(
+		const std::vector<Interaction> & interactions,
+		unsigned int rounds,
+		float sigma,
+		std::vector<Sample> & samples )
+{
+	std::mt19937 random( 42 );
+	std::normal_distribution<float> noise( 0.0, sigma );
+
+	RingWindow<float, CBHA_DELTA_DEPTH>
+		pressureDeltas[ CBHA_BELLOWS_COUNT ],
+		potDeltas[ CBHA_STRINGPOTS_COUNT ];
+	float readPressures[ CBHA_BELLOWS_COUNT ] = { 0.0, 0.0, 0.0, 0.0, 0.0, 0.0, 0.0, 0.0 };
+	float targetPressures[ CBHA_BELLOWS_COUNT ] = { 0.0, 0.0, 0.0, 0.0, 0.0, 0.0, 0.0, 0.0 };
+	float pots[ CBHA_STRINGPOTS_COUNT ] = { 0.0, 0.0, 0.0, 0.0, 0.0, 0.0 };
+	float cyclePots[ CBHA_STRINGPOTS_COUNT ] = { 0.0, 0.0, 0.0, 0.0, 0.0, 0.0 };
+
+	CbhaPatternEngine engine( CBHA_SIGNAL_COUNT );
+	int ids[ CBHA_EVENT_COUNT ];
+	CbhaPatterns::define( engine, ids );
+
+	bool holding = false, gripping = false, releasing = false;
+	unsigned int time = 0, gripDoneTime = 0, releaseDoneTime = 0;
+
+	for ( unsigned int r = 0; r < rounds; r++ )
+	{
+		for ( unsigned int i = 0; i < interactions.size(); i++ )
+		{
+			const Interaction & interaction = interactions[ i ];
+
+			for ( unsigned int c = 0; c < interaction.cycles; c++ )
+			{
+				time += BRAIN_LOOP_TIME;
+
+				for ( unsigned int p = 0; p < CBHA_STRINGPOTS_COUNT; p++ )
+					pots[ p ] += noise( random );
+				pots[ CBHA_INNER_OVER ] += interaction.downRate;
+				pots[ CBHA_OUTER_OVER ] += interaction.downRate;
+				if ( c == 0 )
+				{
+					pots[ CBHA_INNER_RIGHT ] += interaction.touchStep;
+					pots[ CBHA_OUTER_RIGHT ] += interaction.touchStep;
+				}
+
+				// One delta per cycle, as _CompactBha::analyze()
+				for ( unsigned int p = 0; p < CBHA_STRINGPOTS_COUNT; p++ )
+				{
+					potDeltas[ p ].push( pots[ p ] - cyclePots[ p ] );
+					cyclePots[ p ] = pots[ p ];
+				}
+
+				// The pressures follow their targets unless the arm is moving
+				// by its own pressure, the first bellow lagging behind
+				readPressures[ 0 ] = targetPressures[ 0 ] + interaction.pressureError;
+				pressureDeltas[ 0 ].push( interaction.pressureError / 10 );
+
+				Sample sample;
+				sample.time = time;
+				sample.expected = interaction.expected;
+				sample.handled = interaction.handled;
+				sample.interaction = ( r * interactions.size() ) + i;
+
+				CbhaPatterns::signals(
+						readPressures,
+						targetPressures,
+						pressureDeltas,
+						potDeltas,
+						! holding && ! gripping && time > releaseDoneTime,
+						holding && ! releasing,
+						sample.signals );
+
+				// The gripper, as _CompactBha::apply()
+				unsigned int fired = engine.evaluate( sample.signals, time );
+				sample.detected = 0;
+				for ( unsigned int e = 0; e < CBHA_EVENT_COUNT; e++ )
+					if ( fired & ( 1u << ids[ e ] ) ) sample.detected |= ( 1u << e );
+				if ( ( fired & ( 1u << ids[ 1 ] ) ) && ! gripping && ! holding )
+				{
+					gripping = true;
+					releasing = false;
+					releaseDoneTime = 0;
+					gripDoneTime = time + CBHA_GRIP_TIME_MSECS;
+				}
+				if ( ( fired & ( 1u << ids[ 2 ] ) ) && ! releasing && holding )
+				{
+					releasing = true;
+					gripping = false;
+					releaseDoneTime = time + CBHA_RELEASE_TIME_MSECS;
+				}
+				if ( gripping && time > gripDoneTime )
+				{
+					gripping = false;
+					holding = true;
+					engine.reset();
+				}
+				if ( releasing && time > releaseDoneTime )
+				{
+					releasing = false;
+					holding = false;
+				}
+
+				samples.push_back( sample );
+			}
+		}
+	}
+}
+
+/**
+ * Reads recorded signals, one sample per line
+ *
+ * @param	fileName	The file
+ * @param	samples	Output, the samples, with no events expected
+ *
+ * @return	Success of reading
+ */
+bool readSamples( const char * fileName, std::vector<Sample> & samples )
+{
+	std::ifstream file( fileName );
+	if ( ! file ) return false;
+
+	std::string line;
+	while ( std::getline( file, line ) )
+	{
+		if ( line.empty() || line[ 0 ] == '#' ) continue;
+
+		std::istringstream fields( line );
+		Sample sample;
+		sample.expected = REPLAY_NONE;
+		sample.interaction = samples.size();
+		sample.handled = false;
+		sample.detected = 0;
+		fields >> sample.time;
+		for ( unsigned int s = 0; s < CBHA_SIGNAL_COUNT; s++ )
+			fields >> sample.signals[ s ];
+		if ( fields.fail() )
+		{
+			std::cerr << "Malformed sample \"" << line << "\"" << std::endl;
+			return false;
+		}
+		samples.push_back( sample );
+	}
+
+	return true;
+}
+
+int main( int argc, char * argv[] )
+{
+	long
+		rounds = 100;
+
+	float
+		sigma = 0.001;
+
+	const char
+		* writeFile = NULL,
+		* replayFile = NULL;
+
+	bool
+		failed = false;
+
+	int option;
+	while ( ( option = getopt( argc, argv, "n:s:w:f:" ) ) != -1 )
+	{
+		switch ( option )
+		{
+			case 'n': rounds = atol( optarg ); break;
+			case 's': sigma = atof( optarg ); break;
+			case 'w': writeFile = optarg; break;
+			case 'f': replayFile = optarg; break;
+			default:
+				std::cerr << "Usage: " << argv[ 0 ] << " [-n rounds] [-s sigma] [-w file] [-f file]" << std::endl;
+				return EXIT_FAILURE;
+		}
+	}
+	if ( rounds < 1 ) rounds = 1;
+
+	// The settling after a grip moves the arm like the start of a lift, and
+	// must not be taken for a deliver
+	std::vector<Interaction> interactions;
+	interactions.push_back( { "idle", 20, 0.0, 0.0, 0.0, REPLAY_NONE, false } );
+	interactions.push_back( { "push down", REPLAY_PUSH_CYCLES, REPLAY_PUSH_RATE, 0.0, 0.0, 1, true } );
+	interactions.push_back( { "gripping", ( CBHA_GRIP_TIME_MSECS / BRAIN_LOOP_TIME ) - REPLAY_PUSH_CYCLES + 2, 0.0, 0.0, 0.0, REPLAY_NONE, false } );
+	interactions.push_back( { "settling", REPLAY_SETTLE_CYCLES, REPLAY_SETTLE_RATE, 0.0, 0.0, REPLAY_NONE, true } );
+	interactions.push_back( { "holding", 30, 0.0, 0.0, 0.0, REPLAY_NONE, false } );
+	interactions.push_back( { "lift", REPLAY_PUSH_CYCLES, -REPLAY_PUSH_RATE, 0.0, 0.0, 2, true } );
+	interactions.push_back( { "releasing", ( CBHA_RELEASE_TIME_MSECS / BRAIN_LOOP_TIME ) + 2, 0.0, 0.0, 0.0, REPLAY_NONE, false } );
+	interactions.push_back( { "touch", 6, 0.0, REPLAY_TOUCH_STEP, 0.0, 0, true } );
+	interactions.push_back( { "idle", 10, 0.0, 0.0, 0.0, REPLAY_NONE, false } );
+	interactions.push_back( { "moving down", REPLAY_PUSH_CYCLES, REPLAY_PUSH_RATE, REPLAY_TOUCH_STEP, REPLAY_MOVING_ERROR, REPLAY_NONE, false } );
+	interactions.push_back( { "moving up", REPLAY_PUSH_CYCLES, -REPLAY_PUSH_RATE, 0.0, REPLAY_MOVING_ERROR, REPLAY_NONE, false } );
+
+	std::vector<Sample> samples;
+	if ( replayFile != NULL )
+	{
+		if ( ! readSamples( replayFile, samples ) )
+		{
+			std::cerr << "Could not read " << replayFile << std::endl;
+			return EXIT_FAILURE;
+		}
+	}
+	else
+		simulate( interactions, rounds, sigma, samples );
+
+	if ( writeFile != NULL )
+	{
+		std::ofstream file( writeFile );
+		file << "# time";
+		for ( unsigned int s = 0; s < CBHA_SIGNAL_COUNT; s++ )
+			file << " signal" << s;
+		file << std::endl;
+		for ( unsigned int i = 0; i < samples.size(); i++ )
+		{
+			file << samples[ i ].time;
+			for ( unsigned int s = 0; s < CBHA_SIGNAL_COUNT; s++ )
+				file << " " << samples[ i ].signals[ s ];
+			file << std::endl;
+		}
+	}
+
+	CbhaPatternEngine engine( CBHA_SIGNAL_COUNT );
+	int ids[ CBHA_EVENT_COUNT ];
+	CbhaPatterns::define( engine, ids );
+
+	if ( replayFile != NULL )
+	{
+		// The recorded ready signals already follow the detections, only the
+		// reset of the patterns when a grip completes is repeated
+		for ( unsigned int i = 0; i < samples.size(); i++ )
+		{
+			if ( i > 0 && samples[ i ].signals[ CBHA_SIGNAL_RELEASE_READY ] > 0.5
+					&& samples[ i - 1 ].signals[ CBHA_SIGNAL_RELEASE_READY ] < 0.5 )
+				engine.reset();
+
+			unsigned int fired = engine.evaluate( samples[ i ].signals, samples[ i ].time );
+			for ( unsigned int e = 0; e < CBHA_EVENT_COUNT; e++ )
+				if ( fired & ( 1u << ids[ e ] ) )
+					std::cout << samples[ i ].time << " " << eventName( e ) << std::endl;
+		}
+	}
+	else
+	{
+		// Compares the detections with the labels of the interactions. A
+		// detection is a hit if it is the event of the current interaction,
+		// or of an interaction ended at most REPLAY_TOLERANCE before.
+		std::vector<Labeled> labels;
+		for ( unsigned int i = 0; i < samples.size(); i++ )
+		{
+			if ( i == 0 || samples[ i ].interaction != samples[ i - 1 ].interaction )
+				labels.push_back( { samples[ i ].expected, samples[ i ].time, samples[ i ].time, samples[ i ].handled, false } );
+			labels.back().end = samples[ i ].time;
+		}
+
+		unsigned long long
+			hits[ CBHA_EVENT_COUNT ] = { 0, 0, 0 },
+			misses[ CBHA_EVENT_COUNT ] = { 0, 0, 0 },
+			falses[ CBHA_EVENT_COUNT ] = { 0, 0, 0 },
+			delays[ CBHA_EVENT_COUNT ] = { 0, 0, 0 },
+			incidental = 0;
+
+		for ( unsigned int i = 0; i < samples.size(); i++ )
+		{
+			for ( unsigned int e = 0; e < CBHA_EVENT_COUNT; e++ )
+			{
+				if ( ! ( samples[ i ].detected & ( 1u << e ) ) ) continue;
+
+				bool hit = false, handled = false;
+				for ( int l = samples[ i ].interaction; l >= 0; l-- )
+				{
+					Labeled & label = labels[ l ];
+					if ( label.end + REPLAY_TOLERANCE < samples[ i ].time ) break;
+					if ( label.handled ) handled = true;
+					if ( label.expected != (int) e || label.hit ) continue;
+
+					label.hit = true;
+					hits[ e ]++;
+					delays[ e ] += samples[ i ].time - label.start;
+					hit = true;
+					break;
+				}
+				if ( hit ) continue;
+
+				// Moving the arm by hand is also a touch
+				if ( e == 0 && handled )
+					incidental++;
+				else
+					falses[ e ]++;
+			}
+		}
+
+		for ( unsigned int l = 0; l < labels.size(); l++ )
+			if ( labels[ l ].expected != REPLAY_NONE && ! labels[ l ].hit )
+				misses[ labels[ l ].expected ]++;
+
+		std::cout
+			<< rounds << " rounds of " << interactions.size() << " interactions, "
+			<< samples.size() << " samples, noise " << sigma << std::endl;
+		for ( unsigned int e = 0; e < CBHA_EVENT_COUNT; e++ )
+		{
+			std::cout
+				<< "  " << eventName( e ) << ": " << hits[ e ] << " hits, "
+				<< misses[ e ] << " misses, " << falses[ e ] << " false";
+			if ( hits[ e ] > 0 ) std::cout << ", mean delay " << ( delays[ e ] / hits[ e ] ) << " ms";
+			if ( e == 0 ) std::cout << ", " << incidental << " while moved by hand";
+			std::cout << std::endl;
+			if ( misses[ e ] > 0 || falses[ e ] > 0 ) failed = true;
+		}
+	}
+
+	// Throughput of the engine over the samples
+	unsigned int repeats = 1 + ( 10000000 / ( samples.size() + 1 ) );
+	unsigned int total = 0;
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	for ( unsigned int r = 0; r < repeats; r++ )
+		for ( unsigned int i = 0; i < samples.size(); i++ )
+			total += engine.evaluate( samples[ i ].signals, samples[ i ].time + ( r * samples.back().time ) );
+	double nsecs = std::chrono::duration_cast<std::chrono::nanoseconds>(
+			std::chrono::steady_clock::now() - start ).count() / ( (double) repeats * samples.size() );
+
+	std::cout
+		<< "Engine: " << nsecs << " ns per sample for 3 patterns ("
+		<< (long) ( 1000000000.0 / nsecs ) << " samples/s)" << std::endl;
+	if ( total == 0xffffffff ) std::cout << total << std::endl;
+
+	return failed ? EXIT_FAILURE : EXIT_SUCCESS;
+}
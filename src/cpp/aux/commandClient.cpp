@@ -0,0 +1,244 @@
+/**
+ * @file	commandClient.cpp
+ * @brief	Client for the CommandServer, for scripting and benchmarking
+ *
+ * Sends commands to a running Brain and prints the replies. The commands
+ * are given as arguments, one command per argument, or read from standard
+ * input one per line, letting a script drive the robot:
+ *
+ *	commandClient "goto 1.0 0.5" "pointat 2.0 0.0"
+ *	commandClient < mission.txt
+ *
+ * With -n the commands are repeated as a benchmark, keeping up to -w
+ * commands in flight, and the round trip time and the time from receipt to
+ * execution reported by the server are summarised.
+ *
+ * Usage: commandClient [options] [command ...]
+ *	-h host		Host running the Brain, default 127.0.0.1
+ *	-p port		Port of the CommandServer, default 5200
+ *	-n count	Send the commands count times in total and print latencies
+ *	-w window	Commands in flight during a benchmark, default 1
+ *	-q		Print only the status of each reply
+ */
+
+#include "../tcp/TcpSocket.h"
+#include "../tcp/CommandServer.h"
+
+#include <arpa/inet.h>
+#include <sys/uio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <iostream>
+#include <string>
+#include <vector>
+#include <deque>
+#include <algorithm>
+#include <chrono>
+#include <stdexcept>
+
+
+/**
+ * Sends one command, framed by its length
+ *
+ * @param	socket	The connection
+ * @param	command	The command
+ *
+ * @return	Success of sending
+ */
+bool sendCommand( TcpSocket & socket, const std::string & command )
+{
+	uint32_t length = htonl( command.size() );
+
+	struct iovec frames[ 2 ];
+	frames[ 0 ].iov_base = & length;
+	frames[ 0 ].iov_len = COMMANDSERVER_HEADER_SIZE;
+	frames[ 1 ].iov_base = const_cast<char *>( command.data() );
+	frames[ 1 ].iov_len = command.size();
+
+	return socket.writeFrames( frames, 2 );
+}
+
+/**
+ * Waits for one reply and splits it into its parts
+ *
+ * @param	socket	The connection
+ * @param	status	Output, the status of the command
+ * @param	usecs	Output, microseconds from receipt to execution
+ * @param	output	Output, the text written by the command
+ *
+ * @return	Success of receiving
+ */
+bool readReply( TcpSocket & socket, std::string & status, long & usecs, std::string & output )
+{
+	const char * data;
+	uint32_t length;
+
+	if ( ! socket.readBytes( data, COMMANDSERVER_HEADER_SIZE ) ) return false;
+	memcpy( & length, data, COMMANDSERVER_HEADER_SIZE );
+	length = ntohl( length );
+
+	if ( length > TCPSOCKET_READ_BUFFER_SIZE )
+	{
+		std::cerr << "Reply of " << length << " bytes too long" << std::endl;
+		return false;
+	}
+	if ( ! socket.readBytes( data, length ) ) return false;
+
+	std::string reply( data, length );
+	size_t space = reply.find( ' ' );
+	size_t newline = reply.find( '\n' );
+	if ( space == std::string::npos || newline == std::string::npos || space > newline )
+	{
+		std::cerr << "Malformed reply \"" << reply << "\"" << std::endl;
+		return false;
+	}
+
+	status = reply.substr( 0, space );
+	usecs = atol( reply.substr( space + 1, newline - space - 1 ).c_str() );
+	output = reply.substr( newline + 1 );
+	return true;
+}
+
+/**
+ * Prints a summary of latencies
+ *
+ * @param	name	What was measured
+ * @param	usecs	The latencies in microseconds, sorted in place
+ */
+void printLatencies( const char * name, std::vector<long> & usecs )
+{
+	if ( usecs.empty() ) return;
+
+	std::sort( usecs.begin(), usecs.end() );
+
+	long long total = 0;
+	for ( unsigned int i = 0; i < usecs.size(); i++ )
+		total += usecs[ i ];
+
+	std::cout
+		<< name << " (us): min " << usecs.front()
+		<< ", mean " << ( total / (long long) usecs.size() )
+		<< ", p50 " << usecs[ usecs.size() / 2 ]
+		<< ", p99 " << usecs[ ( usecs.size() * 99 ) / 100 ]
+		<< ", max " << usecs.back() << std::endl;
+}
+
+int main( int argc, char * argv[] )
+{
+	std::string
+		host = "127.0.0.1",
+		port = "5200";
+
+	long
+		count = 0,
+		window = 1;
+
+	bool
+		quiet = false;
+
+	int option;
+	while ( ( option = getopt( argc, argv, "h:p:n:w:q" ) ) != -1 )
+	{
+		switch ( option )
+		{
+			case 'h': host = optarg; break;
+			case 'p': port = optarg; break;
+			case 'n': count = atol( optarg ); break;
+			case 'w': window = atol( optarg ); break;
+			case 'q': quiet = true; break;
+			default:
+				std::cerr
+					<< "Usage: " << argv[ 0 ] << " [-h host] [-p port] [-n count] [-w window] [-q]"
+					<< " [command ...]" << std::endl;
+				return EXIT_FAILURE;
+		}
+	}
+
+	std::vector<std::string> commands( argv + optind, argv + argc );
+	if ( commands.empty() )
+	{
+		std::string line;
+		while ( std::getline( std::cin, line ) )
+			if ( ! line.empty() ) commands.push_back( line );
+	}
+	if ( commands.empty() ) return EXIT_SUCCESS;
+
+	if ( count <= 0 ) count = commands.size();
+	if ( window < 1 ) window = 1;
+	if ( window > COMMANDSERVER_QUEUE_SIZE ) window = COMMANDSERVER_QUEUE_SIZE;
+	bool benchmark = ( count != (long) commands.size() || window > 1 );
+
+	TcpSocket * socket;
+	try
+	{
+		socket = new TcpSocket( port, host );
+	}
+	catch ( std::runtime_error * e )
+	{
+		std::cerr << "Could not connect to " << host << ":" << port << ": " << e->what() << std::endl;
+		delete e;
+		return EXIT_FAILURE;
+	}
+
+	std::deque<std::chrono::steady_clock::time_point> inFlight;
+	std::vector<long> roundTrips, executions;
+	long sent = 0, failed = 0;
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+	for ( long received = 0; received < count; received++ )
+	{
+		// Keep the window full
+		while ( sent < count && (long) inFlight.size() < window )
+		{
+			inFlight.push_back( std::chrono::steady_clock::now() );
+			if ( ! sendCommand( * socket, commands[ sent % commands.size() ] ) )
+			{
+				std::cerr << "Sending failed" << std::endl;
+				delete socket;
+				return EXIT_FAILURE;
+			}
+			sent++;
+		}
+
+		std::string status, output;
+		long usecs;
+		if ( ! readReply( * socket, status, usecs, output ) )
+		{
+			std::cerr << "Connection lost" << std::endl;
+			delete socket;
+			return EXIT_FAILURE;
+		}
+
+		roundTrips.push_back( std::chrono::duration_cast<std::chrono::microseconds>(
+				std::chrono::steady_clock::now() - inFlight.front() ).count() );
+		inFlight.pop_front();
+		executions.push_back( usecs );
+		if ( status != "OK" ) failed++;
+
+		if ( benchmark ) continue;
+		if ( quiet )
+			std::cout << status << std::endl;
+		else
+			std::cout << status << " " << usecs << " us\n" << output << std::flush;
+	}
+
+	if ( benchmark )
+	{
+		double seconds = std::chrono::duration_cast<std::chrono::microseconds>(
+				std::chrono::steady_clock::now() - start ).count() / 1000000.0;
+
+		std::cout
+			<< count << " commands, window " << window << ", " << failed << " not OK, "
+			<< (long) ( count / seconds ) << " commands/s" << std::endl;
+		printLatencies( "Round trip", roundTrips );
+		printLatencies( "Receipt to executed", executions );
+		std::cout << "Over target of " << COMMANDSERVER_LATENCY_TARGET << " us: "
+			<< std::count_if( executions.begin(), executions.end(),
+					[]( long usecs ) { return usecs > COMMANDSERVER_LATENCY_TARGET; } )
+			<< std::endl;
+	}
+
+	delete socket;
+	return ( failed == 0 ) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,653 @@
+/**
+ * @file	kinectEmulator.cpp
+ * @brief	Emulator of the Kinect server, for testing KinectReader locally
+ *
+ * Serves hand coordinates the way the Kinect server does, synthesised or
+ * replayed from a recording, at rates from 30 Hz to 10 kHz. Clicks, split
+ * and merged writes and disconnects can be injected to exercise the reader.
+ *
+ * Clients offering the binary protocol (KINECTREADER_BINARY_HELLO) get
+ * KinectRecord records, other clients get text lines. With -u the records
+ * are sent as UDP datagrams to clients sending hello datagrams.
+ *
+ * A recording is the text stream of a server, one "x,y,z" or "Click" line
+ * per sample, e.g. captured with: nc [kinect server] 5000 > hand.txt, or
+ * aux/kinectHand.txt
+ *
+ * Usage: kinectEmulator [options]
+ *	-p port		Port to listen on, default 5000
+ *	-r rate		Samples per second, 30 to 10000, default 30
+ *	-f file		Replay a recording in a loop instead of synthesising
+ *	-j joints	Joints per sample, binary protocol only, default 1
+ *	-c msecs	Inject a click every msecs
+ *	-m count	Merge the samples of count ticks into one write
+ *	-s		Split each write in two, cutting lines and records
+ *	-d msecs	Disconnect the client every msecs
+ *	-t		Text protocol only, ignore the binary hello
+ *	-u		Send records as UDP datagrams
+ */
+
+#include "../tcp/TcpSocket.h"
+#include "../kinect/KinectReader.h"
+
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <time.h>
+#include <math.h>
+#include <errno.h>
+#include <unistd.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <signal.h>
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <stdexcept>
+
+
+/// Lowest rate in samples per second
+#define EMULATOR_RATE_MIN	30
+/// Highest rate in samples per second
+#define EMULATOR_RATE_MAX	10000
+/// Milliseconds to wait for the binary hello after a client connects
+#define EMULATOR_HELLO_WAIT	200
+/// Milliseconds without hello datagrams before a UDP client is dropped
+#define EMULATOR_UDP_TIMEOUT	( 2 * KINECTREADER_UDP_TIMEOUT )
+/// Milliseconds behind schedule after which the schedule restarts instead
+/// of catching up with a burst
+#define EMULATOR_MAX_LAG	100
+/// Milliseconds between statistics
+#define EMULATOR_STATS_INTERVAL	1000
+
+
+	// Synthesised trajectory, Kinect coordinates in millimeters
+
+/// Distance of the hand from the Kinect
+#define EMULATOR_HAND_DEPTH	1500.0
+/// Height of the hand relative to the Kinect
+#define EMULATOR_HAND_HEIGHT	-200.0
+/// Half width of the figure eight traced by the hand
+#define EMULATOR_HAND_WIDTH	300.0
+/// Seconds to trace the figure eight once
+#define EMULATOR_HAND_PERIOD	2.0
+
+
+/// Set by SIGINT to end the program
+static volatile sig_atomic_t running = 1;
+
+/**
+ * Stops the emulator on SIGINT
+ */
+static void interrupt( int )
+{
+	running = 0;
+}
+
+/**
+ * Gets a monotonic time
+ *
+ * @return	Microseconds since an arbitrary point
+ */
+static long long monotonicMicros()
+{
+	struct timespec now;
+	clock_gettime( CLOCK_MONOTONIC, & now );
+	return ( (long long) now.tv_sec * 1000000 ) + ( now.tv_nsec / 1000 );
+}
+
+/**
+ * Gets the wall clock time used for record timestamps
+ *
+ * @return	Microseconds since the epoch
+ */
+static uint64_t epochMicros()
+{
+	struct timespec now;
+	clock_gettime( CLOCK_REALTIME, & now );
+	return ( (uint64_t) now.tv_sec * 1000000 ) + ( now.tv_nsec / 1000 );
+}
+
+
+/**
+ * Serves emulated Kinect samples to one client at a time
+ */
+class KinectEmulator
+{
+ public:
+	std::string
+	/// Port to listen on
+		port,
+	/// Recording to replay, synthesised if empty
+		recordingFile;
+
+	unsigned int
+	/// Samples per second
+		rate,
+	/// Joints per sample in the binary protocol
+		joints,
+	/// Milliseconds between clicks, 0 for none
+		clickInterval,
+	/// Ticks merged into one write
+		merge,
+	/// Milliseconds between disconnects, 0 for none
+		disconnectInterval;
+
+	bool
+	/// If writes are split in two
+		split,
+	/// If the binary hello is ignored
+		textOnly,
+	/// If records are sent as UDP datagrams
+		udp;
+
+	/**
+	 * Constructs the emulator with the default options
+	 */
+	KinectEmulator()
+	{
+		this->port = "5000";
+		this->rate = EMULATOR_RATE_MIN;
+		this->joints = 1;
+		this->clickInterval = 0;
+		this->merge = 1;
+		this->disconnectInterval = 0;
+		this->split = false;
+		this->textOnly = false;
+		this->udp = false;
+		this->sequence = 0;
+		this->tick = 0;
+	}
+
+	/**
+	 * Loads the recording, if any
+	 *
+	 * @return	Success of loading
+	 */
+	bool load()
+	{
+		if ( this->recordingFile.empty() ) return true;
+
+		std::ifstream file( this->recordingFile.c_str() );
+		std::string line;
+		while ( std::getline( file, line ) )
+		{
+			if ( ! line.empty() && line[ line.size() - 1 ] == '\r' ) line.erase( line.size() - 1 );
+			if ( ! line.empty() ) this->recording.push_back( line );
+		}
+
+		if ( this->recording.empty() )
+		{
+			std::cerr << "No samples in " << this->recordingFile << std::endl;
+			return false;
+		}
+
+		std::cerr << "Replaying " << this->recording.size() << " lines from " << this->recordingFile << std::endl;
+		return true;
+	}
+
+	/**
+	 * Serves TCP clients until interrupted
+	 */
+	void serveTcp()
+	{
+		TcpSocket * pServer;
+		try
+		{
+			pServer = new TcpSocket( const_cast<char *>( this->port.c_str() ) );
+		}
+		catch ( std::runtime_error * e )
+		{
+			std::cerr << "Could not listen on port " << this->port << ": " << e->what() << std::endl;
+			delete e;
+			return;
+		}
+
+		std::cerr << "Listening on port " << this->port << " at " << this->rate << " Hz" << std::endl;
+
+		while ( running )
+		{
+			TcpSocket * pClient = this->waitForClient( pServer );
+			if ( pClient == NULL ) continue;
+
+			bool binary = this->waitForHello( pClient );
+			std::cerr << "Client connected, " << ( binary ? "binary" : "text" ) << " protocol" << std::endl;
+
+			if ( binary )
+			{
+				std::string hello = KINECTREADER_BINARY_HELLO "\n";
+				pClient->write( hello );
+			}
+
+			this->stream( pClient, binary );
+			delete pClient;
+			std::cerr << "Client disconnected" << std::endl;
+		}
+
+		delete pServer;
+	}
+
+	/**
+	 * Serves UDP clients until interrupted, sending to the address of the
+	 * latest hello datagram
+	 */
+	void serveUdp()
+	{
+		int socketFD = socket( AF_INET6, SOCK_DGRAM | SOCK_NONBLOCK, 0 );
+		int off = 0;
+		setsockopt( socketFD, IPPROTO_IPV6, IPV6_V6ONLY, & off, sizeof( off ) );
+
+		struct sockaddr_in6 address;
+		memset( & address, 0, sizeof( address ) );
+		address.sin6_family = AF_INET6;
+		address.sin6_addr = in6addr_any;
+		address.sin6_port = htons( atoi( this->port.c_str() ) );
+
+		if ( socketFD == -1 || bind( socketFD, (struct sockaddr *) & address, sizeof( address ) ) == -1 )
+		{
+			std::cerr << "Could not bind UDP port " << this->port << ": " << strerror( errno ) << std::endl;
+			if ( socketFD != -1 ) close( socketFD );
+			return;
+		}
+
+		std::cerr << "Listening for UDP clients on port " << this->port << " at " << this->rate << " Hz" << std::endl;
+
+		struct sockaddr_storage client;
+		socklen_t clientLength = 0;
+		long long lastHello = 0;
+
+		this->startSchedule();
+		while ( running )
+		{
+			// Take hello datagrams, the latest sender is the client
+			char hello[ 64 ];
+			struct sockaddr_storage sender;
+			socklen_t senderLength = sizeof( sender );
+			ssize_t length;
+			while ( ( length = recvfrom( socketFD, hello, sizeof( hello ), 0, (struct sockaddr *) & sender, & senderLength ) ) >= 0 )
+			{
+				if ( (size_t) length >= strlen( KINECTREADER_BINARY_HELLO )
+						&& memcmp( hello, KINECTREADER_BINARY_HELLO, strlen( KINECTREADER_BINARY_HELLO ) ) == 0 )
+				{
+					if ( clientLength == 0 ) std::cerr << "UDP client subscribed" << std::endl;
+					memcpy( & client, & sender, senderLength );
+					clientLength = senderLength;
+					lastHello = monotonicMicros();
+				}
+				senderLength = sizeof( sender );
+			}
+
+			if ( clientLength != 0 && monotonicMicros() - lastHello > EMULATOR_UDP_TIMEOUT * 1000LL )
+			{
+				std::cerr << "UDP client lost" << std::endl;
+				clientLength = 0;
+			}
+
+			std::string records;
+			this->sample( records, true );
+			if ( clientLength != 0 )
+			{
+				// One record per datagram
+				for ( size_t pos = 0; pos < records.size(); pos += KINECTREADER_RECORD_SIZE )
+					if ( sendto( socketFD, records.data() + pos, KINECTREADER_RECORD_SIZE, 0,
+							(struct sockaddr *) & client, clientLength ) == -1 )
+						this->failedWrites++;
+				this->samplesSent += records.size() / KINECTREADER_RECORD_SIZE;
+			}
+
+			this->waitForTick();
+		}
+
+		close( socketFD );
+	}
+
+ private:
+	/// The lines of the recording
+	std::vector<std::string>
+		recording;
+
+	/// Sequence number of the next record
+	uint32_t
+		sequence;
+
+	unsigned long long
+	/// Ticks since the start
+		tick,
+	/// Records or lines sent since the last statistics
+		samplesSent,
+	/// Clicks sent since the last statistics
+		clicksSent,
+	/// Writes failed or dropped since the last statistics
+		failedWrites,
+	/// Ticks late by more than a tick since the last statistics
+		lateTicks;
+
+	long long
+	/// Monotonic time of the start of the schedule, in microseconds
+		scheduleStart,
+	/// Monotonic time of the next tick
+		nextTick,
+	/// Monotonic time of the last click
+		lastClick,
+	/// Monotonic time of the last statistics
+		lastStats,
+	/// Longest write since the last statistics, in microseconds
+		maxWrite;
+
+	/**
+	 * Waits for a client to connect
+	 *
+	 * @param	pServer	The listening socket
+	 *
+	 * @return	The client, NULL if interrupted or on errors
+	 */
+	TcpSocket * waitForClient( TcpSocket * pServer )
+	{
+		struct pollfd listening;
+		listening.fd = pServer->serverDescriptor();
+		listening.events = POLLIN;
+		listening.revents = 0;
+
+		if ( poll( & listening, 1, 500 ) <= 0 ) return NULL;
+
+		TcpSocket * pClient = pServer->acceptClient();
+		if ( pClient == NULL ) return NULL;
+
+		// Send each write as its own segment, keeping split writes split
+		int noDelay = 1;
+		setsockopt( pClient->descriptor(), IPPROTO_TCP, TCP_NODELAY, & noDelay, sizeof( noDelay ) );
+		return pClient;
+	}
+
+	/**
+	 * Waits briefly for the binary hello from a new client
+	 *
+	 * @param	pClient	The client
+	 *
+	 * @return	If the binary protocol is to be used
+	 */
+	bool waitForHello( TcpSocket * pClient )
+	{
+		long long deadline = monotonicMicros() + ( EMULATOR_HELLO_WAIT * 1000LL );
+
+		while ( monotonicMicros() < deadline )
+		{
+			const char * line;
+			unsigned int length;
+			if ( pClient->readLine( line, length ) )
+				return ( ! this->textOnly && strcmp( line, KINECTREADER_BINARY_HELLO ) == 0 );
+
+			if ( ! pClient->isConnected() ) return false;
+
+			struct pollfd connection;
+			connection.fd = pClient->descriptor();
+			connection.events = POLLIN;
+			connection.revents = 0;
+			poll( & connection, 1, 10 );
+		}
+
+		return false;
+	}
+
+	/**
+	 * Streams samples to a client until it disconnects, it is to be
+	 * disconnected or the program is interrupted
+	 *
+	 * @param	pClient	The client
+	 * @param	binary	If records are sent instead of lines
+	 */
+	void stream( TcpSocket * pClient, bool binary )
+	{
+		long long connected = monotonicMicros();
+		std::string pending;
+		unsigned int ticks = 0;
+
+		this->startSchedule();
+		while ( running && pClient->isConnected() )
+		{
+			// Discard anything sent by the client, noticing disconnects
+			const char * line;
+			unsigned int length;
+			while ( pClient->readLine( line, length ) );
+
+			this->sample( pending, binary );
+
+			if ( ++ticks >= this->merge )
+			{
+				if ( ! this->send( pClient, pending ) ) break;
+				this->samplesSent += binary
+					? pending.size() / KINECTREADER_RECORD_SIZE
+					: ticks;
+				pending.clear();
+				ticks = 0;
+			}
+
+			if ( this->disconnectInterval != 0
+					&& monotonicMicros() - connected > this->disconnectInterval * 1000LL )
+			{
+				std::cerr << "Disconnecting client" << std::endl;
+				break;
+			}
+
+			this->waitForTick();
+		}
+	}
+
+	/**
+	 * Sends a write to a client, split in two if requested
+	 *
+	 * @param	pClient	The client
+	 * @param	data	The data to send
+	 *
+	 * @return	Success of sending
+	 */
+	bool send( TcpSocket * pClient, const std::string & data )
+	{
+		long long start = monotonicMicros();
+		bool success;
+
+		if ( this->split && data.size() > 1 )
+		{
+			size_t half = data.size() / 2;
+			success = pClient->write( data.data(), half )
+				&& pClient->write( data.data() + half, data.size() - half );
+		}
+		else
+			success = pClient->write( data );
+
+		long long duration = monotonicMicros() - start;
+		if ( duration > this->maxWrite ) this->maxWrite = duration;
+		if ( ! success ) this->failedWrites++;
+		return success;
+	}
+
+	/**
+	 * Appends the samples of the current tick, and a click if one is due
+	 *
+	 * @param	output	The data to append to
+	 * @param	binary	If records are appended instead of lines
+	 */
+	void sample( std::string & output, bool binary )
+	{
+		long long now = monotonicMicros();
+
+		if ( this->clickInterval != 0 && now - this->lastClick >= this->clickInterval * 1000LL )
+		{
+			this->lastClick = now;
+			this->clicksSent++;
+			if ( binary )
+				this->appendRecord( output, KINECTREADER_RECORD_CLICK, 0, 0.0, 0.0, 0.0 );
+			else
+				output.append( "Click\n" );
+		}
+
+		if ( ! this->recording.empty() )
+		{
+			const std::string & line = this->recording[ this->tick % this->recording.size() ];
+			float x, y, z;
+
+			if ( line == "Click" ) this->clicksSent++;
+
+			if ( ! binary )
+				output.append( line ).append( "\n" );
+			else if ( line == "Click" )
+				this->appendRecord( output, KINECTREADER_RECORD_CLICK, 0, 0.0, 0.0, 0.0 );
+			else if ( sscanf( line.c_str(), "%f,%f,%f", & x, & y, & z ) == 3 )
+				this->appendRecord( output, KINECTREADER_RECORD_SAMPLE, 0, x, y, z );
+		}
+		else
+		{
+			// A figure eight in front of the Kinect, joints trailing by a
+			// tenth of a period each
+			double seconds = ( now - this->scheduleStart ) / 1000000.0;
+			unsigned int count = binary ? this->joints : 1;
+
+			for ( unsigned int joint = 0; joint < count; joint++ )
+			{
+				double phase = 2.0 * M_PI * ( seconds / EMULATOR_HAND_PERIOD - joint * 0.1 );
+				float x = EMULATOR_HAND_WIDTH * sin( phase ),
+					y = EMULATOR_HAND_HEIGHT + ( 0.5 * EMULATOR_HAND_WIDTH * sin( 2.0 * phase ) ),
+					z = EMULATOR_HAND_DEPTH + ( 0.3 * EMULATOR_HAND_WIDTH * cos( phase ) );
+
+				if ( binary )
+					this->appendRecord( output, KINECTREADER_RECORD_SAMPLE, joint, x, y, z );
+				else
+				{
+					char line[ 64 ];
+					snprintf( line, sizeof( line ), "%.1f,%.1f,%.1f\n", x, y, z );
+					output.append( line );
+				}
+			}
+		}
+
+		this->tick++;
+	}
+
+	/**
+	 * Appends a binary record
+	 *
+	 * @param	output	The data to append to
+	 * @param	type	The record type
+	 * @param	joint	The joint
+	 * @param	x, y, z	The coordinates in millimeters
+	 */
+	void appendRecord( std::string & output, uint8_t type, uint8_t joint, float x, float y, float z )
+	{
+		KinectRecord record;
+		memset( & record, 0, sizeof( record ) );
+		record.timestamp = epochMicros();
+		record.sequence = this->sequence++;
+		record.type = type;
+		record.joint = joint;
+		record.x = x;
+		record.y = y;
+		record.z = z;
+
+		output.append( (const char *) & record, sizeof( record ) );
+	}
+
+	/**
+	 * Restarts the tick schedule and the statistics
+	 */
+	void startSchedule()
+	{
+		this->scheduleStart = monotonicMicros();
+		this->nextTick = this->scheduleStart;
+		this->lastClick = this->scheduleStart;
+		this->lastStats = this->scheduleStart;
+		this->samplesSent = 0;
+		this->clicksSent = 0;
+		this->failedWrites = 0;
+		this->lateTicks = 0;
+		this->maxWrite = 0;
+	}
+
+	/**
+	 * Sleeps until the next tick, printing statistics when due
+	 */
+	void waitForTick()
+	{
+		long long period = 1000000 / this->rate;
+		this->nextTick += period;
+
+		long long now = monotonicMicros();
+		if ( now - this->nextTick > period ) this->lateTicks++;
+		if ( now - this->nextTick > EMULATOR_MAX_LAG * 1000LL ) this->nextTick = now;
+
+		if ( now - this->lastStats >= EMULATOR_STATS_INTERVAL * 1000LL )
+		{
+			double seconds = ( now - this->lastStats ) / 1000000.0;
+			std::cerr
+				<< "Sent " << this->samplesSent << " samples (" << (int) ( this->samplesSent / seconds ) << "/s), "
+				<< this->clicksSent << " clicks, " << this->failedWrites << " failed writes, "
+				<< this->lateTicks << " late ticks, max write " << this->maxWrite << " usecs" << std::endl;
+
+			this->lastStats = now;
+			this->samplesSent = 0;
+			this->clicksSent = 0;
+			this->failedWrites = 0;
+			this->lateTicks = 0;
+			this->maxWrite = 0;
+		}
+
+		struct timespec due;
+		due.tv_sec = this->nextTick / 1000000;
+		due.tv_nsec = ( this->nextTick % 1000000 ) * 1000;
+		clock_nanosleep( CLOCK_MONOTONIC, TIMER_ABSTIME, & due, NULL );
+	}
+};
+
+
+/**
+ * Parses the options and runs the emulator
+ */
+int main( int argc, char * argv[] )
+{
+	KinectEmulator emulator;
+
+	int option;
+	while ( ( option = getopt( argc, argv, "p:r:f:j:c:m:d:stu" ) ) != -1 )
+	{
+		switch ( option )
+		{
+			case 'p': emulator.port = optarg; break;
+			case 'r': emulator.rate = atoi( optarg ); break;
+			case 'f': emulator.recordingFile = optarg; break;
+			case 'j': emulator.joints = atoi( optarg ); break;
+			case 'c': emulator.clickInterval = atoi( optarg ); break;
+			case 'm': emulator.merge = atoi( optarg ); break;
+			case 'd': emulator.disconnectInterval = atoi( optarg ); break;
+			case 's': emulator.split = true; break;
+			case 't': emulator.textOnly = true; break;
+			case 'u': emulator.udp = true; break;
+			default:
+				std::cerr
+					<< "Usage: " << argv[ 0 ] << " [-p port] [-r rate] [-f recording] [-j joints]"
+					<< " [-c click msecs] [-m merge] [-s] [-d disconnect msecs] [-t] [-u]" << std::endl;
+				return EXIT_FAILURE;
+		}
+	}
+
+	if ( emulator.rate < EMULATOR_RATE_MIN ) emulator.rate = EMULATOR_RATE_MIN;
+	if ( emulator.rate > EMULATOR_RATE_MAX ) emulator.rate = EMULATOR_RATE_MAX;
+	if ( emulator.joints < 1 ) emulator.joints = 1;
+	if ( emulator.joints > KINECTREADER_JOINTS ) emulator.joints = KINECTREADER_JOINTS;
+	if ( emulator.merge < 1 ) emulator.merge = 1;
+
+	if ( ! emulator.load() ) return EXIT_FAILURE;
+
+	signal( SIGINT, interrupt );
+	signal( SIGPIPE, SIG_IGN );
+
+	if ( emulator.udp )
+		emulator.serveUdp();
+	else
+		emulator.serveTcp();
+
+	std::cerr << "Emulator stopped" << std::endl;
+	return EXIT_SUCCESS;
+}
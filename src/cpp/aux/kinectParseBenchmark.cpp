@@ -0,0 +1,197 @@
+/**
+ * @file	kinectParseBenchmark.cpp
+ * @brief	Benchmark of KinectReader::parseCoordinate() against the parsing
+ * it replaced
+ *
+ * KinectReader used to read each line of the text protocol into a
+ * std::string, find the commas and convert each value with
+ * atof( substr() ). This generates lines as sent by the Kinect server,
+ * coordinates in millimeters with some "Click" lines in between, parses
+ * them both ways, checks that the values agree, and prints the lines per
+ * second and the allocations per line. Some malformed lines are checked to
+ * be rejected.
+ *
+ * Usage: kinectParseBenchmark [options]
+ *	-n count	Lines parsed per run, default 1000000
+ *	-c ratio	Ratio of "Click" lines, default 0.01
+ */
+
+#include "../kinect/KinectReader.h"
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <unistd.h>
+#include <math.h>
+#include <string.h>
+#include <iostream>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <random>
+#include <new>
+
+
+/// The number of allocations made, counted by operator new
+static unsigned long long allocations = 0;
+
+// Not inlined, as inlining makes g++ warn that the memory from operator new
+// is released by free()
+__attribute__(( noinline )) void * operator new( size_t size )
+{
+	allocations++;
+	void * memory = malloc( size );
+	if ( memory == NULL ) throw std::bad_alloc();
+	return memory;
+}
+
+__attribute__(( noinline )) void operator delete( void * memory ) noexcept
+{
+	free( memory );
+}
+
+/**
+ * Parses a line as KinectReader did before parsing in place
+ *
+ * @param	input	The line, as read into a string
+ * @param	x	Output, the x value
+ * @param	y	Output, the y value
+ * @param	z	Output, the z value
+ *
+ * @return	Boolean indicating if the line held a coordinate
+ */
+bool
+substrCoordinate( const std::string & input, float & x, float & y, float & z )
+{
+	size_t endx = input.find( ',', 0 );
+	if ( endx == std::string::npos ) return false;
+	size_t endy = input.find( ',', endx + 1 );
+	if ( endy == std::string::npos ) return false;
+
+	x = (float) atof( input.substr( 0, endx ).c_str() );
+	y = (float) atof( input.substr( endx + 1, endy ).c_str() );
+	z = (float) atof( input.substr( endy + 1 ).c_str() );
+	return true;
+}
+
+int main( int argc, char * argv[] )
+{
+	long
+		count = 1000000;
+
+	float
+		clickRatio = 0.01;
+
+	int option;
+	while ( ( option = getopt( argc, argv, "n:c:" ) ) != -1 )
+	{
+		switch ( option )
+		{
+			case 'n': count = atol( optarg ); break;
+			case 'c': clickRatio = atof( optarg ); break;
+			default:
+				std::cerr << "Usage: " << argv[ 0 ] << " [-n count] [-c ratio]" << std::endl;
+				return EXIT_FAILURE;
+		}
+	}
+	if ( count < 1 ) count = 1;
+
+	// Lines as TcpSocket::readLine() returns them, null terminated in the
+	// read buffer, with a hand moving in front of the Kinect
+	std::mt19937 random( 42 );
+	std::uniform_real_distribution<float> uniform( 0.0, 1.0 );
+	std::vector<char> buffer;
+	std::vector<unsigned int> starts;
+	char line[ 64 ];
+	for ( long i = 0; i < count; i++ )
+	{
+		if ( uniform( random ) < clickRatio )
+			snprintf( line, sizeof( line ), "Click" );
+		else
+			snprintf( line, sizeof( line ), "%.3f,%.3f,%.3f",
+					-600.0 + 1200.0 * uniform( random ),
+					-400.0 + 800.0 * uniform( random ),
+					800.0 + 2400.0 * uniform( random ) );
+
+		starts.push_back( buffer.size() );
+		buffer.insert( buffer.end(), line, line + strlen( line ) + 1 );
+	}
+
+	unsigned long long before;
+	unsigned long parsed = 0, clicks = 0, disagreements = 0;
+	double sum = 0.0;
+	float x, y, z;
+
+	// In place, as KinectReader::handleLine()
+	before = allocations;
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	for ( long i = 0; i < count; i++ )
+	{
+		const char * begin = & buffer[ starts[ i ] ];
+		const char * end = begin + strlen( begin );
+
+		if ( KinectReader::isClick( begin, end ) )
+			clicks++;
+		else if ( KinectReader::parseCoordinate( begin, end, x, y, z ) )
+		{
+			parsed++;
+			sum += x + y + z;
+		}
+	}
+	double inPlaceSecs = std::chrono::duration<double>( std::chrono::steady_clock::now() - start ).count();
+	double inPlaceAllocations = ( allocations - before ) / (double) count;
+
+	// Into a string and with substr(), as before
+	double substrSum = 0.0;
+	before = allocations;
+	start = std::chrono::steady_clock::now();
+	for ( long i = 0; i < count; i++ )
+	{
+		std::string input( & buffer[ starts[ i ] ] );
+
+		if ( input == "Click" ) continue;
+		if ( substrCoordinate( input, x, y, z ) ) substrSum += x + y + z;
+	}
+	double substrSecs = std::chrono::duration<double>( std::chrono::steady_clock::now() - start ).count();
+	double substrAllocations = ( allocations - before ) / (double) count;
+
+	// Checks that both give the same values, strtof() and atof() may
+	// round differently in the last bit
+	for ( long i = 0; i < count; i++ )
+	{
+		const char * begin = & buffer[ starts[ i ] ];
+		float ox, oy, oz;
+		bool inPlace = KinectReader::parseCoordinate( begin, begin + strlen( begin ), x, y, z );
+		bool substr = substrCoordinate( std::string( begin ), ox, oy, oz );
+		if ( inPlace != substr
+				|| ( inPlace && ( fabs( x - ox ) > 1e-3 || fabs( y - oy ) > 1e-3 || fabs( z - oz ) > 1e-3 ) ) )
+			disagreements++;
+	}
+
+	// Malformed lines must be rejected, also when followed by another line
+	const char * rejected[] = { "", "1,2", "1,2,", ",2,3", "1,,3", "Click", "1,2,\n4" };
+	unsigned int accepted = 0;
+	for ( unsigned int i = 0; i < sizeof( rejected ) / sizeof( rejected[ 0 ] ); i++ )
+	{
+		const char * end = strchr( rejected[ i ], '\n' );
+		if ( end == NULL ) end = rejected[ i ] + strlen( rejected[ i ] );
+		if ( KinectReader::parseCoordinate( rejected[ i ], end, x, y, z ) )
+		{
+			std::cout << "Malformed line accepted: \"" << rejected[ i ] << "\"" << std::endl;
+			accepted++;
+		}
+	}
+
+	std::cout
+		<< count << " lines, " << parsed << " coordinates and " << clicks << " clicks" << std::endl
+		<< "  substr/atof:     " << ( count / substrSecs / 1e6 ) << " M lines/s, "
+		<< substrAllocations << " allocations per line" << std::endl
+		<< "  parseCoordinate: " << ( count / inPlaceSecs / 1e6 ) << " M lines/s, "
+		<< inPlaceAllocations << " allocations per line" << std::endl;
+	if ( disagreements > 0 )
+		std::cout << "Values differ on " << disagreements << " lines!" << std::endl;
+
+	// Keeps the sums from being optimized away
+	if ( sum + substrSum == 0.12345 ) std::cout << sum << std::endl;
+
+	return ( disagreements == 0 && accepted == 0 ) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,279 @@
+/**
+ * @file	kinectTransportBenchmark.cpp
+ * @brief	Worst case latency of KinectReader over TCP against UDP
+ *
+ * Serves KinectRecord records on the loopback interface, once over TCP and
+ * once as UDP datagrams, to a KinectReader running on a Reactor, and prints
+ * the latency, drops and stale records it measured for each transport.
+ *
+ * The loopback interface does not lose packets, so losses are emulated at
+ * the server. A record lost over TCP holds back every newer record until it
+ * is retransmitted, emulated by holding the records for the retransmission
+ * timeout, 200 milliseconds at least on Linux. A lost datagram is only
+ * missing, and the reader counts it as dropped from the sequence numbers.
+ *
+ * Usage: kinectTransportBenchmark [options]
+ *	-r rate		Records per second, default 100
+ *	-s secs		Duration of each run, default 5
+ *	-l interval	Records between losses, 0 for none, default 100
+ *	-t msecs	Retransmission timeout of a lost TCP segment, default 200
+ *	-p port		Port of the TCP server, the UDP server uses the next, default 47330
+ */
+
+#include "../kinect/KinectReader.h"
+#include "../tcp/Reactor.h"
+
+#include <rec/robotino/api2/Com.h>
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <iostream>
+#include <string>
+#include <vector>
+#include <thread>
+#include <chrono>
+
+
+/// Milliseconds the reader is given to connect before records are sent
+#define BENCHMARK_CONNECT_WAIT	1000
+/// Milliseconds the reader is given to read the last records
+#define BENCHMARK_DRAIN_WAIT	500
+
+
+/**
+ * Makes a record captured now, in the middle of the Kinect view
+ *
+ * @param	sequence	The sequence number
+ *
+ * @return	The record
+ */
+KinectRecord
+makeRecord( uint32_t sequence )
+{
+	struct timespec now;
+	clock_gettime( CLOCK_REALTIME, & now );
+
+	KinectRecord record;
+	memset( & record, 0, sizeof( record ) );
+	record.timestamp = ( (uint64_t) now.tv_sec * 1000000 ) + ( now.tv_nsec / 1000 );
+	record.sequence = sequence;
+	record.type = KINECTREADER_RECORD_SAMPLE;
+	record.x = 100.0;
+	record.y = 200.0;
+	record.z = 2000.0;
+	return record;
+}
+
+/**
+ * Opens a socket bound to a port on the loopback interface
+ *
+ * @param	type	SOCK_STREAM or SOCK_DGRAM
+ * @param	port	The port
+ *
+ * @return	The descriptor, -1 on failure
+ */
+int
+bindLoopback( int type, unsigned int port )
+{
+	int descriptor = socket( AF_INET, type, 0 );
+	if ( descriptor == -1 ) return -1;
+
+	int reuse = 1;
+	setsockopt( descriptor, SOL_SOCKET, SO_REUSEADDR, & reuse, sizeof( reuse ) );
+
+	struct sockaddr_in address;
+	memset( & address, 0, sizeof( address ) );
+	address.sin_family = AF_INET;
+	address.sin_port = htons( port );
+	address.sin_addr.s_addr = htonl( INADDR_LOOPBACK );
+	if ( bind( descriptor, (struct sockaddr *) & address, sizeof( address ) ) == -1
+			|| ( type == SOCK_STREAM && listen( descriptor, 1 ) == -1 ) )
+	{
+		close( descriptor );
+		return -1;
+	}
+
+	return descriptor;
+}
+
+/**
+ * Sends the records of a run at the given rate, over a connected TCP socket
+ * or as datagrams to a UDP client, emulating losses
+ *
+ * @param	descriptor	The socket
+ * @param	client	The address of the UDP client, NULL for TCP
+ * @param	clientLength	The length of the address
+ * @param	rate	Records per second
+ * @param	secs	The duration
+ * @param	loss	Records between losses, 0 for none
+ * @param	retransmit	Milliseconds a lost TCP segment holds back the stream
+ */
+void
+sendRecords( int descriptor, const struct sockaddr * client, socklen_t clientLength,
+		unsigned int rate, unsigned int secs, unsigned int loss, unsigned int retransmit )
+{
+	std::vector<KinectRecord> held;
+	std::chrono::steady_clock::time_point
+		next = std::chrono::steady_clock::now(),
+		holdUntil = next;
+
+	for ( uint32_t sequence = 0; sequence < rate * secs; sequence++ )
+	{
+		std::this_thread::sleep_until( next );
+		next += std::chrono::microseconds( 1000000 / rate );
+
+		KinectRecord record = makeRecord( sequence );
+		bool lost = ( loss > 0 && sequence % loss == loss - 1 );
+
+		if ( client != NULL )
+		{
+			// Only the lost datagram is missing
+			if ( ! lost )
+				sendto( descriptor, & record, sizeof( record ), 0, client, clientLength );
+			continue;
+		}
+
+		// Everything after a lost segment waits for its retransmission
+		if ( lost )
+			holdUntil = std::chrono::steady_clock::now() + std::chrono::milliseconds( retransmit );
+
+		held.push_back( record );
+		if ( std::chrono::steady_clock::now() >= holdUntil )
+		{
+			send( descriptor, & held[ 0 ], held.size() * sizeof( KinectRecord ), MSG_NOSIGNAL );
+			held.clear();
+		}
+	}
+
+	if ( client == NULL && ! held.empty() )
+		send( descriptor, & held[ 0 ], held.size() * sizeof( KinectRecord ), MSG_NOSIGNAL );
+}
+
+/**
+ * Serves one TCP client, answering the binary hello
+ *
+ * @param	server	The listening socket
+ * @param	rate, secs, loss, retransmit	As for sendRecords()
+ */
+void
+serveTcp( int server, unsigned int rate, unsigned int secs, unsigned int loss, unsigned int retransmit )
+{
+	int client = accept( server, NULL, NULL );
+	if ( client == -1 ) return;
+
+	// The reader offers the binary protocol with a line of its own
+	char hello[ 64 ];
+	if ( recv( client, hello, sizeof( hello ), 0 ) > 0 )
+	{
+		std::string reply = KINECTREADER_BINARY_HELLO "\n";
+		send( client, reply.data(), reply.size(), MSG_NOSIGNAL );
+		usleep( BENCHMARK_CONNECT_WAIT * 1000 );
+		sendRecords( client, NULL, 0, rate, secs, loss, retransmit );
+		usleep( BENCHMARK_DRAIN_WAIT * 1000 );
+	}
+
+	close( client );
+}
+
+/**
+ * Serves the UDP client sending the first hello datagram
+ *
+ * @param	server	The bound socket
+ * @param	rate, secs, loss, retransmit	As for sendRecords()
+ */
+void
+serveUdp( int server, unsigned int rate, unsigned int secs, unsigned int loss, unsigned int retransmit )
+{
+	char hello[ 64 ];
+	struct sockaddr_storage client;
+	socklen_t clientLength = sizeof( client );
+	if ( recvfrom( server, hello, sizeof( hello ), 0, (struct sockaddr *) & client, & clientLength ) == -1 )
+		return;
+
+	usleep( BENCHMARK_CONNECT_WAIT * 1000 );
+	sendRecords( server, (struct sockaddr *) & client, clientLength, rate, secs, loss, retransmit );
+	usleep( BENCHMARK_DRAIN_WAIT * 1000 );
+}
+
+/**
+ * Runs a KinectReader against one of the servers and prints what it measured
+ *
+ * @param	pCom	The Com giving the reader its clock
+ * @param	udp	If the records are sent as datagrams
+ * @param	port	The port of the server
+ * @param	rate, secs, loss, retransmit	As for sendRecords()
+ *
+ * @return	Boolean indicating if the server could be started
+ */
+bool
+run( rec::robotino::api2::Com * pCom, bool udp, unsigned int port,
+		unsigned int rate, unsigned int secs, unsigned int loss, unsigned int retransmit )
+{
+	int server = bindLoopback( udp ? SOCK_DGRAM : SOCK_STREAM, port );
+	if ( server == -1 )
+	{
+		std::cerr << "Could not bind port " << port << ": " << strerror( errno ) << std::endl;
+		return false;
+	}
+
+	std::thread serving( udp ? serveUdp : serveTcp, server, rate, secs, loss, retransmit );
+
+	Reactor reactor;
+	std::thread reacting( & Reactor::run, & reactor );
+	KinectReader reader( "127.0.0.1", std::to_string( port ), pCom, udp );
+	reader.start( & reactor );
+
+	serving.join();
+	reactor.stop();
+	reacting.join();
+	reader.stopLoop();
+	close( server );
+
+	std::cout << ( udp ? "UDP" : "TCP" ) << ", " << ( rate * secs ) << " records";
+	if ( loss > 0 ) std::cout << ", " << ( rate * secs / loss ) << " lost";
+	std::cout << std::endl;
+	reader.connectionToString( std::cout );
+
+	return true;
+}
+
+int main( int argc, char * argv[] )
+{
+	unsigned int
+		rate = 100,
+		secs = 5,
+		loss = 100,
+		retransmit = 200,
+		port = 47330;
+
+	int option;
+	while ( ( option = getopt( argc, argv, "r:s:l:t:p:" ) ) != -1 )
+	{
+		switch ( option )
+		{
+			case 'r': rate = atoi( optarg ); break;
+			case 's': secs = atoi( optarg ); break;
+			case 'l': loss = atoi( optarg ); break;
+			case 't': retransmit = atoi( optarg ); break;
+			case 'p': port = atoi( optarg ); break;
+			default:
+				std::cerr << "Usage: " << argv[ 0 ] << " [-r rate] [-s secs] [-l interval] [-t msecs] [-p port]" << std::endl;
+				return EXIT_FAILURE;
+		}
+	}
+	if ( rate < 1 ) rate = 1;
+	if ( rate > 1000000 ) rate = 1000000;
+	if ( secs < 1 ) secs = 1;
+
+	rec::robotino::api2::Com com( "kinectTransportBenchmark", true, true );
+
+	if ( ! run( & com, false, port, rate, secs, loss, retransmit ) ) return EXIT_FAILURE;
+	if ( ! run( & com, true, port + 1, rate, secs, loss, retransmit ) ) return EXIT_FAILURE;
+
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,245 @@
+/**
+ * @file	lineExtractorBenchmark.cpp
+ * @brief	Benchmark of the LineExtractor on simulated scans
+ *
+ * Simulates scans of a rectangular room with a box standing in it, as seen
+ * by a URG-04LX from a number of positions, with gaussian range noise and
+ * dropped beams. Each scan is run through the LineExtractor, and the time
+ * per scan, the number of features against the number of beams and the
+ * error of the extracted walls are printed.
+ *
+ * Usage: lineExtractorBenchmark [options]
+ *	-n scans	Number of scans, default 10000
+ *	-s sigma	Standard deviation of the range noise in meters, default 0.01
+ *	-d ratio	Ratio of dropped beams, default 0.02
+ */
+
+#include "../robotino/headers/LineExtractor.h"
+
+#include <stdlib.h>
+#include <unistd.h>
+#include <math.h>
+#include <iostream>
+#include <vector>
+#include <algorithm>
+#include <chrono>
+#include <random>
+
+
+	// Scanner, like the URG-04LX on Robotino
+
+/// Number of beams in a scan
+#define BENCHMARK_BEAMS	683
+/// Angle of the first beam, in rad
+#define BENCHMARK_ANGLE_MIN	-2.0944
+/// Angle between two beams, in rad
+#define BENCHMARK_ANGLE_INCREMENT	0.00613
+/// Minimum valid range, in meters
+#define BENCHMARK_RANGE_MIN	0.02
+/// Maximum valid range, in meters
+#define BENCHMARK_RANGE_MAX	5.6
+
+
+	// Room
+
+/// Half the width of the room along x, in meters
+#define BENCHMARK_ROOM_X	2.5
+/// Half the depth of the room along y, in meters
+#define BENCHMARK_ROOM_Y	1.8
+/// Half the side of the box, in meters
+#define BENCHMARK_BOX_SIZE	0.3
+/// Center of the box along x, in meters
+#define BENCHMARK_BOX_X	1.2
+/// Center of the box along y, in meters
+#define BENCHMARK_BOX_Y	-0.6
+/// Number of scanner positions simulated
+#define BENCHMARK_POSES	16
+
+
+/**
+ * A wall segment of the simulated room, by its end points
+ */
+struct Wall
+{
+	float x1, y1, x2, y2;
+};
+
+/**
+ * Casts a ray against the walls
+ *
+ * @param	walls	The walls
+ * @param	x	Start of the ray along x
+ * @param	y	Start of the ray along y
+ * @param	angle	Direction of the ray
+ *
+ * @return	Distance to the nearest wall, or a huge value if none is hit
+ */
+float cast( const std::vector<Wall> & walls, float x, float y, float angle )
+{
+	float dx = cos( angle ), dy = sin( angle ), nearest = 1e9;
+
+	for ( unsigned int i = 0; i < walls.size(); i++ )
+	{
+		const Wall & w = walls[ i ];
+		float ex = w.x2 - w.x1, ey = w.y2 - w.y1;
+		float denominator = dx * ey - dy * ex;
+		if ( fabs( denominator ) < 1e-9 ) continue;
+
+		float t = ( ( w.x1 - x ) * ey - ( w.y1 - y ) * ex ) / denominator;
+		float u = ( ( w.x1 - x ) * dy - ( w.y1 - y ) * dx ) / denominator;
+		if ( t > 0 && u >= 0 && u <= 1 && t < nearest ) nearest = t;
+	}
+
+	return nearest;
+}
+
+int main( int argc, char * argv[] )
+{
+	long
+		count = 10000;
+
+	float
+		sigma = 0.01,
+		dropRatio = 0.02;
+
+	int option;
+	while ( ( option = getopt( argc, argv, "n:s:d:" ) ) != -1 )
+	{
+		switch ( option )
+		{
+			case 'n': count = atol( optarg ); break;
+			case 's': sigma = atof( optarg ); break;
+			case 'd': dropRatio = atof( optarg ); break;
+			default:
+				std::cerr << "Usage: " << argv[ 0 ] << " [-n scans] [-s sigma] [-d ratio]" << std::endl;
+				return EXIT_FAILURE;
+		}
+	}
+	if ( count < 1 ) count = 1;
+
+	std::vector<Wall> walls;
+	float rx = BENCHMARK_ROOM_X, ry = BENCHMARK_ROOM_Y;
+	float bx = BENCHMARK_BOX_X, by = BENCHMARK_BOX_Y, bs = BENCHMARK_BOX_SIZE;
+	walls.push_back( { -rx, -ry, rx, -ry } );
+	walls.push_back( { rx, -ry, rx, ry } );
+	walls.push_back( { rx, ry, -rx, ry } );
+	walls.push_back( { -rx, ry, -rx, -ry } );
+	walls.push_back( { bx - bs, by - bs, bx + bs, by - bs } );
+	walls.push_back( { bx + bs, by - bs, bx + bs, by + bs } );
+	walls.push_back( { bx + bs, by + bs, bx - bs, by + bs } );
+	walls.push_back( { bx - bs, by + bs, bx - bs, by - bs } );
+
+	// Precalculates noisy scans from a circle of poses, facing different ways
+	std::mt19937 random( 42 );
+	std::normal_distribution<float> noise( 0.0, sigma );
+	std::uniform_real_distribution<float> uniform( 0.0, 1.0 );
+
+	std::vector< std::vector<float> > scans( BENCHMARK_POSES, std::vector<float>( BENCHMARK_BEAMS ) );
+	float poseX[ BENCHMARK_POSES ], poseY[ BENCHMARK_POSES ], posePhi[ BENCHMARK_POSES ];
+	for ( unsigned int p = 0; p < BENCHMARK_POSES; p++ )
+	{
+		float around = ( 2 * M_PI * p ) / BENCHMARK_POSES;
+		poseX[ p ] = -0.8 + 0.6 * cos( around );
+		poseY[ p ] = 0.6 * sin( around );
+		posePhi[ p ] = around;
+
+		for ( unsigned int i = 0; i < BENCHMARK_BEAMS; i++ )
+		{
+			float angle = posePhi[ p ] + BENCHMARK_ANGLE_MIN + i * BENCHMARK_ANGLE_INCREMENT;
+			float range = cast( walls, poseX[ p ], poseY[ p ], angle ) + noise( random );
+			if ( range > BENCHMARK_RANGE_MAX || uniform( random ) < dropRatio ) range = 0.0;
+			scans[ p ][ i ] = range;
+		}
+	}
+
+	LineExtractor extractor;
+	std::vector<long> nsecs;
+	nsecs.reserve( count );
+	unsigned long long lines = 0, corners = 0;
+	double rhoError = 0.0, alphaError = 0.0;
+	unsigned long long matched = 0, walled = 0;
+
+	for ( long n = 0; n < count; n++ )
+	{
+		unsigned int p = n % BENCHMARK_POSES;
+
+		std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+		extractor.extract(
+				scans[ p ].data(),
+				BENCHMARK_BEAMS,
+				BENCHMARK_ANGLE_MIN,
+				BENCHMARK_ANGLE_INCREMENT,
+				BENCHMARK_RANGE_MIN,
+				BENCHMARK_RANGE_MAX,
+				0.0 );
+		nsecs.push_back( std::chrono::duration_cast<std::chrono::nanoseconds>(
+				std::chrono::steady_clock::now() - start ).count() );
+
+		lines += extractor.lines().size();
+		corners += extractor.corners().size();
+
+		// Compares each line with the nearest wall, in the scanners frame
+		if ( n >= BENCHMARK_POSES ) continue;
+		for ( unsigned int l = 0; l < extractor.lines().size(); l++ )
+		{
+			const ScanLine & line = extractor.lines()[ l ];
+			float bestAlpha = 1e9, bestRho = 1e9;
+
+			for ( unsigned int w = 0; w < walls.size(); w++ )
+			{
+				// The wall on normal form relative to the pose
+				float ex = walls[ w ].x2 - walls[ w ].x1, ey = walls[ w ].y2 - walls[ w ].y1;
+				float alpha = atan2( ex, -ey ) - posePhi[ p ];
+				float rho = ( walls[ w ].x1 - poseX[ p ] ) * cos( alpha + posePhi[ p ] )
+						+ ( walls[ w ].y1 - poseY[ p ] ) * sin( alpha + posePhi[ p ] );
+				if ( rho < 0 )
+				{
+					rho = -rho;
+					alpha += M_PI;
+				}
+
+				float dAlpha = fabs( remainder( line.alpha - alpha, 2 * M_PI ) );
+				float dRho = fabs( line.rho - rho );
+				if ( dAlpha + dRho < bestAlpha + bestRho )
+				{
+					bestAlpha = dAlpha;
+					bestRho = dRho;
+				}
+			}
+
+			walled++;
+			if ( bestAlpha > 0.1 || bestRho > 0.1 ) continue;
+			matched++;
+			alphaError += bestAlpha;
+			rhoError += bestRho;
+		}
+	}
+
+	std::sort( nsecs.begin(), nsecs.end() );
+	long long total = 0;
+	for ( unsigned int i = 0; i < nsecs.size(); i++ )
+		total += nsecs[ i ];
+
+	double scanUsecs = total / 1000.0 / count;
+	double features = (double) ( lines + corners ) / count;
+
+	std::cout
+		<< count << " scans of " << BENCHMARK_BEAMS << " beams, noise " << sigma
+		<< " m, " << ( dropRatio * 100 ) << " % dropped" << std::endl
+		<< "Time per scan (us): mean " << scanUsecs
+		<< ", p50 " << nsecs[ nsecs.size() / 2 ] / 1000.0
+		<< ", p99 " << nsecs[ ( nsecs.size() * 99 ) / 100 ] / 1000.0
+		<< ", max " << nsecs.back() / 1000.0
+		<< " (" << (long) ( 1000000.0 / scanUsecs ) << " scans/s)" << std::endl
+		<< "Features per scan: " << ( (double) lines / count ) << " lines, "
+		<< ( (double) corners / count ) << " corners, "
+		<< ( BENCHMARK_BEAMS / std::max( features, 1.0 ) ) << " times fewer than beams" << std::endl;
+
+	if ( matched > 0 )
+		std::cout
+			<< "Lines matching a wall: " << matched << " of " << walled
+			<< ", mean error " << ( rhoError / matched * 1000 ) << " mm, "
+			<< ( alphaError / matched * 180 / M_PI ) << " degrees" << std::endl;
+
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,371 @@
+/**
+ * @file	oneEuroEvaluation.cpp
+ * @brief	Evaluation of the OneEuroFilter parameters on hand streams
+ *
+ * Runs a stream of hand coordinates through the OneEuroFilter as
+ * KinectReader does, one filter per axis on coordinates in meters, for a
+ * range of parameters, and prints the jitter and the lag of each:
+ *	- jitter, the RMS change between samples while the hand is still
+ *	- lag, the delay of the filtered stream behind the raw stream while the
+ *	hand moves, found as the time shift giving the smallest difference
+ *
+ * Both are measured without knowing the true hand position, so recordings
+ * can be evaluated. Still and moving samples are told apart by the speed of
+ * a centered moving average of the raw stream, which is also the reference
+ * for the lag, as it has no delay. Samples count as still only after
+ * EVALUATION_SETTLE, so the jitter does not include the filter settling.
+ *
+ * The stream is a recording as replayed by kinectEmulator, one "x,y,z" line
+ * in millimeters or "Click" line per sample. Without a recording, a hand
+ * reaching, holding, waving and returning with gaussian noise is
+ * synthesised, which may be written as a recording. aux/kinectHand.txt is
+ * such a stream, written with -w, for replaying and for comparing with
+ * captures from the Kinect server.
+ *
+ * Usage: oneEuroEvaluation [options]
+ *	-f file		Evaluate a recording instead of synthesising
+ *	-r rate		Samples per second of the recording, default 30
+ *	-c cutoff	Evaluate only this minimum cutoff frequency, in Hz
+ *	-b beta		Evaluate only this beta, with -c
+ *	-d cutoff	Derivative cutoff frequency in Hz, default as the filter
+ *	-s sigma	Noise of the synthesised stream in mm, default 4
+ *	-w file		Write the synthesised stream as a recording
+ */
+
+#include "../kinect/OneEuroFilter.h"
+
+#include <stdlib.h>
+#include <unistd.h>
+#include <math.h>
+#include <stdio.h>
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <random>
+
+
+/// Samples in the centered moving average used as reference, odd
+#define EVALUATION_REFERENCE_WINDOW	5
+/// Speed below which the hand is still, in meters per second
+#define EVALUATION_STILL_SPEED	0.1
+/// Speed above which the hand is moving, in meters per second
+#define EVALUATION_MOVING_SPEED	0.3
+/// Milliseconds the hand must have been still before its samples count as
+/// still, so a filter catching up after a motion is not taken as jitter
+#define EVALUATION_SETTLE	500
+/// Largest lag searched for, in milliseconds
+#define EVALUATION_LAG_MAX	400
+/// Noise along the depth axis, relative to the other axes, as the Kinect
+/// depth is noisier
+#define EVALUATION_DEPTH_NOISE	2.0
+
+
+/**
+ * A sample of the stream, in meters
+ */
+struct Sample
+{
+	float position[ 3 ];
+};
+
+/**
+ * Moves smoothly from 0 to 1, the minimum jerk profile of a reaching hand
+ *
+ * @param	s	The progress, 0 to 1
+ *
+ * @return	The position, 0 to 1
+ */
+float minimumJerk( float s )
+{
+	if ( s <= 0.0 ) return 0.0;
+	if ( s >= 1.0 ) return 1.0;
+	return s * s * s * ( 10.0 - ( 15.0 * s ) + ( 6.0 * s * s ) );
+}
+
+/**
+ * Synthesises a hand in front of the Kinect: still, reaching, holding,
+ * waving, returning and still again, about 17 seconds
+ *
+ * @param	rate	Samples per second
+ * @param	sigma	Standard deviation of the noise, in mm
+ * @param	lines	Output, the stream as recording lines
+ */
+void synthesise( float rate, float sigma, std::vector<std::string> & lines )
+{
+	std::mt19937 random( 42 );
+	std::normal_distribution<float> noise( 0.0, sigma );
+	char line[ 64 ];
+
+	float
+		still[ 3 ] = { 0.0, 100.0, 1800.0 },
+		reach[ 3 ] = { -250.0, 250.0, 1300.0 };
+
+	for ( unsigned int i = 0; i < 17.0 * rate; i++ )
+	{
+		float t = i / rate, p[ 3 ];
+		float out = minimumJerk( ( t - 3.0 ) / 1.0 ), back = minimumJerk( ( t - 12.0 ) / 1.2 );
+
+		for ( int a = 0; a < 3; a++ )
+			p[ a ] = still[ a ] + ( reach[ a ] - still[ a ] ) * ( out - back );
+
+		// Waving sideways at 1 Hz
+		if ( t >= 7.0 && t < 11.0 )
+			p[ 0 ] += 200.0 * sin( 2.0 * M_PI * ( t - 7.0 ) );
+
+		// A click while holding, as the server sends them
+		if ( i == (unsigned int) ( 5.0 * rate ) ) lines.push_back( "Click" );
+
+		snprintf( line, sizeof( line ), "%.1f,%.1f,%.1f",
+				p[ 0 ] + noise( random ),
+				p[ 1 ] + noise( random ),
+				p[ 2 ] + EVALUATION_DEPTH_NOISE * noise( random ) );
+		lines.push_back( line );
+	}
+}
+
+/**
+ * Parses the recording lines, skipping clicks
+ *
+ * @param	lines	The lines
+ * @param	samples	Output, the samples in meters
+ */
+void parse( const std::vector<std::string> & lines, std::vector<Sample> & samples )
+{
+	for ( unsigned int i = 0; i < lines.size(); i++ )
+	{
+		float x, y, z;
+		if ( sscanf( lines[ i ].c_str(), "%f,%f,%f", & x, & y, & z ) != 3 ) continue;
+
+		Sample sample = { { x / 1000.0f, y / 1000.0f, z / 1000.0f } };
+		samples.push_back( sample );
+	}
+}
+
+/**
+ * Gets the distance between two positions
+ *
+ * @param	a	The first position
+ * @param	b	The second position
+ *
+ * @return	The distance
+ */
+float distance( const float * a, const float * b )
+{
+	float dx = a[ 0 ] - b[ 0 ], dy = a[ 1 ] - b[ 1 ], dz = a[ 2 ] - b[ 2 ];
+	return sqrt( ( dx * dx ) + ( dy * dy ) + ( dz * dz ) );
+}
+
+/**
+ * Filters the stream and measures the jitter and the lag
+ *
+ * @param	samples	The raw stream
+ * @param	reference	The centered moving average of the stream
+ * @param	motion	The state of each sample, -1 still, 1 moving, 0 neither
+ * @param	rate	Samples per second
+ * @param	minCutoff	The minimum cutoff frequency, 0 for no filter
+ * @param	beta	The beta
+ * @param	derivativeCutoff	The derivative cutoff frequency
+ * @param	jitter	Output, the jitter in mm
+ * @param	lag	Output, the lag in milliseconds
+ */
+void evaluate(
+		const std::vector<Sample> & samples,
+		const std::vector<Sample> & reference,
+		const std::vector<int> & motion,
+		float rate,
+		float minCutoff,
+		float beta,
+		float derivativeCutoff,
+		float & jitter,
+		float & lag )
+{
+	OneEuroFilter filters[ 3 ];
+	for ( int a = 0; a < 3; a++ )
+		filters[ a ].setParameters( minCutoff, beta, derivativeCutoff );
+
+	std::vector<Sample> filtered( samples.size() );
+	for ( unsigned int i = 0; i < samples.size(); i++ )
+		for ( int a = 0; a < 3; a++ )
+			filtered[ i ].position[ a ] = ( minCutoff > 0.0 )
+				? filters[ a ].filter( samples[ i ].position[ a ], 1.0 / rate )
+				: samples[ i ].position[ a ];
+
+	double sum = 0.0;
+	unsigned int count = 0;
+	for ( unsigned int i = 1; i < filtered.size(); i++ )
+	{
+		if ( motion[ i ] >= 0 || motion[ i - 1 ] >= 0 ) continue;
+		float step = distance( filtered[ i ].position, filtered[ i - 1 ].position );
+		sum += step * step;
+		count++;
+	}
+	jitter = ( count > 0 ) ? sqrt( sum / count ) * 1000.0 : 0.0;
+
+	// The shift of the reference, interpolated, best matching the filtered
+	// samples while moving
+	float bestError = -1.0;
+	lag = 0.0;
+	for ( unsigned int shift = 0; shift <= EVALUATION_LAG_MAX; shift++ )
+	{
+		float frames = shift * rate / 1000.0;
+		unsigned int whole = (unsigned int) frames;
+		float part = frames - whole;
+
+		double error = 0.0;
+		for ( unsigned int i = whole + 1; i < filtered.size(); i++ )
+		{
+			if ( motion[ i ] <= 0 ) continue;
+
+			float shifted[ 3 ];
+			for ( int a = 0; a < 3; a++ )
+				shifted[ a ] = ( ( 1.0 - part ) * reference[ i - whole ].position[ a ] )
+					+ ( part * reference[ i - whole - 1 ].position[ a ] );
+
+			float d = distance( filtered[ i ].position, shifted );
+			error += d * d;
+		}
+
+		if ( bestError < 0.0 || error < bestError )
+		{
+			bestError = error;
+			lag = shift;
+		}
+	}
+}
+
+int main( int argc, char * argv[] )
+{
+	std::string
+		recordingFile = "",
+		writeFile = "";
+
+	float
+		rate = 30.0,
+		minCutoff = -1.0,
+		beta = ONEEUROFILTER_BETA,
+		derivativeCutoff = ONEEUROFILTER_DERIVATIVE_CUTOFF,
+		sigma = 4.0;
+
+	int option;
+	while ( ( option = getopt( argc, argv, "f:r:c:b:d:s:w:" ) ) != -1 )
+	{
+		switch ( option )
+		{
+			case 'f': recordingFile = optarg; break;
+			case 'r': rate = atof( optarg ); break;
+			case 'c': minCutoff = atof( optarg ); break;
+			case 'b': beta = atof( optarg ); break;
+			case 'd': derivativeCutoff = atof( optarg ); break;
+			case 's': sigma = atof( optarg ); break;
+			case 'w': writeFile = optarg; break;
+			default:
+				std::cerr
+					<< "Usage: " << argv[ 0 ] << " [-f file] [-r rate] [-c cutoff] [-b beta]"
+					<< " [-d cutoff] [-s sigma] [-w file]" << std::endl;
+				return EXIT_FAILURE;
+		}
+	}
+	if ( rate <= 0.0 ) rate = 30.0;
+
+	std::vector<std::string> lines;
+	if ( recordingFile.empty() )
+	{
+		synthesise( rate, sigma, lines );
+
+		if ( ! writeFile.empty() )
+		{
+			std::ofstream file( writeFile.c_str() );
+			for ( unsigned int i = 0; i < lines.size(); i++ )
+				file << lines[ i ] << "\n";
+			std::cout << "Wrote " << lines.size() << " lines to " << writeFile << std::endl;
+		}
+	}
+	else
+	{
+		std::ifstream file( recordingFile.c_str() );
+		std::string line;
+		while ( std::getline( file, line ) )
+		{
+			if ( ! line.empty() && line[ line.size() - 1 ] == '\r' ) line.erase( line.size() - 1 );
+			if ( ! line.empty() ) lines.push_back( line );
+		}
+	}
+
+	std::vector<Sample> samples;
+	parse( lines, samples );
+	if ( samples.size() < 2 * EVALUATION_REFERENCE_WINDOW )
+	{
+		std::cerr << "Too few samples" << std::endl;
+		return EXIT_FAILURE;
+	}
+
+	// The reference and the motion of each sample, edges excluded
+	unsigned int half = EVALUATION_REFERENCE_WINDOW / 2;
+	std::vector<Sample> reference( samples );
+	std::vector<int> motion( samples.size(), 0 );
+	for ( unsigned int i = half; i + half < samples.size(); i++ )
+		for ( int a = 0; a < 3; a++ )
+		{
+			float sum = 0.0;
+			for ( unsigned int j = i - half; j <= i + half; j++ )
+				sum += samples[ j ].position[ a ];
+			reference[ i ].position[ a ] = sum / EVALUATION_REFERENCE_WINDOW;
+		}
+
+	// The speed over the span of the window, as the reference is still
+	// noisy from one sample to the next
+	unsigned int still = 0, moving = 0, stillSince = 0;
+	unsigned int settle = (unsigned int) ( EVALUATION_SETTLE * rate / 1000.0 );
+	for ( unsigned int i = 2 * half; i + 2 * half < samples.size(); i++ )
+	{
+		float speed = distance( reference[ i + half ].position, reference[ i - half ].position )
+			* rate / ( 2 * half );
+
+		if ( speed >= EVALUATION_STILL_SPEED )
+			stillSince = i + 1;
+		else if ( i >= stillSince + settle )
+		{
+			motion[ i ] = -1;
+			still++;
+		}
+
+		if ( speed > EVALUATION_MOVING_SPEED )
+		{
+			motion[ i ] = 1;
+			moving++;
+		}
+	}
+
+	std::cout
+		<< samples.size() << " samples at " << rate << " Hz, "
+		<< still << " still and " << moving << " moving" << std::endl;
+	printf( "%10s %6s %10s %8s\n", "mincutoff", "beta", "jitter mm", "lag ms" );
+
+	float jitter, lag;
+	evaluate( samples, reference, motion, rate, 0.0, 0.0, derivativeCutoff, jitter, lag );
+	printf( "%10s %6s %10.2f %8.0f\n", "raw", "", jitter, lag );
+
+	if ( minCutoff >= 0.0 )
+	{
+		evaluate( samples, reference, motion, rate, minCutoff, beta, derivativeCutoff, jitter, lag );
+		printf( "%10.2f %6.1f %10.2f %8.0f\n", minCutoff, beta, jitter, lag );
+		return EXIT_SUCCESS;
+	}
+
+	// The defaults, then a range around them
+	evaluate( samples, reference, motion, rate,
+			ONEEUROFILTER_MIN_CUTOFF, ONEEUROFILTER_BETA, derivativeCutoff, jitter, lag );
+	printf( "%10.2f %6.1f %10.2f %8.0f  (default)\n", ONEEUROFILTER_MIN_CUTOFF, ONEEUROFILTER_BETA, jitter, lag );
+
+	float cutoffs[] = { 0.5, 1.0, 2.0, 4.0 };
+	float betas[] = { 0.0, 5.0, 10.0, 20.0, 40.0 };
+	for ( unsigned int c = 0; c < sizeof( cutoffs ) / sizeof( cutoffs[ 0 ] ); c++ )
+		for ( unsigned int b = 0; b < sizeof( betas ) / sizeof( betas[ 0 ] ); b++ )
+		{
+			evaluate( samples, reference, motion, rate, cutoffs[ c ], betas[ b ], derivativeCutoff, jitter, lag );
+			printf( "%10.2f %6.1f %10.2f %8.0f\n", cutoffs[ c ], betas[ b ], jitter, lag );
+		}
+
+	return EXIT_SUCCESS;
+}
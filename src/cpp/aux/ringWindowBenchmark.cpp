@@ -0,0 +1,168 @@
+/**
+ * @file	ringWindowBenchmark.cpp
+ * @brief	Benchmark of RingWindow against the std::list deltas it replaced
+ *
+ * _CompactBha used to keep its delta windows in std::list, doing pop_back()
+ * and push_front() for each new delta and walking the list to sum it, see
+ * floatListSum() before RingWindow. This pushes the same random values into
+ * such a list and into a RingWindow, checks that sum, min, max and latest
+ * agree, and prints the time and the allocations per push and sum, for the
+ * depth used by _CompactBha and for a deeper window.
+ *
+ * Usage: ringWindowBenchmark [options]
+ *	-n count	Values pushed per run, default 1000000
+ */
+
+#include "../robotino/headers/RingWindow.h"
+
+#include <stdlib.h>
+#include <unistd.h>
+#include <math.h>
+#include <iostream>
+#include <list>
+#include <vector>
+#include <algorithm>
+#include <chrono>
+#include <random>
+#include <new>
+
+
+/// The depth of the delta windows, as CBHA_DELTA_DEPTH in _CompactBha.h,
+/// which is not included to build without RobotinoAPI2
+#define BENCHMARK_DEPTH	4
+/// The depth of a deeper window, for comparison
+#define BENCHMARK_DEEP	64
+
+
+/// The number of allocations made, counted by operator new
+static unsigned long long allocations = 0;
+
+// Not inlined, as inlining makes g++ warn that the memory from operator new
+// is released by free()
+__attribute__(( noinline )) void * operator new( size_t size )
+{
+	allocations++;
+	void * memory = malloc( size );
+	if ( memory == NULL ) throw std::bad_alloc();
+	return memory;
+}
+
+__attribute__(( noinline )) void operator delete( void * memory ) noexcept
+{
+	free( memory );
+}
+
+/**
+ * Sums a list, as _CompactBha::floatListSum() did
+ *
+ * @param	list	The list
+ *
+ * @return	The sum
+ */
+double floatListSum( std::list<float> * list )
+{
+	double result = 0.0;
+
+	for ( std::list<float>::iterator it = list->begin(); it != list->end(); ++it )
+		result += *it;
+
+	return result;
+}
+
+/**
+ * Pushes the values into a list and a RingWindow of depth N and prints the
+ * results
+ *
+ * @param	values	The values
+ *
+ * @return	@c false if the two disagreed
+ */
+template <unsigned int N>
+bool compare( const std::vector<float> & values )
+{
+	std::list<float> list;
+	list.assign( N, 0.0 );
+	RingWindow<float, N> window( 0.0 );
+	bool agree = true;
+	double sink = 0.0;
+
+	// Checks that both give the same results
+	for ( unsigned int i = 0; i < values.size() && i < 100000; i++ )
+	{
+		list.pop_back();
+		list.push_front( values[ i ] );
+		window.push( values[ i ] );
+
+		float listMin = * std::min_element( list.begin(), list.end() );
+		float listMax = * std::max_element( list.begin(), list.end() );
+		if ( fabs( floatListSum( & list ) - window.sum() ) > 1e-4
+				|| listMin != window.min() || listMax != window.max()
+				|| list.front() != window.latest() )
+			agree = false;
+	}
+
+	// Times push and sum, once per delta as in _CompactBha
+	unsigned long long before = allocations;
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	for ( unsigned int i = 0; i < values.size(); i++ )
+	{
+		list.pop_back();
+		list.push_front( values[ i ] );
+		sink += floatListSum( & list );
+	}
+	double listNsecs = std::chrono::duration_cast<std::chrono::nanoseconds>(
+			std::chrono::steady_clock::now() - start ).count() / (double) values.size();
+	double listAllocations = ( allocations - before ) / (double) values.size();
+
+	before = allocations;
+	start = std::chrono::steady_clock::now();
+	for ( unsigned int i = 0; i < values.size(); i++ )
+	{
+		window.push( values[ i ] );
+		sink += window.sum();
+	}
+	double windowNsecs = std::chrono::duration_cast<std::chrono::nanoseconds>(
+			std::chrono::steady_clock::now() - start ).count() / (double) values.size();
+	double windowAllocations = ( allocations - before ) / (double) values.size();
+
+	std::cout
+		<< "Depth " << N << ( agree ? "" : " (results differ!)" ) << std::endl
+		<< "  std::list:  " << listNsecs << " ns, " << listAllocations << " allocations per push and sum" << std::endl
+		<< "  RingWindow: " << windowNsecs << " ns, " << windowAllocations << " allocations per push and sum" << std::endl;
+
+	// Keeps the sums from being optimized away
+	if ( sink == 0.12345 ) std::cout << sink << std::endl;
+
+	return agree;
+}
+
+int main( int argc, char * argv[] )
+{
+	long
+		count = 1000000;
+
+	int option;
+	while ( ( option = getopt( argc, argv, "n:" ) ) != -1 )
+	{
+		switch ( option )
+		{
+			case 'n': count = atol( optarg ); break;
+			default:
+				std::cerr << "Usage: " << argv[ 0 ] << " [-n count]" << std::endl;
+				return EXIT_FAILURE;
+		}
+	}
+	if ( count < 1 ) count = 1;
+
+	// Deltas of the size seen from the pressure sensors
+	std::mt19937 random( 42 );
+	std::normal_distribution<float> delta( 0.0, 0.01 );
+	std::vector<float> values( count );
+	for ( long i = 0; i < count; i++ )
+		values[ i ] = delta( random );
+
+	bool agree = compare<BENCHMARK_DEPTH>( values );
+	agree = compare<BENCHMARK_DEEP>( values ) && agree;
+
+	return agree ? EXIT_SUCCESS : EXIT_FAILURE;
+}
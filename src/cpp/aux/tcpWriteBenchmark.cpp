@@ -0,0 +1,341 @@
+/**
+ * @file	tcpWriteBenchmark.cpp
+ * @brief	Throughput of TcpSocket::write() and writeFrames() for small and
+ * large messages
+ *
+ * Connects a TcpSocket to a server on the loopback interface, whose
+ * connection is read by a thread summing the bytes recieved, and sends
+ * messages of several sizes: one write() per message, and writeFrames()
+ * with all messages of the run as frames. Small messages are also sent as
+ * TcpSocket::write() did before sending from the caller's buffer, copying
+ * each message into a stack buffer of 500 bytes; longer messages never
+ * finished that way, as the position was set to the chunk size instead of
+ * advanced. Every run checks that the stream arrived intact.
+ *
+ * Two more checks cover the error handling: a non-blocking socket writing a
+ * large message to a slow reader, going through partial writes and EAGAIN,
+ * and writes to a closed peer, which must fail without SIGPIPE.
+ *
+ * Usage: tcpWriteBenchmark [options]
+ *	-m megabytes	Bytes sent per run, default 64
+ *	-p port		First port used, one per run, default 47350
+ */
+
+#include "../tcp/TcpSocket.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <iostream>
+#include <string>
+#include <vector>
+#include <thread>
+#include <chrono>
+#include <stdexcept>
+
+
+/// The chunk size of the write() before sending from the caller's buffer
+#define BENCHMARK_OLD_CHUNK	500
+/// Size of the message written to the slow reader, in bytes
+#define BENCHMARK_SLOW_SIZE	( 8 << 20 )
+/// Microseconds the slow reader sleeps between reads
+#define BENCHMARK_SLOW_DELAY	200
+
+
+/**
+ * The recieving end of a connection, reading until the writer shuts down
+ */
+struct Sink
+{
+	/// The connection
+	int descriptor;
+	/// Microseconds to sleep between reads, 0 for none
+	unsigned int delay;
+	/// Bytes recieved
+	unsigned long long bytes;
+	/// Checksum of the bytes recieved
+	unsigned long long sum;
+	/// The thread reading
+	std::thread reader;
+};
+
+/**
+ * Adds bytes to a checksum depending on their order
+ *
+ * @param	sum	The checksum
+ * @param	data	The bytes
+ * @param	length	The number of bytes
+ *
+ * @return	The new checksum
+ */
+unsigned long long
+checksum( unsigned long long sum, const char * data, size_t length )
+{
+	for ( size_t i = 0; i < length; i++ )
+		sum = ( sum * 31 ) + (unsigned char) data[ i ];
+	return sum;
+}
+
+/**
+ * Reads a connection until it is shut down
+ *
+ * @param	pSink	The sink
+ */
+void
+readAll( Sink * pSink )
+{
+	std::vector<char> buffer( 65536 );
+	ssize_t length;
+	while ( ( length = recv( pSink->descriptor, & buffer[ 0 ], buffer.size(), 0 ) ) > 0 )
+	{
+		pSink->sum = checksum( pSink->sum, & buffer[ 0 ], length );
+		pSink->bytes += length;
+		if ( pSink->delay > 0 ) usleep( pSink->delay );
+	}
+}
+
+/**
+ * Connects a TcpSocket to a server on the loopback interface and starts
+ * reading the server end
+ *
+ * @param	port	The port
+ * @param	sink	Output, the server end
+ * @param	delay	Microseconds the reader sleeps between reads
+ *
+ * @return	The client end, NULL on failure
+ */
+TcpSocket *
+connectPair( unsigned int port, Sink & sink, unsigned int delay )
+{
+	std::string portName = std::to_string( port );
+	TcpSocket * pServer, * pClient;
+	try
+	{
+		pServer = new TcpSocket( const_cast<char *>( portName.c_str() ) );
+	}
+	catch ( std::runtime_error * e )
+	{
+		std::cerr << "Could not listen on port " << port << ": " << e->what() << std::endl;
+		delete e;
+		return NULL;
+	}
+
+	try
+	{
+		// Connected once in the backlog, before it is accepted
+		pClient = new TcpSocket( portName, "127.0.0.1" );
+	}
+	catch ( std::runtime_error * e )
+	{
+		std::cerr << "Could not connect to port " << port << ": " << e->what() << std::endl;
+		delete e;
+		delete pServer;
+		return NULL;
+	}
+
+	if ( ! pServer->accept() )
+	{
+		delete pClient;
+		delete pServer;
+		return NULL;
+	}
+
+	// Keeps the connection when the server is deleted
+	sink.descriptor = dup( pServer->descriptor() );
+	sink.delay = delay;
+	sink.bytes = 0;
+	sink.sum = 0;
+	delete pServer;
+	sink.reader = std::thread( readAll, & sink );
+
+	return pClient;
+}
+
+/**
+ * Sends a message as TcpSocket::write() did before sending from the
+ * caller's buffer, for messages of at most one chunk
+ *
+ * @param	descriptor	The connection
+ * @param	message	The message
+ *
+ * @return	Success of sending
+ */
+bool
+chunkedWrite( int descriptor, const std::string & message )
+{
+	int
+		pos = 0,
+		cut,
+		length = message.size(),
+		writeLen;
+
+	char
+		buffer[ BENCHMARK_OLD_CHUNK ];
+
+	while ( pos < length )
+	{
+		bzero( buffer, BENCHMARK_OLD_CHUNK );
+		cut = ( ( pos + BENCHMARK_OLD_CHUNK ) < length ) ?
+				BENCHMARK_OLD_CHUNK :
+				length - pos;
+
+		for ( int i = 0; i < cut; i++ ) buffer[ i ] = message[ pos + i ];
+
+		writeLen = ::send( descriptor, buffer, cut, 0 );
+
+		pos = cut;
+
+		if ( writeLen != cut ) return false;
+	}
+
+	return true;
+}
+
+/**
+ * Sends a message a number of times one way and prints the throughput
+ *
+ * @param	name	The name of the way
+ * @param	way	0 as the old write(), 1 with write(), 2 with writeFrames()
+ * @param	port	The port
+ * @param	size	The size of the message
+ * @param	count	The number of messages
+ *
+ * @return	Boolean indicating if the stream arrived intact
+ */
+bool
+measure( const char * name, unsigned int way, unsigned int port, size_t size, unsigned long count )
+{
+	Sink sink;
+	TcpSocket * pClient = connectPair( port, sink, 0 );
+	if ( pClient == NULL ) return false;
+
+	std::string message( size, ' ' );
+	for ( size_t i = 0; i < size; i++ )
+		message[ i ] = 'a' + ( i % 26 );
+
+	std::vector<struct iovec> frames( way == 2 ? count : 0 );
+	for ( unsigned long i = 0; i < frames.size(); i++ )
+	{
+		frames[ i ].iov_base = const_cast<char *>( message.data() );
+		frames[ i ].iov_len = message.size();
+	}
+
+	bool sent = true;
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	if ( way == 0 )
+		for ( unsigned long i = 0; i < count && sent; i++ )
+			sent = chunkedWrite( pClient->descriptor(), message );
+	else if ( way == 1 )
+		for ( unsigned long i = 0; i < count && sent; i++ )
+			sent = pClient->write( message );
+	else
+		sent = pClient->writeFrames( & frames[ 0 ], count );
+	double secs = std::chrono::duration<double>( std::chrono::steady_clock::now() - start ).count();
+
+	shutdown( pClient->descriptor(), SHUT_WR );
+	sink.reader.join();
+	close( sink.descriptor );
+	delete pClient;
+
+	unsigned long long expected = 0;
+	for ( unsigned long i = 0; i < count; i++ )
+		expected = checksum( expected, message.data(), message.size() );
+	bool intact = sent && sink.bytes == size * count && sink.sum == expected;
+
+	std::cout
+		<< "  " << name << ": " << ( size * count / secs / 1e6 ) << " MB/s, "
+		<< (unsigned long) ( count / secs ) << " messages/s" << ( intact ? "" : " (stream corrupt!)" ) << std::endl;
+
+	return intact;
+}
+
+int main( int argc, char * argv[] )
+{
+	unsigned long
+		megabytes = 64;
+
+	unsigned int
+		port = 47350;
+
+	int option;
+	while ( ( option = getopt( argc, argv, "m:p:" ) ) != -1 )
+	{
+		switch ( option )
+		{
+			case 'm': megabytes = atol( optarg ); break;
+			case 'p': port = atoi( optarg ); break;
+			default:
+				std::cerr << "Usage: " << argv[ 0 ] << " [-m megabytes] [-p port]" << std::endl;
+				return EXIT_FAILURE;
+		}
+	}
+	if ( megabytes < 1 ) megabytes = 1;
+
+	const size_t sizes[] = { 64, 400, 65536, 1 << 20 };
+	bool intact = true;
+
+	for ( unsigned int i = 0; i < sizeof( sizes ) / sizeof( sizes[ 0 ] ); i++ )
+	{
+		size_t size = sizes[ i ];
+		unsigned long count = ( megabytes << 20 ) / size;
+		if ( count < 1 ) count = 1;
+
+		std::cout << count << " messages of " << size << " bytes" << std::endl;
+		if ( size <= BENCHMARK_OLD_CHUNK )
+			intact = measure( "old write()  ", 0, port++, size, count ) && intact;
+		intact = measure( "write()      ", 1, port++, size, count ) && intact;
+		intact = measure( "writeFrames()", 2, port++, size, count ) && intact;
+	}
+
+	// A non-blocking write to a slow reader, through partial writes and
+	// EAGAIN
+	Sink sink;
+	TcpSocket * pClient = connectPair( port++, sink, BENCHMARK_SLOW_DELAY );
+	if ( pClient != NULL )
+	{
+		std::string message( BENCHMARK_SLOW_SIZE, ' ' );
+		for ( size_t i = 0; i < message.size(); i++ )
+			message[ i ] = (char) ( i * 7 );
+
+		pClient->setBlocking( false );
+		bool sent = pClient->write( message );
+		shutdown( pClient->descriptor(), SHUT_WR );
+		sink.reader.join();
+		close( sink.descriptor );
+		delete pClient;
+
+		bool slowIntact = sent && sink.bytes == message.size()
+			&& sink.sum == checksum( 0, message.data(), message.size() );
+		std::cout << "Non-blocking, " << message.size() << " bytes to a slow reader: "
+			<< ( sent ? "sent" : "failed" ) << ( slowIntact ? ", intact" : ", stream corrupt!" ) << std::endl;
+		intact = slowIntact && intact;
+	}
+	else
+		intact = false;
+
+	// Writes to a closed peer fail, without SIGPIPE ending the process
+	pClient = connectPair( port++, sink, 0 );
+	if ( pClient != NULL )
+	{
+		shutdown( sink.descriptor, SHUT_RDWR );
+		sink.reader.join();
+		close( sink.descriptor );
+		usleep( 50000 );
+
+		std::string message( 4096, 'z' );
+		bool sent = true;
+		for ( unsigned int i = 0; i < 10 && sent; i++ )
+			sent = pClient->write( message );
+		std::cout << "Closed peer: write() " << ( sent ? "succeeded!" : "failed" )
+			<< ", error \"" << strerror( pClient->error() ) << "\"" << std::endl;
+		intact = ! sent && intact;
+		delete pClient;
+	}
+	else
+		intact = false;
+
+	return intact ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,356 @@
+/**
+ * @file	telemetryBenchmark.cpp
+ * @brief	Benchmark of the TelemetryServer fan-out to fast, slow and
+ * stalled clients
+ *
+ * Starts a TelemetryServer on a Reactor and connects clients to it on the
+ * loopback interface: clients reading as fast as they can, and with small
+ * recieve buffers a client sleeping between reads and a client that never
+ * reads. Frames carrying a sequence number are broadcast at a fixed
+ * interval, first with only the fast clients and then with the slow and
+ * the stalled client added, and the cost of broadcast() is printed for
+ * both, along with the frames each client recieved. The fast clients check
+ * that frames arrive whole and in order, frames dropped from their queues
+ * show as gaps.
+ *
+ * Usage: telemetryBenchmark [options]
+ *	-n count	Frames broadcast per run, default 3000
+ *	-b bytes	Size of a frame, default 4000
+ *	-i usecs	Interval between frames, default 1000
+ *	-c clients	Fast clients, default 4
+ *	-p port		Port of the server, default 47340
+ */
+
+#include "../tcp/TelemetryServer.h"
+#include "../tcp/Reactor.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <iostream>
+#include <string>
+#include <vector>
+#include <memory>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <algorithm>
+#include <stdexcept>
+
+
+/// Microseconds the slow client sleeps between reads
+#define BENCHMARK_SLOW_DELAY	20000
+/// Recieve buffer of the slow and the stalled client, in bytes
+#define BENCHMARK_SMALL_BUFFER	4096
+/// Milliseconds given to the Reactor to accept clients and send the last
+/// frames
+#define BENCHMARK_SETTLE	200
+
+
+/**
+ * A client of the server, counting the frames it recieves
+ */
+struct BenchmarkClient
+{
+	/// The connection
+	int descriptor;
+	/// Microseconds to sleep between reads, 0 for none
+	unsigned int delay;
+	/// Frames recieved
+	std::atomic<unsigned long> frames;
+	/// Frames missing between recieved frames
+	std::atomic<unsigned long> gaps;
+	/// Frames recieved out of order or with the wrong size
+	std::atomic<unsigned long> corrupt;
+	/// The thread reading, if the client reads
+	std::thread reader;
+};
+
+/**
+ * Connects a client to the server
+ *
+ * @param	port	The port of the server
+ * @param	recieveBuffer	The size of the recieve buffer, 0 for the default
+ *
+ * @return	The descriptor, -1 on failure
+ */
+int
+connectClient( unsigned int port, int recieveBuffer )
+{
+	int descriptor = socket( AF_INET, SOCK_STREAM, 0 );
+	if ( descriptor == -1 ) return -1;
+
+	// Set before connecting, to limit the window advertised
+	if ( recieveBuffer > 0 )
+		setsockopt( descriptor, SOL_SOCKET, SO_RCVBUF, & recieveBuffer, sizeof( recieveBuffer ) );
+
+	struct sockaddr_in address;
+	memset( & address, 0, sizeof( address ) );
+	address.sin_family = AF_INET;
+	address.sin_port = htons( port );
+	address.sin_addr.s_addr = htonl( INADDR_LOOPBACK );
+	if ( connect( descriptor, (struct sockaddr *) & address, sizeof( address ) ) == -1 )
+	{
+		close( descriptor );
+		return -1;
+	}
+
+	return descriptor;
+}
+
+/**
+ * Reads frames until the connection is shut down, checking their sequence
+ * numbers and sizes
+ *
+ * @param	pClient	The client
+ * @param	frameSize	The size of a frame
+ */
+void
+readFrames( BenchmarkClient * pClient, size_t frameSize )
+{
+	std::vector<char> buffer( 65536 );
+	std::string pending;
+	long last = -1;
+	ssize_t length;
+
+	while ( ( length = recv( pClient->descriptor, & buffer[ 0 ], buffer.size(), 0 ) ) > 0 )
+	{
+		pending.append( & buffer[ 0 ], length );
+
+		size_t start = 0, end;
+		while ( ( end = pending.find( '\n', start ) ) != std::string::npos )
+		{
+			long sequence = atol( pending.c_str() + start );
+			if ( end + 1 - start != frameSize || sequence <= last )
+				pClient->corrupt++;
+			else if ( last >= 0 )
+				pClient->gaps += sequence - last - 1;
+			last = sequence;
+			pClient->frames++;
+			start = end + 1;
+		}
+		pending.erase( 0, start );
+
+		if ( pClient->delay > 0 ) usleep( pClient->delay );
+	}
+}
+
+/**
+ * Makes a frame of the given size, the sequence number followed by filler
+ * and a newline
+ *
+ * @param	sequence	The sequence number
+ * @param	frameSize	The size of the frame
+ *
+ * @return	The frame
+ */
+std::shared_ptr<const std::string>
+makeFrame( unsigned int sequence, size_t frameSize )
+{
+	std::string * pFrame = new std::string( std::to_string( sequence ) );
+	pFrame->push_back( ' ' );
+	if ( pFrame->size() + 1 < frameSize ) pFrame->append( frameSize - pFrame->size() - 1, 'x' );
+	pFrame->push_back( '\n' );
+	return std::shared_ptr<const std::string>( pFrame );
+}
+
+/**
+ * Broadcasts frames at the interval and prints the cost of broadcast()
+ *
+ * @param	name	The name of the run
+ * @param	pServer	The server
+ * @param	count	The number of frames
+ * @param	frameSize	The size of a frame
+ * @param	interval	Microseconds between frames
+ */
+void
+broadcastFrames( const char * name, TelemetryServer * pServer, unsigned int count, size_t frameSize, unsigned int interval )
+{
+	std::vector<double> usecs;
+	usecs.reserve( count );
+
+	std::chrono::steady_clock::time_point next = std::chrono::steady_clock::now();
+	for ( unsigned int i = 0; i < count; i++ )
+	{
+		std::this_thread::sleep_until( next );
+		next += std::chrono::microseconds( interval );
+
+		// Built once, as the Brain does, and shared by all clients
+		std::shared_ptr<const std::string> frame = makeFrame( i, frameSize );
+
+		std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+		pServer->broadcast( frame );
+		usecs.push_back( std::chrono::duration<double, std::micro>( std::chrono::steady_clock::now() - start ).count() );
+	}
+
+	std::sort( usecs.begin(), usecs.end() );
+	double sum = 0.0;
+	for ( unsigned int i = 0; i < count; i++ )
+		sum += usecs[ i ];
+
+	std::cout
+		<< name << ", " << pServer->clients() << " clients" << std::endl
+		<< "  broadcast() (usecs): average = " << ( sum / count )
+		<< "  median = " << usecs[ count / 2 ]
+		<< "  99th percentile = " << usecs[ ( count * 99 ) / 100 ]
+		<< "  max = " << usecs[ count - 1 ] << std::endl;
+}
+
+/**
+ * Shuts down the clients, waits for their readers and prints what they
+ * recieved
+ *
+ * @param	clients	The clients
+ * @param	count	The number of frames broadcast
+ *
+ * @return	The number of corrupt frames
+ */
+unsigned long
+finishClients( std::vector<BenchmarkClient *> & clients, unsigned int count )
+{
+	unsigned long corrupt = 0;
+
+	for ( unsigned int i = 0; i < clients.size(); i++ )
+	{
+		BenchmarkClient * pClient = clients[ i ];
+		shutdown( pClient->descriptor, SHUT_RDWR );
+		if ( pClient->reader.joinable() )
+		{
+			pClient->reader.join();
+			std::cout
+				<< "  client " << i << ( pClient->delay > 0 ? " (slow)" : "" ) << ": "
+				<< pClient->frames << " of " << count << " frames, "
+				<< pClient->gaps << " missing in between, " << pClient->corrupt << " corrupt" << std::endl;
+		}
+		else
+			std::cout << "  client " << i << " (stalled): not reading" << std::endl;
+
+		corrupt += pClient->corrupt;
+		close( pClient->descriptor );
+		delete pClient;
+	}
+	clients.clear();
+
+	return corrupt;
+}
+
+/**
+ * Connects a client and starts its reader
+ *
+ * @param	clients	The clients, the new client is appended
+ * @param	port	The port of the server
+ * @param	frameSize	The size of a frame
+ * @param	delay	Microseconds between reads, 0 for none
+ * @param	reading	If the client reads at all
+ *
+ * @return	Boolean indicating if the client connected
+ */
+bool
+addClient( std::vector<BenchmarkClient *> & clients, unsigned int port, size_t frameSize, unsigned int delay, bool reading )
+{
+	int descriptor = connectClient( port, ( reading && delay == 0 ) ? 0 : BENCHMARK_SMALL_BUFFER );
+	if ( descriptor == -1 )
+	{
+		std::cerr << "Could not connect to port " << port << ": " << strerror( errno ) << std::endl;
+		return false;
+	}
+
+	BenchmarkClient * pClient = new BenchmarkClient();
+	pClient->descriptor = descriptor;
+	pClient->delay = delay;
+	pClient->frames = 0;
+	pClient->gaps = 0;
+	pClient->corrupt = 0;
+	if ( reading ) pClient->reader = std::thread( readFrames, pClient, frameSize );
+	clients.push_back( pClient );
+
+	return true;
+}
+
+int main( int argc, char * argv[] )
+{
+	unsigned int
+		count = 3000,
+		interval = 1000,
+		fastClients = 4,
+		port = 47340;
+
+	size_t
+		frameSize = 4000;
+
+	int option;
+	while ( ( option = getopt( argc, argv, "n:b:i:c:p:" ) ) != -1 )
+	{
+		switch ( option )
+		{
+			case 'n': count = atoi( optarg ); break;
+			case 'b': frameSize = atoi( optarg ); break;
+			case 'i': interval = atoi( optarg ); break;
+			case 'c': fastClients = atoi( optarg ); break;
+			case 'p': port = atoi( optarg ); break;
+			default:
+				std::cerr << "Usage: " << argv[ 0 ] << " [-n count] [-b bytes] [-i usecs] [-c clients] [-p port]" << std::endl;
+				return EXIT_FAILURE;
+		}
+	}
+	if ( count < 1 ) count = 1;
+	if ( frameSize < 16 ) frameSize = 16;
+	if ( fastClients + 2 > TELEMETRYSERVER_MAX_CLIENTS ) fastClients = TELEMETRYSERVER_MAX_CLIENTS - 2;
+
+	Reactor reactor;
+	TelemetryServer * pServer;
+	try
+	{
+		pServer = new TelemetryServer( std::to_string( port ), & reactor );
+	}
+	catch ( std::runtime_error * e )
+	{
+		std::cerr << "Could not listen on port " << port << ": " << e->what() << std::endl;
+		delete e;
+		return EXIT_FAILURE;
+	}
+	std::thread reacting( & Reactor::run, & reactor );
+
+	std::vector<BenchmarkClient *> clients;
+	unsigned long corrupt = 0;
+	bool connected = true;
+
+	// Fast clients only
+	for ( unsigned int i = 0; i < fastClients && connected; i++ )
+		connected = addClient( clients, port, frameSize, 0, true );
+	usleep( BENCHMARK_SETTLE * 1000 );
+	if ( connected )
+	{
+		broadcastFrames( "Fast clients", pServer, count, frameSize, interval );
+		usleep( BENCHMARK_SETTLE * 1000 );
+		pServer->serverToString( std::cout );
+	}
+	corrupt += finishClients( clients, count );
+
+	// With a slow and a stalled client
+	for ( unsigned int i = 0; i < fastClients && connected; i++ )
+		connected = addClient( clients, port, frameSize, 0, true );
+	connected = connected
+		&& addClient( clients, port, frameSize, BENCHMARK_SLOW_DELAY, true )
+		&& addClient( clients, port, frameSize, 0, false );
+	usleep( BENCHMARK_SETTLE * 1000 );
+	if ( connected )
+	{
+		broadcastFrames( "Fast, slow and stalled clients", pServer, count, frameSize, interval );
+		usleep( BENCHMARK_SETTLE * 1000 );
+		pServer->serverToString( std::cout );
+	}
+	corrupt += finishClients( clients, count );
+
+	reactor.stop();
+	reacting.join();
+	delete pServer;
+
+	if ( corrupt > 0 ) std::cout << corrupt << " frames arrived corrupt or out of order!" << std::endl;
+
+	return ( connected && corrupt == 0 ) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
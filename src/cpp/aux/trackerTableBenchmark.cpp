@@ -0,0 +1,256 @@
+/**
+ * @file	trackerTableBenchmark.cpp
+ * @brief	Benchmark of the lock free reads of the TrackerTable
+ *
+ * Measures the cost of TrackerTable::latest() alone, while a writer
+ * publishes at the rate of a Kinect and while a writer publishes as fast as
+ * it can, and compares it with the same copy protected by a std::mutex.
+ * Every sample published has all values equal, so a torn read, mixing two
+ * samples, is detected and counted. The cost of fuse() is measured for a
+ * joint seen by one to four cameras.
+ *
+ * Usage: trackerTableBenchmark [options]
+ *	-n count	Reads per measurement, default 10000000
+ *	-t threads	Reader threads against the writer, default 4
+ *	-s msecs	Duration of the runs against a writer, default 1000
+ */
+
+#include "../kinect/TrackerTable.h"
+
+#include <stdlib.h>
+#include <unistd.h>
+#include <iostream>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <chrono>
+
+
+/// Samples per second published by the Kinect rate writer
+#define BENCHMARK_KINECT_RATE	30
+/// The source read, camera 0 and joint 3
+#define BENCHMARK_SOURCE	TRACKERTABLE_SOURCE( 0, 3 )
+
+
+/**
+ * A sample protected by a mutex, for comparison
+ */
+struct LockedSample
+{
+	std::mutex mutex;
+	TrackedSample sample;
+};
+
+/**
+ * Makes a sample with all values equal, so torn reads can be detected
+ *
+ * @param	source	The source
+ * @param	value	The value
+ *
+ * @return	The sample
+ */
+TrackedSample
+makeSample( unsigned int source, long long value )
+{
+	TrackedSample sample;
+	sample.source = source;
+	sample.x = sample.y = sample.z = (float) value;
+	sample.xVelocity = sample.yVelocity = sample.zVelocity = (float) value;
+	sample.captureTime = value;
+	return sample;
+}
+
+/**
+ * Checks if a sample mixes two published samples
+ *
+ * @param	sample	The sample
+ *
+ * @return	If the sample is torn
+ */
+bool
+isTorn( const TrackedSample & sample )
+{
+	return sample.x != sample.y || sample.y != sample.z
+		|| sample.z != sample.xVelocity || sample.xVelocity != sample.yVelocity
+		|| sample.yVelocity != sample.zVelocity || (long long) sample.x != sample.captureTime;
+}
+
+/**
+ * Reads from a number of threads while a writer publishes, and prints the
+ * reads per thread and their mean cost
+ *
+ * @param	name	The name of the run
+ * @param	locked	Read the mutex protected sample instead of the table
+ * @param	rate	Samples published per second, 0 as fast as possible
+ * @param	threads	The number of reader threads
+ * @param	msecs	The duration
+ *
+ * @return	The number of torn reads
+ */
+unsigned long long
+contend( const char * name, bool locked, unsigned int rate, unsigned int threads, unsigned int msecs )
+{
+	TrackerTable table;
+	LockedSample shared;
+	std::atomic<bool> stop( false );
+	std::atomic<unsigned long long> reads( 0 ), torn( 0 ), writes( 0 );
+
+	table.publish( makeSample( BENCHMARK_SOURCE, 1 ) );
+	shared.sample = makeSample( BENCHMARK_SOURCE, 1 );
+
+	std::thread writer( [ & ]
+	{
+		long long value = 2;
+		while ( ! stop )
+		{
+			TrackedSample sample = makeSample( BENCHMARK_SOURCE, value++ % 1000000 );
+			if ( locked )
+			{
+				std::lock_guard<std::mutex> lock( shared.mutex );
+				shared.sample = sample;
+			}
+			else
+				table.publish( sample );
+			writes++;
+
+			if ( rate > 0 ) usleep( 1000000 / rate );
+		}
+	} );
+
+	std::vector<std::thread> readers;
+	for ( unsigned int i = 0; i < threads; i++ )
+		readers.push_back( std::thread( [ & ]
+		{
+			TrackedSample sample;
+			unsigned long long count = 0, bad = 0;
+			while ( ! stop )
+			{
+				if ( locked )
+				{
+					std::lock_guard<std::mutex> lock( shared.mutex );
+					sample = shared.sample;
+				}
+				else
+					table.latest( BENCHMARK_SOURCE, sample );
+
+				if ( isTorn( sample ) ) bad++;
+				count++;
+			}
+			reads += count;
+			torn += bad;
+		} ) );
+
+	usleep( msecs * 1000 );
+	stop = true;
+	writer.join();
+	for ( unsigned int i = 0; i < threads; i++ )
+		readers[ i ].join();
+
+	// Each reader thread spends the whole duration reading
+	double perThread = (double) reads / threads;
+	std::cout
+		<< "  " << name << ": " << (unsigned long long) ( perThread / ( msecs / 1000.0 ) ) << " reads/s per thread, "
+		<< ( msecs * 1000000.0 / perThread ) << " ns per read, "
+		<< writes << " writes, " << torn << " torn" << std::endl;
+
+	return torn;
+}
+
+int main( int argc, char * argv[] )
+{
+	long
+		count = 10000000;
+
+	unsigned int
+		threads = 4,
+		msecs = 1000;
+
+	int option;
+	while ( ( option = getopt( argc, argv, "n:t:s:" ) ) != -1 )
+	{
+		switch ( option )
+		{
+			case 'n': count = atol( optarg ); break;
+			case 't': threads = atoi( optarg ); break;
+			case 's': msecs = atoi( optarg ); break;
+			default:
+				std::cerr << "Usage: " << argv[ 0 ] << " [-n count] [-t threads] [-s msecs]" << std::endl;
+				return EXIT_FAILURE;
+		}
+	}
+	if ( count < 1 ) count = 1;
+	if ( threads < 1 ) threads = 1;
+
+	// Without a writer
+	TrackerTable table;
+	LockedSample shared;
+	TrackedSample sample;
+	double sink = 0.0;
+
+	table.publish( makeSample( BENCHMARK_SOURCE, 1 ) );
+	shared.sample = makeSample( BENCHMARK_SOURCE, 1 );
+
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	for ( long i = 0; i < count; i++ )
+	{
+		table.latest( BENCHMARK_SOURCE, sample );
+		sink += sample.x;
+	}
+	double tableNsecs = std::chrono::duration<double, std::nano>( std::chrono::steady_clock::now() - start ).count() / count;
+
+	start = std::chrono::steady_clock::now();
+	for ( long i = 0; i < count; i++ )
+	{
+		std::lock_guard<std::mutex> lock( shared.mutex );
+		sample = shared.sample;
+		sink += sample.x;
+	}
+	double mutexNsecs = std::chrono::duration<double, std::nano>( std::chrono::steady_clock::now() - start ).count() / count;
+
+	std::cout
+		<< "One thread, no writer" << std::endl
+		<< "  latest(): " << tableNsecs << " ns per read" << std::endl
+		<< "  mutex:    " << mutexNsecs << " ns per read" << std::endl;
+
+	unsigned long long torn = 0;
+
+	std::cout << threads << " reader threads, a writer at " << BENCHMARK_KINECT_RATE << " Hz" << std::endl;
+	torn += contend( "latest()", false, BENCHMARK_KINECT_RATE, threads, msecs );
+	torn += contend( "mutex   ", true, BENCHMARK_KINECT_RATE, threads, msecs );
+
+	std::cout << threads << " reader threads, a writer publishing without pause" << std::endl;
+	torn += contend( "latest()", false, 0, threads, msecs );
+	torn += contend( "mutex   ", true, 0, threads, msecs );
+
+	// fuse() over the cameras seeing the joint, fresh and close together
+	std::cout << "fuse()" << std::endl;
+	for ( unsigned int cameras = 1; cameras <= 4; cameras++ )
+	{
+		TrackerTable fused;
+		for ( unsigned int camera = 0; camera < cameras; camera++ )
+		{
+			TrackedSample seen = makeSample( TRACKERTABLE_SOURCE( camera, 3 ), 0 );
+			seen.x = 1.0 + ( 0.01 * camera );
+			seen.captureTime = TrackerTable::monotonicTime();
+			fused.publish( seen );
+		}
+
+		long fuses = count / 10;
+		unsigned int merged = 0;
+		start = std::chrono::steady_clock::now();
+		for ( long i = 0; i < fuses; i++ )
+		{
+			merged = fused.fuse( 3, sample, 1000000 );
+			sink += sample.x;
+		}
+		double fuseNsecs = std::chrono::duration<double, std::nano>( std::chrono::steady_clock::now() - start ).count() / fuses;
+
+		std::cout << "  " << cameras << " cameras: " << fuseNsecs << " ns, " << merged << " merged" << std::endl;
+	}
+
+	// Keeps the reads from being optimized away
+	if ( sink == 0.12345 ) std::cout << sink << std::endl;
+
+	return ( torn == 0 ) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
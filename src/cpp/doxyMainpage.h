@@ -7,9 +7,23 @@
  *
  * This relase includes
  * 	- Brain, the framework
+ * 	- Behaviour, routines stepped by the Brain main loop, which may run side by side and be cancelled at any time
  * 	- A collection of geometry classes used by Brain
  * 	- KinectReader, a class for reading coordinates from a Kinect connected to a remove server
  * 	- TcpSocket, a tcp socket library used by KinectReader
+ * 	- TelemetryServer, streaming Brain's state to any number of monitoring clients
+ * 	- CommandServer, taking Control commands from scripts and remote clients
+ * 	- commandClient, sending commands to the CommandServer and benchmarking it (make aux/commandClient)
+ * 	- kinectEmulator, a local Kinect server for testing KinectReader (make aux/kinectEmulator)
+ * 	- lineExtractorBenchmark, timing and accuracy of the LineExtractor on simulated scans (make aux/lineExtractorBenchmark)
+ * 	- ringWindowBenchmark, RingWindow against the std::list deltas it replaced (make aux/ringWindowBenchmark)
+ * 	- cbhaPatternReplay, accuracy and throughput of the cBHA interaction patterns on replayed interactions (make aux/cbhaPatternReplay)
+ * 	- kinectParseBenchmark, KinectReader::parseCoordinate() against the substr() parsing it replaced (make aux/kinectParseBenchmark)
+ * 	- oneEuroEvaluation, jitter and lag of the OneEuroFilter parameters on aux/kinectHand.txt or other recordings (make aux/oneEuroEvaluation)
+ * 	- trackerTableBenchmark, lock free TrackerTable reads against a mutex, and the cost of fuse() (make aux/trackerTableBenchmark)
+ * 	- kinectTransportBenchmark, worst case latency of KinectReader over TCP against UDP with lost records (make aux/kinectTransportBenchmark)
+ * 	- telemetryBenchmark, cost of TelemetryServer::broadcast() and the frames recieved by fast, slow and stalled clients (make aux/telemetryBenchmark)
+ * 	- tcpWriteBenchmark, throughput of TcpSocket::write() and writeFrames() for small and large messages (make aux/tcpWriteBenchmark)
  * 
  * A class for Control and a functional main.cpp is also provided for demonstrational purposes.
  *
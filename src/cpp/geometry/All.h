@@ -4,3 +4,4 @@
 #include "Vector.h"
 #include "AngularCoordinate.h"
 #include "VolumeCoordinate.h"
+#include "RigidTransform.h"
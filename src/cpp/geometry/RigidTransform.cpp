@@ -0,0 +1,108 @@
+#include "RigidTransform.h"
+
+#include "VolumeCoordinate.h"
+
+#include <math.h>
+#include <iostream>
+
+
+RigidTransform::RigidTransform()
+{
+	for ( int i = 0; i < 9; i++ )
+		this->_rotation[ i ] = ( i % 4 == 0 ) ? 1.0 : 0.0;
+
+	this->_translation[ 0 ] = 0.0;
+	this->_translation[ 1 ] = 0.0;
+	this->_translation[ 2 ] = 0.0;
+
+	this->_yaw = 0.0;
+	this->_pitch = 0.0;
+	this->_roll = 0.0;
+}
+
+RigidTransform::RigidTransform( float yaw, float pitch, float roll, float x, float y, float z )
+{
+	float
+		cy = cos( yaw ),
+		sy = sin( yaw ),
+		cp = cos( pitch ),
+		sp = sin( pitch ),
+		cr = cos( roll ),
+		sr = sin( roll );
+
+	// R = Rz( yaw ) * Ry( pitch ) * Rx( roll )
+	this->_rotation[ 0 ] = cy * cp;
+	this->_rotation[ 1 ] = ( cy * sp * sr ) - ( sy * cr );
+	this->_rotation[ 2 ] = ( cy * sp * cr ) + ( sy * sr );
+	this->_rotation[ 3 ] = sy * cp;
+	this->_rotation[ 4 ] = ( sy * sp * sr ) + ( cy * cr );
+	this->_rotation[ 5 ] = ( sy * sp * cr ) - ( cy * sr );
+	this->_rotation[ 6 ] = -sp;
+	this->_rotation[ 7 ] = cp * sr;
+	this->_rotation[ 8 ] = cp * cr;
+
+	this->_translation[ 0 ] = x;
+	this->_translation[ 1 ] = y;
+	this->_translation[ 2 ] = z;
+
+	this->_yaw = yaw;
+	this->_pitch = pitch;
+	this->_roll = roll;
+}
+
+VolumeCoordinate
+RigidTransform::apply( VolumeCoordinate coordinate ) const
+{
+	float point[ 3 ] = { coordinate.x(), coordinate.y(), coordinate.z() };
+	this->apply( point, point );
+	return VolumeCoordinate( point[ 0 ], point[ 1 ], point[ 2 ] );
+}
+
+void
+RigidTransform::apply( const float * in, float * out ) const
+{
+	this->rotate( in, out );
+
+	out[ 0 ] += this->_translation[ 0 ];
+	out[ 1 ] += this->_translation[ 1 ];
+	out[ 2 ] += this->_translation[ 2 ];
+}
+
+void
+RigidTransform::rotate( const float * in, float * out ) const
+{
+	const float * r = this->_rotation;
+	float
+		x = in[ 0 ],
+		y = in[ 1 ],
+		z = in[ 2 ];
+
+	out[ 0 ] = ( r[ 0 ] * x ) + ( r[ 1 ] * y ) + ( r[ 2 ] * z );
+	out[ 1 ] = ( r[ 3 ] * x ) + ( r[ 4 ] * y ) + ( r[ 5 ] * z );
+	out[ 2 ] = ( r[ 6 ] * x ) + ( r[ 7 ] * y ) + ( r[ 8 ] * z );
+}
+
+void
+RigidTransform::setTranslation( float x, float y, float z )
+{
+	this->_translation[ 0 ] = x;
+	this->_translation[ 1 ] = y;
+	this->_translation[ 2 ] = z;
+}
+
+VolumeCoordinate
+RigidTransform::translation() const
+{
+	return VolumeCoordinate( this->_translation[ 0 ], this->_translation[ 1 ], this->_translation[ 2 ] );
+}
+
+/// Overloaded out stream operator
+std::ostream & operator << ( std::ostream & output, const RigidTransform & t )
+{
+	output
+		<< "yaw " << t._yaw << ", pitch " << t._pitch << ", roll " << t._roll
+		<< ", translation " << t._translation[ 0 ]
+		<< "," << t._translation[ 1 ]
+		<< "," << t._translation[ 2 ];
+	return output;
+}
@@ -0,0 +1,100 @@
+#ifndef RIGIDTRANSFORM_H
+#define RIGIDTRANSFORM_H
+
+#include "VolumeCoordinate.h"
+
+#include <iostream>
+
+
+/**
+ * Represents a rigid transform in three dimensions, a rotation followed by
+ * a translation
+ *
+ * Used to map coordinates from a sensor, like the Kinect, to the coordinate
+ * system of Robotino. The rotation is given as yaw (around z), pitch (around
+ * y) and roll (around x), applied in the order roll, pitch, yaw.
+ */
+class RigidTransform
+{
+ public:
+	/**
+	 * Default constructor, initializes the identity transform
+	 */
+	RigidTransform();
+
+	/**
+	 * Constructs RigidTransform
+	 *
+	 * @param	yaw	Rotation around the z axis, in radians
+	 * @param	pitch	Rotation around the y axis, in radians
+	 * @param	roll	Rotation around the x axis, in radians
+	 * @param	x	Translation along the x axis
+	 * @param	y	Translation along the y axis
+	 * @param	z	Translation along the z axis
+	 */
+	RigidTransform( float yaw, float pitch, float roll, float x, float y, float z );
+
+	/**
+	 * Transforms a coordinate
+	 *
+	 * @param	coordinate	The coordinate to transform
+	 *
+	 * @return	The transformed coordinate
+	 */
+	VolumeCoordinate apply( VolumeCoordinate coordinate ) const;
+
+	/**
+	 * Transforms a point given as three values
+	 *
+	 * @param	in	The x, y and z values to transform
+	 * @param	out	Output, the transformed x, y and z values, may be the
+	 * same as in
+	 */
+	void apply( const float * in, float * out ) const;
+
+	/**
+	 * Rotates a direction given as three values, without translating it.
+	 * Used for velocities.
+	 *
+	 * @param	in	The x, y and z values to rotate
+	 * @param	out	Output, the rotated x, y and z values, may be the same
+	 * as in
+	 */
+	void rotate( const float * in, float * out ) const;
+
+	/**
+	 * Sets the translation, keeping the rotation
+	 *
+	 * @param	x	Translation along the x axis
+	 * @param	y	Translation along the y axis
+	 * @param	z	Translation along the z axis
+	 */
+	void setTranslation( float x, float y, float z );
+
+	/**
+	 * Gets the translation
+	 *
+	 * @return	The translation as a VolumeCoordinate
+	 */
+	VolumeCoordinate translation() const;
+
+	/**
+	 * Overload of the << stream operator for a RigidTransform object, allows direct use of a RigidTransform object in a stream out situation
+	 */
+	friend std::ostream & operator << ( std::ostream & output, const RigidTransform & t );
+
+ private:
+	float
+	/// The rotation matrix, row major
+		_rotation[ 9 ],
+	/// The translation, x, y and z
+		_translation[ 3 ];
+
+	float
+	/// The rotation angles the transform was constructed from, for output
+		_yaw,
+		_pitch,
+		_roll;
+};
+
+#endif
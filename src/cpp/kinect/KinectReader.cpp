@@ -1,145 +1,296 @@
 #include "KinectReader.h"
 
 #include "../geometry/VolumeCoordinate.h"
+#include "../geometry/RigidTransform.h"
 #include "../tcp/TcpSocket.h"
+#include "../tcp/UdpSocket.h"
+#include "../tcp/Reactor.h"
+#include "TrackerTable.h"
 
 #include <rec/robotino/api2/Com.h>
 
 #include <stdlib.h>
 #include <math.h>       // for fabs()
-#include <unistd.h>		// for usleep()
 #include <string>
 #include <cstring>
 #include <iostream>
+#include <mutex>
+#include <time.h>		// for clock_gettime()
 
 
-int KinectReader::readPosition( unsigned int average ) 
-{
-	std::string input;
-
-	/* Kinect has the following coordinate map:
-	 * x -> -left/+right
-	 * y -> +up/-down
-	 * z -> -closer/+farther
-	 * ..with the kinect positioned in 0,0,0
-	 * Values given in millimeters
-	 *
-	 * Mapping to Robotino:
-	 * robotinoX = kinectZ
-	 * robotinoY = kinectX
-	 * robotinoZ = kinectY + kinectHeight
-	 * Brain/API2 expected values in meters
-	 */
+static_assert( sizeof( KinectRecord ) == KINECTREADER_RECORD_SIZE, "KinectRecord must match the protocol" );
 
-	float
-		xCurVal = 0.0,
-		yCurVal = 0.0,
-		zCurVal = 0.0;
+bool
+KinectReader::start( Reactor * reactor )
+{
+	if ( this->runLoop ) return false;
 
-	unsigned int
-		i = 0,
-		endx = 0,
-		endy = 0;
+	this->pReactor = reactor;
+	this->runLoop = true;
 
-/*	TcpSocket
-		tcpClient;
+	// Connect from the Reactor thread
+	this->pReactor->schedule( this, 0 );
+	return true;
+}
 
-	// Connect to the server
-	try 
-	{
-		std::cerr << "KinectReader: connecting..." << std::endl;
-*/		TcpSocket tcpClient( this->port, this->server );
-/*	}
-	catch ( std::exception * e )
+void
+KinectReader::readable( int descriptor )
+{
+	if ( this->udp )
 	{
-		std::cout << "Kinect - TcpSocket - " << e->what() << std::endl;
-		return KINECTREADER_COULD_NOT_CONNECT;
+		this->readDatagrams();
+		return;
 	}
- 	
-	std::cerr << "KinectReader: connected" << std::endl;
-*/
-	this->runLoop = true;
 
-	while ( this->runLoop )
+	// A connect in progress has failed
+	if ( ! this->connected )
 	{
-		xCurVal = 0.0;
-		yCurVal = 0.0;
-		zCurVal = 0.0;
+		this->writable( descriptor );
+		return;
+	}
 
-		i = 0;
+	const char * data = NULL;
+	unsigned int length = 0;
 
-		// Read data from socket
-		while ( tcpClient.read( input ) )
+	// Handle every complete line or record recieved, parsed in place
+	while ( true )
+	{
+		if ( this->binary )
 		{
-	//		std::cout << "Kinect read: " << input << std::endl;
-			
-			if ( input == "Click" )
-			{
-				this->clickTime = pCom->msecsElapsed();
-				continue;
-			}
+			if ( ! this->pSocket->readBytes( data, KINECTREADER_RECORD_SIZE ) ) break;
+			this->handleRecord( data );
+		}
+		else
+		{
+			if ( ! this->pSocket->readLine( data, length ) ) break;
+			this->handleLine( data, length );
+		}
+	}
 
-			endx = input.find( ',', 0 );
-			if ( endx == std::string::npos ) continue;
-			endy = input.find( ',', endx + 1 );
-			if ( endy == std::string::npos ) continue;
+	if ( ! this->pSocket->isConnected() )
+	{
+		std::cerr << "KinectReader: Connection lost, reconnecting" << std::endl;
+		this->disconnect();
+		this->scheduleConnect();
+	}
+}
 
-			xCurVal += (float) std::atof( input.substr( 0, endx ).c_str() );
-			yCurVal += (float) std::atof( input.substr( endx + 1, endy ).c_str() );
-			zCurVal += (float) std::atof( input.substr( endy + 1 ).c_str() );
+void
+KinectReader::writable( int descriptor )
+{
+	if ( this->connected || this->pSocket == NULL ) return;
 
-	//		std::cout << "Kinect extracted: " << VolumeCoordinate( xCurVal, yCurVal, zCurVal ) << std::endl;
+	if ( ! this->pSocket->finishConnect() )
+	{
+		this->connectFailed( strerror( this->pSocket->error() ) );
+		return;
+	}
 
-			// If data is erranous, read again
-			if ( ( fabs( xCurVal ) + fabs( yCurVal ) + fabs( zCurVal ) ) < 0.1f ) continue;
+	this->pReactor->setWritable( this->socketDescriptor, false );
+	this->pReactor->cancel( this );
 
-			// When the requested number of coordinates has been recieved,
-			// exit reading loop to store data
-			if ( ++i >= average ) break;
-		}
+	unsigned int connectTime = this->pCom->msecsElapsed() - this->connectStartTime;
+	{
+		std::lock_guard<std::mutex> lock( this->sampleMutex );
+		this->lastConnectTime = connectTime;
+		if ( connectTime > this->maxConnectTime ) this->maxConnectTime = connectTime;
+		this->connections++;
+		this->hasSequence = false;
+		this->resetTracks();
+	}
+	this->backoff = KINECTREADER_BACKOFF_MIN;
 
-		if ( i < average )
-		{
-			this->runLoop = false;
-			std::cerr << "KinectReader: Connection lost" << std::endl;
-			return KINECTREADER_LOST_CONNECTION;
-		}
+	// Offer the binary protocol, servers not supporting it keep sending text
+	this->binary = false;
+	std::string hello = KINECTREADER_BINARY_HELLO "\n";
+	this->pSocket->write( hello );
 
-		// Convert to Robotino/Brain standard and store in class variables
-		this->x = ( ( zCurVal / average ) / 1000.0 ) + KINECTREADER_DEPTH_ADJUSTMENT;
-		this->y = ( ( xCurVal / average ) / 1000.0 );
-		this->z = ( ( yCurVal / average ) / 1000.0 ) + this->height;
+	this->connected = true;
+	std::cerr << "KinectReader: Connected in " << connectTime << " msecs" << std::endl;
+}
 
-		this->updateTime = this->pCom->msecsElapsed();
-		this->updated = true;
+void
+KinectReader::timeout()
+{
+	if ( ! this->runLoop ) return;
+
+	if ( this->udp )
+	{
+		if ( this->pUdp == NULL )
+			this->startUdp();
+		else
+			this->udpTimeout();
 	}
+	else if ( this->pSocket == NULL )
+		this->startConnect();
+	else if ( ! this->connected )
+		this->connectFailed( "Timed out" );
+}
+
+void
+KinectReader::setConnectTimeouts( unsigned int connectTimeout, unsigned int maxBackoff )
+{
+	this->connectTimeout = connectTimeout;
+	this->maxBackoff = ( maxBackoff > KINECTREADER_BACKOFF_MIN ) ? maxBackoff : KINECTREADER_BACKOFF_MIN;
+}
 
-	return KINECTREADER_NORMAL_EXIT;
+void
+KinectReader::connectionToString( std::ostream & out )
+{
+	std::lock_guard<std::mutex> lock( this->sampleMutex );
+
+	out
+		<< "KinectReader: " << ( this->connected ? "Connected" : "Not connected" )
+		<< " to " << this->server << ":" << this->port << std::endl
+		<< "  attempts = " << this->connectAttempts
+		<< "  failures = " << this->connectFailures
+		<< "  connections = " << this->connections << std::endl
+		<< "  connect time (msecs): last = " << this->lastConnectTime
+		<< "  max = " << this->maxConnectTime << std::endl
+		<< "  protocol = " << ( this->udp ? "binary/udp" : ( this->binary ? "binary" : "text" ) )
+		<< "  records = " << this->records
+		<< "  dropped = " << this->drops
+		<< "  stale = " << this->stale << std::endl
+		<< "  latency (usecs): last = " << this->lastLatency
+		<< "  average = "
+		<< ( ( this->latencyCount > 0 ) ? (unsigned int) ( this->latencySum / this->latencyCount ) : 0 )
+		<< "  max = " << this->maxLatency << std::endl
+		<< "  transform: " << this->transform << std::endl
+		<< "  filter: min cutoff = " << this->filterMinCutoff
+		<< "  beta = " << this->filterBeta
+		<< "  derivative cutoff = " << this->filterDerivativeCutoff << std::endl
+		<< "  camera = " << this->camera
+		<< "  primary joint = " << this->primaryJoint << std::endl
+		<< "  velocity (m/s) = " << VolumeCoordinate(
+				this->tracks[ this->primaryJoint ].sample.xVelocity,
+				this->tracks[ this->primaryJoint ].sample.yVelocity,
+				this->tracks[ this->primaryJoint ].sample.zVelocity ) << std::endl
+		<< "  latency budget (msecs): capture to recieve = "
+		<< ( ( this->latencyCount > 0 ) ? ( this->latencySum / this->latencyCount ) / 1000.0 : (double) KINECTREADER_TEXT_LATENCY )
+		<< "  recieve to use = "
+		<< ( ( this->predictions > 0 ) ? ( this->useAgeSum / this->predictions ) / 1000.0 : 0.0 )
+		<< "  capture to use = "
+		<< ( ( this->predictions > 0 ) ? ( this->horizonSum / this->predictions ) / 1000.0 : 0.0 )
+		<< "  max = " << this->maxHorizon / 1000.0
+		<< "  budget = " << KINECTREADER_LATENCY_BUDGET << std::endl
+		<< "  predictions = " << this->predictions
+		<< "  over budget = " << this->overBudget
+		<< "  capped = " << this->capped << std::endl;
 }
 
-KinectReader::KinectReader( std::string server, std::string port, rec::robotino::api2::Com * pCom ) 
+KinectReader::KinectReader( std::string server, std::string port, rec::robotino::api2::Com * pCom, bool udp ) 
 {
 	this->server = server;
 	this->port = port;
 	this->pCom = pCom;
+	this->udp = udp;
 
-	this->x = 0.0;
-	this->y = 0.0;
-	this->z = 0.0;
+	this->pTrackers = NULL;
+	this->camera = 0;
+	this->primaryJoint = 0;
+	for ( unsigned int i = 0; i < KINECTREADER_JOINTS; i++ )
+	{
+		TrackedSample & sample = this->tracks[ i ].sample;
+		sample.source = TRACKERTABLE_SOURCE( this->camera, i );
+		sample.x = sample.y = sample.z = 0.0;
+		sample.xVelocity = sample.yVelocity = sample.zVelocity = 0.0;
+		sample.captureTime = 0;
+	}
+	this->resetTracks();
+	this->recieveTime = 0;
 
-	this->height = KINECTREADER_MIN_HEIGHT;
+	this->transform = RigidTransform( 0.0, 0.0, 0.0, KINECTREADER_DEPTH_ADJUSTMENT, 0.0, KINECTREADER_MIN_HEIGHT );
 
 	this->updateTime = 0;
 	this->clickTime = 0;
 
 	this->runLoop = false;
 	this->updated = false;
+	this->connected = false;
+
+	this->pReactor = NULL;
+	this->pSocket = NULL;
+	this->pUdp = NULL;
+	this->socketDescriptor = -1;
+	this->datagramTime = 0;
+
+	this->connectTimeout = KINECTREADER_CONNECT_TIMEOUT;
+	this->maxBackoff = KINECTREADER_BACKOFF_MAX;
+	this->backoff = KINECTREADER_BACKOFF_MIN;
+	this->connectStartTime = 0;
+	this->connectAttempts = 0;
+	this->connectFailures = 0;
+	this->connections = 0;
+	this->lastConnectTime = 0;
+	this->maxConnectTime = 0;
+
+	this->binary = false;
+	this->hasSequence = false;
+	this->lastSequence = 0;
+	this->records = 0;
+	this->drops = 0;
+	this->stale = 0;
+	this->lastLatency = 0;
+	this->maxLatency = 0;
+	this->latencyCount = 0;
+	this->latencySum = 0.0;
+
+	this->predictions = 0;
+	this->overBudget = 0;
+	this->capped = 0;
+	this->lastUseAge = 0;
+	this->lastHorizon = 0;
+	this->maxHorizon = 0;
+	this->useAgeSum = 0.0;
+	this->horizonSum = 0.0;
+
+	this->setFilter( ONEEUROFILTER_MIN_CUTOFF, ONEEUROFILTER_BETA, ONEEUROFILTER_DERIVATIVE_CUTOFF );
 }
 
 VolumeCoordinate KinectReader::getCoordinate()
 {
+	std::lock_guard<std::mutex> lock( this->sampleMutex );
+
+	const TrackedSample & sample = this->tracks[ this->primaryJoint ].sample;
 	this->updated = false;
-	return VolumeCoordinate( this->x, this->y, this->z );
+	return VolumeCoordinate( sample.x, sample.y, sample.z );
+}
+
+VolumeCoordinate
+KinectReader::getPredictedCoordinate()
+{
+	std::lock_guard<std::mutex> lock( this->sampleMutex );
+
+	const TrackedSample & sample = this->tracks[ this->primaryJoint ].sample;
+	this->updated = false;
+	if ( ! this->tracks[ this->primaryJoint ].hasSample )
+		return VolumeCoordinate( sample.x, sample.y, sample.z );
+
+	long long now = TrackerTable::monotonicTime();
+	long long horizon = now - sample.captureTime;
+	if ( horizon < 0 ) horizon = 0;
+
+	// Latency budget
+	this->lastUseAge = (unsigned int) ( now - this->recieveTime );
+	this->lastHorizon = (unsigned int) horizon;
+	if ( this->lastHorizon > this->maxHorizon ) this->maxHorizon = this->lastHorizon;
+	this->useAgeSum += this->lastUseAge;
+	this->horizonSum += this->lastHorizon;
+	this->predictions++;
+	if ( horizon > KINECTREADER_LATENCY_BUDGET * 1000LL ) this->overBudget++;
+
+	// Do not extrapolate stale coordinates indefinitely
+	if ( horizon > KINECTREADER_PREDICTION_MAX * 1000LL )
+	{
+		horizon = KINECTREADER_PREDICTION_MAX * 1000LL;
+		this->capped++;
+	}
+
+	float seconds = horizon / 1000000.0;
+	return VolumeCoordinate(
+			sample.x + ( sample.xVelocity * seconds ),
+			sample.y + ( sample.yVelocity * seconds ),
+			sample.z + ( sample.zVelocity * seconds ) );
 }
 
 bool KinectReader::isUpdated()
@@ -152,6 +303,11 @@ unsigned int KinectReader::dataAge()
 	return ( this->pCom->msecsElapsed() - this->updateTime );
 }
 
+unsigned int KinectReader::dataTime()
+{
+	return this->updateTime;
+}
+
 unsigned int KinectReader::clickAge()
 {
 	return this->pCom->msecsElapsed() - this->clickTime;
@@ -160,13 +316,15 @@ unsigned int KinectReader::clickAge()
 bool
 KinectReader::isRunning()
 {
-	return this->runLoop;
+	return this->connected;
 }
 
 void
 KinectReader::stopLoop()
 {
 	this->runLoop = false;
+	if ( this->pReactor != NULL ) this->pReactor->cancel( this );
+	this->disconnect();
 }
 
 void
@@ -174,9 +332,418 @@ KinectReader::setHeight( float height )
 {
 	if ( height > KINECTREADER_MIN_HEIGHT )
 	{
-		this->height = height;
+		std::lock_guard<std::mutex> lock( this->sampleMutex );
+
+		VolumeCoordinate translation = this->transform.translation();
+		this->transform.setTranslation( translation.x(), translation.y(), height );
 		std::cout << "Kinect height set to " << height << " meters" << std::endl;
 	}
 	else
 		std::cout << "Could not set kinect height to " << height << " meters, too low" << std::endl;
 }
+
+void
+KinectReader::setTransform( const RigidTransform & transform )
+{
+	std::lock_guard<std::mutex> lock( this->sampleMutex );
+
+	this->transform = transform;
+	this->resetTracks();
+	std::cout << "Kinect transform set to " << transform << std::endl;
+}
+
+RigidTransform
+KinectReader::getTransform()
+{
+	std::lock_guard<std::mutex> lock( this->sampleMutex );
+	return this->transform;
+}
+
+void
+KinectReader::setFilter( float minCutoff, float beta, float derivativeCutoff )
+{
+	std::lock_guard<std::mutex> lock( this->sampleMutex );
+
+	this->filterMinCutoff = ( minCutoff > 0.0 ) ? minCutoff : 0.0;
+	this->filterBeta = beta;
+	this->filterDerivativeCutoff = derivativeCutoff;
+	for ( unsigned int i = 0; i < KINECTREADER_JOINTS; i++ )
+		for ( int j = 0; j < 3; j++ )
+			this->tracks[ i ].filters[ j ].setParameters( minCutoff, beta, derivativeCutoff );
+}
+
+void
+KinectReader::setTrackerTable( TrackerTable * trackers, unsigned int camera )
+{
+	std::lock_guard<std::mutex> lock( this->sampleMutex );
+
+	this->pTrackers = trackers;
+	this->camera = camera;
+	for ( unsigned int i = 0; i < KINECTREADER_JOINTS; i++ )
+		this->tracks[ i ].sample.source = TRACKERTABLE_SOURCE( camera, i );
+}
+
+void
+KinectReader::setPrimaryJoint( unsigned int joint )
+{
+	std::lock_guard<std::mutex> lock( this->sampleMutex );
+
+	if ( joint < KINECTREADER_JOINTS )
+		this->primaryJoint = joint;
+	else
+		std::cerr << "KinectReader: Joint " << joint << " is not tracked" << std::endl;
+}
+
+unsigned int
+KinectReader::getPrimaryJoint()
+{
+	std::lock_guard<std::mutex> lock( this->sampleMutex );
+	return this->primaryJoint;
+}
+
+
+// Private functions
+
+void
+KinectReader::startConnect()
+{
+	{
+		std::lock_guard<std::mutex> lock( this->sampleMutex );
+		this->connectAttempts++;
+	}
+	this->connectStartTime = this->pCom->msecsElapsed();
+
+	this->pSocket = new TcpSocket();
+	if ( ! this->pSocket->connectAsync( this->port, this->server ) )
+	{
+		this->connectFailed( strerror( this->pSocket->error() ) );
+		return;
+	}
+
+	// The connect has completed when the connection is writable
+	this->socketDescriptor = this->pSocket->descriptor();
+	if ( ! this->pReactor->add( this->socketDescriptor, this, true ) )
+	{
+		this->socketDescriptor = -1;
+		this->connectFailed( "Unable to watch connection" );
+		return;
+	}
+
+	this->pReactor->schedule( this, this->connectTimeout );
+}
+
+void
+KinectReader::startUdp()
+{
+	{
+		std::lock_guard<std::mutex> lock( this->sampleMutex );
+		this->connectAttempts++;
+	}
+	this->connectStartTime = this->pCom->msecsElapsed();
+
+	this->pUdp = new UdpSocket();
+	if ( ! this->pUdp->connect( this->port, this->server ) )
+	{
+		this->connectFailed( strerror( this->pUdp->error() ) );
+		return;
+	}
+
+	this->socketDescriptor = this->pUdp->descriptor();
+	if ( ! this->pReactor->add( this->socketDescriptor, this ) )
+	{
+		this->socketDescriptor = -1;
+		this->connectFailed( "Unable to watch socket" );
+		return;
+	}
+
+	// Records only, the stream is connected when the first one arrives
+	this->binary = true;
+	{
+		std::lock_guard<std::mutex> lock( this->sampleMutex );
+		this->hasSequence = false;
+		this->resetTracks();
+	}
+
+	this->udpTimeout();
+}
+
+void
+KinectReader::udpTimeout()
+{
+	if ( this->connected
+			&& this->pCom->msecsElapsed() - this->datagramTime > KINECTREADER_UDP_TIMEOUT )
+	{
+		std::cerr << "KinectReader: No datagrams for " << KINECTREADER_UDP_TIMEOUT << " msecs, stream lost" << std::endl;
+		this->connected = false;
+
+		std::lock_guard<std::mutex> lock( this->sampleMutex );
+		this->hasSequence = false;
+		this->resetTracks();
+	}
+
+	// Subscribe, and keep the subscription alive
+	const char * hello = KINECTREADER_BINARY_HELLO "\n";
+	this->pUdp->send( hello, strlen( hello ) );
+	this->pReactor->schedule( this, KINECTREADER_UDP_HELLO_INTERVAL );
+}
+
+void
+KinectReader::readDatagrams()
+{
+	unsigned int count;
+	while ( ( count = this->pUdp->receive() ) > 0 )
+	{
+		if ( ! this->connected )
+		{
+			unsigned int connectTime = this->pCom->msecsElapsed() - this->connectStartTime;
+			{
+				std::lock_guard<std::mutex> lock( this->sampleMutex );
+				this->lastConnectTime = connectTime;
+				if ( connectTime > this->maxConnectTime ) this->maxConnectTime = connectTime;
+				this->connections++;
+			}
+			this->connected = true;
+			std::cerr << "KinectReader: Recieving datagrams" << std::endl;
+		}
+		this->datagramTime = this->pCom->msecsElapsed();
+
+		// One record per datagram, others are ignored
+		for ( unsigned int i = 0; i < count; i++ )
+		{
+			unsigned int length;
+			const char * data = this->pUdp->datagram( i, length );
+			if ( length == KINECTREADER_RECORD_SIZE ) this->handleRecord( data );
+		}
+
+		if ( count < UDPSOCKET_BATCH ) break;
+	}
+}
+
+void
+KinectReader::connectFailed( const char * reason )
+{
+	{
+		std::lock_guard<std::mutex> lock( this->sampleMutex );
+		this->connectFailures++;
+	}
+	std::cerr
+		<< "KinectReader: Could not connect to " << this->server << ":" << this->port
+		<< " (" << reason << "), retrying in " << this->backoff << " msecs"
+		<< std::endl;
+
+	this->disconnect();
+	this->scheduleConnect();
+}
+
+void
+KinectReader::scheduleConnect()
+{
+	if ( ! this->runLoop ) return;
+
+	this->pReactor->schedule( this, this->backoff );
+
+	// Double the delay for each failure in a row
+	this->backoff *= 2;
+	if ( this->backoff > this->maxBackoff ) this->backoff = this->maxBackoff;
+}
+
+void
+KinectReader::disconnect()
+{
+	if ( this->pSocket == NULL && this->pUdp == NULL ) return;
+
+	this->connected = false;
+	if ( this->socketDescriptor != -1 ) this->pReactor->remove( this->socketDescriptor );
+	this->socketDescriptor = -1;
+	delete this->pSocket;
+	this->pSocket = NULL;
+	delete this->pUdp;
+	this->pUdp = NULL;
+}
+
+void
+KinectReader::handleLine( const char * line, unsigned int length )
+{
+	float
+		xVal,
+		yVal,
+		zVal;
+
+//	std::cout << "Kinect read: " << line << std::endl;
+
+	if ( this->isClick( line, line + length ) )
+	{
+		this->clickTime = pCom->msecsElapsed();
+		return;
+	}
+
+	// The server supports the binary protocol, records follow
+	if ( length == strlen( KINECTREADER_BINARY_HELLO )
+			&& memcmp( line, KINECTREADER_BINARY_HELLO, length ) == 0 )
+	{
+		this->binary = true;
+		std::cerr << "KinectReader: Using binary protocol" << std::endl;
+		return;
+	}
+
+	if ( ! this->parseCoordinate( line, line + length, xVal, yVal, zVal ) ) return;
+
+//	std::cout << "Kinect extracted: " << VolumeCoordinate( xVal, yVal, zVal ) << std::endl;
+
+	// The text protocol carries one joint
+	this->handleSample( 0, xVal, yVal, zVal, TrackerTable::monotonicTime() - ( KINECTREADER_TEXT_LATENCY * 1000LL ) );
+}
+
+void
+KinectReader::handleRecord( const char * data )
+{
+	KinectRecord record;
+	memcpy( & record, data, sizeof( record ) );
+
+	// Requires the clocks of the server and Robotino to be synchronized
+	struct timespec now;
+	clock_gettime( CLOCK_REALTIME, & now );
+	long long latency =
+		( (long long) now.tv_sec * 1000000 ) + ( now.tv_nsec / 1000 )
+		- (long long) record.timestamp;
+
+	// The capture time on the monotonic clock, unknown with unsynchronized
+	// clocks
+	long long capture = TrackerTable::monotonicTime();
+
+	{
+		std::lock_guard<std::mutex> lock( this->sampleMutex );
+
+		// Datagrams may be reordered, a record older than the newest is stale
+		if ( this->hasSequence && (int32_t) ( record.sequence - this->lastSequence ) <= 0 )
+		{
+			this->stale++;
+			return;
+		}
+
+		// Sequence numbers are consecutive, a gap means records were dropped
+		if ( this->hasSequence && record.sequence != this->lastSequence + 1 )
+			this->drops += (unsigned int) ( record.sequence - this->lastSequence - 1 );
+		this->lastSequence = record.sequence;
+		this->hasSequence = true;
+		this->records++;
+
+		if ( latency >= 0 )
+		{
+			capture -= latency;
+
+			this->lastLatency = (unsigned int) latency;
+			if ( this->lastLatency > this->maxLatency ) this->maxLatency = this->lastLatency;
+			this->latencySum += latency;
+			this->latencyCount++;
+		}
+	}
+
+	if ( record.type == KINECTREADER_RECORD_CLICK )
+		this->clickTime = pCom->msecsElapsed();
+	else if ( record.type == KINECTREADER_RECORD_SAMPLE )
+		this->handleSample( record.joint, record.x, record.y, record.z, capture );
+}
+
+void
+KinectReader::handleSample( unsigned int joint, float xVal, float yVal, float zVal, long long capture )
+{
+	// If data is erranous, wait for the next sample
+	if ( ( fabs( xVal ) + fabs( yVal ) + fabs( zVal ) ) < 0.1f ) return;
+	if ( joint >= KINECTREADER_JOINTS ) return;
+
+	/* Kinect has the following coordinate map:
+	 * x -> -left/+right
+	 * y -> +up/-down
+	 * z -> -closer/+farther
+	 * ..with the kinect positioned in 0,0,0
+	 * Values given in millimeters
+	 *
+	 * Mapping to Robotino axes:
+	 * robotinoX = kinectZ
+	 * robotinoY = kinectX
+	 * robotinoZ = kinectY
+	 * Brain/API2 expected values in meters, the calibrated transform then
+	 * adds the Kinects position and orientation
+	 */
+	float point[ 3 ] = { zVal / 1000.0f, xVal / 1000.0f, yVal / 1000.0f };
+
+	std::lock_guard<std::mutex> lock( this->sampleMutex );
+
+	this->transform.apply( point, point );
+
+	KinectTrack & track = this->tracks[ joint ];
+	TrackedSample & sample = track.sample;
+
+	// Filter and estimate the velocity, both restarted after gaps
+	long long interval = capture - sample.captureTime;
+	float seconds = interval / 1000000.0;
+	if ( ! track.hasSample || interval > KINECTREADER_VELOCITY_MAX_GAP * 1000LL )
+	{
+		for ( int i = 0; i < 3; i++ )
+			track.filters[ i ].reset();
+		sample.xVelocity = 0.0;
+		sample.yVelocity = 0.0;
+		sample.zVelocity = 0.0;
+	}
+	if ( this->filterMinCutoff > 0.0 )
+	{
+		for ( int i = 0; i < 3; i++ )
+			point[ i ] = track.filters[ i ].filter( point[ i ], seconds );
+	}
+	if ( track.hasSample && interval > 0 && interval <= KINECTREADER_VELOCITY_MAX_GAP * 1000LL )
+	{
+		sample.xVelocity += KINECTREADER_VELOCITY_SMOOTHING * ( ( ( point[ 0 ] - sample.x ) / seconds ) - sample.xVelocity );
+		sample.yVelocity += KINECTREADER_VELOCITY_SMOOTHING * ( ( ( point[ 1 ] - sample.y ) / seconds ) - sample.yVelocity );
+		sample.zVelocity += KINECTREADER_VELOCITY_SMOOTHING * ( ( ( point[ 2 ] - sample.z ) / seconds ) - sample.zVelocity );
+	}
+
+	sample.x = point[ 0 ];
+	sample.y = point[ 1 ];
+	sample.z = point[ 2 ];
+	sample.captureTime = capture;
+	track.hasSample = true;
+
+	// Shared with other readers and threads through the table
+	if ( this->pTrackers != NULL ) this->pTrackers->publish( sample );
+
+	if ( joint != this->primaryJoint ) return;
+
+	this->recieveTime = TrackerTable::monotonicTime();
+	this->updateTime = this->pCom->msecsElapsed();
+	this->updated = true;
+}
+
+void
+KinectReader::resetTracks()
+{
+	for ( unsigned int i = 0; i < KINECTREADER_JOINTS; i++ )
+		this->tracks[ i ].hasSample = false;
+}
+
+bool
+KinectReader::isClick( const char * begin, const char * end )
+{
+	if ( end > begin && *( end - 1 ) == '\r' ) end--;
+	return ( end - begin == 5 && memcmp( begin, "Click", 5 ) == 0 );
+}
+
+bool
+KinectReader::parseCoordinate( const char * begin, const char * end, float & x, float & y, float & z )
+{
+	char * next;
+
+	x = strtof( begin, & next );
+	if ( next == begin || next >= end || *next != ',' ) return false;
+
+	begin = next + 1;
+	y = strtof( begin, & next );
+	if ( next == begin || next >= end || *next != ',' ) return false;
+
+	begin = next + 1;
+	z = strtof( begin, & next );
+
+	// strtof() skips leading whitespace, including line breaks, make sure
+	// the value is within the line
+	return ( next != begin && next <= end );
+}
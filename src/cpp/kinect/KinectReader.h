@@ -1,9 +1,19 @@
 #ifndef KINECTREADER_H
 #define KINECTREADER_H
 
+#include "../tcp/Reactor.h"
+#include "../geometry/RigidTransform.h"
+#include "OneEuroFilter.h"
+#include "TrackerTable.h"
+
 #include <string>
+#include <ostream>
+#include <mutex>
+#include <atomic>
+#include <stdint.h>
 
 class TcpSocket;
+class UdpSocket;
 class VolumeCoordinate;
 
 namespace rec {
@@ -14,24 +24,140 @@ namespace rec {
 	}
 }
 
-#define KINECTREADER_NORMAL_EXIT		0
-#define KINECTREADER_LOST_CONNECTION	1
-#define KINECTREADER_COULD_NOT_CONNECT	2
-#define KINECTREADER_UNKNOWN_ERROR		99
+/// Default milliseconds to wait for a connect before it fails
+#define KINECTREADER_CONNECT_TIMEOUT	2000
+/// Milliseconds to wait before reconnecting after a lost connection or the
+/// first failed connect, doubled for each failure in a row
+#define KINECTREADER_BACKOFF_MIN	250
+/// Default maximum milliseconds to wait before reconnecting
+#define KINECTREADER_BACKOFF_MAX	30000
 
 #define KINECTREADER_MIN_HEIGHT		0.05
 
-/// Parameter to adjust for deviation in Kinects depth (z) coordinate
+/// The number of joints tracked from one server, higher joints are ignored
+#define KINECTREADER_JOINTS	32
+
+/// Parameter to adjust for deviation in Kinects depth (z) coordinate, the
+/// x translation of the default transform
 #define KINECTREADER_DEPTH_ADJUSTMENT	-0.1
 
+
+	// Prediction
+
+/// Milliseconds from capture to recieve assumed for the text protocol, which
+/// carries no capture timestamps
+#define KINECTREADER_TEXT_LATENCY	0
+/// Weight of the newest velocity in the smoothed velocity estimate, [0,1]
+#define KINECTREADER_VELOCITY_SMOOTHING	0.3
+/// Milliseconds between samples after which the velocity estimate restarts
+#define KINECTREADER_VELOCITY_MAX_GAP	250
+/// Maximum milliseconds a coordinate is projected forward, older coordinates
+/// are projected this far
+#define KINECTREADER_PREDICTION_MAX	300
+/// Milliseconds from capture to use which a prediction is expected to stay
+/// within, predictions over it are counted
+#define KINECTREADER_LATENCY_BUDGET	100
+
+
+	// Binary protocol
+
+/// Line sent by the client after connecting, servers supporting the binary
+/// protocol reply with the same line and then send KinectRecord records
+#define KINECTREADER_BINARY_HELLO	"KBIN 1"
+/// Size of a binary record in bytes
+#define KINECTREADER_RECORD_SIZE	32
+/// Record type of a coordinate sample
+#define KINECTREADER_RECORD_SAMPLE	1
+/// Record type of a click
+#define KINECTREADER_RECORD_CLICK	2
+
+
+	// UDP transport
+
+/// Milliseconds between the hello datagrams subscribing to the stream
+#define KINECTREADER_UDP_HELLO_INTERVAL	500
+/// Milliseconds without datagrams before the stream is considered lost
+#define KINECTREADER_UDP_TIMEOUT	2000
+
+
+/**
+ * A record of the binary Kinect protocol, sent in host (little endian) byte
+ * order without padding between records
+ */
+struct KinectRecord
+{
+	/// Capture time on the server, in microseconds since the epoch
+	uint64_t timestamp;
+	/// Sequence number, increased by one for each record
+	uint32_t sequence;
+	/// KINECTREADER_RECORD_SAMPLE or KINECTREADER_RECORD_CLICK
+	uint8_t type;
+	/// The tracked joint the sample belongs to
+	uint8_t joint;
+	/// Reserved, 0
+	uint16_t reserved;
+	/// Kinect coordinates of the sample in millimeters, 0 for clicks
+	float x, y, z;
+	/// Reserved, 0
+	uint32_t padding;
+};
+
+/**
+ * The filter and estimate of one joint tracked by a KinectReader
+ */
+struct KinectTrack
+{
+	/// Filters of the x, y and z coordinates
+	OneEuroFilter filters[ 3 ];
+	/// The latest estimate, in Robotino coordinates
+	TrackedSample sample;
+	/// If the track has a sample since it was last reset
+	bool hasSample;
+};
+
 /**
  *	Class for connecting to a remote server with a connected Kinect.
  *
  *	The current implementation reads lines containing one coordinate on the
  *	formate [x],[y],[z] (without the brackets), using . as the decimal
- *	separator.
+ *	separator. Lines are framed by TcpSocket::readLine() and parsed in place
+ *	in its recieve buffer, without allocations.
+ *
+ *	After connecting, the binary protocol is offered by sending the line
+ *	KINECTREADER_BINARY_HELLO. A server supporting it replies with the same
+ *	line and continues with fixed size KinectRecord records, carrying a
+ *	capture timestamp and sequence number used to measure latency and drops.
+ *	Servers ignoring the line keep the text protocol.
+ *
+ *	With the UDP transport, the binary protocol is used over datagrams: the
+ *	client sends KINECTREADER_BINARY_HELLO as a datagram to the server port
+ *	every KINECTREADER_UDP_HELLO_INTERVAL milliseconds, and the server sends
+ *	one KinectRecord per datagram back to the sending address. A lost or
+ *	late datagram never holds back newer ones; records older than the newest
+ *	recieved are discarded, and gaps are counted as drops.
+ *
+ *	Samples are mapped from Kinect to Robotino coordinates by a calibrated
+ *	RigidTransform, see setTransform(), and smoothed by a OneEuroFilter per
+ *	axis, see setFilter(). Every sample updates the stored coordinate, with
+ *	a lag of about 10 milliseconds at hand speeds with the default filter
+ *	parameters. Each stored coordinate keeps its capture time and a smoothed
+ *	velocity estimate, and getPredictedCoordinate() projects it forward to
+ *	the time it is read, compensating for the latency from capture to use.
+ *	The latency budget, capture to recieve, recieve to use and the total, is
+ *	printed by connectionToString().
+ *
+ *	Binary records carry the joint they belong to, and every joint up to
+ *	KINECTREADER_JOINTS is filtered separately. The stored coordinate follows
+ *	the primary joint, see setPrimaryJoint(). With a TrackerTable, see
+ *	setTrackerTable(), the estimate of every joint is published to the table,
+ *	shared by all readers of a Reactor.
+ *
+ *	The connection is non-blocking and handled by a Reactor, including the
+ *	connect. Failed connects are retried with exponential backoff, and a
+ *	lost connection is reconnected, so a missing server never blocks or
+ *	terminates the program.
  */
-class KinectReader
+class KinectReader : public ReactorHandler
 {
 	public:
 		/**
@@ -40,20 +166,59 @@ class KinectReader
 		 * @param	server	IP or domain name of serving hosting the kinect
 		 * @param	port	Port number to connect to
 		 * @param	pCom	Pointer to the active Robotino Com object, used to calculate age of the current stored coordinate
+		 * @param	udp	If the UDP transport is used instead of TCP
 		 */
-		KinectReader( std::string server, std::string port, rec::robotino::api2::Com * pCom ); 
+		KinectReader( std::string server, std::string port, rec::robotino::api2::Com * pCom, bool udp = false ); 
 
 		/**
-		 * Connects to the server and starts the loop reading coordinates
+		 * Starts reading coordinates, connecting from the Reactor thread
 		 *
 		 * The recieved coordinates are expected to be on the form [x],[y],[z]
 		 * where . is used as decimal separator and each line contains only
 		 * one coordinate.
 		 *
-		 * @param	average	The number of values over which to calculate an average coordinate
-		 * @return	Integer indicating exit status, statuses are defined in this header file
+		 * @param	reactor	The Reactor handling the connection
+		 * @return	Boolean indicating if reading was started, false if already started
+		 */
+		bool start( Reactor * reactor );
+
+		/**
+		 * Reads and handles all complete lines or datagrams recieved,
+		 * called by the Reactor
+		 *
+		 * @param	descriptor	The descriptor of the connection
+		 */
+		void readable( int descriptor );
+
+		/**
+		 * Completes a connect in progress, called by the Reactor
+		 *
+		 * @param	descriptor	The descriptor of the connection
+		 */
+		void writable( int descriptor );
+
+		/**
+		 * Starts a scheduled connect, or fails a connect which has timed
+		 * out, called by the Reactor. With the UDP transport, also renews
+		 * the subscription and detects a lost stream.
+		 */
+		void timeout();
+
+		/**
+		 * Sets the timeouts used when connecting
+		 *
+		 * @param	connectTimeout	Milliseconds to wait for a connect
+		 * @param	maxBackoff	Maximum milliseconds to wait before
+		 * retrying a failed connect
+		 */
+		void setConnectTimeouts( unsigned int connectTimeout, unsigned int maxBackoff );
+
+		/**
+		 * Prints the connection status and connect metrics
+		 *
+		 * @param	out	The stream to print to
 		 */
-		int readPosition( unsigned int average = 1 );
+		void connectionToString( std::ostream & out );
 
 		/**
 		 * Get the current coordinate
@@ -62,6 +227,15 @@ class KinectReader
 		 */
 		VolumeCoordinate getCoordinate();
 
+		/**
+		 * Get the current coordinate projected forward from its capture
+		 * time to now, using the estimated velocity. The projection is
+		 * limited to KINECTREADER_PREDICTION_MAX milliseconds.
+		 *
+		 * @return	The predicted x,y,z coordinate as a VolumeCoordinate
+		 */
+		VolumeCoordinate getPredictedCoordinate();
+
 		/**
 		 * Check if values have been updated since they were last read
 		 *
@@ -76,6 +250,15 @@ class KinectReader
 		 */
 		unsigned int dataAge();
 
+		/**
+		 * Gets the time the current values were received. Lets several
+		 * readers tell new values apart, as isUpdated() is reset by any
+		 * reader.
+		 *
+		 * @return	The time in milliseconds, see Com::msecsElapsed()
+		 */
+		unsigned int dataTime();
+
 		/**
 		 * Check the age of the last "Click!" from kinect
 		 *
@@ -84,24 +267,107 @@ class KinectReader
 		unsigned int clickAge();
 
 		/**
-		 * Check if the reader is currently running
+		 * Check if the reader is currently connected
 		 *
 		 * @return	Boolean indicating status
 		 */
 		bool isRunning();
 
 		/**
-		 * Signal the reading loop to exit
+		 * Stop reading and disconnect. Must be called from the Reactor
+		 * thread, or when the Reactor is stopped.
 		 */
 		void stopLoop();
 
 		/**
-		 * Set the height of the Kinects physical position relative to the floor
+		 * Set the height of the Kinects physical position relative to the
+		 * floor, the z translation of the transform
 		 *
 		 * @param	height	Distance from floor to the center of Kinects camera(s) in meters
 		 */
 		void setHeight( float height );
 
+		/**
+		 * Set the calibrated transform from Kinect to Robotino coordinates.
+		 *
+		 * The transform is applied to Kinect coordinates in meters, with
+		 * the axes already ordered as Robotinos: x forward (Kinect depth),
+		 * y sideways and z up. The default has no rotation, and translates
+		 * by KINECTREADER_DEPTH_ADJUSTMENT and the height.
+		 *
+		 * @param	transform	The transform
+		 */
+		void setTransform( const RigidTransform & transform );
+
+		/**
+		 * Get the transform from Kinect to Robotino coordinates
+		 *
+		 * @return	The transform
+		 */
+		RigidTransform getTransform();
+
+		/**
+		 * Set the parameters of the position filter, see OneEuroFilter
+		 *
+		 * @param	minCutoff	The minimum cutoff frequency in Hz, lower
+		 * gives less jitter. 0 disables the filter.
+		 * @param	beta	The increase of the cutoff frequency per meter
+		 * per second of speed, higher gives less lag
+		 * @param	derivativeCutoff	The cutoff frequency in Hz of the
+		 * filtered speed
+		 */
+		void setFilter( float minCutoff, float beta, float derivativeCutoff = ONEEUROFILTER_DERIVATIVE_CUTOFF );
+
+		/**
+		 * Set the table the estimates of all joints are published to
+		 *
+		 * @param	trackers	The table, NULL to stop publishing
+		 * @param	camera	The camera number of this reader, part of the
+		 * source ids, see TRACKERTABLE_SOURCE
+		 */
+		void setTrackerTable( TrackerTable * trackers, unsigned int camera );
+
+		/**
+		 * Set the joint followed by the stored coordinate. The text protocol
+		 * only carries joint 0.
+		 *
+		 * @param	joint	The joint
+		 */
+		void setPrimaryJoint( unsigned int joint );
+
+		/**
+		 * Get the joint followed by the stored coordinate
+		 *
+		 * @return	The joint
+		 */
+		unsigned int getPrimaryJoint();
+
+		/**
+		 * Checks if a line is a "Click" from kinect
+		 *
+		 * @param	begin	The first character of the line
+		 * @param	end	The end of the line, not included
+		 *
+		 * @return	Boolean indicating if the line is a click
+		 */
+		static bool isClick( const char * begin, const char * end );
+
+		/**
+		 * Parses a line on the format [x],[y],[z] in place, see
+		 * aux/kinectParseBenchmark
+		 *
+		 * @param	begin	The first character of the line
+		 * @param	end	The end of the line, not included. The line must be
+		 * followed by a character which is not part of a number, like the
+		 * null character terminating lines from TcpSocket::readLine().
+		 * @param	x	Output, the x value
+		 * @param	y	Output, the y value
+		 * @param	z	Output, the z value
+		 *
+		 * @return	Boolean indicating if the line held a coordinate
+		 */
+		static bool parseCoordinate( const char * begin, const char * end, float & x, float & y, float & z );
+
 	private: 
 		std::string
 		/// The port on which to connect
@@ -113,27 +379,225 @@ class KinectReader
 		/// Pointer to the Com object (Brain)
 			* pCom;
 
-		float
-		/// Stored value of X
-			x,
-		/// Stored value of Y
-			y,
-		/// Stored value of Z
-			z,
-		/// The height of Kinects position, used to correct the z coordinate
-			height;
+		Reactor
+		/// Pointer to the Reactor handling the connection
+			* pReactor;
+
+		TcpSocket
+		/// The connection to the server, NULL if not connected or connecting
+			* pSocket;
+
+		UdpSocket
+		/// The UDP socket with the UDP transport, NULL if not created
+			* pUdp;
+
+		/// The descriptor of the connection added to the Reactor, -1 if none
+		int
+			socketDescriptor;
+
+		/// The filters and estimates of the joints
+		KinectTrack
+			tracks[ KINECTREADER_JOINTS ];
+
+		TrackerTable
+		/// The table estimates are published to, NULL if none
+			* pTrackers;
 
 		unsigned int
+		/// The camera number, part of the source ids
+			camera,
+		/// The joint followed by the stored coordinate
+			primaryJoint;
+
+		float
+		/// Minimum cutoff frequency of the filter, 0 if disabled
+			filterMinCutoff,
+		/// Beta of the filter
+			filterBeta,
+		/// Derivative cutoff frequency of the filter
+			filterDerivativeCutoff;
+
+		/// Maps Kinect coordinates to Robotino coordinates
+		RigidTransform
+			transform;
+
+		/// Protects the tracks, transform and filter parameters, and the
+		/// connect, record and prediction statistics, which are written by
+		/// the Reactor thread and printed by connectionToString()
+		std::mutex
+			sampleMutex;
+
+		/// Monotonic time the stored coordinate was recieved, in microseconds
+		long long
+			recieveTime;
+
+		/// Written by the Reactor thread and read without locking
+		std::atomic<unsigned int>
 		/// Time of last update
 			updateTime,
 		/// Time of last registered click
 			clickTime;
 
+		unsigned int
+		/// Milliseconds to wait for a connect
+			connectTimeout,
+		/// Maximum milliseconds to wait before retrying a connect
+			maxBackoff,
+		/// Milliseconds to wait before the next connect
+			backoff,
+		/// Time the current connect was started
+			connectStartTime,
+		/// The number of connects started
+			connectAttempts,
+		/// The number of connects failed
+			connectFailures,
+		/// The number of connects completed
+			connections,
+		/// Milliseconds used by the last completed connect
+			lastConnectTime,
+		/// Milliseconds used by the slowest completed connect
+			maxConnectTime,
+		/// Time the last datagram was recieved, with the UDP transport
+			datagramTime;
+
+		/// Written by the Reactor thread and read without locking
+		std::atomic<bool>
+		/// If the coordinate has been updated since it was last read
+			updated,
+		/// If connected to the server
+			connected,
+		/// If the server has switched to the binary protocol
+			binary;
+
 		bool
 		/// Stop flag for the loop
 			runLoop,
-		/// If the coordinate has been updated since it was last read
-			updated;
+		/// If the UDP transport is used
+			udp,
+		/// If a sequence number has been recieved on this connection
+			hasSequence;
+
+		uint32_t
+		/// Sequence number of the last record
+			lastSequence;
+
+		unsigned long
+		/// The number of binary records recieved
+			records,
+		/// The number of binary records dropped, from sequence gaps
+			drops,
+		/// The number of binary records discarded as older than the newest
+			stale,
+		/// The number of latencies measured
+			latencyCount;
+
+		unsigned int
+		/// Latency of the last record, in microseconds
+			lastLatency,
+		/// Largest latency measured, in microseconds
+			maxLatency;
+
+		/// Sum of the latencies measured, in microseconds
+		double
+			latencySum;
+
+		unsigned long
+		/// The number of predictions made
+			predictions,
+		/// The number of predictions over KINECTREADER_LATENCY_BUDGET
+			overBudget,
+		/// The number of predictions limited by KINECTREADER_PREDICTION_MAX
+			capped;
+
+		unsigned int
+		/// Recieve to use time of the last prediction, in microseconds
+			lastUseAge,
+		/// Capture to use time of the last prediction, in microseconds
+			lastHorizon,
+		/// Largest capture to use time, in microseconds
+			maxHorizon;
+
+		double
+		/// Sum of the recieve to use times, in microseconds
+			useAgeSum,
+		/// Sum of the capture to use times, in microseconds
+			horizonSum;
+
+		/**
+		 * Starts a non-blocking connect to the server, completed by
+		 * writable()
+		 */
+		void startConnect();
+
+		/**
+		 * Creates the UDP socket and subscribes to the stream
+		 */
+		void startUdp();
+
+		/**
+		 * Renews the UDP subscription and checks if the stream is lost,
+		 * called every KINECTREADER_UDP_HELLO_INTERVAL milliseconds
+		 */
+		void udpTimeout();
+
+		/**
+		 * Reads and handles all datagrams recieved, in batches
+		 */
+		void readDatagrams();
+
+		/**
+		 * Reports a failed connect and schedules a new one
+		 *
+		 * @param	reason	Description of the failure
+		 */
+		void connectFailed( const char * reason );
+
+		/**
+		 * Schedules a connect after the current backoff, and increases the
+		 * backoff
+		 */
+		void scheduleConnect();
+
+		/**
+		 * Removes the connection or UDP socket from the Reactor and closes
+		 * it
+		 */
+		void disconnect();
+
+		/**
+		 * Handles a recieved line, a click or a coordinate
+		 *
+		 * @param	line	The line, null terminated
+		 * @param	length	The length of the line
+		 */
+		void handleLine( const char * line, unsigned int length );
+
+		/**
+		 * Handles a binary record, a click or a coordinate, and updates the
+		 * drop and latency statistics
+		 *
+		 * @param	data	The record, KINECTREADER_RECORD_SIZE bytes
+		 */
+		void handleRecord( const char * data );
+
+		/**
+		 * Handles a coordinate sample, transforming, filtering and storing
+		 * it, and updating the velocity estimate
+		 *
+		 * @param	joint	The joint of the sample
+		 * @param	xVal	Kinect x value in millimeters
+		 * @param	yVal	Kinect y value in millimeters
+		 * @param	zVal	Kinect z value in millimeters
+		 * @param	capture	Capture time of the sample, see
+		 * TrackerTable::monotonicTime()
+		 */
+		void handleSample( unsigned int joint, float xVal, float yVal, float zVal, long long capture );
+
+		/**
+		 * Restarts the filters and velocity estimates of all joints, the
+		 * sampleMutex must be held
+		 */
+		void resetTracks();
 };
 
 #endif
@@ -0,0 +1,60 @@
+#include "OneEuroFilter.h"
+
+#ifndef _USE_MATH_DEFINES
+#define _USE_MATH_DEFINES
+#endif
+#include <math.h>
+
+
+OneEuroFilter::OneEuroFilter( float minCutoff, float beta, float derivativeCutoff )
+{
+	this->setParameters( minCutoff, beta, derivativeCutoff );
+	this->reset();
+}
+
+void
+OneEuroFilter::setParameters( float minCutoff, float beta, float derivativeCutoff )
+{
+	this->minCutoff = minCutoff;
+	this->beta = beta;
+	this->derivativeCutoff = derivativeCutoff;
+}
+
+float
+OneEuroFilter::filter( float value, float seconds )
+{
+	if ( ! this->initialized || seconds <= 0.0 )
+	{
+		// Nothing to filter against, or a repeated sample
+		if ( ! this->initialized ) this->value = value;
+		this->initialized = true;
+		return this->value;
+	}
+
+	// Filter the speed, then let it raise the cutoff of the value
+	float speed = ( value - this->value ) / seconds;
+	this->speed += this->alpha( this->derivativeCutoff, seconds ) * ( speed - this->speed );
+
+	float cutoff = this->minCutoff + ( this->beta * fabs( this->speed ) );
+	this->value += this->alpha( cutoff, seconds ) * ( value - this->value );
+
+	return this->value;
+}
+
+void
+OneEuroFilter::reset()
+{
+	this->value = 0.0;
+	this->speed = 0.0;
+	this->initialized = false;
+}
+
+
+// Private functions
+
+float
+OneEuroFilter::alpha( float cutoff, float seconds )
+{
+	float tau = 1.0 / ( 2.0 * M_PI * cutoff );
+	return 1.0 / ( 1.0 + ( tau / seconds ) );
+}
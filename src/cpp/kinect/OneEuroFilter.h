@@ -0,0 +1,96 @@
+#ifndef ONEEUROFILTER_H
+#define ONEEUROFILTER_H
+
+/// Default minimum cutoff frequency in Hz, lower gives less jitter when still
+#define ONEEUROFILTER_MIN_CUTOFF	1.0
+/// Default increase of the cutoff frequency per unit per second of speed,
+/// higher gives less lag when moving
+#define ONEEUROFILTER_BETA	20.0
+/// Default cutoff frequency in Hz of the filtered speed
+#define ONEEUROFILTER_DERIVATIVE_CUTOFF	1.0
+
+
+/**
+ * Adaptive low pass filter for noisy positions, the 1€ filter by Casiez,
+ * Roussel and Vogel.
+ *
+ * Each sample is filtered as it arrives, with a cutoff frequency following
+ * the filtered speed: a low cutoff removes jitter while the value is still,
+ * and a high cutoff keeps the lag low while it moves. The minimum cutoff and
+ * beta set the trade-off between jitter and lag.
+ *
+ * Filters one value, use one filter per axis.
+ */
+class OneEuroFilter
+{
+	public:
+		/**
+		 * Constructs the filter
+		 *
+		 * @param	minCutoff	The minimum cutoff frequency in Hz
+		 * @param	beta	The increase of the cutoff frequency per unit
+		 * per second of speed
+		 * @param	derivativeCutoff	The cutoff frequency in Hz of the
+		 * filtered speed
+		 */
+		OneEuroFilter(
+				float minCutoff = ONEEUROFILTER_MIN_CUTOFF,
+				float beta = ONEEUROFILTER_BETA,
+				float derivativeCutoff = ONEEUROFILTER_DERIVATIVE_CUTOFF );
+
+		/**
+		 * Sets the parameters, keeping the filter state
+		 *
+		 * @param	minCutoff	The minimum cutoff frequency in Hz
+		 * @param	beta	The increase of the cutoff frequency per unit
+		 * per second of speed
+		 * @param	derivativeCutoff	The cutoff frequency in Hz of the
+		 * filtered speed
+		 */
+		void setParameters( float minCutoff, float beta, float derivativeCutoff );
+
+		/**
+		 * Filters a sample
+		 *
+		 * @param	value	The sample
+		 * @param	seconds	Seconds since the previous sample, ignored for
+		 * the first sample after a reset
+		 *
+		 * @return	The filtered value
+		 */
+		float filter( float value, float seconds );
+
+		/**
+		 * Restarts the filter, the next sample is passed through unfiltered
+		 */
+		void reset();
+
+	private:
+		float
+		/// The minimum cutoff frequency in Hz
+			minCutoff,
+		/// The increase of the cutoff frequency per unit per second of speed
+			beta,
+		/// The cutoff frequency in Hz of the filtered speed
+			derivativeCutoff,
+		/// The last filtered value
+			value,
+		/// The last filtered speed, in units per second
+			speed;
+
+		/// If a sample has been filtered since the last reset
+		bool
+			initialized;
+
+		/**
+		 * Calculates the smoothing factor of a low pass filter
+		 *
+		 * @param	cutoff	The cutoff frequency in Hz
+		 * @param	seconds	The sample interval in seconds
+		 *
+		 * @return	The weight of the new sample, (0,1]
+		 */
+		float alpha( float cutoff, float seconds );
+};
+
+#endif
@@ -0,0 +1,221 @@
+#include "TrackerTable.h"
+
+#include <math.h>
+#include <time.h>		// for clock_gettime()
+#include <iostream>
+#include <atomic>
+
+
+TrackerTable::TrackerTable()
+{
+	for ( unsigned int i = 0; i < TRACKERTABLE_SIZE; i++ )
+	{
+		this->slots[ i ].source.store( TRACKERTABLE_EMPTY );
+		this->slots[ i ].sequence.store( 0 );
+		for ( unsigned int j = 0; j < 6; j++ )
+			this->slots[ i ].values[ j ].store( 0.0 );
+		this->slots[ i ].captureTime.store( 0 );
+	}
+}
+
+bool
+TrackerTable::publish( const TrackedSample & sample )
+{
+	Slot * slot = this->find( sample.source, true );
+	if ( slot == NULL ) return false;
+
+	// Make the sequence odd while writing, readers retry meanwhile
+	unsigned int sequence = slot->sequence.load( std::memory_order_relaxed );
+	slot->sequence.store( sequence + 1, std::memory_order_relaxed );
+	std::atomic_thread_fence( std::memory_order_release );
+
+	slot->values[ 0 ].store( sample.x, std::memory_order_relaxed );
+	slot->values[ 1 ].store( sample.y, std::memory_order_relaxed );
+	slot->values[ 2 ].store( sample.z, std::memory_order_relaxed );
+	slot->values[ 3 ].store( sample.xVelocity, std::memory_order_relaxed );
+	slot->values[ 4 ].store( sample.yVelocity, std::memory_order_relaxed );
+	slot->values[ 5 ].store( sample.zVelocity, std::memory_order_relaxed );
+	slot->captureTime.store( sample.captureTime, std::memory_order_relaxed );
+
+	slot->sequence.store( sequence + 2, std::memory_order_release );
+	return true;
+}
+
+bool
+TrackerTable::latest( unsigned int source, TrackedSample & sample )
+{
+	Slot * slot = this->find( source, false );
+	return ( slot != NULL && this->read( slot, sample ) );
+}
+
+unsigned int
+TrackerTable::sources( unsigned int * sources, unsigned int max )
+{
+	unsigned int count = 0;
+	for ( unsigned int i = 0; i < TRACKERTABLE_SIZE && count < max; i++ )
+	{
+		unsigned int source = this->slots[ i ].source.load( std::memory_order_acquire );
+		if ( source == TRACKERTABLE_EMPTY ) break;
+		if ( this->slots[ i ].sequence.load( std::memory_order_acquire ) == 0 ) continue;
+		sources[ count++ ] = source;
+	}
+
+	return count;
+}
+
+unsigned int
+TrackerTable::fuse( unsigned int joint, TrackedSample & sample, unsigned int maxAge )
+{
+	TrackedSample samples[ TRACKERTABLE_SIZE ];
+	float ages[ TRACKERTABLE_SIZE ];
+	unsigned int count = 0;
+	int freshest = -1;
+
+	long long now = TrackerTable::monotonicTime();
+
+	// Collect the fresh samples of the joint, projected to now
+	for ( unsigned int i = 0; i < TRACKERTABLE_SIZE; i++ )
+	{
+		unsigned int source = this->slots[ i ].source.load( std::memory_order_acquire );
+		if ( source == TRACKERTABLE_EMPTY ) break;
+		if ( TRACKERTABLE_JOINT( source ) != joint ) continue;
+
+		TrackedSample & s = samples[ count ];
+		if ( ! this->read( & this->slots[ i ], s ) ) continue;
+
+		long long age = now - s.captureTime;
+		if ( age < 0 ) age = 0;
+		if ( age > maxAge * 1000LL ) continue;
+
+		float seconds = age / 1000000.0;
+		s.x += s.xVelocity * seconds;
+		s.y += s.yVelocity * seconds;
+		s.z += s.zVelocity * seconds;
+		ages[ count ] = age / 1000.0;
+
+		if ( freshest < 0 || ages[ count ] < ages[ freshest ] ) freshest = count;
+		count++;
+	}
+
+	if ( count == 0 ) return 0;
+
+	// Merge the samples close to the freshest, weighted by age
+	TrackedSample & f = samples[ freshest ];
+	float weights = 0.0;
+	unsigned int merged = 0;
+
+	sample.source = joint;
+	sample.x = sample.y = sample.z = 0.0;
+	sample.xVelocity = sample.yVelocity = sample.zVelocity = 0.0;
+	sample.captureTime = now;
+
+	for ( unsigned int i = 0; i < count; i++ )
+	{
+		TrackedSample & s = samples[ i ];
+		float dx = s.x - f.x,
+			dy = s.y - f.y,
+			dz = s.z - f.z;
+		if ( sqrt( ( dx * dx ) + ( dy * dy ) + ( dz * dz ) ) > TRACKERTABLE_FUSION_DISTANCE ) continue;
+
+		float weight = 1.0 / ( ages[ i ] + TRACKERTABLE_FUSION_AGE_OFFSET );
+		sample.x += weight * s.x;
+		sample.y += weight * s.y;
+		sample.z += weight * s.z;
+		sample.xVelocity += weight * s.xVelocity;
+		sample.yVelocity += weight * s.yVelocity;
+		sample.zVelocity += weight * s.zVelocity;
+		weights += weight;
+		merged++;
+	}
+
+	sample.x /= weights;
+	sample.y /= weights;
+	sample.z /= weights;
+	sample.xVelocity /= weights;
+	sample.yVelocity /= weights;
+	sample.zVelocity /= weights;
+
+	return merged;
+}
+
+void
+TrackerTable::tableToString( std::ostream & out )
+{
+	long long now = TrackerTable::monotonicTime();
+
+	out << "TrackerTable:" << std::endl;
+	for ( unsigned int i = 0; i < TRACKERTABLE_SIZE; i++ )
+	{
+		TrackedSample s;
+		unsigned int source = this->slots[ i ].source.load( std::memory_order_acquire );
+		if ( source == TRACKERTABLE_EMPTY ) break;
+		if ( ! this->read( & this->slots[ i ], s ) ) continue;
+
+		out
+			<< "  camera " << TRACKERTABLE_CAMERA( source )
+			<< " joint " << TRACKERTABLE_JOINT( source )
+			<< ": " << s.x << "," << s.y << "," << s.z
+			<< "  velocity " << s.xVelocity << "," << s.yVelocity << "," << s.zVelocity
+			<< "  age " << ( now - s.captureTime ) / 1000 << " msecs"
+			<< "  samples " << this->slots[ i ].sequence.load( std::memory_order_relaxed ) / 2
+			<< std::endl;
+	}
+}
+
+long long
+TrackerTable::monotonicTime()
+{
+	struct timespec now;
+	clock_gettime( CLOCK_MONOTONIC, & now );
+	return ( (long long) now.tv_sec * 1000000 ) + ( now.tv_nsec / 1000 );
+}
+
+
+// Private functions
+
+TrackerTable::Slot *
+TrackerTable::find( unsigned int source, bool create )
+{
+	for ( unsigned int i = 0; i < TRACKERTABLE_SIZE; i++ )
+	{
+		unsigned int current = this->slots[ i ].source.load( std::memory_order_acquire );
+		if ( current == source ) return & this->slots[ i ];
+		if ( current != TRACKERTABLE_EMPTY ) continue;
+		if ( ! create ) return NULL;
+
+		// Take the first free slot, or find the source if another writer
+		// took it first
+		if ( this->slots[ i ].source.compare_exchange_strong( current, source )
+				|| current == source )
+			return & this->slots[ i ];
+	}
+
+	return NULL;
+}
+
+bool
+TrackerTable::read( Slot * slot, TrackedSample & sample )
+{
+	unsigned int before, after;
+
+	do
+	{
+		before = slot->sequence.load( std::memory_order_acquire );
+		if ( before == 0 ) return false;
+
+		sample.x = slot->values[ 0 ].load( std::memory_order_relaxed );
+		sample.y = slot->values[ 1 ].load( std::memory_order_relaxed );
+		sample.z = slot->values[ 2 ].load( std::memory_order_relaxed );
+		sample.xVelocity = slot->values[ 3 ].load( std::memory_order_relaxed );
+		sample.yVelocity = slot->values[ 4 ].load( std::memory_order_relaxed );
+		sample.zVelocity = slot->values[ 5 ].load( std::memory_order_relaxed );
+		sample.captureTime = slot->captureTime.load( std::memory_order_relaxed );
+
+		std::atomic_thread_fence( std::memory_order_acquire );
+		after = slot->sequence.load( std::memory_order_relaxed );
+	}
+	while ( ( before & 1 ) || before != after );
+
+	sample.source = slot->source.load( std::memory_order_relaxed );
+	return true;
+}
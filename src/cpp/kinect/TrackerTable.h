@@ -0,0 +1,171 @@
+#ifndef TRACKERTABLE_H
+#define TRACKERTABLE_H
+
+#include <atomic>
+#include <ostream>
+
+/// The maximum number of sources in the table
+#define TRACKERTABLE_SIZE	64
+/// Source id of an unused slot
+#define TRACKERTABLE_EMPTY	0xFFFFFFFF
+/// The source id of a joint tracked by a camera
+#define TRACKERTABLE_SOURCE( camera, joint )	( ( ( camera ) << 8 ) | ( ( joint ) & 0xFF ) )
+/// The camera of a source id
+#define TRACKERTABLE_CAMERA( source )	( ( source ) >> 8 )
+/// The joint of a source id
+#define TRACKERTABLE_JOINT( source )	( ( source ) & 0xFF )
+
+
+	// Fusion
+
+/// Default milliseconds after which a sample is left out of the fusion
+#define TRACKERTABLE_FUSION_MAX_AGE	200
+/// Meters from the freshest sample within which samples of other cameras
+/// are taken to be the same joint and merged
+#define TRACKERTABLE_FUSION_DISTANCE	0.3
+/// Milliseconds added to the age of each sample when weighting, limits the
+/// weight of the freshest sample
+#define TRACKERTABLE_FUSION_AGE_OFFSET	10
+
+
+/**
+ * The latest sample of a tracked source, in Robotino coordinates
+ */
+struct TrackedSample
+{
+	/// The source, see TRACKERTABLE_SOURCE
+	unsigned int source;
+	/// Position in meters
+	float x, y, z;
+	/// Velocity in meters per second
+	float xVelocity, yVelocity, zVelocity;
+	/// Capture time, see TrackerTable::monotonicTime()
+	long long captureTime;
+};
+
+/**
+ * Table of the latest sample of each tracked source, like a joint tracked by
+ * one of several cameras.
+ *
+ * Sources are identified by the camera and the joint, see
+ * TRACKERTABLE_SOURCE. Each source has a slot, taken on its first sample,
+ * written by one thread (the Reactor) and read by any number of threads
+ * without locks: a sequence number is made odd while a slot is written, and
+ * readers retry until they read the same even number before and after
+ * copying the sample. Writers never wait for readers.
+ *
+ * fuse() merges the samples of a joint seen by overlapping cameras.
+ */
+class TrackerTable
+{
+	public:
+		/**
+		 * Constructs an empty table
+		 */
+		TrackerTable();
+
+		/**
+		 * Stores the latest sample of a source. The samples of one source
+		 * must be published by one thread at a time.
+		 *
+		 * @param	sample	The sample
+		 *
+		 * @return	@c false if the table is full
+		 */
+		bool publish( const TrackedSample & sample );
+
+		/**
+		 * Gets the latest sample of a source
+		 *
+		 * @param	source	The source
+		 * @param	sample	Output, the sample
+		 *
+		 * @return	@c false if the source has no sample
+		 */
+		bool latest( unsigned int source, TrackedSample & sample );
+
+		/**
+		 * Lists the sources with samples
+		 *
+		 * @param	sources	Output, the source ids
+		 * @param	max	The size of sources
+		 *
+		 * @return	The number of sources listed
+		 */
+		unsigned int sources( unsigned int * sources, unsigned int max );
+
+		/**
+		 * Merges the samples of a joint from all cameras into an estimate
+		 * of its position now.
+		 *
+		 * Each sample is projected to now by its velocity. The freshest
+		 * sample is merged with the samples within
+		 * TRACKERTABLE_FUSION_DISTANCE of it, weighted by their age, while
+		 * samples further away are taken to be another person.
+		 *
+		 * @param	joint	The joint
+		 * @param	sample	Output, the merged sample, with the joint as the
+		 * source and the current time as the capture time
+		 * @param	maxAge	Milliseconds after which samples are left out
+		 *
+		 * @return	The number of samples merged, 0 if none are fresh
+		 */
+		unsigned int fuse( unsigned int joint, TrackedSample & sample, unsigned int maxAge = TRACKERTABLE_FUSION_MAX_AGE );
+
+		/**
+		 * Prints the latest sample and update count of each source
+		 *
+		 * @param	out	The stream to print to
+		 */
+		void tableToString( std::ostream & out );
+
+		/**
+		 * Gets the current time of the clock used for capture times
+		 *
+		 * @return	Monotonic time in microseconds
+		 */
+		static long long monotonicTime();
+
+	private:
+		/**
+		 * A source and its latest sample, read and written without locks
+		 */
+		struct Slot
+		{
+			/// The source, TRACKERTABLE_EMPTY if unused
+			std::atomic<unsigned int> source;
+			/// Twice the number of samples written, odd while a sample is
+			/// written
+			std::atomic<unsigned int> sequence;
+			/// Position and velocity, as in TrackedSample
+			std::atomic<float> values[ 6 ];
+			/// Capture time
+			std::atomic<long long> captureTime;
+		};
+
+		/// The slots, taken in order from the start and never released
+		Slot
+			slots[ TRACKERTABLE_SIZE ];
+
+		/**
+		 * Finds the slot of a source
+		 *
+		 * @param	source	The source
+		 * @param	create	If a slot is taken for a new source
+		 *
+		 * @return	The slot, NULL if not found or the table is full
+		 */
+		Slot * find( unsigned int source, bool create );
+
+		/**
+		 * Reads the sample of a slot
+		 *
+		 * @param	slot	The slot
+		 * @param	sample	Output, the sample
+		 *
+		 * @return	@c false if the slot has no sample yet
+		 */
+		bool read( Slot * slot, TrackedSample & sample );
+};
+
+#endif
@@ -15,6 +15,9 @@
 #define	KINECT_PORT "5000"
 #define KINECT_HEIGHT_METERS 0.68
 
+#define TELEMETRY_PORT "5100"
+#define COMMAND_PORT "5200"
+
 using namespace std;
 
 
@@ -47,6 +50,12 @@ int main( int argc, char *argv[] )
 	
 	// Enable and connect to Kinect Server
 	//brain.enableKinect( KINECT_IP, KINECT_PORT, KINECT_HEIGHT_METERS );
+
+	// Stream telemetry to monitoring clients
+	brain.enableTelemetry( TELEMETRY_PORT );
+
+	// Take commands from scripts and remote clients, executed by Control
+	brain.enableCommands( COMMAND_PORT );
 	
 	// start brain function (loop)
 	brain.start();
@@ -54,7 +63,7 @@ int main( int argc, char *argv[] )
 	cerr << "Current position: " << brain.odom()->getPosition() << endl;
 	
 
-	// Start control program and prompt for user input
+	// Start control program, serving network commands, and prompt for user input
 	Control c( & brain );
 	c.prompt();
 
@@ -0,0 +1,49 @@
+#include "headers/Behaviour.h"
+#include "headers/Brain.h"
+
+
+Behaviour::Behaviour( Brain * pBrain, const char * name, unsigned int resources )
+{
+	this->pBrain = pBrain;
+	this->behaviourName = name;
+	this->usedResources = resources;
+	this->currentState = 0;
+	this->stateStartTime = pBrain->msecsElapsed();
+}
+
+Brain *
+Behaviour::brain()
+{
+	return this->pBrain;
+}
+
+const char *
+Behaviour::name()
+{
+	return this->behaviourName;
+}
+
+unsigned int
+Behaviour::resources()
+{
+	return this->usedResources;
+}
+
+unsigned int
+Behaviour::state()
+{
+	return this->currentState;
+}
+
+void
+Behaviour::setState( unsigned int state )
+{
+	this->currentState = state;
+	this->stateStartTime = this->pBrain->msecsElapsed();
+}
+
+unsigned int
+Behaviour::stateMsecs()
+{
+	return this->pBrain->msecsElapsed() - this->stateStartTime;
+}
@@ -0,0 +1,181 @@
+#include "headers/BellowsController.h"
+
+#include <math.h>
+#include <iostream>
+#include <iomanip>
+
+
+BellowsController::BellowsController( float maxRate )
+{
+	this->maxRate = maxRate;
+	this->hasPrevious = false;
+	this->previousTime = 0;
+
+	for ( unsigned int i = 0; i < BELLOWSCONTROLLER_CHANNELS; i++ )
+	{
+		this->target[ i ] = 0.0;
+		this->reference[ i ] = 0.0;
+		this->integral[ i ] = 0.0;
+		this->previous[ i ] = 0.0;
+		this->outputs[ i ] = 0.0;
+
+		this->settling[ i ] = false;
+		this->withinTolerance[ i ] = false;
+		this->settleStart[ i ] = 0;
+		this->toleranceEntered[ i ] = 0;
+		this->lastSettleTime[ i ] = 0;
+		this->maxSettleTime[ i ] = 0;
+		this->settleCount[ i ] = 0;
+		this->settleTimeSum[ i ] = 0.0;
+	}
+}
+
+void
+BellowsController::setTarget( unsigned int channel, float pressure, unsigned int time )
+{
+	if ( channel >= BELLOWSCONTROLLER_CHANNELS ) return;
+
+	if ( fabs( pressure - this->target[ channel ] ) >= BELLOWSCONTROLLER_SETTLE_MIN_STEP )
+	{
+		this->settling[ channel ] = true;
+		this->withinTolerance[ channel ] = false;
+		this->settleStart[ channel ] = time;
+	}
+
+	this->target[ channel ] = pressure;
+}
+
+void
+BellowsController::setMaxRate( float maxRate )
+{
+	this->maxRate = maxRate;
+}
+
+void
+BellowsController::update( const float * measured, unsigned int time )
+{
+	if ( ! this->hasPrevious )
+	{
+		// Start from the current state, without any correction
+		for ( unsigned int i = 0; i < BELLOWSCONTROLLER_CHANNELS; i++ )
+		{
+			this->reference[ i ] = measured[ i ];
+			this->previous[ i ] = measured[ i ];
+			this->outputs[ i ] = measured[ i ];
+		}
+		this->previousTime = time;
+		this->hasPrevious = true;
+		return;
+	}
+
+	unsigned int step = time - this->previousTime;
+	if ( step > BELLOWSCONTROLLER_MAX_STEP ) step = BELLOWSCONTROLLER_MAX_STEP;
+	float dt = step / 1000.0f;
+	float maxChange = this->maxRate * dt;
+
+	for ( unsigned int i = 0; i < BELLOWSCONTROLLER_CHANNELS; i++ )
+	{
+		// Move the reference toward the target at the limited rate
+		float change = this->target[ i ] - this->reference[ i ];
+		if ( change > maxChange ) change = maxChange;
+		if ( change < -maxChange ) change = -maxChange;
+		this->reference[ i ] += change;
+
+		float
+			error = this->reference[ i ] - measured[ i ],
+			derivative = ( step > 0 ) ? ( this->previous[ i ] - measured[ i ] ) / dt : 0.0f,
+			integral = this->integral[ i ] + ( BELLOWSCONTROLLER_KI * error * dt );
+
+		if ( integral > BELLOWSCONTROLLER_MAX_INTEGRAL ) integral = BELLOWSCONTROLLER_MAX_INTEGRAL;
+		if ( integral < -BELLOWSCONTROLLER_MAX_INTEGRAL ) integral = -BELLOWSCONTROLLER_MAX_INTEGRAL;
+
+		float output =
+			( BELLOWSCONTROLLER_KFF * this->reference[ i ] )
+			+ ( BELLOWSCONTROLLER_KP * error )
+			+ integral
+			+ ( BELLOWSCONTROLLER_KD * derivative );
+
+		// Only keep the new integral if the output is not saturated
+		if ( output > BELLOWSCONTROLLER_MAX_OUTPUT )
+			output = BELLOWSCONTROLLER_MAX_OUTPUT;
+		else if ( output < BELLOWSCONTROLLER_MIN_OUTPUT )
+			output = BELLOWSCONTROLLER_MIN_OUTPUT;
+		else
+			this->integral[ i ] = integral;
+
+		this->outputs[ i ] = output;
+		this->previous[ i ] = measured[ i ];
+
+		this->measureSettling( i, measured[ i ], time );
+	}
+
+	this->previousTime = time;
+}
+
+float
+BellowsController::output( unsigned int channel ) const
+{
+	if ( channel >= BELLOWSCONTROLLER_CHANNELS ) return 0.0;
+	return this->outputs[ channel ];
+}
+
+bool
+BellowsController::settled() const
+{
+	for ( unsigned int i = 0; i < BELLOWSCONTROLLER_CHANNELS; i++ )
+		if ( this->settling[ i ] ) return false;
+
+	return true;
+}
+
+void
+BellowsController::metricsToString( std::ostream & out ) const
+{
+	out << "BellowsController: Settling times (msecs)" << std::endl;
+	for ( unsigned int i = 0; i < BELLOWSCONTROLLER_CHANNELS; i++ )
+	{
+		out
+			<< "  [" << i << "]"
+			<< "  count = " << std::setw( 4 ) << this->settleCount[ i ]
+			<< "  last = " << std::setw( 5 ) << this->lastSettleTime[ i ]
+			<< "  average = " << std::setw( 5 )
+			<< ( ( this->settleCount[ i ] > 0 )
+					? (unsigned int) ( this->settleTimeSum[ i ] / this->settleCount[ i ] )
+					: 0 )
+			<< "  max = " << std::setw( 5 ) << this->maxSettleTime[ i ]
+			<< ( this->settling[ i ] ? "  (settling)" : "" )
+			<< std::endl;
+	}
+}
+
+
+// Private functions
+
+void
+BellowsController::measureSettling( unsigned int channel, float measured, unsigned int time )
+{
+	if ( ! this->settling[ channel ] ) return;
+
+	if ( fabs( measured - this->target[ channel ] ) > BELLOWSCONTROLLER_SETTLE_TOLERANCE )
+	{
+		this->withinTolerance[ channel ] = false;
+		return;
+	}
+
+	if ( ! this->withinTolerance[ channel ] )
+	{
+		this->withinTolerance[ channel ] = true;
+		this->toleranceEntered[ channel ] = time;
+	}
+
+	if ( time - this->toleranceEntered[ channel ] < BELLOWSCONTROLLER_SETTLE_HOLD ) return;
+
+	// Settled, the settling time is counted until the tolerance was entered
+	unsigned int settleTime = this->toleranceEntered[ channel ] - this->settleStart[ channel ];
+
+	this->lastSettleTime[ channel ] = settleTime;
+	if ( settleTime > this->maxSettleTime[ channel ] ) this->maxSettleTime[ channel ] = settleTime;
+	this->settleTimeSum[ channel ] += settleTime;
+	this->settleCount[ channel ]++;
+	this->settling[ channel ] = false;
+}
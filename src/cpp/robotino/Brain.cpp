@@ -6,10 +6,16 @@
 #include "headers/_Odometry.h"
 #include "headers/_DistanceSensors.h"
 #include "headers/_LaserRangeFinder.h"
+#include "headers/ObstacleIndex.h"
+#include "headers/Behaviour.h"
 
 #include "../geometry/All.h"
 
 #include "../kinect/KinectReader.h"
+#include "../kinect/TrackerTable.h"
+#include "../tcp/Reactor.h"
+#include "../tcp/TelemetryServer.h"
+#include "../tcp/CommandServer.h"
 
 #include <rec/robotino/api2/Com.h>
 
@@ -17,7 +23,10 @@
 #include <iostream>
 #include <string.h>
 #include <unistd.h> // Needed by usleep()
+#include <stdio.h>	// Needed by snprintf()
 #include <thread>
+#include <memory>
+#include <stdexcept>
 
 
 Brain::Brain( std::string name, std::string robotinoIP )
@@ -32,9 +41,18 @@ Brain::Brain( std::string name, std::string robotinoIP )
 	this->initializationDone = false;
 	this->runMainLoop = false;
 	this->runComEventsLoop = false;
+	this->pTrackers = new TrackerTable();
+	this->pTelemetry = NULL;
+	this->pCommands = NULL;
+	this->nextBehaviourId = 1;
+	this->telemetryCycle = 0;
 
 	// Start ComEvents reader thread
 	this->tComEvents = std::thread( & Brain::processComEventsLoop, this );
+
+	// Start the Reactor thread, handling connections to external sources
+	this->pReactor = new Reactor();
+	this->tReactor = std::thread( & Reactor::run, this->pReactor );
 }
 
 Brain::~Brain()
@@ -43,13 +61,26 @@ Brain::~Brain()
 
 	this->stop();
 
-	if ( this->kinectRunning && this->tKinectReader.joinable() )
+	for ( std::map<unsigned int, Behaviour *>::iterator it = this->behaviours.begin(); it != this->behaviours.end(); ++it )
+		delete it->second;
+	this->behaviours.clear();
+
+	std::cerr << "Stopping Reactor" << std::endl;
+	this->pReactor->stop();
+	this->tReactor.join();
+
+	for ( unsigned int i = 0; i < this->kinectReaders.size(); i++ )
 	{
-		std::cerr << "Stopping Kinect reader" << std::endl;
-		this->pKinect->stopLoop();
-		this->tKinectReader.join();
-		std::cerr << "Kinect reader exited" << std::endl;
+		std::cerr << "Stopping Kinect reader " << i << std::endl;
+		this->kinectReaders[ i ]->stopLoop();
+		delete this->kinectReaders[ i ];
 	}
+	this->kinectReaders.clear();
+	delete this->pTrackers;
+	delete this->pTelemetry;
+	delete this->pCommands;
+
+	delete this->pReactor;
 
 	std::cerr << "Disconnecting" << std::endl;
 	this->disconnectFromServer();
@@ -91,10 +122,52 @@ Brain::hasLRF()
 	return this->hasLaserRangeFinder;
 }
 
+ObstacleIndex *
+Brain::obstacles()
+{
+	return this->pObstacles;
+}
+
 KinectReader *
 Brain::kinect()
 {
-	return this->pKinect;
+	return this->kinect( 0 );
+}
+
+KinectReader *
+Brain::kinect( unsigned int camera )
+{
+	return ( camera < this->kinectReaders.size() ) ? this->kinectReaders[ camera ] : NULL;
+}
+
+unsigned int
+Brain::kinects()
+{
+	return this->kinectReaders.size();
+}
+
+TrackerTable *
+Brain::trackers()
+{
+	return this->pTrackers;
+}
+
+Reactor *
+Brain::reactor()
+{
+	return this->pReactor;
+}
+
+TelemetryServer *
+Brain::telemetry()
+{
+	return this->pTelemetry;
+}
+
+CommandServer *
+Brain::commands()
+{
+	return this->pCommands;
 }
 
 int
@@ -125,6 +198,9 @@ Brain::initialize()
 
 	// Inspect robotino configuration
 	
+	std::cerr << "- ObstacleIndex" << std::endl;
+	this->pObstacles = new ObstacleIndex();
+
 	std::cerr << "- Bumper" << std::endl;
 	this->pBumper = new _Bumper( this );
 
@@ -162,41 +238,83 @@ Brain::initialize()
 }
 
 void
-Brain::enableKinect( std::string server, std::string port, float height )
+Brain::enableKinect( std::string server, std::string port, float height, bool udp )
 {
-	if ( this->kinectRunning )
-	{
-		std::cerr << "Brain: Kinect is already up and running" << std::endl;
-		return;
-	}
+	unsigned int camera = this->kinectReaders.size();
 
-	std::cerr << "Connecting to kinect at " << server << ":" << port << std::endl;
-	this->pKinect = new KinectReader( server, port, this );
-	this->pKinect->setHeight( height );
+	std::cerr
+		<< "Connecting to kinect " << camera << " at " << server << ":" << port
+		<< ( udp ? " (udp)" : "" ) << std::endl;
+	KinectReader * reader = new KinectReader( server, port, this, udp );
+	reader->setHeight( height );
+	reader->setTrackerTable( this->pTrackers, camera );
+	this->kinectReaders.push_back( reader );
 
-	this->tKinectReader = std::thread( & Brain::kinectReader, this );
+	reader->start( this->pReactor );
 	
 	sleep( 1 );
 
-	if ( this->kinectRunning )
+	if ( reader->isRunning() )
+		std::cerr << "Kinect reader started" << std::endl;
+	else
+		std::cerr << "Could not connect to Kinect, retrying in the background" << std::endl;
+}
+
+bool
+Brain::kinectIsAvailable()
+{
+	for ( unsigned int i = 0; i < this->kinectReaders.size(); i++ )
+		if ( this->kinectReaders[ i ]->isRunning() ) return true;
+
+	return false;
+}
+
+bool
+Brain::enableTelemetry( std::string port )
+{
+	if ( this->pTelemetry != NULL )
 	{
-		std::cerr << "Kinect reader thread started" << std::endl;
+		std::cerr << "Telemetry is already enabled" << std::endl;
+		return false;
 	}
-	else
+
+	try
 	{
-		std::cerr << "Could not connect to Kinect" << std::endl;
-		this->tKinectReader.join();
-		this->pKinect = NULL;
+		this->pTelemetry = new TelemetryServer( port, this->pReactor );
 	}
+	catch ( std::runtime_error * e )
+	{
+		std::cerr << "Could not start telemetry on port " << port << ": " << e->what() << std::endl;
+		delete e;
+		return false;
+	}
+
+	std::cerr << "Telemetry on port " << port << std::endl;
+	return true;
 }
 
 bool
-Brain::kinectIsAvailable()
+Brain::enableCommands( std::string port )
 {
-	if ( this->kinectRunning )
-		return this->pKinect->isRunning();
-	else
+	if ( this->pCommands != NULL )
+	{
+		std::cerr << "Commands are already enabled" << std::endl;
 		return false;
+	}
+
+	try
+	{
+		this->pCommands = new CommandServer( port, this->pReactor );
+	}
+	catch ( std::runtime_error * e )
+	{
+		std::cerr << "Could not take commands on port " << port << ": " << e->what() << std::endl;
+		delete e;
+		return false;
+	}
+
+	std::cerr << "Commands on port " << port << std::endl;
+	return true;
 }
 
 void
@@ -236,6 +354,102 @@ Brain::isRunning()
 	return this->runMainLoop;
 }
 
+unsigned int
+Brain::startBehaviour( Behaviour * pBehaviour )
+{
+	std::lock_guard<std::mutex> lock( this->behaviourMutex );
+
+	std::map<unsigned int, Behaviour *>::iterator it = this->behaviours.begin();
+	while ( it != this->behaviours.end() )
+	{
+		if ( it->second->resources() & pBehaviour->resources() )
+		{
+			std::cerr << "Brain: Behaviour " << it->second->name() << " cancelled by " << pBehaviour->name() << std::endl;
+			it->second->cancel();
+			delete it->second;
+			this->behaviours.erase( it++ );
+		}
+		else
+			++it;
+	}
+
+	// A trajectory being played would overwrite the target pressures set by
+	// the behaviour
+	if ( ( pBehaviour->resources() & BEHAVIOUR_ARM ) && this->initializationDone )
+		this->pCbha->stopPlayback();
+
+	if ( this->behaviours.size() >= BRAIN_MAX_BEHAVIOURS )
+	{
+		std::cerr << "Brain: Too many behaviours, " << pBehaviour->name() << " not started" << std::endl;
+		delete pBehaviour;
+		return 0;
+	}
+
+	unsigned int id = this->nextBehaviourId++;
+	this->behaviours[ id ] = pBehaviour;
+	return id;
+}
+
+bool
+Brain::cancelBehaviour( unsigned int id )
+{
+	std::lock_guard<std::mutex> lock( this->behaviourMutex );
+
+	std::map<unsigned int, Behaviour *>::iterator it = this->behaviours.find( id );
+	if ( it == this->behaviours.end() ) return false;
+
+	it->second->cancel();
+	delete it->second;
+	this->behaviours.erase( it );
+	return true;
+}
+
+unsigned int
+Brain::cancelBehaviours( unsigned int resources )
+{
+	std::lock_guard<std::mutex> lock( this->behaviourMutex );
+
+	unsigned int cancelled = 0;
+	std::map<unsigned int, Behaviour *>::iterator it = this->behaviours.begin();
+	while ( it != this->behaviours.end() )
+	{
+		if ( it->second->resources() & resources )
+		{
+			it->second->cancel();
+			delete it->second;
+			this->behaviours.erase( it++ );
+			cancelled++;
+		}
+		else
+			++it;
+	}
+
+	if ( ( resources & BEHAVIOUR_ARM ) && this->initializationDone )
+		this->pCbha->stopPlayback();
+
+	return cancelled;
+}
+
+bool
+Brain::behaviourIsRunning( unsigned int id )
+{
+	std::lock_guard<std::mutex> lock( this->behaviourMutex );
+	return ( this->behaviours.find( id ) != this->behaviours.end() );
+}
+
+void
+Brain::behavioursToString( std::ostream & out )
+{
+	std::lock_guard<std::mutex> lock( this->behaviourMutex );
+
+	out << "Behaviours: " << this->behaviours.size() << " running" << std::endl;
+	for ( std::map<unsigned int, Behaviour *>::iterator it = this->behaviours.begin(); it != this->behaviours.end(); ++it )
+		out
+			<< "  " << it->first << " " << it->second->name()
+			<< ": state " << it->second->state()
+			<< ", resources " << it->second->resources() << std::endl;
+}
+
 
 // - Private functions -
 
@@ -254,42 +468,6 @@ Brain::processComEventsLoop()
 	std::cerr << "ComEvents reader thread exited" << std::endl;
 }
 
-void
-Brain::kinectReader()
-{
-	this->kinectRunning = true;
-	unsigned int tries = 0;
-	while ( this->kinectRunning )
-	{
-		switch ( this->pKinect->readPosition() )
-		{
-			case KINECTREADER_NORMAL_EXIT :
-				this->kinectRunning = false;
-				std::cerr << "Kinect disconnected" << std::endl;
-				return;
-				break;
-
-			case KINECTREADER_COULD_NOT_CONNECT :
-				this->kinectRunning = false;
-				std::cerr << "Could not connect to Kinect" << std::endl;
-				if ( tries++ < BRAIN_EXTERNAL_CONNECTION_RETRIES ) continue;
-				return;
-				break;
-
-			case KINECTREADER_LOST_CONNECTION :
-				std::cerr << "Lost kinect, reconnecting" << std::endl;
-				tries = 0;
-				break;
-
-			default:
-				this->kinectRunning = false;
-				std::cerr << "Kinect: unknown error" << std::endl;
-				return;
-				break;
-		}
-	}
-}
-
 void
 Brain::mainLoop()
 {
@@ -325,13 +503,19 @@ Brain::mainLoop()
 		
 		// Call analyzers for all Robotino sensors
 		this->pOdom->analyze();
-//		this->pDistSensors->analyze();	// Not yet implemented
+		this->pDistSensors->analyze();
+		if ( this->hasLaserRangeFinder ) this->pLRF->analyze();
 		this->pCbha->analyze();
 
+		// Let behaviours act on the analysis before it is applied
+		this->stepBehaviours();
+
 		// Call appliers for all Robotino actuators
 		this->pDrive->apply();
 		this->pCbha->apply();
 
+		this->publishTelemetry();
+
 		// Wait until a minimum of time has passed before looping
 		// (to avoid commands queuing up in Robotino)
 		loopContinueTime = loopStartTime + BRAIN_LOOP_TIME;
@@ -344,7 +528,17 @@ Brain::mainLoop()
 		}
 		else
 		{
-			usleep( ( loopContinueTime - this->msecsElapsed() ) * 1000 );
+			// Keep processing events while waiting
+			unsigned int now = this->msecsElapsed();
+			while ( now < loopContinueTime )
+			{
+				unsigned int wait = loopContinueTime - now;
+				if ( wait > BRAIN_EVENT_INTERVAL ) wait = BRAIN_EVENT_INTERVAL;
+				usleep( wait * 1000 );
+
+				this->processEvents();
+				now = this->msecsElapsed();
+			}
 		}
 
 		loopStartTime = this->msecsElapsed();
@@ -353,6 +547,80 @@ Brain::mainLoop()
 	std::cerr << "Brain main loop ended" << std::endl;
 }
 
+void
+Brain::stepBehaviours()
+{
+	std::lock_guard<std::mutex> lock( this->behaviourMutex );
+
+	std::map<unsigned int, Behaviour *>::iterator it = this->behaviours.begin();
+	while ( it != this->behaviours.end() )
+	{
+		if ( it->second->step() )
+		{
+			++it;
+			continue;
+		}
+
+		delete it->second;
+		this->behaviours.erase( it++ );
+	}
+}
+
+void
+Brain::publishTelemetry()
+{
+	if ( this->pTelemetry == NULL || this->pTelemetry->clients() == 0 ) return;
+
+	std::shared_ptr<std::string> frame = std::make_shared<std::string>();
+	frame->reserve( BRAIN_TELEMETRY_FRAME_SIZE );
+	char field[ 64 ];
+
+	AngularCoordinate pose = this->pOdom->getPosition();
+	float xSpeed, ySpeed, omega;
+	this->pDrive->velocity( & xSpeed, & ySpeed, & omega );
+
+	snprintf( field, sizeof( field ), "%u %u pose %.4f %.4f %.4f drive %.3f %.3f %.3f",
+			this->telemetryCycle++, this->msecsElapsed(),
+			pose.x(), pose.y(), pose.phi(), xSpeed, ySpeed, omega );
+	frame->append( field );
+
+	VolumeCoordinate gripper = this->pCbha->gripperPosition();
+	float read[ CBHA_BELLOWS_COUNT ], target[ CBHA_BELLOWS_COUNT ];
+	this->pCbha->bellowsPressures( read, target );
+
+	snprintf( field, sizeof( field ), " cbha %d %.3f %.3f %.3f",
+			this->pCbha->isHolding() ? 1 : 0, gripper.x(), gripper.y(), gripper.z() );
+	frame->append( field );
+	for ( unsigned int i = 0; i < CBHA_BELLOWS_COUNT; i++ )
+	{
+		snprintf( field, sizeof( field ), " %.3f", read[ i ] );
+		frame->append( field );
+	}
+	for ( unsigned int i = 0; i < CBHA_BELLOWS_COUNT; i++ )
+	{
+		snprintf( field, sizeof( field ), " %.3f", target[ i ] );
+		frame->append( field );
+	}
+
+	if ( this->hasLaserRangeFinder )
+	{
+		std::vector<float> & ranges = this->telemetryRanges;
+		float angleMin, angleIncrement;
+		this->pLRF->filteredScan( ranges, angleMin, angleIncrement );
+		snprintf( field, sizeof( field ), " scan %.5f %.5f %u",
+				angleMin, angleIncrement, (unsigned int) ranges.size() );
+		frame->append( field );
+		for ( unsigned int i = 0; i < ranges.size(); i++ )
+		{
+			snprintf( field, sizeof( field ), " %.3f", ranges[ i ] );
+			frame->append( field );
+		}
+	}
+
+	frame->append( "\n" );
+	this->pTelemetry->broadcast( frame );
+}
+
 void
 Brain::errorEvent( const char * errorString )
 {
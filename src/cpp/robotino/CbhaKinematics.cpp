@@ -0,0 +1,162 @@
+#include "headers/CbhaKinematics.h"
+
+#include "headers/_CompactBha.h"
+
+#include "../geometry/VolumeCoordinate.h"
+
+#include <math.h>
+
+
+CbhaKinematics::CbhaKinematics()
+{
+	float maxBend2 = CBHAKINEMATICS_MAX_BEND * CBHAKINEMATICS_MAX_BEND;
+	this->tableStep = maxBend2 / CBHAKINEMATICS_TABLE_SIZE;
+	this->tableScale = CBHAKINEMATICS_TABLE_SIZE / maxBend2;
+
+	this->bendTable[ 0 ] = 0.5;
+	this->sincTable[ 0 ] = 1.0;
+	for ( unsigned int i = 1; i <= CBHAKINEMATICS_TABLE_SIZE; i++ )
+	{
+		double t = sqrt( i * (double) this->tableStep );
+		this->bendTable[ i ] = ( 1.0 - cos( t ) ) / ( t * t );
+		this->sincTable[ i ] = sin( t ) / t;
+	}
+
+	// A segment bends away from its longer strings, with the bending vector
+	// -2 / ( 3 * r ) * sum( length * direction ) over the strings
+	float angles[ 3 ] = {
+		CBHAKINEMATICS_POT_ANGLE_OVER,
+		CBHAKINEMATICS_POT_ANGLE_RIGHT,
+		CBHAKINEMATICS_POT_ANGLE_LEFT };
+	for ( unsigned int i = 0; i < 3; i++ )
+	{
+		this->stringX[ i ] = -2.0 * cos( angles[ i ] ) / ( 3.0 * CBHAKINEMATICS_STRING_RADIUS );
+		this->stringY[ i ] = -2.0 * sin( angles[ i ] ) / ( 3.0 * CBHAKINEMATICS_STRING_RADIUS );
+	}
+
+	this->mountCos = cos( CBHAKINEMATICS_MOUNT_PITCH );
+	this->mountSin = sin( CBHAKINEMATICS_MOUNT_PITCH );
+
+	float relaxed[ CBHA_STRINGPOTS_COUNT ] = { 0.0, 0.0, 0.0, 0.0, 0.0, 0.0 };
+	this->update( relaxed );
+}
+
+void
+CbhaKinematics::update( const float * readings )
+{
+	float
+		innerRotation[ 9 ],
+		innerPosition[ 3 ],
+		outerRotation[ 9 ],
+		outerPosition[ 3 ];
+
+	this->segment(
+			readings[ CBHA_INNER_OVER ],
+			readings[ CBHA_INNER_RIGHT ],
+			readings[ CBHA_INNER_LEFT ],
+			innerRotation,
+			innerPosition );
+	this->segment(
+			readings[ CBHA_OUTER_OVER ],
+			readings[ CBHA_OUTER_RIGHT ],
+			readings[ CBHA_OUTER_LEFT ],
+			outerRotation,
+			outerPosition );
+
+	// Gripper tip and direction relative to the inner segment end
+	float tip[ 3 ], axis[ 3 ];
+	for ( unsigned int i = 0; i < 3; i++ )
+	{
+		axis[ i ] = outerRotation[ ( i * 3 ) + 2 ];
+		tip[ i ] = outerPosition[ i ] + ( CBHAKINEMATICS_GRIPPER_LENGTH * axis[ i ] );
+	}
+
+	// Relative to the arm base
+	float armTip[ 3 ], armAxis[ 3 ];
+	for ( unsigned int i = 0; i < 3; i++ )
+	{
+		const float * row = & innerRotation[ i * 3 ];
+		armTip[ i ] = innerPosition[ i ] + ( row[ 0 ] * tip[ 0 ] ) + ( row[ 1 ] * tip[ 1 ] ) + ( row[ 2 ] * tip[ 2 ] );
+		armAxis[ i ] = ( row[ 0 ] * axis[ 0 ] ) + ( row[ 1 ] * axis[ 1 ] ) + ( row[ 2 ] * axis[ 2 ] );
+	}
+
+	// Relative to Robotino. The arm x axis points up and forwards, the y axis
+	// to the right and the z axis down and forwards.
+	this->position[ 0 ] = CBHAKINEMATICS_MOUNT_X + ( armTip[ 0 ] * this->mountCos ) + ( armTip[ 2 ] * this->mountSin );
+	this->position[ 1 ] = -armTip[ 1 ];
+	this->position[ 2 ] = CBHAKINEMATICS_MOUNT_Z + ( armTip[ 0 ] * this->mountSin ) - ( armTip[ 2 ] * this->mountCos );
+
+	this->direction[ 0 ] = ( armAxis[ 0 ] * this->mountCos ) + ( armAxis[ 2 ] * this->mountSin );
+	this->direction[ 1 ] = -armAxis[ 1 ];
+	this->direction[ 2 ] = ( armAxis[ 0 ] * this->mountSin ) - ( armAxis[ 2 ] * this->mountCos );
+}
+
+VolumeCoordinate
+CbhaKinematics::gripperPosition() const
+{
+	return VolumeCoordinate( this->position[ 0 ], this->position[ 1 ], this->position[ 2 ] );
+}
+
+VolumeCoordinate
+CbhaKinematics::gripperDirection() const
+{
+	return VolumeCoordinate( this->direction[ 0 ], this->direction[ 1 ], this->direction[ 2 ] );
+}
+
+
+// Private functions
+
+void
+CbhaKinematics::segment(
+		float over,
+		float right,
+		float left,
+		float * rotation,
+		float * position ) const
+{
+	float lengths[ 3 ];
+	lengths[ 0 ] = CBHAKINEMATICS_POT_LENGTH_OFFSET + ( over * CBHAKINEMATICS_POT_LENGTH_SCALE );
+	lengths[ 1 ] = CBHAKINEMATICS_POT_LENGTH_OFFSET + ( right * CBHAKINEMATICS_POT_LENGTH_SCALE );
+	lengths[ 2 ] = CBHAKINEMATICS_POT_LENGTH_OFFSET + ( left * CBHAKINEMATICS_POT_LENGTH_SCALE );
+
+	float
+		length = ( lengths[ 0 ] + lengths[ 1 ] + lengths[ 2 ] ) * ( 1.0f / 3.0f ),
+		bx = ( lengths[ 0 ] * this->stringX[ 0 ] ) + ( lengths[ 1 ] * this->stringX[ 1 ] ) + ( lengths[ 2 ] * this->stringX[ 2 ] ),
+		by = ( lengths[ 0 ] * this->stringY[ 0 ] ) + ( lengths[ 1 ] * this->stringY[ 1 ] ) + ( lengths[ 2 ] * this->stringY[ 2 ] ),
+		bend2 = ( bx * bx ) + ( by * by );
+
+	// Limit the bending angle, keeping the direction
+	float maxBend2 = this->tableStep * CBHAKINEMATICS_TABLE_SIZE;
+	if ( bend2 > maxBend2 )
+	{
+		float scale = sqrt( maxBend2 / bend2 );
+		bx *= scale;
+		by *= scale;
+		bend2 = maxBend2;
+	}
+
+	// Interpolate the table
+	float index = bend2 * this->tableScale;
+	unsigned int i = (unsigned int) index;
+	if ( i >= CBHAKINEMATICS_TABLE_SIZE ) i = CBHAKINEMATICS_TABLE_SIZE - 1;
+	float fraction = index - i;
+
+	float
+		bend = this->bendTable[ i ] + ( fraction * ( this->bendTable[ i + 1 ] - this->bendTable[ i ] ) ),
+		sinc = this->sincTable[ i ] + ( fraction * ( this->sincTable[ i + 1 ] - this->sincTable[ i ] ) );
+
+	// The rotation of bending t around the axis perpendicular to (bx, by)
+	rotation[ 0 ] = 1.0f - ( bend * bx * bx );
+	rotation[ 1 ] = -bend * bx * by;
+	rotation[ 2 ] = sinc * bx;
+	rotation[ 3 ] = rotation[ 1 ];
+	rotation[ 4 ] = 1.0f - ( bend * by * by );
+	rotation[ 5 ] = sinc * by;
+	rotation[ 6 ] = -rotation[ 2 ];
+	rotation[ 7 ] = -rotation[ 5 ];
+	rotation[ 8 ] = 1.0f - ( bend * bend2 );
+
+	position[ 0 ] = length * bend * bx;
+	position[ 1 ] = length * bend * by;
+	position[ 2 ] = length * sinc;
+}
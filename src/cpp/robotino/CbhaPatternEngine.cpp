@@ -0,0 +1,118 @@
+#include "headers/CbhaPatternEngine.h"
+
+#include <vector>
+
+
+CbhaPatternEngine::CbhaPatternEngine( unsigned int signalCount )
+{
+	this->signalCount = signalCount;
+}
+
+int
+CbhaPatternEngine::addPattern( const CbhaPatternStep * steps, unsigned int stepCount )
+{
+	if ( stepCount == 0 ) return -1;
+	if ( this->patternFirstStep.size() >= CBHAPATTERNENGINE_MAX_PATTERNS ) return -1;
+
+	// Validate the whole pattern before adding anything
+	for ( unsigned int s = 0; s < stepCount; s++ )
+	{
+		if ( steps[ s ].conditionCount > CBHAPATTERNENGINE_MAX_CONDITIONS ) return -1;
+		for ( unsigned int c = 0; c < steps[ s ].conditionCount; c++ )
+			if ( steps[ s ].conditions[ c ].signal >= this->signalCount ) return -1;
+	}
+
+	this->patternFirstStep.push_back( this->stepFirstCondition.size() );
+	this->patternStepCount.push_back( stepCount );
+
+	for ( unsigned int s = 0; s < stepCount; s++ )
+	{
+		this->stepFirstCondition.push_back( this->conditionSignal.size() );
+		this->stepConditionCount.push_back( steps[ s ].conditionCount );
+		this->stepMinDuration.push_back( steps[ s ].minDuration );
+		this->stepTimeout.push_back( ( s == 0 ) ? 0 : steps[ s ].timeout );
+
+		for ( unsigned int c = 0; c < steps[ s ].conditionCount; c++ )
+		{
+			this->conditionSignal.push_back( steps[ s ].conditions[ c ].signal );
+			this->conditionComparison.push_back( steps[ s ].conditions[ c ].comparison );
+			this->conditionThreshold.push_back( steps[ s ].conditions[ c ].threshold );
+		}
+	}
+
+	this->patternStep.push_back( 0 );
+	this->patternHoldingSince.push_back( 0 );
+	this->patternStepDone.push_back( 0 );
+	this->patternHolding.push_back( false );
+
+	return this->patternFirstStep.size() - 1;
+}
+
+unsigned int
+CbhaPatternEngine::evaluate( const float * signals, unsigned int time )
+{
+	unsigned int fired = 0;
+
+	for ( unsigned int p = 0; p < this->patternFirstStep.size(); p++ )
+	{
+		unsigned int step = this->patternFirstStep[ p ] + this->patternStep[ p ];
+
+		// Start over if the current step has timed out
+		if ( this->stepTimeout[ step ] > 0
+				&& time - this->patternStepDone[ p ] > this->stepTimeout[ step ] )
+		{
+			this->patternStep[ p ] = 0;
+			this->patternHolding[ p ] = false;
+			step = this->patternFirstStep[ p ];
+		}
+
+		// Check the conditions of the current step
+		bool holding = true;
+		unsigned int
+			first = this->stepFirstCondition[ step ],
+			last = first + this->stepConditionCount[ step ];
+		for ( unsigned int c = first; c < last && holding; c++ )
+		{
+			float signal = signals[ this->conditionSignal[ c ] ];
+			holding = ( this->conditionComparison[ c ] == CBHAPATTERNENGINE_ABOVE )
+				? ( signal > this->conditionThreshold[ c ] )
+				: ( signal < this->conditionThreshold[ c ] );
+		}
+
+		if ( ! holding )
+		{
+			this->patternHolding[ p ] = false;
+			continue;
+		}
+
+		if ( ! this->patternHolding[ p ] )
+		{
+			this->patternHolding[ p ] = true;
+			this->patternHoldingSince[ p ] = time;
+		}
+
+		if ( time - this->patternHoldingSince[ p ] < this->stepMinDuration[ step ] ) continue;
+
+		// Step completed
+		this->patternHolding[ p ] = false;
+		this->patternStepDone[ p ] = time;
+
+		if ( ++this->patternStep[ p ] >= this->patternStepCount[ p ] )
+		{
+			this->patternStep[ p ] = 0;
+			fired |= ( 1u << p );
+		}
+	}
+
+	return fired;
+}
+
+void
+CbhaPatternEngine::reset()
+{
+	for ( unsigned int p = 0; p < this->patternFirstStep.size(); p++ )
+	{
+		this->patternStep[ p ] = 0;
+		this->patternHolding[ p ] = false;
+	}
+}
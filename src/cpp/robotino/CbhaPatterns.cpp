@@ -0,0 +1,80 @@
+#include "headers/CbhaPatterns.h"
+
+#include <math.h>
+
+
+void
+CbhaPatterns::define( CbhaPatternEngine & engine, int * ids )
+{
+	// All interactions require the arm to be still, not moving by its own
+	// pressure
+	CbhaCondition
+		still = { CBHA_SIGNAL_PRESSURE_ERROR, CBHAPATTERNENGINE_BELOW, CBHA_ARM_ACTIVITY_THRESHOLD },
+		steady = { CBHA_SIGNAL_PRESSURE_MOTION, CBHAPATTERNENGINE_BELOW, CBHA_ARM_ACTIVITY_DELTAS_THRESHOLD };
+
+	CbhaPatternStep recieve = { 4, {
+		still,
+		steady,
+		{ CBHA_SIGNAL_GRIP_READY, CBHAPATTERNENGINE_ABOVE, 0.5 },
+		{ CBHA_SIGNAL_DOWN, CBHAPATTERNENGINE_ABOVE, CBHA_GRIP_THRESHOLD } }, 0, 0 };
+	ids[ 1 ] = engine.addPattern( & recieve, 1 );	// CBHA_EVENT_RECIEVE
+
+	// Lift after hold: the object must have been held still before it is
+	// lifted. The patterns are reset when a grip is completed, see
+	// _CompactBha::apply().
+	CbhaPatternStep deliver[ 2 ] = {
+		{ 4, {
+			still,
+			steady,
+			{ CBHA_SIGNAL_RELEASE_READY, CBHAPATTERNENGINE_ABOVE, 0.5 },
+			{ CBHA_SIGNAL_DOWN, CBHAPATTERNENGINE_ABOVE, CBHA_RELEASE_THRESHOLD } }, CBHA_DELIVER_HOLD_MSECS, 0 },
+		{ 4, {
+			still,
+			steady,
+			{ CBHA_SIGNAL_RELEASE_READY, CBHAPATTERNENGINE_ABOVE, 0.5 },
+			{ CBHA_SIGNAL_DOWN, CBHAPATTERNENGINE_BELOW, CBHA_RELEASE_THRESHOLD } }, 0, 0 } };
+	ids[ 2 ] = engine.addPattern( deliver, 2 );	// CBHA_EVENT_DELIVER
+
+	CbhaPatternStep touch = { 3, {
+		still,
+		steady,
+		{ CBHA_SIGNAL_TOUCH, CBHAPATTERNENGINE_ABOVE, CBHA_TOUCHED_THRESHOLD } }, 0, 0 };
+	ids[ 0 ] = engine.addPattern( & touch, 1 );	// CBHA_EVENT_TOUCH
+}
+
+void
+CbhaPatterns::signals(
+		const float * readPressures,
+		const float * targetPressures,
+		const RingWindow<float, CBHA_DELTA_DEPTH> * pressureDeltas,
+		const RingWindow<float, CBHA_DELTA_DEPTH> * potDeltas,
+		bool gripReady,
+		bool releaseReady,
+		float * signals )
+{
+	float
+		pressureError = 0.0,
+		pressureMotion = 0.0;
+	for ( unsigned int i = 0; i < CBHA_BELLOWS_COUNT - 2; i++ ) // Don't care about rotation
+	{
+		float error = fabs( readPressures[ i ] - targetPressures[ i ] );
+		float motion = fabs( pressureDeltas[ i ].mean() );
+		if ( error > pressureError ) pressureError = error;
+		if ( motion > pressureMotion ) pressureMotion = motion;
+	}
+
+	float touch = 0.0;
+	for ( unsigned int i = 0; i < CBHA_STRINGPOTS_COUNT / 2 ; i++ )
+	{
+		float motion = fabs( potDeltas[ i ].latest() + potDeltas[ i + 3 ].latest() );
+		if ( motion > touch ) touch = motion;
+	}
+
+	signals[ CBHA_SIGNAL_PRESSURE_ERROR ] = pressureError;
+	signals[ CBHA_SIGNAL_PRESSURE_MOTION ] = pressureMotion;
+	signals[ CBHA_SIGNAL_DOWN ] =
+		potDeltas[ CBHA_INNER_OVER ].mean() + potDeltas[ CBHA_OUTER_OVER ].mean();
+	signals[ CBHA_SIGNAL_TOUCH ] = touch;
+	signals[ CBHA_SIGNAL_GRIP_READY ] = gripReady ? 1.0 : 0.0;
+	signals[ CBHA_SIGNAL_RELEASE_READY ] = releaseReady ? 1.0 : 0.0;
+}
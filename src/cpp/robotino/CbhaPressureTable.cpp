@@ -0,0 +1,234 @@
+#include "headers/CbhaPressureTable.h"
+
+#include <rec/robotino/api2/CompactBHASimple.h>
+
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <vector>
+
+
+CbhaPressureTable::CbhaPressureTable()
+{
+	if ( ! this->load() )
+	{
+		this->generate();
+		this->save();
+	}
+}
+
+void
+CbhaPressureTable::lookup( float x, float y, float * over, float * left, float * right ) const
+{
+	// Grid coordinates, limited to the table
+	float
+		gx = ( x + 1.0f ) * ( CBHAPRESSURETABLE_SIZE * 0.5f ),
+		gy = ( y + 1.0f ) * ( CBHAPRESSURETABLE_SIZE * 0.5f );
+	if ( gx < 0.0f ) gx = 0.0f;
+	if ( gx > CBHAPRESSURETABLE_SIZE ) gx = CBHAPRESSURETABLE_SIZE;
+	if ( gy < 0.0f ) gy = 0.0f;
+	if ( gy > CBHAPRESSURETABLE_SIZE ) gy = CBHAPRESSURETABLE_SIZE;
+
+	unsigned int
+		ix = (unsigned int) gx,
+		iy = (unsigned int) gy;
+	if ( ix >= CBHAPRESSURETABLE_SIZE ) ix = CBHAPRESSURETABLE_SIZE - 1;
+	if ( iy >= CBHAPRESSURETABLE_SIZE ) iy = CBHAPRESSURETABLE_SIZE - 1;
+
+	float
+		fx = gx - ix,
+		fy = gy - iy;
+
+	const float
+		* p00 = & this->table[ ( ( iy * ( CBHAPRESSURETABLE_SIZE + 1 ) ) + ix ) * 3 ],
+		* p10 = p00 + 3,
+		* p01 = p00 + ( ( CBHAPRESSURETABLE_SIZE + 1 ) * 3 ),
+		* p11 = p01 + 3;
+
+	float result[ 3 ];
+	for ( unsigned int i = 0; i < 3; i++ )
+	{
+		float
+			bottom = p00[ i ] + ( fx * ( p10[ i ] - p00[ i ] ) ),
+			top = p01[ i ] + ( fx * ( p11[ i ] - p01[ i ] ) );
+		result[ i ] = bottom + ( fy * ( top - bottom ) );
+	}
+
+	* over = result[ 0 ];
+	* left = result[ 1 ];
+	* right = result[ 2 ];
+}
+
+void
+CbhaPressureTable::lookup(
+		const float * x,
+		const float * y,
+		unsigned int count,
+		float * over,
+		float * left,
+		float * right ) const
+{
+	for ( unsigned int i = 0; i < count; i++ )
+		this->lookup( x[ i ], y[ i ], & over[ i ], & left[ i ], & right[ i ] );
+}
+
+void
+CbhaPressureTable::compare( std::ostream & out ) const
+{
+	std::vector<float>
+		x( CBHAPRESSURETABLE_COMPARE_SAMPLES ),
+		y( CBHAPRESSURETABLE_COMPARE_SAMPLES ),
+		tablePressures( CBHAPRESSURETABLE_COMPARE_SAMPLES * 3 ),
+		apiPressures( CBHAPRESSURETABLE_COMPARE_SAMPLES * 3 );
+
+	for ( unsigned int i = 0; i < CBHAPRESSURETABLE_COMPARE_SAMPLES; i++ )
+	{
+		x[ i ] = ( 2.0f * rand() / RAND_MAX ) - 1.0f;
+		y[ i ] = ( 2.0f * rand() / RAND_MAX ) - 1.0f;
+	}
+
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	for ( unsigned int i = 0; i < CBHAPRESSURETABLE_COMPARE_SAMPLES; i++ )
+		rec::robotino::api2::CompactBHASimple::xy2pressure(
+				x[ i ],
+				y[ i ],
+				& apiPressures[ i * 3 ],
+				& apiPressures[ ( i * 3 ) + 1 ],
+				& apiPressures[ ( i * 3 ) + 2 ] );
+	std::chrono::steady_clock::time_point apiDone = std::chrono::steady_clock::now();
+	for ( unsigned int i = 0; i < CBHAPRESSURETABLE_COMPARE_SAMPLES; i++ )
+		this->lookup(
+				x[ i ],
+				y[ i ],
+				& tablePressures[ i * 3 ],
+				& tablePressures[ ( i * 3 ) + 1 ],
+				& tablePressures[ ( i * 3 ) + 2 ] );
+	std::chrono::steady_clock::time_point tableDone = std::chrono::steady_clock::now();
+
+	double
+		maxError = 0.0,
+		errorSum = 0.0;
+	for ( unsigned int i = 0; i < CBHAPRESSURETABLE_COMPARE_SAMPLES * 3; i++ )
+	{
+		double error = fabs( tablePressures[ i ] - apiPressures[ i ] );
+		if ( error > maxError ) maxError = error;
+		errorSum += error;
+	}
+
+	double
+		apiNsecs = std::chrono::duration_cast<std::chrono::nanoseconds>( apiDone - start ).count(),
+		tableNsecs = std::chrono::duration_cast<std::chrono::nanoseconds>( tableDone - apiDone ).count();
+
+	out
+		<< "CbhaPressureTable: " << CBHAPRESSURETABLE_COMPARE_SAMPLES << " samples"
+		<< "\n\tError; max = " << maxError << " bar  average = "
+		<< ( errorSum / ( CBHAPRESSURETABLE_COMPARE_SAMPLES * 3 ) ) << " bar"
+		<< "\n\tTime per sample; xy2pressure = "
+		<< ( apiNsecs / CBHAPRESSURETABLE_COMPARE_SAMPLES ) << " ns  table = "
+		<< ( tableNsecs / CBHAPRESSURETABLE_COMPARE_SAMPLES ) << " ns"
+		<< std::endl;
+}
+
+
+// Private functions
+
+void
+CbhaPressureTable::generate()
+{
+	for ( unsigned int iy = 0; iy <= CBHAPRESSURETABLE_SIZE; iy++ )
+	{
+		for ( unsigned int ix = 0; ix <= CBHAPRESSURETABLE_SIZE; ix++ )
+		{
+			float * p = & this->table[ ( ( iy * ( CBHAPRESSURETABLE_SIZE + 1 ) ) + ix ) * 3 ];
+			rec::robotino::api2::CompactBHASimple::xy2pressure(
+					( 2.0f * ix / CBHAPRESSURETABLE_SIZE ) - 1.0f,
+					( 2.0f * iy / CBHAPRESSURETABLE_SIZE ) - 1.0f,
+					& p[ 0 ],
+					& p[ 1 ],
+					& p[ 2 ] );
+		}
+	}
+}
+
+bool
+CbhaPressureTable::load()
+{
+	if ( strlen( CBHAPRESSURETABLE_CACHE_FILE ) == 0 ) return false;
+
+	std::ifstream file( CBHAPRESSURETABLE_CACHE_FILE, std::ios::binary );
+	if ( ! file ) return false;
+
+	int header[ 2 ] = { 0, 0 };
+	file.read( (char *) header, sizeof( header ) );
+	if ( header[ 0 ] != CBHAPRESSURETABLE_CACHE_VERSION
+			|| header[ 1 ] != CBHAPRESSURETABLE_SIZE )
+	{
+		std::cerr << "CbhaPressureTable: Cache does not match, regenerating" << std::endl;
+		return false;
+	}
+
+	file.read( (char *) this->table, sizeof( this->table ) );
+	if ( ! file )
+	{
+		std::cerr << "CbhaPressureTable: Cache is incomplete, regenerating" << std::endl;
+		return false;
+	}
+
+	// Check the corners and center against the API, in case it has changed
+	unsigned int points[ 5 ][ 2 ] = {
+		{ 0, 0 },
+		{ CBHAPRESSURETABLE_SIZE, 0 },
+		{ 0, CBHAPRESSURETABLE_SIZE },
+		{ CBHAPRESSURETABLE_SIZE, CBHAPRESSURETABLE_SIZE },
+		{ CBHAPRESSURETABLE_SIZE / 2, CBHAPRESSURETABLE_SIZE / 2 } };
+
+	for ( unsigned int i = 0; i < 5; i++ )
+	{
+		float expected[ 3 ];
+		rec::robotino::api2::CompactBHASimple::xy2pressure(
+				( 2.0f * points[ i ][ 0 ] / CBHAPRESSURETABLE_SIZE ) - 1.0f,
+				( 2.0f * points[ i ][ 1 ] / CBHAPRESSURETABLE_SIZE ) - 1.0f,
+				& expected[ 0 ],
+				& expected[ 1 ],
+				& expected[ 2 ] );
+
+		const float * p = & this->table[
+			( ( points[ i ][ 1 ] * ( CBHAPRESSURETABLE_SIZE + 1 ) ) + points[ i ][ 0 ] ) * 3 ];
+		for ( unsigned int j = 0; j < 3; j++ )
+		{
+			if ( fabs( p[ j ] - expected[ j ] ) > CBHAPRESSURETABLE_CACHE_TOLERANCE )
+			{
+				std::cerr << "CbhaPressureTable: Cache is outdated, regenerating" << std::endl;
+				return false;
+			}
+		}
+	}
+
+	return true;
+}
+
+bool
+CbhaPressureTable::save() const
+{
+	if ( strlen( CBHAPRESSURETABLE_CACHE_FILE ) == 0 ) return false;
+
+	std::ofstream file( CBHAPRESSURETABLE_CACHE_FILE, std::ios::binary | std::ios::trunc );
+
+	int header[ 2 ] = { CBHAPRESSURETABLE_CACHE_VERSION, CBHAPRESSURETABLE_SIZE };
+	file.write( (const char *) header, sizeof( header ) );
+	file.write( (const char *) this->table, sizeof( this->table ) );
+
+	if ( ! file )
+	{
+		std::cerr
+			<< "CbhaPressureTable: Unable to write cache file "
+			<< CBHAPRESSURETABLE_CACHE_FILE
+			<< std::endl;
+		return false;
+	}
+
+	return true;
+}
@@ -0,0 +1,173 @@
+#include "headers/CbhaTrajectory.h"
+
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+
+CbhaTrajectory::CbhaTrajectory()
+{}
+
+void
+CbhaTrajectory::clear()
+{
+	this->times.clear();
+	this->pressures.clear();
+}
+
+bool
+CbhaTrajectory::addFrame( unsigned int time, const float * pressures )
+{
+	if ( ! this->times.empty() && time < this->times.back() ) return false;
+
+	this->times.push_back( time );
+	for ( unsigned int i = 0; i < CBHATRAJECTORY_CHANNELS; i++ )
+	{
+		float units = ( pressures[ i ] / CBHATRAJECTORY_RESOLUTION ) + 0.5;
+		if ( units < 0.0 ) units = 0.0;
+		if ( units > 65535.0 ) units = 65535.0;
+		this->pressures.push_back( (unsigned short) units );
+	}
+
+	return true;
+}
+
+unsigned int
+CbhaTrajectory::frames() const
+{
+	return this->times.size();
+}
+
+unsigned int
+CbhaTrajectory::duration() const
+{
+	return ( this->times.empty() ) ? 0 : this->times.back();
+}
+
+bool
+CbhaTrajectory::sample( unsigned int time, float * pressures, unsigned int & cursor ) const
+{
+	unsigned int count = this->times.size();
+	if ( count == 0 ) return false;
+
+	if ( cursor >= count || this->times[ cursor ] > time ) cursor = 0;
+	while ( cursor + 1 < count && this->times[ cursor + 1 ] <= time ) cursor++;
+
+	const unsigned short * a = & this->pressures[ cursor * CBHATRAJECTORY_CHANNELS ];
+
+	// Before the first or after the last frame
+	if ( cursor + 1 >= count || time <= this->times[ cursor ] )
+	{
+		for ( unsigned int i = 0; i < CBHATRAJECTORY_CHANNELS; i++ )
+			pressures[ i ] = a[ i ] * CBHATRAJECTORY_RESOLUTION;
+		return true;
+	}
+
+	const unsigned short * b = a + CBHATRAJECTORY_CHANNELS;
+	float fraction =
+		(float) ( time - this->times[ cursor ] )
+		/ ( this->times[ cursor + 1 ] - this->times[ cursor ] );
+
+	for ( unsigned int i = 0; i < CBHATRAJECTORY_CHANNELS; i++ )
+		pressures[ i ] = ( a[ i ] + ( fraction * ( b[ i ] - a[ i ] ) ) ) * CBHATRAJECTORY_RESOLUTION;
+
+	return true;
+}
+
+bool
+CbhaTrajectory::save( const std::string & filename ) const
+{
+	std::ofstream file( filename.c_str(), std::ios::binary | std::ios::trunc );
+
+	unsigned int header[ 3 ] = {
+		CBHATRAJECTORY_FILE_VERSION,
+		CBHATRAJECTORY_CHANNELS,
+		(unsigned int) this->times.size() };
+	file.write( (const char *) header, sizeof( header ) );
+	if ( ! this->times.empty() )
+	{
+		file.write( (const char *) this->times.data(), this->times.size() * sizeof( unsigned int ) );
+		file.write( (const char *) this->pressures.data(), this->pressures.size() * sizeof( unsigned short ) );
+	}
+
+	if ( ! file )
+	{
+		std::cerr << "CbhaTrajectory: Unable to write " << filename << std::endl;
+		return false;
+	}
+
+	return true;
+}
+
+bool
+CbhaTrajectory::load( const std::string & filename )
+{
+	std::ifstream file( filename.c_str(), std::ios::binary | std::ios::ate );
+	if ( ! file )
+	{
+		std::cerr << "CbhaTrajectory: Unable to open " << filename << std::endl;
+		return false;
+	}
+
+	std::streamoff fileSize = file.tellg();
+	file.seekg( 0 );
+
+	unsigned int header[ 3 ] = { 0, 0, 0 };
+	file.read( (char *) header, sizeof( header ) );
+	if ( file.gcount() != sizeof( header )
+			|| header[ 0 ] != CBHATRAJECTORY_FILE_VERSION
+			|| header[ 1 ] != CBHATRAJECTORY_CHANNELS )
+	{
+		std::cerr << "CbhaTrajectory: Unsupported file " << filename << std::endl;
+		return false;
+	}
+
+	// The frame count is checked before anything is allocated for it
+	unsigned int count = header[ 2 ];
+	std::streamoff expectedSize =
+		sizeof( header )
+		+ ( (std::streamoff) count * ( sizeof( unsigned int ) + ( CBHATRAJECTORY_CHANNELS * sizeof( unsigned short ) ) ) );
+	if ( count > CBHATRAJECTORY_MAX_FRAMES || fileSize != expectedSize )
+	{
+		std::cerr << "CbhaTrajectory: Frame count " << count << " does not match the size of " << filename << std::endl;
+		return false;
+	}
+
+	std::vector<unsigned int> fileTimes( count );
+	std::vector<unsigned short> filePressures( count * CBHATRAJECTORY_CHANNELS );
+	if ( count > 0 )
+	{
+		std::streamsize
+			timesSize = fileTimes.size() * sizeof( unsigned int ),
+			pressuresSize = filePressures.size() * sizeof( unsigned short );
+
+		file.read( (char *) fileTimes.data(), timesSize );
+		bool complete = ( file.gcount() == timesSize );
+		if ( complete )
+		{
+			file.read( (char *) filePressures.data(), pressuresSize );
+			complete = ( file.gcount() == pressuresSize );
+		}
+
+		if ( ! complete )
+		{
+			std::cerr << "CbhaTrajectory: Incomplete file " << filename << std::endl;
+			return false;
+		}
+	}
+
+	// sample() relies on the times being in order
+	for ( unsigned int i = 1; i < count; i++ )
+	{
+		if ( fileTimes[ i ] < fileTimes[ i - 1 ] )
+		{
+			std::cerr << "CbhaTrajectory: Frame " << i << " is out of time order in " << filename << std::endl;
+			return false;
+		}
+	}
+
+	this->times.swap( fileTimes );
+	this->pressures.swap( filePressures );
+	return true;
+}
@@ -0,0 +1,309 @@
+#include "headers/LineExtractor.h"
+
+#include "../geometry/Coordinate.h"
+
+#ifndef _USE_MATH_DEFINES
+#define _USE_MATH_DEFINES
+#endif
+#include <math.h>
+#include <vector>
+
+
+LineExtractor::LineExtractor()
+{
+	this->tableAngleMin = 0.0;
+	this->tableAngleIncrement = 0.0;
+}
+
+void
+LineExtractor::extract(
+		const float * ranges,
+		unsigned int count,
+		float angleMin,
+		float angleIncrement,
+		float rangeMin,
+		float rangeMax,
+		float offsetX )
+{
+	// Recalculate beam directions only if the scan geometry has changed
+	if ( count != this->beamCos.size()
+			|| angleMin != this->tableAngleMin
+			|| angleIncrement != this->tableAngleIncrement )
+	{
+		this->beamCos.resize( count );
+		this->beamSin.resize( count );
+		for ( unsigned int i = 0; i < count; i++ )
+		{
+			this->beamCos[ i ] = cos( angleMin + ( i * angleIncrement ) );
+			this->beamSin[ i ] = sin( angleMin + ( i * angleIncrement ) );
+		}
+		this->tableAngleMin = angleMin;
+		this->tableAngleIncrement = angleIncrement;
+	}
+
+	this->px.clear();
+	this->py.clear();
+	this->sums.assign( 5, 0.0 );
+	this->clusters.clear();
+	this->segments.clear();
+	this->_lines.clear();
+	this->_corners.clear();
+
+	// Convert to cartesian points, dividing them into clusters at gaps
+	bool gap = true;
+	for ( unsigned int i = 0; i < count; i++ )
+	{
+		float range = ranges[ i ];
+		if ( range < rangeMin || range > rangeMax )
+		{
+			gap = true;
+			continue;
+		}
+
+		float
+			x = offsetX + ( range * this->beamCos[ i ] ),
+			y = range * this->beamSin[ i ];
+
+		if ( ! this->px.empty() && ! gap )
+		{
+			float
+				dx = x - this->px.back(),
+				dy = y - this->py.back();
+			gap = ( ( dx * dx ) + ( dy * dy ) )
+				> ( LINEEXTRACTOR_MAX_POINT_GAP * LINEEXTRACTOR_MAX_POINT_GAP );
+		}
+		if ( gap ) this->clusters.push_back( this->px.size() );
+		gap = false;
+
+		this->px.push_back( x );
+		this->py.push_back( y );
+
+		unsigned int last = this->sums.size() - 5;
+		this->sums.push_back( this->sums[ last ] + x );
+		this->sums.push_back( this->sums[ last + 1 ] + y );
+		this->sums.push_back( this->sums[ last + 2 ] + ( x * x ) );
+		this->sums.push_back( this->sums[ last + 3 ] + ( y * y ) );
+		this->sums.push_back( this->sums[ last + 4 ] + ( x * y ) );
+	}
+	this->clusters.push_back( this->px.size() );
+
+	for ( unsigned int c = 0; c + 1 < this->clusters.size(); c++ )
+	{
+		unsigned int
+			first = this->clusters[ c ],
+			last = this->clusters[ c + 1 ] - 1;
+
+		if ( this->clusters[ c + 1 ] - first >= LINEEXTRACTOR_MIN_POINTS )
+			this->split( first, last );
+	}
+
+	this->merge();
+	this->findCorners();
+}
+
+const std::vector<ScanLine> &
+LineExtractor::lines() const
+{
+	return this->_lines;
+}
+
+const std::vector<ScanCorner> &
+LineExtractor::corners() const
+{
+	return this->_corners;
+}
+
+
+// Private functions
+
+void
+LineExtractor::fit( unsigned int first, unsigned int last, float * alpha, float * rho ) const
+{
+	const double
+		* a = & this->sums[ first * 5 ],
+		* b = & this->sums[ ( last + 1 ) * 5 ];
+
+	double
+		n = last - first + 1,
+		mx = ( b[ 0 ] - a[ 0 ] ) / n,
+		my = ( b[ 1 ] - a[ 1 ] ) / n,
+		sxx = ( b[ 2 ] - a[ 2 ] ) - ( n * mx * mx ),
+		syy = ( b[ 3 ] - a[ 3 ] ) - ( n * my * my ),
+		sxy = ( b[ 4 ] - a[ 4 ] ) - ( n * mx * my );
+
+	double
+		lineAlpha = 0.5 * atan2( -2.0 * sxy, syy - sxx ),
+		lineRho = ( mx * cos( lineAlpha ) ) + ( my * sin( lineAlpha ) );
+
+	// Keep rho positive by flipping the normal
+	if ( lineRho < 0.0 )
+	{
+		lineRho = -lineRho;
+		lineAlpha += ( lineAlpha < 0.0 ) ? M_PI : -M_PI;
+	}
+
+	* alpha = lineAlpha;
+	* rho = lineRho;
+}
+
+unsigned int
+LineExtractor::farthest(
+		unsigned int first,
+		unsigned int last,
+		float alpha,
+		float rho,
+		float * distance ) const
+{
+	float
+		nx = cos( alpha ),
+		ny = sin( alpha ),
+		maxDistance = 0.0;
+
+	unsigned int index = first;
+
+	for ( unsigned int i = first; i <= last; i++ )
+	{
+		float d = fabs( ( this->px[ i ] * nx ) + ( this->py[ i ] * ny ) - rho );
+		if ( d > maxDistance )
+		{
+			maxDistance = d;
+			index = i;
+		}
+	}
+
+	* distance = maxDistance;
+	return index;
+}
+
+void
+LineExtractor::split( unsigned int first, unsigned int last )
+{
+	this->splitStack.clear();
+	this->splitStack.push_back( first );
+	this->splitStack.push_back( last );
+
+	while ( ! this->splitStack.empty() )
+	{
+		unsigned int b = this->splitStack.back();
+		this->splitStack.pop_back();
+		unsigned int a = this->splitStack.back();
+		this->splitStack.pop_back();
+
+		if ( b - a + 1 < LINEEXTRACTOR_MIN_POINTS ) continue;
+
+		// Line through the end points of the range
+		float
+			dx = this->px[ b ] - this->px[ a ],
+			dy = this->py[ b ] - this->py[ a ],
+			alpha = atan2( dx, -dy ),
+			rho = ( this->px[ a ] * cos( alpha ) ) + ( this->py[ a ] * sin( alpha ) ),
+			distance;
+
+		unsigned int splitAt = this->farthest( a + 1, b - 1, alpha, rho, & distance );
+
+		if ( distance > LINEEXTRACTOR_SPLIT_DISTANCE )
+		{
+			// Push the far half first, so segments are accepted in scan order
+			this->splitStack.push_back( splitAt );
+			this->splitStack.push_back( b );
+			this->splitStack.push_back( a );
+			this->splitStack.push_back( splitAt );
+		}
+		else
+		{
+			this->segments.push_back( a );
+			this->segments.push_back( b );
+		}
+	}
+}
+
+void
+LineExtractor::merge()
+{
+	unsigned int count = this->segments.size() / 2;
+	unsigned int i = 0;
+
+	while ( i < count )
+	{
+		unsigned int
+			first = this->segments[ i * 2 ],
+			last = this->segments[ ( i * 2 ) + 1 ];
+
+		float
+			alpha,
+			rho,
+			distance;
+
+		// Extend the segment while the next segment fits the same line
+		while ( i + 1 < count && this->segments[ ( i + 1 ) * 2 ] == last )
+		{
+			unsigned int nextLast = this->segments[ ( ( i + 1 ) * 2 ) + 1 ];
+			this->fit( first, nextLast, & alpha, & rho );
+			this->farthest( first, nextLast, alpha, rho, & distance );
+			if ( distance > LINEEXTRACTOR_SPLIT_DISTANCE ) break;
+
+			last = nextLast;
+			i++;
+		}
+		i++;
+
+		this->fit( first, last, & alpha, & rho );
+
+		// Project the end points onto the fitted line
+		float
+			nx = cos( alpha ),
+			ny = sin( alpha ),
+			ds = ( this->px[ first ] * nx ) + ( this->py[ first ] * ny ) - rho,
+			de = ( this->px[ last ] * nx ) + ( this->py[ last ] * ny ) - rho;
+
+		ScanLine line;
+		line.start = Coordinate( this->px[ first ] - ( ds * nx ), this->py[ first ] - ( ds * ny ) );
+		line.end = Coordinate( this->px[ last ] - ( de * nx ), this->py[ last ] - ( de * ny ) );
+		line.alpha = alpha;
+		line.rho = rho;
+		line.points = last - first + 1;
+
+		float
+			lx = line.end.x() - line.start.x(),
+			ly = line.end.y() - line.start.y();
+		if ( ( ( lx * lx ) + ( ly * ly ) ) < ( LINEEXTRACTOR_MIN_LENGTH * LINEEXTRACTOR_MIN_LENGTH ) )
+			continue;
+
+		this->_lines.push_back( line );
+	}
+}
+
+void
+LineExtractor::findCorners()
+{
+	for ( unsigned int i = 0; i + 1 < this->_lines.size(); i++ )
+	{
+		ScanLine
+			& a = this->_lines[ i ],
+			& b = this->_lines[ i + 1 ];
+
+		float
+			gx = b.start.x() - a.end.x(),
+			gy = b.start.y() - a.end.y();
+		if ( ( ( gx * gx ) + ( gy * gy ) ) > ( LINEEXTRACTOR_CORNER_MAX_GAP * LINEEXTRACTOR_CORNER_MAX_GAP ) )
+			continue;
+
+		// The angle between the lines, [0, pi/2]
+		float angle = fmod( fabs( a.alpha - b.alpha ), M_PI );
+		if ( angle > M_PI_2 ) angle = M_PI - angle;
+		if ( angle < LINEEXTRACTOR_CORNER_MIN_ANGLE ) continue;
+
+		// Intersection of the two lines
+		float det = sin( b.alpha - a.alpha );
+
+		ScanCorner corner;
+		corner.position = Coordinate(
+				( ( a.rho * sin( b.alpha ) ) - ( b.rho * sin( a.alpha ) ) ) / det,
+				( ( b.rho * cos( a.alpha ) ) - ( a.rho * cos( b.alpha ) ) ) / det );
+		corner.angle = angle;
+		corner.first = i;
+		corner.second = i + 1;
+
+		this->_corners.push_back( corner );
+	}
+}
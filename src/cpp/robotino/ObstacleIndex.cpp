@@ -0,0 +1,155 @@
+#include "headers/ObstacleIndex.h"
+
+#ifndef _USE_MATH_DEFINES
+#define _USE_MATH_DEFINES
+#endif
+#include <math.h>
+
+
+ObstacleIndex::ObstacleIndex()
+{
+	for ( unsigned int s = 0; s < OBSTACLEINDEX_SOURCE_COUNT; s++ )
+	{
+		this->clear( s );
+		this->sourceTime[ s ] = 0;
+		this->sourceCommitted[ s ] = false;
+	}
+
+	for ( unsigned int k = 0; k < OBSTACLEINDEX_LEVELS; k++ )
+		for ( unsigned int i = 0; i < OBSTACLEINDEX_SECTORS; i++ )
+			this->table[ k ][ i ] = OBSTACLEINDEX_NO_OBSTACLE;
+
+	this->log2Table[ 0 ] = 0;
+	this->log2Table[ 1 ] = 0;
+	for ( unsigned int n = 2; n <= OBSTACLEINDEX_SECTORS; n++ )
+		this->log2Table[ n ] = this->log2Table[ n / 2 ] + 1;
+}
+
+void
+ObstacleIndex::clear( unsigned int source )
+{
+	if ( source >= OBSTACLEINDEX_SOURCE_COUNT ) return;
+
+	for ( unsigned int i = 0; i < OBSTACLEINDEX_SECTORS; i++ )
+		this->sourceSectors[ source ][ i ] = OBSTACLEINDEX_NO_OBSTACLE;
+}
+
+void
+ObstacleIndex::insert( unsigned int source, float phi, float distance )
+{
+	if ( source >= OBSTACLEINDEX_SOURCE_COUNT ) return;
+
+	if ( distance < 0.0 ) distance = 0.0;
+
+	float * nearest = & this->sourceSectors[ source ][ this->sector( phi ) ];
+	if ( distance < * nearest ) * nearest = distance;
+}
+
+void
+ObstacleIndex::insert( unsigned int source, float fromPhi, float toPhi, float distance )
+{
+	if ( source >= OBSTACLEINDEX_SOURCE_COUNT ) return;
+
+	if ( distance < 0.0 ) distance = 0.0;
+
+	unsigned int
+		i = this->sector( fromPhi ),
+		last = this->sector( toPhi );
+
+	while ( true )
+	{
+		if ( distance < this->sourceSectors[ source ][ i ] )
+			this->sourceSectors[ source ][ i ] = distance;
+
+		if ( i == last ) break;
+		i = ( i + 1 ) % OBSTACLEINDEX_SECTORS;
+	}
+}
+
+void
+ObstacleIndex::commit( unsigned int source, unsigned int time )
+{
+	if ( source >= OBSTACLEINDEX_SOURCE_COUNT ) return;
+
+	this->sourceTime[ source ] = time;
+	this->sourceCommitted[ source ] = true;
+
+	// Merge all sources with recent data into level 0
+	for ( unsigned int i = 0; i < OBSTACLEINDEX_SECTORS; i++ )
+		this->table[ 0 ][ i ] = OBSTACLEINDEX_NO_OBSTACLE;
+
+	for ( unsigned int s = 0; s < OBSTACLEINDEX_SOURCE_COUNT; s++ )
+	{
+		if ( ! this->sourceCommitted[ s ]
+				|| ( time - this->sourceTime[ s ] ) > OBSTACLEINDEX_SOURCE_MAX_AGE )
+			continue;
+
+		for ( unsigned int i = 0; i < OBSTACLEINDEX_SECTORS; i++ )
+			if ( this->sourceSectors[ s ][ i ] < this->table[ 0 ][ i ] )
+				this->table[ 0 ][ i ] = this->sourceSectors[ s ][ i ];
+	}
+
+	// Build the range minimum table, each level covering twice the sectors of
+	// the previous
+	for ( unsigned int k = 1; k < OBSTACLEINDEX_LEVELS; k++ )
+	{
+		unsigned int half = 1 << ( k - 1 );
+		for ( unsigned int i = 0; i + ( 1 << k ) <= OBSTACLEINDEX_SECTORS; i++ )
+		{
+			float
+				a = this->table[ k - 1 ][ i ],
+				b = this->table[ k - 1 ][ i + half ];
+			this->table[ k ][ i ] = ( a < b ) ? a : b;
+		}
+	}
+}
+
+float
+ObstacleIndex::nearest( float fromPhi, float toPhi )
+{
+	unsigned int
+		first = this->sector( fromPhi ),
+		last = this->sector( toPhi );
+
+	if ( first <= last )
+		return this->rangeMinimum( first, last );
+
+	// Sector wraps around the back of the index
+	float
+		a = this->rangeMinimum( first, OBSTACLEINDEX_SECTORS - 1 ),
+		b = this->rangeMinimum( 0, last );
+	return ( a < b ) ? a : b;
+}
+
+float
+ObstacleIndex::clearance( float heading )
+{
+	return this->nearest(
+			heading - OBSTACLEINDEX_CLEARANCE_HALF_ANGLE,
+			heading + OBSTACLEINDEX_CLEARANCE_HALF_ANGLE );
+}
+
+
+// Private functions
+
+unsigned int
+ObstacleIndex::sector( float phi )
+{
+	// Normalize to [0, 2pi)
+	phi = fmod( phi, 2 * M_PI );
+	if ( phi < 0 ) phi += 2 * M_PI;
+
+	unsigned int i = (unsigned int) ( phi * ( OBSTACLEINDEX_SECTORS / ( 2 * M_PI ) ) );
+	return ( i < OBSTACLEINDEX_SECTORS ) ? i : OBSTACLEINDEX_SECTORS - 1;
+}
+
+float
+ObstacleIndex::rangeMinimum( unsigned int first, unsigned int last )
+{
+	unsigned int k = this->log2Table[ last - first + 1 ];
+
+	float
+		a = this->table[ k ][ first ],
+		b = this->table[ k ][ last + 1 - ( 1 << k ) ];
+	return ( a < b ) ? a : b;
+}
@@ -0,0 +1,182 @@
+#include "headers/ScanFilter.h"
+
+#include <math.h>
+#include <vector>
+
+
+ScanFilter::ScanFilter()
+{
+	this->enabledFilters = SCANFILTER_DEFAULT;
+	this->medianWindow = SCANFILTER_MEDIAN_WINDOW;
+	this->decimation = SCANFILTER_DECIMATION;
+}
+
+unsigned int
+ScanFilter::filters()
+{
+	return this->enabledFilters;
+}
+
+void
+ScanFilter::setFilters( unsigned int filters )
+{
+	this->enabledFilters = filters;
+}
+
+void
+ScanFilter::setMedianWindow( unsigned int window )
+{
+	if ( window % 2 == 0 ) window++;
+	if ( window > SCANFILTER_MEDIAN_MAX_WINDOW ) window = SCANFILTER_MEDIAN_MAX_WINDOW;
+	this->medianWindow = window;
+}
+
+void
+ScanFilter::setDecimation( unsigned int factor )
+{
+	this->decimation = ( factor > 0 ) ? factor : 1;
+}
+
+void
+ScanFilter::apply(
+		std::vector<float> & ranges,
+		float & angleIncrement,
+		float rangeMin,
+		float rangeMax )
+{
+	if ( ranges.empty() ) return;
+
+	if ( this->enabledFilters & SCANFILTER_RANGE_GATE )
+		this->rangeGate( ranges, rangeMin, rangeMax );
+
+	if ( this->enabledFilters & SCANFILTER_MEDIAN )
+		this->median( ranges, rangeMin );
+
+	if ( this->enabledFilters & SCANFILTER_SHADOW )
+		this->shadow( ranges, angleIncrement, rangeMin );
+
+	if ( this->enabledFilters & SCANFILTER_DECIMATE )
+		this->decimate( ranges, angleIncrement );
+}
+
+bool
+ScanFilter::isValid( float range )
+{
+	return range > SCANFILTER_INVALID_RANGE;
+}
+
+
+// Private functions
+
+void
+ScanFilter::rangeGate( std::vector<float> & ranges, float rangeMin, float rangeMax )
+{
+	float * r = ranges.data();
+	unsigned int n = ranges.size();
+
+	for ( unsigned int i = 0; i < n; i++ )
+		r[ i ] = ( r[ i ] >= rangeMin && r[ i ] <= rangeMax ) ? r[ i ] : SCANFILTER_INVALID_RANGE;
+}
+
+void
+ScanFilter::median( std::vector<float> & ranges, float rangeMin )
+{
+	// The original values of the ranges behind the current one are kept in
+	// history, as they are overwritten
+	float
+		history[ SCANFILTER_MEDIAN_MAX_WINDOW ],
+		window[ SCANFILTER_MEDIAN_MAX_WINDOW ];
+
+	unsigned int
+		n = ranges.size(),
+		half = this->medianWindow / 2;
+
+	for ( unsigned int i = 0; i < n; i++ )
+	{
+		float original = ranges[ i ];
+		unsigned int count = 0;
+
+		// Collect the valid ranges of the window, sorted by insertion
+		for ( unsigned int k = 0; k < this->medianWindow; k++ )
+		{
+			if ( k < half && i + k < half ) continue;
+			unsigned int j = i + k - half;
+			if ( j >= n ) break;
+
+			float value = ( j < i ) ? history[ j % SCANFILTER_MEDIAN_MAX_WINDOW ] : ranges[ j ];
+			if ( ! ScanFilter::isValid( value ) || value < rangeMin ) continue;
+
+			unsigned int position = count++;
+			while ( position > 0 && window[ position - 1 ] > value )
+			{
+				window[ position ] = window[ position - 1 ];
+				position--;
+			}
+			window[ position ] = value;
+		}
+
+		history[ i % SCANFILTER_MEDIAN_MAX_WINDOW ] = original;
+
+		// Invalid ranges are kept invalid
+		if ( ScanFilter::isValid( original ) && original >= rangeMin )
+			ranges[ i ] = window[ count / 2 ];
+	}
+}
+
+void
+ScanFilter::shadow( std::vector<float> & ranges, float angleIncrement, float rangeMin )
+{
+	unsigned int n = ranges.size();
+	if ( n < 2 ) return;
+
+	// For two neighbouring points, the angle at the farther point between its
+	// beam and the line to the nearer point is
+	// atan2( near * sin( inc ), far - near * cos( inc ) ).
+	// Comparing the tangents avoids calculating atan2 for each point.
+	float
+		sinIncrement = sin( fabs( angleIncrement ) ),
+		cosIncrement = cos( angleIncrement ),
+		tanMinAngle = tan( SCANFILTER_SHADOW_MIN_ANGLE );
+
+	const float * r = ranges.data();
+
+	this->shadowMarks.assign( n, 0 );
+	unsigned char * marks = this->shadowMarks.data();
+
+	for ( unsigned int i = 1; i < n; i++ )
+	{
+		float
+			a = r[ i - 1 ],
+			b = r[ i ],
+			near = ( a < b ) ? a : b,
+			far = ( a < b ) ? b : a;
+
+		unsigned char isShadow =
+			( near > SCANFILTER_INVALID_RANGE ) & ( near >= rangeMin )
+			& ( ( near * sinIncrement ) < ( ( far - ( near * cosIncrement ) ) * tanMinAngle ) );
+
+		// Only the farther point is the shadow, the nearer is the edge
+		marks[ i - 1 ] |= isShadow & ( a > b );
+		marks[ i ] |= isShadow & ( b >= a );
+	}
+
+	float * w = ranges.data();
+	for ( unsigned int i = 0; i < n; i++ )
+		w[ i ] = marks[ i ] ? SCANFILTER_INVALID_RANGE : w[ i ];
+}
+
+void
+ScanFilter::decimate( std::vector<float> & ranges, float & angleIncrement )
+{
+	if ( this->decimation <= 1 ) return;
+
+	unsigned int
+		n = ranges.size(),
+		kept = 0;
+
+	for ( unsigned int i = 0; i < n; i += this->decimation )
+		ranges[ kept++ ] = ranges[ i ];
+
+	ranges.resize( kept );
+	angleIncrement *= this->decimation;
+}
@@ -3,25 +3,29 @@
 #include "headers/Axon.h"
 #include "headers/Brain.h"
 #include "headers/_Odometry.h"
+#include "headers/CbhaPatterns.h"
 
 #include "../kinect/KinectReader.h"
 
-#include "../geometry/Vector.h"
-
 #include <rec/robotino/api2/CompactBHA.h>
-#include <rec/robotino/api2/CompactBHASimple.h>
 
 #include <stdlib.h>
-#include <unistd.h>	// usleep
 #include <iostream>
 #include <iomanip>
-#include <list>
 #include <math.h>	// fabs
+#include <chrono>
+#include <mutex>
+#include <condition_variable>
+
 
+static_assert( ( CBHA_EVENT_TOUCH | CBHA_EVENT_RECIEVE | CBHA_EVENT_DELIVER ) == ( 1u << CBHA_EVENT_COUNT ) - 1,
+		"The CBHA_EVENT_ flags must be the bits below CBHA_EVENT_COUNT" );
 
 _CompactBha::_CompactBha( Brain * pBrain )
 	: rec::robotino::api2::CompactBHA::CompactBHA()
 	  , Axon::Axon( pBrain )
+	  , bellows( CBHA_PRESSURE_MAX_ADJUST * 1000.0 / BRAIN_LOOP_TIME )
+	  , patterns( CBHA_SIGNAL_COUNT )
 {
 	float bellowReadings[ CBHA_BELLOWS_COUNT ];
 	this->pressures( & bellowReadings[ 0 ] );
@@ -30,7 +34,8 @@ _CompactBha::_CompactBha( Brain * pBrain )
 		this->appliedPressures[ i ] = 0.0;
 		this->targetPressures[ i ] = 0.0;
 		this->readPressures[ i ] = bellowReadings[ i ];
-		this->pressureDeltas[ i ].assign( CBHA_DELTA_DEPTH, 0.0 );
+		this->cyclePressures[ i ] = bellowReadings[ i ];
+		this->pressureDeltas[ i ].fill( 0.0 );
 	}
 
 	float potReadings[ CBHA_STRINGPOTS_COUNT ];
@@ -38,11 +43,14 @@ _CompactBha::_CompactBha( Brain * pBrain )
 	for ( unsigned int i = 0; i < CBHA_STRINGPOTS_COUNT; i++ )
 	{
 		this->readPots[ i ] = potReadings[ i ];
-		this->potDeltas[ i ].assign( CBHA_DELTA_DEPTH, 0.0 );
+		this->cyclePots[ i ] = potReadings[ i ];
+		this->potDeltas[ i ].fill( 0.0 );
 	}
+	this->kinematics.update( potReadings );
 
 	this->readFoilPot = this->foilPot();
-	this->foilPotDeltas.assign( CBHA_DELTA_DEPTH, 0.0 );
+	this->cycleFoilPot = this->readFoilPot;
+	this->foilPotDeltas.fill( 0.0 );
 
 //	this->largestPressureDelta = 0.0;
 //	this->largestPotDelta = 0.0;
@@ -55,16 +63,20 @@ _CompactBha::_CompactBha( Brain * pBrain )
 	this->isGripping = false;
 	this->isReleasing = false;
 
-	this->pressuresUpdated = false;
-	this->potsUpdated = false;
-	this->foilPotUpdated = false;
-	
 	this->armPressureRequired = false;
+	this->rotatePressureRequired = false;
 	
 	this->touchDetected = false;
 	this->recieveDetected = false;
 	this->deliverDetected = false;
 
+	this->recording = false;
+	this->playing = false;
+	this->playbackPending = false;
+	this->recordStartTime = 0;
+	this->playbackStartTime = 0;
+	this->playbackCursor = 0;
+
 	this->pressuresUpdateTime = 0;
 	this->potsUpdateTime = 0;
 	this->foilPotUpdateTime = 0;
@@ -72,40 +84,40 @@ _CompactBha::_CompactBha( Brain * pBrain )
 	this->releaseDoneTime = 0;
 
 	this->maxArmSpeed = CBHA_PRESSURE_MAX_ADJUST;
+
+	for ( unsigned int i = 0; i < CBHA_EVENT_COUNT; i++ )
+		this->eventCounts[ i ] = 0;
+	this->touchCoordinateCount = 0;
+	this->touchWaiters = 0;
+
+	for ( unsigned int i = 0; i < CBHA_SIGNAL_COUNT; i++ )
+		this->signals[ i ] = 0.0;
+	this->definePatterns();
 }
 
 void
 _CompactBha::analyze()
 {
-		// Insert 0.0 delta values if no new data was recieved
-	if ( ! pressuresUpdated )
-		for ( unsigned int i = 0; i < CBHA_BELLOWS_COUNT; i++ )
-		{
-			pressureDeltas[ i ].pop_back();
-			pressureDeltas[ i ].push_front( 0.0 );
-		}
-//	else
-//		this->printLatestDeltas( this->pressureDeltas, CBHA_BELLOWS_COUNT );
-
-	if ( ! potsUpdated )
-		for ( unsigned int i = 0; i < CBHA_STRINGPOTS_COUNT; i++ )
-		{
-			potDeltas[ i ].pop_back();
-			potDeltas[ i ].push_front( 0.0 );
-		}
-//	else
-//		this->printLatestDeltas( this->potDeltas, CBHA_STRINGPOTS_COUNT );
+		// Insert one delta value per cycle, the change since the previous
+		// cycle, which is 0.0 if no new data was recieved. The events may
+		// come several times per cycle, so the windows always span
+		// CBHA_DELTA_DEPTH cycles.
+	for ( unsigned int i = 0; i < CBHA_BELLOWS_COUNT; i++ )
+	{
+		this->pressureDeltas[ i ].push( this->readPressures[ i ] - this->cyclePressures[ i ] );
+		this->cyclePressures[ i ] = this->readPressures[ i ];
+	}
+//	this->printLatestDeltas( this->pressureDeltas, CBHA_BELLOWS_COUNT );
 
-	if ( ! foilPotUpdated )
+	for ( unsigned int i = 0; i < CBHA_STRINGPOTS_COUNT; i++ )
 	{
-		foilPotDeltas.pop_back();
-		foilPotDeltas.push_front( 0.0 );
+		this->potDeltas[ i ].push( this->readPots[ i ] - this->cyclePots[ i ] );
+		this->cyclePots[ i ] = this->readPots[ i ];
 	}
+//	this->printLatestDeltas( this->potDeltas, CBHA_STRINGPOTS_COUNT );
 
-	// Reset updated-flags for next iteration
-	this->pressuresUpdated = false;
-	this->potsUpdated = false;
-	this->foilPotUpdated = false;
+	this->foilPotDeltas.push( this->readFoilPot - this->cycleFoilPot );
+	this->cycleFoilPot = this->readFoilPot;
 
 	// Reset detection flags for this iteration
 	this->touchDetected = false;
@@ -114,18 +126,12 @@ _CompactBha::analyze()
 	this->armPressureRequired = false;
 
 
-	// Calculate new pressures from targetPressures
-	for ( unsigned int i = 0; i < CBHA_BELLOWS_COUNT - 2; i++ )
-	{
-		float diff = this->targetPressures[ i ] - this->readPressures[ i ];
-		if ( fabs( diff ) < maxArmSpeed )
-			this->appliedPressures[ i ] = this->targetPressures[ i ];
-		else if ( diff > 0 )
-			this->appliedPressures[ i ] = this->readPressures[ i ] + maxArmSpeed;
-		else // diff < 0
-			this->appliedPressures[ i ] = this->readPressures[ i ] - maxArmSpeed;
-	}
-	
+	// Target pressures are set by the trajectory being played, if any
+	this->stepTrajectories();
+
+	// Pressures for the arm are applied by the bellows controller, on each
+	// pressure reading (see pressuresChangedEvent())
+
 	// Pressures for rotation are applied directly (for now anyways)
 	this->appliedPressures[ 6 ] = this->targetPressures[ 6 ];
 	this->appliedPressures[ 7 ] = this->targetPressures[ 7 ];
@@ -133,7 +139,8 @@ _CompactBha::analyze()
 	// Check if arm or rotation is active (pressure required)
 	for ( unsigned int i = 0; i < CBHA_BELLOWS_COUNT - 2; i++ ) // Don't care about rotation
 	{
-		if ( appliedPressures[ i ] > CBHA_PRESSURE_REQUIRED_THRESHOLD )
+		if ( appliedPressures[ i ] > CBHA_PRESSURE_REQUIRED_THRESHOLD
+				|| targetPressures[ i ] > CBHA_PRESSURE_REQUIRED_THRESHOLD )
 		{
 			this->armPressureRequired = true;
 //			std::cout
@@ -148,99 +155,45 @@ _CompactBha::analyze()
 
 		// Start actual analysis, detect arm "events"
 
-	// Detect if arm is moving because of pressure difference (between read and set)
-	bool armActivity = false;
-	for ( unsigned int i = 0; i < CBHA_BELLOWS_COUNT - 2; i++ ) // Don't care about rotation
-	{
-		double diff = fabs( readPressures[ i ] - targetPressures[ i ] );
-		if ( diff > CBHA_ARM_ACTIVITY_THRESHOLD )
-		{
-			armActivity = true;
-//			std::cout
-//				<< "CompactBha: Arm activity threshold! - Diffs"
-//			    << " ("	<< i << ": "
-//				<< readPressures[ i ] << " - "
-//				<< targetPressures[ i ] << " = "
-//				<< diff << " )"
-//				<< std::endl;
-			break;
-		}
-		else
-		{
-			double pressureDeltaSum = this->floatListSum( & this->pressureDeltas[ i ] );
-			pressureDeltaSum /= CBHA_DELTA_DEPTH;
-			if ( fabs( pressureDeltaSum ) > CBHA_ARM_ACTIVITY_DELTAS_THRESHOLD )
-			{
-				armActivity = true;
-//				std::cout
-//					<< "CompactBha: Arm activity threshold! - Deltas"
-//					<< " ("	<< i << ": "
-//					<< pressureDeltaSum
-//					<< " > " << CBHA_ARM_ACTIVITY_DELTAS_THRESHOLD
-//					<< " )"
-//					<< std::endl;
-				break;
-			}
-		}
-	}
+	this->updateSignals();
+	unsigned int fired = this->patterns.evaluate( this->signals, this->brain()->msecsElapsed() );
 
-	// If arm is not moving, look for interaction triggers
-	if ( ! armActivity )
+	// Detect if arm is pushed down (given object) and if gripping action is allowed
+	if ( fired & ( 1u << this->recievePattern ) )
 	{
-		// Calculate arm up/down motion
-		double down = this->floatListSum( & this->potDeltas[ CBHA_INNER_OVER ] );
-		down += this->floatListSum( & this->potDeltas[ CBHA_OUTER_OVER ] );
-		down /= CBHA_DELTA_DEPTH;
-
-		// Detect if arm is pushed down (given object) and if gripping action is allowed
-		if ( ! this->_isHolding
-				&& ! this->isGripping
-				&& ( this->brain()->msecsElapsed() > this->releaseDoneTime )
-				&& down > ( CBHA_GRIP_THRESHOLD ) )
-		{
-			std::cout
-				<< "CompactBha: Recieve!"
-				<< " ( " << down << " > " << CBHA_GRIP_THRESHOLD << " )"
-				<< std::endl;
+		std::cout
+			<< "CompactBha: Recieve!"
+			<< " ( " << this->signals[ CBHA_SIGNAL_DOWN ] << " > " << CBHA_GRIP_THRESHOLD << " )"
+			<< std::endl;
 
-			this->recieveDetected = true;
-			this->touchDetected = true;
-		}
+		this->recieveDetected = true;
+		this->touchDetected = true;
+	}
 
-		// Detect if arm is lifted (object is taken)
-		if ( this->_isHolding
-				&& ! this->isReleasing
-				&& ( down < CBHA_RELEASE_THRESHOLD ) )
-		{
-			std::cout
-				<< "CompactBha: Release!"
-				<< " ( " << down << " < " << CBHA_RELEASE_THRESHOLD << " )"
-				<< std::endl;
+	// Detect if arm is lifted (object is taken)
+	if ( fired & ( 1u << this->deliverPattern ) )
+	{
+		std::cout
+			<< "CompactBha: Release!"
+			<< " ( " << this->signals[ CBHA_SIGNAL_DOWN ] << " < " << CBHA_RELEASE_THRESHOLD << " )"
+			<< std::endl;
 
-			this->deliverDetected = true;
-			this->touchDetected = true;
-		}
+		this->deliverDetected = true;
+		this->touchDetected = true;
+	}
 
-		// If not already detected, check if touched (for calibration)
-		if ( ! this->touchDetected )
-		{
-			for ( unsigned int i = 0; i < CBHA_STRINGPOTS_COUNT / 2 ; i++ )
-			{
-				double motionSum = fabs( this->potDeltas[ i ].front() + this->potDeltas[ i + 3 ].front() );
-				if ( motionSum > CBHA_TOUCHED_THRESHOLD )
-				{
-					std::cout
-						<< "CompactBha: Touched!"
-						<< " ( pots " << i << '+' << i+3 << " = " << motionSum << " )"
-						<< std::endl;
-
-					this->touchDetected = true;
-				}
-			}
-		}
+	// If not already detected, check if touched (for calibration)
+	if ( ! this->touchDetected && ( fired & ( 1u << this->touchPattern ) ) )
+	{
+		std::cout
+			<< "CompactBha: Touched!"
+			<< " ( " << this->signals[ CBHA_SIGNAL_TOUCH ] << " > " << CBHA_TOUCHED_THRESHOLD << " )"
+			<< std::endl;
 
-		/// @todo Detect more cBHA patterns?
+		this->touchDetected = true;
 	}
+
+	this->publishEvents();
 }
 
 void
@@ -250,14 +203,13 @@ _CompactBha::apply()
 	if ( this->deliverDetected ) this->release();
 	if ( this->touchDetected )
 	{
-		if ( this->waitForTouch )
+		// Touches are used by a waiting thread instead, if any
+		bool touchWaited;
 		{
-			int i = 0;
-			while ( i++ < 5 && this->waitForTouch )
-				usleep( 5000 );
+			std::lock_guard<std::mutex> lock( this->eventMutex );
+			touchWaited = ( this->touchWaiters > 0 );
 		}
-		else
-			this->calibrateOdometry();
+		if ( ! touchWaited ) this->calibrateOdometry();
 	}
 	
 	// Check if gripping is in progress, and if so if it is done
@@ -266,6 +218,9 @@ _CompactBha::apply()
 		this->setGripperValve1( false ); // Close intake-valve
 		this->isGripping = false;
 		this->_isHolding = true;
+
+		// A deliver needs a new hold, not one started before the grip
+		this->patterns.reset();
 	}
 
 	// Check if releasing is in progress, and if so if it is done
@@ -347,7 +302,7 @@ _CompactBha::rotateRelax()
 void
 _CompactBha::innerToCoordinate( float x, float y )
 {
-	rec::robotino::api2::CompactBHASimple::xy2pressure(
+	this->pressureTable.lookup(
 			x,
 			y,
 			& this->targetPressures[ CBHA_INNER_OVER ],
@@ -365,7 +320,7 @@ _CompactBha::innerToCoordinate( Coordinate c )
 void
 _CompactBha::outerToCoordinate( float x, float y )
 {
-	rec::robotino::api2::CompactBHASimple::xy2pressure(
+	this->pressureTable.lookup(
 			x,
 			y,
 			& this->targetPressures[ CBHA_OUTER_OVER ],
@@ -380,6 +335,12 @@ _CompactBha::outerToCoordinate( Coordinate c )
 	this->outerToCoordinate( c.x(), c.y() );
 }
 
+const CbhaPressureTable *
+_CompactBha::armPressureTable()
+{
+	return & this->pressureTable;
+}
+
 void
 _CompactBha::armRelax()
 {
@@ -400,29 +361,95 @@ _CompactBha::setMaxArmSpeed( float maxAdjustPerCycle )
 		this->maxArmSpeed = CBHA_PRESSURE_MIN_ADJUST;
 	else
 		this->maxArmSpeed = maxAdjustPerCycle;
+
+	this->bellows.setMaxRate( this->maxArmSpeed * 1000.0 / BRAIN_LOOP_TIME );
 }
 
 VolumeCoordinate
 _CompactBha::getTouchCoordinate()
 {
-	this->waitForTouch = true;
+	std::unique_lock<std::mutex> lock( this->eventMutex );
+
+	this->touchWaiters++;
+	unsigned long count = this->touchCoordinateCount;
+	while ( this->touchCoordinateCount == count )
+		this->eventCondition.wait( lock );
+	this->touchWaiters--;
+
+	return this->touchCoordinate;
+}
+
+unsigned long
+_CompactBha::watchTouch()
+{
+	std::lock_guard<std::mutex> lock( this->eventMutex );
+
+	this->touchWaiters++;
+	return this->touchCoordinateCount;
+}
+
+bool
+_CompactBha::pollTouchCoordinate( unsigned long ticket, VolumeCoordinate & coordinate )
+{
+	std::lock_guard<std::mutex> lock( this->eventMutex );
+
+	if ( this->touchCoordinateCount == ticket ) return false;
+
+	this->touchWaiters--;
+	coordinate = this->touchCoordinate;
+	return true;
+}
+
+void
+_CompactBha::unwatchTouch()
+{
+	std::lock_guard<std::mutex> lock( this->eventMutex );
 
-	VolumeCoordinate touchPos;
+	if ( this->touchWaiters > 0 ) this->touchWaiters--;
+}
+
+unsigned int
+_CompactBha::waitForEvents( unsigned int events, unsigned int timeoutMsecs )
+{
+	std::unique_lock<std::mutex> lock( this->eventMutex );
+
+	unsigned long counts[ CBHA_EVENT_COUNT ];
+	for ( unsigned int i = 0; i < CBHA_EVENT_COUNT; i++ )
+		counts[ i ] = this->eventCounts[ i ];
+
+	std::chrono::steady_clock::time_point deadline =
+		std::chrono::steady_clock::now() + std::chrono::milliseconds( timeoutMsecs );
 
 	while ( true )
 	{
-		while ( ! this->touchDetected ) usleep( 5000 );
+		unsigned int detected = 0;
+		for ( unsigned int i = 0; i < CBHA_EVENT_COUNT; i++ )
+			if ( ( events & ( 1u << i ) ) && this->eventCounts[ i ] != counts[ i ] )
+				detected |= ( 1u << i );
 
-		if ( this->brain()->kinect()->isUpdated()
-			&& this->brain()->kinect()->dataAge() < 100 )
-		{
-			touchPos = this->brain()->kinect()->getCoordinate();
-			break;
-		}
+		if ( detected ) return detected;
+
+		if ( timeoutMsecs == 0 )
+			this->eventCondition.wait( lock );
+		else if ( this->eventCondition.wait_until( lock, deadline ) == std::cv_status::timeout )
+			return 0;
 	}
+}
 
-	this->waitForTouch = false;
-	return touchPos;
+VolumeCoordinate
+_CompactBha::gripperPosition()
+{
+	if ( ! CBHA_USE_KINEMATICS )
+		return VolumeCoordinate( CBHA_ARM_RELAXED_DISTANCE_FROM_CENTER, 0.0, 0.0 );
+
+	return this->kinematics.gripperPosition();
+}
+
+float
+_CompactBha::gripperReach()
+{
+	VolumeCoordinate gripper = this->gripperPosition();
+	return sqrt( ( gripper.x() * gripper.x() ) + ( gripper.y() * gripper.y() ) );
 }
 
 float
@@ -435,6 +462,62 @@ _CompactBha::armTotalPressureDiff()
 	return (float) sum;
 }
 
+void
+_CompactBha::bellowsPressures( float * read, float * target )
+{
+	for ( unsigned int i = 0; i < CBHA_BELLOWS_COUNT; i++ )
+	{
+		read[ i ] = this->readPressures[ i ];
+		target[ i ] = this->targetPressures[ i ];
+	}
+}
+
+void
+_CompactBha::settlingToString( std::ostream & out )
+{
+	this->bellows.metricsToString( out );
+}
+
+void
+_CompactBha::startRecording()
+{
+	std::lock_guard<std::mutex> lock( this->trajectoryMutex );
+	this->recordedTrajectory.clear();
+	this->recording = true;
+}
+
+CbhaTrajectory
+_CompactBha::stopRecording()
+{
+	std::lock_guard<std::mutex> lock( this->trajectoryMutex );
+	this->recording = false;
+	return this->recordedTrajectory;
+}
+
+void
+_CompactBha::play( const CbhaTrajectory & trajectory )
+{
+	std::lock_guard<std::mutex> lock( this->trajectoryMutex );
+	this->playbackTrajectory = trajectory;
+	this->playing = false;
+	this->playbackPending = true;
+}
+
+void
+_CompactBha::stopPlayback()
+{
+	std::lock_guard<std::mutex> lock( this->trajectoryMutex );
+	this->playing = false;
+	this->playbackPending = false;
+}
+
+bool
+_CompactBha::isPlaying()
+{
+	std::lock_guard<std::mutex> lock( this->trajectoryMutex );
+	return this->playing || this->playbackPending;
+}
+
 /*
 //	This function is a part of a functionality to observe deltas, it has done
 //	it's job, but is kept commented out as a convenience for future developers
@@ -451,14 +534,23 @@ void _CompactBha::resetDeltas()
 void
 _CompactBha::pressuresChangedEvent( const float * pressures, unsigned int size )
 {
-	for ( unsigned int i = 0; i < size; i++ )
-	{
-		this->pressureDeltas[ i ].pop_back();
-		this->pressureDeltas[ i ].push_front( pressures[ i ] - this->readPressures[ i ] );
+	for ( unsigned int i = 0; i < size && i < CBHA_BELLOWS_COUNT; i++ )
 		this->readPressures[ i ] = pressures[ i ];
-	}
-	this->pressuresUpdated = true;
 	this->pressuresUpdateTime = this->brain()->msecsElapsed();
+
+	if ( size < BELLOWSCONTROLLER_CHANNELS ) return;
+
+	// Step the bellows controller with the new readings, and apply the result
+	// immediately instead of waiting for the next Brain cycle
+	for ( unsigned int i = 0; i < BELLOWSCONTROLLER_CHANNELS; i++ )
+		this->bellows.setTarget( i, this->targetPressures[ i ], this->pressuresUpdateTime );
+
+	this->bellows.update( pressures, this->pressuresUpdateTime );
+
+	for ( unsigned int i = 0; i < BELLOWSCONTROLLER_CHANNELS; i++ )
+		this->appliedPressures[ i ] = this->bellows.output( i );
+
+	this->setPressures( this->appliedPressures );
 }
  
 void
@@ -470,23 +562,16 @@ _CompactBha::pressureSensorChangedEvent( bool pressureSensor )
 void
 _CompactBha::stringPotsChangedEvent( const float * readings, unsigned int size )
 {
-	for ( unsigned int i = 0; i < size; i++ )
-	{
-		this->potDeltas[ i ].pop_back();
-		this->potDeltas[ i ].push_front( readings[ i ] - this->readPots[ i ] );
+	for ( unsigned int i = 0; i < size && i < CBHA_STRINGPOTS_COUNT; i++ )
 		this->readPots[ i ] = readings[ i ];
-	}
-	this->potsUpdated = true;
+	if ( size >= CBHA_STRINGPOTS_COUNT ) this->kinematics.update( readings );
 	this->potsUpdateTime = this->brain()->msecsElapsed();
 }
 
 void
 _CompactBha::foilPotChangedEvent( float value )
 {
-	this->foilPotDeltas.pop_back();
-	this->foilPotDeltas.push_front( value - this->readFoilPot );
 	this->readFoilPot = value;
-	this->foilPotUpdated = true;
 	this->foilPotUpdateTime = this->brain()->msecsElapsed();
 }
 
@@ -566,9 +651,15 @@ _CompactBha::calibrateOdometry()
 	// calculate new center position based on kinect coordinate and arm position
 	AngularCoordinate odomPosition = this->brain()->odom()->getPosition();
 
-	/// @todo Project suggestion: Precice position of cBHA gripper derived from potmeters
-	Vector cbhaVector( CBHA_ARM_RELAXED_DISTANCE_FROM_CENTER, odomPosition.phi() );
-	Coordinate cbhaVectorCartesian = cbhaVector.cartesian();
+	// Rotate the gripper position from Robotinos heading to the odometry
+	// coordinate system
+	VolumeCoordinate gripper = this->gripperPosition();
+	float
+		phiCos = cos( odomPosition.phi() ),
+		phiSin = sin( odomPosition.phi() );
+	Coordinate cbhaVectorCartesian(
+			( gripper.x() * phiCos ) - ( gripper.y() * phiSin ),
+			( gripper.x() * phiSin ) + ( gripper.y() * phiCos ) );
 	
 	Coordinate newPosition =
 		Coordinate(
@@ -588,7 +679,7 @@ _CompactBha::calibrateOdometry()
 			<< "CompactBha: Calibration aborted, coordinate deviation too large: ["
 			<< deltaX << ',' << deltaY << "] (max: "
 			<< CBHA_CALIBRATE_MAX_XY_DEVIATION << ')'
-			<< "\n\tcBha correction: " << cbhaVector.cartesian()
+			<< "\n\tcBha correction: " << cbhaVectorCartesian
 			<< std::endl;
 		return;
 	}
@@ -602,9 +693,104 @@ _CompactBha::calibrateOdometry()
 	this->brain()->odom()->set( newPosition.x(), newPosition.y(), odomPosition.phi() );
 }
 
+void
+_CompactBha::definePatterns()
+{
+	int ids[ CBHA_EVENT_COUNT ];
+	CbhaPatterns::define( this->patterns, ids );
+
+	this->touchPattern = ids[ 0 ];
+	this->recievePattern = ids[ 1 ];
+	this->deliverPattern = ids[ 2 ];
+}
+
+void
+_CompactBha::updateSignals()
+{
+	CbhaPatterns::signals(
+			this->readPressures,
+			this->targetPressures,
+			this->pressureDeltas,
+			this->potDeltas,
+			! this->_isHolding
+				&& ! this->isGripping
+				&& ( this->brain()->msecsElapsed() > this->releaseDoneTime ),
+			this->_isHolding && ! this->isReleasing,
+			this->signals );
+}
+
+void
+_CompactBha::publishEvents()
+{
+	unsigned int events =
+		( this->touchDetected ? CBHA_EVENT_TOUCH : 0 )
+		| ( this->recieveDetected ? CBHA_EVENT_RECIEVE : 0 )
+		| ( this->deliverDetected ? CBHA_EVENT_DELIVER : 0 );
+
+	if ( ! events ) return;
+
+	{
+		std::lock_guard<std::mutex> lock( this->eventMutex );
+
+		// Counted by bit number, as read by waitForEvents()
+		for ( unsigned int i = 0; i < CBHA_EVENT_COUNT; i++ )
+			if ( events & ( 1u << i ) ) this->eventCounts[ i ]++;
+
+		// Store the Kinect coordinate of the touch for getTouchCoordinate()
+		if ( this->touchDetected
+				&& this->touchWaiters > 0
+				&& this->brain()->kinectIsAvailable()
+				&& this->brain()->kinect()->dataAge() < CBHA_TOUCH_COORD_MAX_AGE )
+		{
+			this->touchCoordinate = this->brain()->kinect()->getCoordinate();
+			this->touchCoordinateCount++;
+		}
+	}
+
+	this->eventCondition.notify_all();
+}
+
+void
+_CompactBha::stepTrajectories()
+{
+	std::lock_guard<std::mutex> lock( this->trajectoryMutex );
+	unsigned int now = this->brain()->msecsElapsed();
+
+	if ( this->playbackPending )
+	{
+		this->playbackPending = false;
+		this->playing = true;
+		this->playbackStartTime = now;
+		this->playbackCursor = 0;
+	}
+
+	if ( this->playing )
+	{
+		unsigned int time = now - this->playbackStartTime;
+		if ( this->playbackTrajectory.sample( time, this->targetPressures, this->playbackCursor ) )
+		{
+			this->rotatePressureRequired =
+				this->targetPressures[ CBHA_ROTATE_HORISONTAL ] > CBHA_PRESSURE_REQUIRED_THRESHOLD
+				|| this->targetPressures[ CBHA_ROTATE_VERTICAL ] > CBHA_PRESSURE_REQUIRED_THRESHOLD;
+		}
+
+		if ( time >= this->playbackTrajectory.duration() )
+		{
+			this->playing = false;
+			std::cout << "CompactBha: Playback completed" << std::endl;
+		}
+	}
+
+	if ( this->recording )
+	{
+		if ( this->recordedTrajectory.frames() == 0 ) this->recordStartTime = now;
+		this->recordedTrajectory.addFrame( now - this->recordStartTime, this->targetPressures );
+	}
+}
+
 void
 _CompactBha::printLatestDeltas(
-		std::list<float> array[],
+		const RingWindow<float, CBHA_DELTA_DEPTH> array[],
 		unsigned int size,
 		unsigned int precision,
 		unsigned int width	) const
@@ -617,23 +803,12 @@ _CompactBha::printLatestDeltas(
 	{
 		std::cout
 			<< "  [" << i << "]"
-			<< std::setw( width ) << array[ i ].front()
+			<< std::setw( width ) << array[ i ].latest()
 			<< " ";
 	}
 	std::cout << std::endl;
 }
 
-double
-_CompactBha::floatListSum( std::list<float> * list ) const
-{
-	double result = 0.0;
-
-	for ( std::list<float>::iterator it = list->begin(); it != list->end(); ++it )
-		result += *it;
-
-	return result;
-}
-
 /*
 //	This function is a part of a functionality to observe deltas, it has done
 //	it's job, but is kept commented out as a convenience for future developers
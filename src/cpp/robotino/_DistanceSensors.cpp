@@ -2,6 +2,7 @@
 
 #include "headers/Axon.h"
 #include "headers/Brain.h"
+#include "headers/ObstacleIndex.h"
 
 #include "../geometry/Angle.h"
 
@@ -23,15 +24,48 @@ _DistanceSensors::_DistanceSensors( Brain * pBrain )
 		for ( unsigned int i = 0; i < DISTANCESENSORS_COUNT; i++ )
 		{
 			this->readDistances[ i ] = 0.0f;
+			this->histogram[ i ] = DISTANCESENSORS_MAX_RANGE;
+
+			this->sensorAngles[ i ] = Angle( ( ( 2 * M_PI ) / DISTANCESENSORS_COUNT ) * i );
+			this->sectorFrom[ i ] = this->sensorAngles[ i ].phi() - DISTANCESENSORS_SECTOR_HALF_ANGLE;
+			this->sectorTo[ i ] = this->sensorAngles[ i ].phi() + DISTANCESENSORS_SECTOR_HALF_ANGLE;
 		}
 
 		this->distancesUpdated = false;
+		this->updateTime = 0;
 }
 
 void
 _DistanceSensors::analyze()
 {
-	/// @todo Not yet implemented
+	if ( ! this->distancesUpdated ) return;
+
+	ObstacleIndex * obstacles = this->brain()->obstacles();
+	obstacles->clear( OBSTACLEINDEX_SOURCE_DISTANCESENSORS );
+
+	for ( unsigned int i = 0; i < DISTANCESENSORS_COUNT; i++ )
+	{
+		float distance = this->readDistances[ i ];
+		if ( distance > DISTANCESENSORS_MAX_RANGE ) distance = DISTANCESENSORS_MAX_RANGE;
+
+		// Follow approaching obstacles faster than receding ones
+		float factor = ( distance < this->histogram[ i ] )
+			? DISTANCESENSORS_SMOOTHING_APPROACH
+			: DISTANCESENSORS_SMOOTHING_RECEDE;
+		this->histogram[ i ] += factor * ( distance - this->histogram[ i ] );
+
+		if ( this->histogram[ i ] >= DISTANCESENSORS_MAX_RANGE ) continue;
+
+		obstacles->insert(
+				OBSTACLEINDEX_SOURCE_DISTANCESENSORS,
+				this->sectorFrom[ i ],
+				this->sectorTo[ i ],
+				this->histogram[ i ] );
+	}
+
+	obstacles->commit( OBSTACLEINDEX_SOURCE_DISTANCESENSORS, this->updateTime );
+
+	this->distancesUpdated = false;
 }
 
 void
@@ -53,7 +87,20 @@ _DistanceSensors::sensorAngle( unsigned int sensorNo )
 	if ( sensorNo >= DISTANCESENSORS_COUNT )
 	   throw new std::out_of_range( std::string( "Specified sensorNo does not exist" ) );
 
-	return Angle( ( ( 2 * M_PI ) / 9 ) * sensorNo );
+	return this->sensorAngles[ sensorNo ];
+}
+
+float
+_DistanceSensors::obstacleDistance( float phi )
+{
+	// Shift by half a sector, so each sensor covers the directions around it
+	float sector = fmod( phi + DISTANCESENSORS_SECTOR_HALF_ANGLE, 2 * M_PI );
+	if ( sector < 0 ) sector += 2 * M_PI;
+
+	unsigned int sensorNo = (unsigned int) ( sector * ( DISTANCESENSORS_COUNT / ( 2 * M_PI ) ) );
+	if ( sensorNo >= DISTANCESENSORS_COUNT ) sensorNo = DISTANCESENSORS_COUNT - 1;
+
+	return this->histogram[ sensorNo ];
 }
 
 
@@ -2,12 +2,14 @@
 
 #include "headers/Axon.h"
 #include "headers/Brain.h"
+#include "headers/ObstacleIndex.h"
 
 #include <stdlib.h>
 #include <stdexcept>
 #include <string>
 #include <iostream>
 #include <iomanip>
+#include <math.h>
 
 
 _LaserRangeFinder::_LaserRangeFinder( Brain * pBrain ) :
@@ -16,13 +18,33 @@ _LaserRangeFinder::_LaserRangeFinder( Brain * pBrain ) :
 {
 	this->readingsUpdated = false;
 	this->updateTime = 0;
+
+	this->rangesAngleMin = 0.0;
+	this->rangesAngleIncrement = 0.0;
+	this->publishedAngleMin = 0.0;
+	this->publishedAngleIncrement = 0.0;
 }
 
 void
 _LaserRangeFinder::analyze()
 {
-	/// @todo Not yet implemented
-	
+	if ( this->readingsUpdated )
+	{
+		this->filterReadings();
+		this->updateObstacles();
+
+		this->extractor.extract(
+				this->ranges.data(),
+				this->ranges.size(),
+				this->rangesAngleMin,
+				this->rangesAngleIncrement,
+				this->latestReadings.range_min,
+				this->latestReadings.range_max,
+				LASERRANGEFINDER_OFFSET_X );
+
+		this->publishScan();
+	}
+
 	this->readingsUpdated = false;
 }
 
@@ -41,9 +63,9 @@ _LaserRangeFinder::test()
 }
 
 void
-_LaserRangeFinder::readingsToString()
+_LaserRangeFinder::readingsToString( std::ostream & out )
 {
-	std::cerr << "Seq = " << latestReadings.seq
+	out << "Seq = " << latestReadings.seq
 		<< "  Stamp = " << latestReadings.stamp
 		<< "\nAngles; min = " << latestReadings.angle_min
 		<< "  max = " << latestReadings.angle_max
@@ -52,7 +74,7 @@ _LaserRangeFinder::readingsToString()
 		<< "  Scan time = " << latestReadings.scan_time
 		<< "\nRange; min = " << latestReadings.range_min
 		<< "  max = " << latestReadings.range_max
-		<< std::cerr;
+		<< std::endl;
 
 	const float *rangev;		// Holder for rangevector
 	unsigned int rangec = 0;	// Holder for rangecount
@@ -65,13 +87,96 @@ _LaserRangeFinder::readingsToString()
 		{
 			if ( i % 50 == 0 )
 			{
-				std::cerr << std::endl;
+				out << std::endl;
 			}
 
-			std::cerr << std::setw(5) << std::setprecision( 2 ) << rangev[ i ] << "   ";
+			out << std::setw(5) << std::setprecision( 2 ) << rangev[ i ] << "   ";
 		}
 	}
-	std::cerr << std::endl;
+	out << std::endl;
+}
+
+ScanFilter *
+_LaserRangeFinder::filter()
+{
+	return & this->scanFilter;
+}
+
+std::vector<float>
+_LaserRangeFinder::filteredRanges() const
+{
+	std::lock_guard<std::mutex> lock( this->scanMutex );
+	return this->publishedRanges;
+}
+
+void
+_LaserRangeFinder::filteredScan( std::vector<float> & ranges, float & angleMin, float & angleIncrement ) const
+{
+	std::lock_guard<std::mutex> lock( this->scanMutex );
+	ranges = this->publishedRanges;
+	angleMin = this->publishedAngleMin;
+	angleIncrement = this->publishedAngleIncrement;
+}
+
+float
+_LaserRangeFinder::filteredAngleMin() const
+{
+	std::lock_guard<std::mutex> lock( this->scanMutex );
+	return this->publishedAngleMin;
+}
+
+float
+_LaserRangeFinder::filteredAngleIncrement() const
+{
+	std::lock_guard<std::mutex> lock( this->scanMutex );
+	return this->publishedAngleIncrement;
+}
+
+std::vector<ScanLine>
+_LaserRangeFinder::lines() const
+{
+	std::lock_guard<std::mutex> lock( this->scanMutex );
+	return this->publishedLines;
+}
+
+std::vector<ScanCorner>
+_LaserRangeFinder::corners() const
+{
+	std::lock_guard<std::mutex> lock( this->scanMutex );
+	return this->publishedCorners;
+}
+
+void
+_LaserRangeFinder::featuresToString( std::ostream & out )
+{
+	std::vector<ScanLine> lines;
+	std::vector<ScanCorner> corners;
+	{
+		// Copies both under one lock, so the corners index the lines
+		std::lock_guard<std::mutex> lock( this->scanMutex );
+		lines = this->publishedLines;
+		corners = this->publishedCorners;
+	}
+
+	out << "Lines: " << lines.size() << std::endl;
+	for ( unsigned int i = 0; i < lines.size(); i++ )
+	{
+		ScanLine line = lines[ i ];
+		out
+			<< "  [" << i << "] " << line.start << " -> " << line.end
+			<< "  (" << line.points << " points)"
+			<< std::endl;
+	}
+
+	out << "Corners: " << corners.size() << std::endl;
+	for ( unsigned int i = 0; i < corners.size(); i++ )
+	{
+		ScanCorner corner = corners[ i ];
+		out
+			<< "  " << corner.position << " between lines "
+			<< corner.first << " and " << corner.second
+			<< std::endl;
+	}
 }
 
 // Private functions
@@ -87,3 +192,63 @@ _LaserRangeFinder::scanEvent(
 	this->updateTime = this->brain()->msecsElapsed();
 }
 
+void
+_LaserRangeFinder::filterReadings()
+{
+	const float *rangev;		// Holder for rangevector
+	unsigned int rangec = 0;	// Holder for rangecount
+
+	this->latestReadings.ranges( &rangev, &rangec );
+
+	// Reuses the buffer, allocating only if the scan has grown
+	this->ranges.assign( rangev, rangev + rangec );
+	this->rangesAngleMin = this->latestReadings.angle_min;
+	this->rangesAngleIncrement = this->latestReadings.angle_increment;
+
+	this->scanFilter.apply(
+			this->ranges,
+			this->rangesAngleIncrement,
+			this->latestReadings.range_min,
+			this->latestReadings.range_max );
+}
+
+void
+_LaserRangeFinder::updateObstacles()
+{
+	ObstacleIndex * obstacles = this->brain()->obstacles();
+
+	obstacles->clear( OBSTACLEINDEX_SOURCE_LRF );
+
+	for ( unsigned int i = 0; i < this->ranges.size(); i++ )
+	{
+		float range = this->ranges[ i ];
+		if ( ! ScanFilter::isValid( range )
+				|| range < this->latestReadings.range_min
+				|| range > this->latestReadings.range_max )
+			continue;
+
+		// Move the point from the LaserRangeFinder to Robotinos center
+		float angle = this->rangesAngleMin + ( i * this->rangesAngleIncrement );
+		float x = LASERRANGEFINDER_OFFSET_X + ( range * cos( angle ) );
+		float y = range * sin( angle );
+
+		obstacles->insert(
+				OBSTACLEINDEX_SOURCE_LRF,
+				atan2( y, x ),
+				sqrt( ( x * x ) + ( y * y ) ) - OBSTACLEINDEX_ROBOT_RADIUS );
+	}
+
+	obstacles->commit( OBSTACLEINDEX_SOURCE_LRF, this->updateTime );
+}
+
+void
+_LaserRangeFinder::publishScan()
+{
+	std::lock_guard<std::mutex> lock( this->scanMutex );
+
+	this->publishedRanges = this->ranges;
+	this->publishedAngleMin = this->rangesAngleMin;
+	this->publishedAngleIncrement = this->rangesAngleIncrement;
+	this->publishedLines = this->extractor.lines();
+	this->publishedCorners = this->extractor.corners();
+}
@@ -3,6 +3,7 @@
 #include "headers/Axon.h"
 #include "headers/Brain.h"
 #include "headers/_Odometry.h"
+#include "headers/ObstacleIndex.h"
 
 #include "../geometry/Angle.h"
 #include "../geometry/AngularCoordinate.h"
@@ -156,6 +157,9 @@ _OmniDrive::apply()
 	this->xSpeed = this->softAccellerate( this->xSpeed, this->xOld );
 	this->ySpeed = this->softAccellerate( this->ySpeed, this->yOld );
 	this->omega = this->softAccellerate( this->omega, this->omegaOld, true );
+
+	// Limit speed by clearance to obstacles
+	this->limitByClearance();
 	
 	// Apply velocities
 //	std::cout
@@ -222,6 +226,14 @@ _OmniDrive::setVelocity( float xSpeed, float ySpeed, float omega )
 	this->targetOmega = omega < OMNIDRIVE_MAX_SPEED ? omega : OMNIDRIVE_MAX_SPEED;
 }
 
+void
+_OmniDrive::velocity( float * xSpeed, float * ySpeed, float * omega )
+{
+	* xSpeed = this->xSpeed;
+	* ySpeed = this->ySpeed;
+	* omega = this->omega;
+}
+
 
 
 // PRIVATE FUNCTIONS
@@ -317,3 +329,23 @@ _OmniDrive::softAccellerate( float newSpeed, float currentSpeed, bool isRotation
 	return newSpeed;
 }
 
+void
+_OmniDrive::limitByClearance()
+{
+	float speed = sqrt( ( this->xSpeed * this->xSpeed ) + ( this->ySpeed * this->ySpeed ) );
+	if ( speed == 0.0 ) return;
+
+	float clearance = this->brain()->obstacles()->clearance( atan2( this->ySpeed, this->xSpeed ) );
+	if ( clearance >= OMNIDRIVE_CLEARANCE_SLOW_DISTANCE ) return;
+
+	float maxSpeed = 0.0;
+	if ( clearance > OMNIDRIVE_CLEARANCE_STOP_DISTANCE )
+		maxSpeed = OMNIDRIVE_MAX_SPEED
+			* ( ( clearance - OMNIDRIVE_CLEARANCE_STOP_DISTANCE )
+				/ ( OMNIDRIVE_CLEARANCE_SLOW_DISTANCE - OMNIDRIVE_CLEARANCE_STOP_DISTANCE ) );
+
+	if ( speed <= maxSpeed ) return;
+
+	this->xSpeed *= maxSpeed / speed;
+	this->ySpeed *= maxSpeed / speed;
+}
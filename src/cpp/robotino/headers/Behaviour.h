@@ -0,0 +1,123 @@
+/**
+ * @file	Behaviour.h
+ * @brief	Header file for the Behaviour class
+ */
+#ifndef BEHAVIOUR_H
+#define BEHAVIOUR_H
+
+class Brain;
+
+	// Resources used by behaviours
+/// The destination and speed of the OmniDrive
+#define BEHAVIOUR_DRIVE	0x01
+/// The heading of the OmniDrive, see _OmniDrive::setPointAt()
+#define BEHAVIOUR_POINT	0x02
+/// The arm and gripper of the cBHA
+#define BEHAVIOUR_ARM	0x04
+/// All resources
+#define BEHAVIOUR_ALL	( BEHAVIOUR_DRIVE | BEHAVIOUR_POINT | BEHAVIOUR_ARM )
+
+
+/**
+ * Abstract class for routines running over many cycles of the Brain, like
+ * fetching an object from a hand tracked by Kinect.
+ *
+ * A behaviour is a state machine stepped by the Brain thread once per main
+ * loop cycle, after the analyzers and before the appliers, see
+ * Brain::startBehaviour(). step() must return at once: waiting is done by
+ * staying in a state until a condition is met or stateMsecs() has passed,
+ * never by sleeping. A behaviour may therefore be cancelled at any time,
+ * and behaviours using different resources run side by side.
+ */
+class Behaviour
+{
+ public:
+	/**
+	 * Constructor
+	 *
+	 * @param	pBrain	Pointer to Brain object
+	 * @param	name	The name of the behaviour, for printing
+	 * @param	resources	The resources used, a combination of the
+	 * BEHAVIOUR_ flags
+	 */
+	Behaviour( Brain * pBrain, const char * name, unsigned int resources );
+
+	virtual ~Behaviour() {}
+
+	/**
+	 * Returns the Brain pointer
+	 *
+	 * @return	Pointer to Brain
+	 */
+	Brain * brain();
+
+	/**
+	 * Gets the name of the behaviour
+	 *
+	 * @return	The name
+	 */
+	const char * name();
+
+	/**
+	 * Gets the resources used by the behaviour
+	 *
+	 * @return	A combination of the BEHAVIOUR_ flags
+	 */
+	unsigned int resources();
+
+	/**
+	 * Gets the current state
+	 *
+	 * @return	The state, 0 when started
+	 */
+	unsigned int state();
+
+	/**
+	 * Advances the behaviour, called by the Brain thread once per cycle.
+	 * Must not block.
+	 *
+	 * @return	@c false when finished, the behaviour is then deleted
+	 */
+	virtual bool step() = 0;
+
+	/**
+	 * Called by Brain instead of further steps when the behaviour is
+	 * cancelled before finishing, should leave the resources safe. May be
+	 * called from any thread, but never during step().
+	 */
+	virtual void cancel() {}
+
+ protected:
+	/**
+	 * Enters a state, restarting stateMsecs()
+	 *
+	 * @param	state	The state
+	 */
+	void setState( unsigned int state );
+
+	/**
+	 * Gets the time spent in the current state, for waiting without
+	 * sleeping
+	 *
+	 * @return	Milliseconds since the state was entered
+	 */
+	unsigned int stateMsecs();
+
+ private:
+	Brain
+		* pBrain;
+
+	const char
+	/// The name, for printing
+		* behaviourName;
+
+	unsigned int
+	/// The BEHAVIOUR_ flags of the resources used
+		usedResources,
+	/// The current state
+		currentState,
+	/// The time the current state was entered, see Brain::msecsElapsed()
+		stateStartTime;
+};
+
+#endif
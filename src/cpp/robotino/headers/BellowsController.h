@@ -0,0 +1,183 @@
+/**
+ * @file	BellowsController.h
+ * @brief	Header file for the BellowsController class
+ */
+#ifndef BELLOWSCONTROLLER_H
+#define BELLOWSCONTROLLER_H
+
+#include <ostream>
+
+
+/// The number of bellows controlled, the six bellows moving the cBHA arm
+#define BELLOWSCONTROLLER_CHANNELS	6
+
+
+	// Controller
+
+/// Proportional gain
+#define BELLOWSCONTROLLER_KP	0.6
+/// Integral gain, per second
+#define BELLOWSCONTROLLER_KI	1.5
+/// Derivative gain, in seconds
+#define BELLOWSCONTROLLER_KD	0.01
+/// Feedforward gain, the share of the reference pressure applied directly
+#define BELLOWSCONTROLLER_KFF	1.0
+/// The largest correction the integral term may contribute, in bar
+#define BELLOWSCONTROLLER_MAX_INTEGRAL	0.3
+/// The lowest pressure output, in bar
+#define BELLOWSCONTROLLER_MIN_OUTPUT	0.0
+/// The highest pressure output, in bar
+#define BELLOWSCONTROLLER_MAX_OUTPUT	1.5
+/// The longest time step used, longer steps (pauses in the readings) are
+/// limited, in milliseconds
+#define BELLOWSCONTROLLER_MAX_STEP	100
+
+
+	// Settling metrics
+
+/// A bellow is settled when its pressure is within this distance of the
+/// target, in bar
+#define BELLOWSCONTROLLER_SETTLE_TOLERANCE	0.05
+/// A bellow must stay within the tolerance this long to be settled, in
+/// milliseconds
+#define BELLOWSCONTROLLER_SETTLE_HOLD	100
+/// Target changes smaller than this do not start a new settling measurement,
+/// in bar
+#define BELLOWSCONTROLLER_SETTLE_MIN_STEP	0.1
+
+
+/**
+ * Closed loop pressure control for the bellows of the cBHA arm.
+ *
+ * Each bellow has a PID controller with feedforward. The reference pressure
+ * moves toward the target pressure at a limited rate, given in bar per
+ * second, and is applied directly as feedforward. The PID terms correct the
+ * remaining error between the reference and the measured pressure. The
+ * derivative is taken of the measurement, avoiding spikes when the target
+ * changes, and the integral is limited and frozen while the output is
+ * saturated.
+ *
+ * The controller is stepped with each new pressure reading, using the time
+ * since the previous reading, so its behaviour does not depend on the rate
+ * of the readings or the Brain loop.
+ *
+ * For each target change, the time until the bellow has settled at the
+ * target is measured.
+ *
+ * See @link BellowsController.h @endlink for documentation of @c \#define
+ * parameters
+ */
+class BellowsController
+{
+ public:
+	/**
+	 * Constructs BellowsController
+	 *
+	 * @param	maxRate	The maximum rate of change of the reference pressure,
+	 * in bar per second
+	 */
+	BellowsController( float maxRate );
+
+	/**
+	 * Sets the target pressure of a bellow
+	 *
+	 * @param	channel	The bellow, [0, BELLOWSCONTROLLER_CHANNELS)
+	 * @param	pressure	The target pressure, in bar
+	 * @param	time	The current time, in milliseconds
+	 */
+	void setTarget( unsigned int channel, float pressure, unsigned int time );
+
+	/**
+	 * Sets the maximum rate of change of the reference pressure
+	 *
+	 * @param	maxRate	The maximum rate, in bar per second
+	 */
+	void setMaxRate( float maxRate );
+
+	/**
+	 * Steps the controllers with new pressure readings. Readings with the
+	 * same time as the previous readings have no derivative, and only
+	 * update the proportional term.
+	 *
+	 * @param	measured	The measured pressures, BELLOWSCONTROLLER_CHANNELS
+	 * values
+	 * @param	time	The time of the readings, in milliseconds
+	 */
+	void update( const float * measured, unsigned int time );
+
+	/**
+	 * Gets the pressure to apply to a bellow, as calculated by the last
+	 * update()
+	 *
+	 * @param	channel	The bellow
+	 *
+	 * @return	The pressure, in bar
+	 */
+	float output( unsigned int channel ) const;
+
+	/**
+	 * Checks if all bellows have settled at their targets
+	 *
+	 * @return	@c true if settled
+	 */
+	bool settled() const;
+
+	/**
+	 * Prints the settling time metrics of each bellow
+	 *
+	 * @param	out	The stream to print to
+	 */
+	void metricsToString( std::ostream & out ) const;
+
+ private:
+	float
+	/// The target pressures
+		target[ BELLOWSCONTROLLER_CHANNELS ],
+	/// The reference pressures, moving toward the targets at a limited rate
+		reference[ BELLOWSCONTROLLER_CHANNELS ],
+	/// The integral term of each controller
+		integral[ BELLOWSCONTROLLER_CHANNELS ],
+	/// The previous measured pressures
+		previous[ BELLOWSCONTROLLER_CHANNELS ],
+	/// The calculated outputs
+		outputs[ BELLOWSCONTROLLER_CHANNELS ],
+	/// The maximum rate of change of the references, in bar per second
+		maxRate;
+
+	bool
+	/// If the previous readings are valid
+		hasPrevious,
+	/// If a settling measurement is in progress for each bellow
+		settling[ BELLOWSCONTROLLER_CHANNELS ],
+	/// If each bellow is currently within the tolerance of its target
+		withinTolerance[ BELLOWSCONTROLLER_CHANNELS ];
+
+	unsigned int
+	/// The time of the previous readings
+		previousTime,
+	/// The time the current settling measurement started
+		settleStart[ BELLOWSCONTROLLER_CHANNELS ],
+	/// The time each bellow entered the tolerance
+		toleranceEntered[ BELLOWSCONTROLLER_CHANNELS ],
+	/// The last settling time of each bellow, in milliseconds
+		lastSettleTime[ BELLOWSCONTROLLER_CHANNELS ],
+	/// The longest settling time of each bellow, in milliseconds
+		maxSettleTime[ BELLOWSCONTROLLER_CHANNELS ],
+	/// The number of settling measurements of each bellow
+		settleCount[ BELLOWSCONTROLLER_CHANNELS ];
+
+	double
+	/// The sum of the settling times of each bellow, for the average
+		settleTimeSum[ BELLOWSCONTROLLER_CHANNELS ];
+
+	/**
+	 * Updates the settling measurement of a bellow
+	 *
+	 * @param	channel	The bellow
+	 * @param	measured	The measured pressure
+	 * @param	time	The time of the reading
+	 */
+	void measureSettling( unsigned int channel, float measured, unsigned int time );
+};
+
+#endif
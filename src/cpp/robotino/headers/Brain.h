@@ -10,8 +10,12 @@
 
 #include <rec/robotino/api2/Com.h>
 
+#include <map>
+#include <mutex>
+#include <ostream>
 #include <string>
 #include <thread>
+#include <vector>
 
 class _Bumper;
 class _CompactBha;
@@ -20,25 +24,39 @@ class _OmniDrive;
 class _DistanceSensors;
 class _LaserRangeFinder;
 
+class ObstacleIndex;
 class KinectReader;
+class TrackerTable;
+class Reactor;
+class TelemetryServer;
+class CommandServer;
+class Behaviour;
 
 
 /// Desired loop time of the main loop in milliseconds, to avoid overloading
 /// the Robotino command bridge
 #define BRAIN_LOOP_TIME	50
 
+/// Interval in milliseconds between processing events while the main loop
+/// waits, letting event driven control (e.g. of the cBHA bellows) run faster
+/// than the main loop
+#define BRAIN_EVENT_INTERVAL	10
+
 /// Age of data in milliseconds before update is forced (on read)
 /// Used by subclasses to trigger read instead of using stored data
 #define BRAIN_DATA_MAX_AGE	200
 
+/// Bytes reserved for each telemetry frame, enough for a frame with a scan
+#define BRAIN_TELEMETRY_FRAME_SIZE	8192
+
+/// The maximum number of behaviours running at once
+#define BRAIN_MAX_BEHAVIOURS	8
+
 /// Number of time to run processEvents to flush data before starting main loop
 /// To avoid erranous values registered during startup to cause unwanted
 /// reactions to invalid sensor data
 #define BRAIN_FLUSH_COUNT	6
 
-/// The number of times an external connection will be tried before failing
-#define BRAIN_EXTERNAL_CONNECTION_RETRIES	5
-
 /** 
  * The Brain class is the central hub of the Brain framework.
  * Brain acts as a hub for accessing sensor data and triggers analysis of data
@@ -95,11 +113,63 @@ class Brain : public rec::robotino::api2::Com
 	bool hasLRF();
 
 	/**
-	 * Gets a pointer to the KinectReader object
+	 * Gets a pointer to the ObstacleIndex object
+	 *
+	 * @return	Pointer to the ObstacleIndex object
+	 */
+	ObstacleIndex * obstacles();
+
+	/**
+	 * Gets a pointer to the KinectReader object of the first Kinect
 	 *
-	 * @return	Pointer to the KinectReader object
+	 * @return	Pointer to the KinectReader object, NULL if not enabled
 	 */
 	KinectReader * kinect();
+
+	/**
+	 * Gets a pointer to the KinectReader object of a Kinect
+	 *
+	 * @param	camera	The camera number, in the order enabled from 0
+	 *
+	 * @return	Pointer to the KinectReader object, NULL if not enabled
+	 */
+	KinectReader * kinect( unsigned int camera );
+
+	/**
+	 * Gets the number of Kinects enabled
+	 *
+	 * @return	The number of Kinects
+	 */
+	unsigned int kinects();
+
+	/**
+	 * Gets a pointer to the table of the latest samples of all joints
+	 * tracked by all Kinects
+	 *
+	 * @return	Pointer to the TrackerTable object
+	 */
+	TrackerTable * trackers();
+
+	/**
+	 * Gets a pointer to the Reactor handling network connections
+	 *
+	 * @return	Pointer to the Reactor object
+	 */
+	Reactor * reactor();
+
+	/**
+	 * Gets a pointer to the server streaming telemetry
+	 *
+	 * @return	Pointer to the TelemetryServer object, NULL if not enabled
+	 */
+	TelemetryServer * telemetry();
+
+	/**
+	 * Gets a pointer to the server taking commands over the network
+	 *
+	 * @return	Pointer to the CommandServer object, NULL if not enabled
+	 */
+	CommandServer * commands();
 	
 	/**
 	 * Initializes Brain by connecing to obotino and creating objects in
@@ -110,27 +180,63 @@ class Brain : public rec::robotino::api2::Com
 	int initialize();
 
 	/**
-	 * Creates a KinectReader object and sarts the thread reading from the
-	 * Kinect Server
+	 * Creates a KinectReader object and starts reading from the Kinect
+	 * Server on the Reactor. May be called once for each Kinect, all
+	 * readers share the Reactor thread and publish to trackers(). The
+	 * first Kinect is the one returned by kinect().
 	 *
 	 * @param	server	The IP or URL of domain name of the host of the Kinect
 	 * server
 	 * @param	port	The port the Kinect server is hosted on
 	 * @param	height	The height of the Kinects position, from the floor, in
 	 * meters
+	 * @param	udp	If the records are recieved as UDP datagrams instead of
+	 * over TCP, see KinectReader
 	 */
-	void enableKinect( std::string server, std::string port, float height );
+	void enableKinect( std::string server, std::string port, float height, bool udp = false );
 	
 	/**
 	 * Checks if a Kinect is available
 	 *
-	 * This function returns true if a KinectReader thread is currently
-	 * running.
+	 * This function returns true if any KinectReader is currently connected.
 	 *
 	 * @param	Boolean indicating the availability of a Kinect sensor
 	 */
 	bool kinectIsAvailable();
 
+	/**
+	 * Starts streaming telemetry to any number of clients on the Reactor,
+	 * see TelemetryServer.
+	 *
+	 * Each main loop cycle with clients connected sends one line, built
+	 * once for all clients, of space separated fields:
+	 *
+	 *	<cycle> <msecs> pose <x> <y> <phi> drive <xSpeed> <ySpeed> <omega>
+	 *	cbha <holding> <x> <y> <z> <read pressures> <target pressures>
+	 *	[scan <angle min> <angle increment> <count> <ranges>]
+	 *
+	 * with the gripper position and CBHA_BELLOWS_COUNT pressures of each
+	 * kind, and the filtered ranges of the latest scan if a
+	 * LaserRangeFinder is present, invalid ranges being
+	 * SCANFILTER_INVALID_RANGE.
+	 *
+	 * @param	port	The port to listen on
+	 *
+	 * @return	Success of listening on the port
+	 */
+	bool enableTelemetry( std::string port );
+
+	/**
+	 * Starts taking commands from any number of clients on the Reactor, see
+	 * CommandServer. The commands are executed by whoever takes them from
+	 * commands(), like Control.
+	 *
+	 * @param	port	The port to listen on
+	 *
+	 * @return	Success of listening on the port
+	 */
+	bool enableCommands( std::string port );
+
 	/**
 	 * Starts the brain loop
 	 */
@@ -148,6 +254,57 @@ class Brain : public rec::robotino::api2::Com
 	 */
 	bool isRunning();
 
+	/**
+	 * Starts a behaviour, stepped by the main loop from the next cycle until
+	 * it finishes or is cancelled. Running behaviours using any of the
+	 * resources of the new behaviour are cancelled first, and so is arm
+	 * playback, see _CompactBha::play(), for a behaviour using BEHAVIOUR_ARM.
+	 *
+	 * Must not be called from Behaviour::step().
+	 *
+	 * @param	pBehaviour	The behaviour, deleted by Brain when finished or
+	 * cancelled
+	 *
+	 * @return	The id of the behaviour, 0 if BRAIN_MAX_BEHAVIOURS are
+	 * running and the behaviour was deleted
+	 */
+	unsigned int startBehaviour( Behaviour * pBehaviour );
+
+	/**
+	 * Cancels a behaviour at once. Waits at most for a step in progress.
+	 *
+	 * @param	id	The id returned by startBehaviour()
+	 *
+	 * @return	If the behaviour was running
+	 */
+	bool cancelBehaviour( unsigned int id );
+
+	/**
+	 * Cancels the running behaviours using any of the given resources, as
+	 * cancelBehaviour(). Arm playback is stopped as well for BEHAVIOUR_ARM.
+	 *
+	 * @param	resources	A combination of the BEHAVIOUR_ flags
+	 *
+	 * @return	The number of behaviours cancelled
+	 */
+	unsigned int cancelBehaviours( unsigned int resources );
+
+	/**
+	 * Checks if a behaviour is running
+	 *
+	 * @param	id	The id returned by startBehaviour()
+	 *
+	 * @return	If the behaviour has neither finished nor been cancelled
+	 */
+	bool behaviourIsRunning( unsigned int id );
+
+	/**
+	 * Prints the running behaviours, with their states
+	 *
+	 * @param	out	The stream to print to
+	 */
+	void behavioursToString( std::ostream & out );
+
  private:
 	std::string
 	/// Holds the name of the application, displayed in Robotinos status screen
@@ -162,8 +319,6 @@ class Brain : public rec::robotino::api2::Com
 		runMainLoop,
 	/// Stop variable for comEvents loop
 		runComEventsLoop,
-	/// Indiator and stop variable for KinectReader loop
-		kinectRunning,
 	/// If LaserRangeFinder is available
 		hasLaserRangeFinder;
 
@@ -191,15 +346,53 @@ class Brain : public rec::robotino::api2::Com
 	/// Holds a pointer to the _LaserRangeFinder object
 		* pLRF;
 
-	KinectReader
-	/// Holds a pointer to the _KinectReader object
-		* pKinect;
+	ObstacleIndex
+	/// Holds a pointer to the ObstacleIndex object
+		* pObstacles;
+
+	std::vector<KinectReader *>
+	/// Holds pointers to the KinectReader objects, in camera order
+		kinectReaders;
+
+	TrackerTable
+	/// Holds a pointer to the table of tracked joints
+		* pTrackers;
+
+	Reactor
+	/// Holds a pointer to the Reactor handling network connections
+		* pReactor;
+
+	TelemetryServer
+	/// Holds a pointer to the server streaming telemetry
+		* pTelemetry;
+
+	CommandServer
+	/// Holds a pointer to the server taking commands
+		* pCommands;
+
+	unsigned int
+	/// The number of telemetry frames sent
+		telemetryCycle,
+	/// The id of the next behaviour started
+		nextBehaviourId;
+
+	/// Copy of the latest scan for telemetry, kept between frames
+	std::vector<float>
+		telemetryRanges;
+
+	/// The running behaviours, by id
+	std::map<unsigned int, Behaviour *>
+		behaviours;
+
+	/// Protects the behaviours, held while they are stepped
+	std::mutex
+		behaviourMutex;
 
 	std::thread
 	/// Thread for running the main loop of Brain
 		tBrainMain,
-	/// Thread for running the KinectReader loop
-		tKinectReader,
+	/// Thread for running the Reactor loop
+		tReactor,
 	/// Thread for running the processComEvents loop
 		tComEvents;
 
@@ -213,16 +406,6 @@ class Brain : public rec::robotino::api2::Com
 	 */
 	void processComEventsLoop();
 
-	/**
-	 * A looping function which handles reading data from the Kinect server.
-	 * If unable to connect, or if the connection is lost, it tries to
-	 * connect again according to the BRAIN_EXTERNAL_CONNECTION_RETRIES
-	 * parameter.
-	 * This function runs in it's own thread, @c tKinectReader, and is started
-	 * by a call to enableKinect().
-	 */
-	void kinectReader();
-
 	/**
 	 * A looping function performing the main task of Brain, making subclasses
 	 * analyze sensor data and apply actions.
@@ -231,6 +414,18 @@ class Brain : public rec::robotino::api2::Com
 	 */
 	void mainLoop();
 
+	/**
+	 * Builds a telemetry frame of the current state and queues it for all
+	 * telemetry clients, if any. Called by mainLoop() after each cycle.
+	 */
+	void publishTelemetry();
+
+	/**
+	 * Steps all running behaviours, deleting those that finish. Called by
+	 * mainLoop() each cycle, before the appliers.
+	 */
+	void stepBehaviours();
+
 	/**
 	 * Implementation of virtual function from rec::robotino::api2::Com, called
 	 * by processComEvents() when an errorEvent has occured. Prints any error
@@ -0,0 +1,147 @@
+/**
+ * @file	CbhaKinematics.h
+ * @brief	Header file for the CbhaKinematics class
+ */
+#ifndef CBHAKINEMATICS_H
+#define CBHAKINEMATICS_H
+
+#include "../../geometry/VolumeCoordinate.h"
+
+
+	// Arm geometry
+
+/// The distance from the axis of an arm segment to its strings, in meters
+#define CBHAKINEMATICS_STRING_RADIUS	0.035
+/// The distance from the end of the outer segment to the tip of the gripper
+/// claw, in meters
+#define CBHAKINEMATICS_GRIPPER_LENGTH	0.1
+/// The position of the base of the arm, forwards from Robotinos center, in
+/// meters
+#define CBHAKINEMATICS_MOUNT_X	0.17
+/// The position of the base of the arm, height above the floor, in meters
+#define CBHAKINEMATICS_MOUNT_Z	0.45
+/// The angle between the base axis of the arm and straight down, tilted
+/// forwards, in rad
+#define CBHAKINEMATICS_MOUNT_PITCH	0.785	// ~= pi / 4
+
+
+	// String potentiometers
+
+/// The length of a string at a reading of 0, in meters
+#define CBHAKINEMATICS_POT_LENGTH_OFFSET	0.16
+/// The change in string length per unit of reading, in meters
+#define CBHAKINEMATICS_POT_LENGTH_SCALE	0.1
+/// The direction of the over strings around the segment axis, in rad.
+/// Measured from the upper side of the arm towards Robotinos right side.
+#define CBHAKINEMATICS_POT_ANGLE_OVER	0.0
+/// The direction of the right strings (facing Robotino), in rad
+#define CBHAKINEMATICS_POT_ANGLE_RIGHT	-2.094	// ~= -2 * pi / 3
+/// The direction of the left strings (facing Robotino), in rad
+#define CBHAKINEMATICS_POT_ANGLE_LEFT	2.094	// ~= 2 * pi / 3
+
+
+	// Lookup table
+
+/// The number of intervals in the bending lookup table
+#define CBHAKINEMATICS_TABLE_SIZE	256
+/// The largest bending angle of a segment, larger bends are limited, in rad
+#define CBHAKINEMATICS_MAX_BEND	3.14
+
+
+/**
+ * Forward kinematics for the cBHA arm, calculating the pose of the gripper
+ * from the string potentiometer readings.
+ *
+ * Each of the two arm segments is modelled as a section of constant
+ * curvature. The three string lengths of a segment give its length, and the
+ * bending angle and direction as a vector. The position and rotation of the
+ * segment end only depend on the bending angle through the functions
+ * (1 - cos t) / t^2 and sin t / t, which are read from a lookup table indexed
+ * by t^2. The evaluation therefore needs no trigonometric functions, only a
+ * few dozen multiplications. A square root and a division are only needed
+ * when a segment bends more than CBHAKINEMATICS_MAX_BEND.
+ *
+ * Positions are given relative to Robotinos center at floor level, with x
+ * forwards, y to the left and z up, in meters. The geometry parameters are
+ * estimates, and should be calibrated for the actual arm. Until then
+ * _CompactBha only uses the model if CBHA_USE_KINEMATICS.
+ *
+ * See @link CbhaKinematics.h @endlink for documentation of @c \#define
+ * parameters
+ */
+class CbhaKinematics
+{
+ public:
+	/**
+	 * Constructs CbhaKinematics, calculating the lookup table
+	 */
+	CbhaKinematics();
+
+	/**
+	 * Calculates the pose of the gripper from string potentiometer readings.
+	 *
+	 * @param	readings	The six string potentiometer readings, ordered as
+	 * the CBHA_ mapping in _CompactBha.h
+	 */
+	void update( const float * readings );
+
+	/**
+	 * Gets the position of the tip of the gripper claw, as calculated by the
+	 * last update()
+	 *
+	 * @return	The position relative to Robotino
+	 */
+	VolumeCoordinate gripperPosition() const;
+
+	/**
+	 * Gets the direction the gripper is pointing in, as calculated by the
+	 * last update()
+	 *
+	 * @return	A unit vector relative to Robotino
+	 */
+	VolumeCoordinate gripperDirection() const;
+
+ private:
+	float
+	/// Lookup table of (1 - cos t) / t^2, indexed by t^2
+		bendTable[ CBHAKINEMATICS_TABLE_SIZE + 1 ],
+	/// Lookup table of sin t / t, indexed by t^2
+		sincTable[ CBHAKINEMATICS_TABLE_SIZE + 1 ],
+	/// The x component of the bending vector for each string, per meter of
+	/// string length
+		stringX[ 3 ],
+	/// The y component of the bending vector for each string, per meter of
+	/// string length
+		stringY[ 3 ],
+	/// The squared bending angle of each table interval
+		tableStep,
+	/// The inverse of tableStep, for indexing the table without dividing
+		tableScale,
+	/// Cosine of CBHAKINEMATICS_MOUNT_PITCH
+		mountCos,
+	/// Sine of CBHAKINEMATICS_MOUNT_PITCH
+		mountSin,
+	/// The last calculated gripper position
+		position[ 3 ],
+	/// The last calculated gripper direction
+		direction[ 3 ];
+
+	/**
+	 * Calculates the end pose of a segment relative to its base.
+	 *
+	 * @param	over	The reading of the over string potentiometer
+	 * @param	right	The reading of the right string potentiometer
+	 * @param	left	The reading of the left string potentiometer
+	 * @param	rotation	Output, the rotation of the segment end, as a row
+	 * major 3x3 matrix
+	 * @param	position	Output, the position of the segment end
+	 */
+	void segment(
+			float over,
+			float right,
+			float left,
+			float * rotation,
+			float * position ) const;
+};
+
+#endif
@@ -0,0 +1,155 @@
+/**
+ * @file	CbhaPatternEngine.h
+ * @brief	Header file for the CbhaPatternEngine class
+ */
+#ifndef CBHAPATTERNENGINE_H
+#define CBHAPATTERNENGINE_H
+
+#include <vector>
+
+
+	// Limits
+
+/// The maximum number of conditions in a pattern step
+#define CBHAPATTERNENGINE_MAX_CONDITIONS	4
+/// The maximum number of patterns, each pattern is given a bit in the
+/// result of evaluate()
+#define CBHAPATTERNENGINE_MAX_PATTERNS	32
+
+
+	// Comparisons
+
+/// The condition holds if the signal is above the threshold
+#define CBHAPATTERNENGINE_ABOVE	0
+/// The condition holds if the signal is below the threshold
+#define CBHAPATTERNENGINE_BELOW	1
+
+
+/**
+ * A condition on a single signal, part of a CbhaPatternStep
+ */
+struct CbhaCondition
+{
+	/// The index of the signal in the signals given to
+	/// CbhaPatternEngine::evaluate()
+	unsigned int signal;
+	/// CBHAPATTERNENGINE_ABOVE or CBHAPATTERNENGINE_BELOW
+	unsigned int comparison;
+	/// The threshold the signal is compared to
+	float threshold;
+};
+
+/**
+ * A step in a pattern definition. The step is completed when all of its
+ * conditions have held for minDuration.
+ */
+struct CbhaPatternStep
+{
+	/// The number of conditions used
+	unsigned int conditionCount;
+	/// The conditions, all must hold
+	CbhaCondition conditions[ CBHAPATTERNENGINE_MAX_CONDITIONS ];
+	/// The time the conditions must hold, 0 to complete on the first sample
+	/// they hold, in milliseconds
+	unsigned int minDuration;
+	/// The time allowed from the previous step completed until this step
+	/// completes, 0 for no limit. Ignored for the first step. In
+	/// milliseconds.
+	unsigned int timeout;
+};
+
+
+/**
+ * Detects patterns, like gestures, in a set of signals sampled over time.
+ *
+ * A pattern is a sequence of steps, each a set of conditions on the signals
+ * which must hold for a given time, like "pushed down for 300 ms" followed
+ * by "lifted within 1 second". Patterns are defined as arrays of
+ * CbhaPatternStep and compiled into flat arrays of conditions and steps when
+ * added. Each sample is evaluated for all patterns in one pass, checking only
+ * the current step of each pattern.
+ *
+ * A pattern fires when its last step completes, and then starts over from
+ * its first step. If the conditions of a step fail, the step starts over. If
+ * a step is not completed within its timeout, the pattern starts over from
+ * its first step.
+ *
+ * See @link CbhaPatternEngine.h @endlink for documentation of @c \#define
+ * parameters
+ */
+class CbhaPatternEngine
+{
+ public:
+	/**
+	 * Constructs CbhaPatternEngine
+	 *
+	 * @param	signalCount	The number of signals given to evaluate()
+	 */
+	CbhaPatternEngine( unsigned int signalCount );
+
+	/**
+	 * Adds a pattern
+	 *
+	 * @param	steps	The steps of the pattern
+	 * @param	stepCount	The number of steps
+	 *
+	 * @return	The id of the pattern, its bit in the result of evaluate(), or
+	 * -1 if the pattern is invalid or there are too many patterns
+	 */
+	int addPattern( const CbhaPatternStep * steps, unsigned int stepCount );
+
+	/**
+	 * Evaluates a sample of the signals for all patterns.
+	 *
+	 * @param	signals	The signals, signalCount values
+	 * @param	time	The time of the sample, in milliseconds
+	 *
+	 * @return	The patterns fired by this sample, with bit @c id set for each
+	 * pattern fired
+	 */
+	unsigned int evaluate( const float * signals, unsigned int time );
+
+	/**
+	 * Restarts all patterns from their first step
+	 */
+	void reset();
+
+ private:
+	/// The number of signals
+	unsigned int
+		signalCount;
+
+	std::vector<unsigned int>
+	/// The signal of each condition
+		conditionSignal,
+	/// The comparison of each condition
+		conditionComparison,
+	/// The first condition of each step
+		stepFirstCondition,
+	/// The number of conditions of each step
+		stepConditionCount,
+	/// The minimum duration of each step
+		stepMinDuration,
+	/// The timeout of each step
+		stepTimeout,
+	/// The first step of each pattern
+		patternFirstStep,
+	/// The number of steps of each pattern
+		patternStepCount,
+	/// The current step of each pattern, relative to its first step
+		patternStep,
+	/// The time the conditions of the current step started holding
+		patternHoldingSince,
+	/// The time the previous step of each pattern was completed
+		patternStepDone;
+
+	std::vector<float>
+	/// The threshold of each condition
+		conditionThreshold;
+
+	std::vector<bool>
+	/// If the conditions of the current step of each pattern are holding
+		patternHolding;
+};
+
+#endif
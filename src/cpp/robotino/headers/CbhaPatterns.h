@@ -0,0 +1,54 @@
+/**
+ * @file	CbhaPatterns.h
+ * @brief	Header file for the CbhaPatterns class
+ */
+#ifndef CBHAPATTERNS_H
+#define CBHAPATTERNS_H
+
+#include "CbhaPatternEngine.h"
+#include "_CompactBha.h"
+
+
+/**
+ * The cBHA interaction patterns and the signals they are evaluated on,
+ * shared by _CompactBha and aux/cbhaPatternReplay so the replay tests the
+ * patterns that are used.
+ *
+ * Only needs the constants of _CompactBha.h, not the RobotinoAPI2 library.
+ */
+class CbhaPatterns
+{
+ public:
+	/**
+	 * Defines the interaction patterns in an engine. New patterns are added
+	 * here.
+	 *
+	 * @param	engine	The engine, with CBHA_SIGNAL_COUNT signals
+	 * @param	ids	Output, CBHA_EVENT_COUNT pattern ids, the id of the
+	 * pattern of each CBHA_EVENT_ flag at the bit number of the flag
+	 */
+	static void define( CbhaPatternEngine & engine, int * ids );
+
+	/**
+	 * Calculates the pattern signals from the readings of a cycle
+	 *
+	 * @param	readPressures	CBHA_BELLOWS_COUNT read pressures
+	 * @param	targetPressures	CBHA_BELLOWS_COUNT target pressures
+	 * @param	pressureDeltas	CBHA_BELLOWS_COUNT windows of pressure deltas
+	 * @param	potDeltas	CBHA_STRINGPOTS_COUNT windows of potentiometer
+	 * deltas
+	 * @param	gripReady	If a gripping action is allowed
+	 * @param	releaseReady	If a release action is allowed
+	 * @param	signals	Output, CBHA_SIGNAL_COUNT signals
+	 */
+	static void signals(
+			const float * readPressures,
+			const float * targetPressures,
+			const RingWindow<float, CBHA_DELTA_DEPTH> * pressureDeltas,
+			const RingWindow<float, CBHA_DELTA_DEPTH> * potDeltas,
+			bool gripReady,
+			bool releaseReady,
+			float * signals );
+};
+
+#endif
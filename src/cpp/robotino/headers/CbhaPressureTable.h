@@ -0,0 +1,122 @@
+/**
+ * @file	CbhaPressureTable.h
+ * @brief	Header file for the CbhaPressureTable class
+ */
+#ifndef CBHAPRESSURETABLE_H
+#define CBHAPRESSURETABLE_H
+
+#include <ostream>
+
+
+	// Table
+
+/// The number of grid intervals along each axis, covering [-1, 1]
+#define CBHAPRESSURETABLE_SIZE	64
+/// The file the table is cached in, relative to the working directory. Set
+/// to an empty string to disable the cache.
+#define CBHAPRESSURETABLE_CACHE_FILE	"cbhaPressureTable.bin"
+/// Identifies the cache file format, change if the format changes
+#define CBHAPRESSURETABLE_CACHE_VERSION	1
+/// The largest difference between a cached value and the API allowed when
+/// checking a loaded cache, in bar
+#define CBHAPRESSURETABLE_CACHE_TOLERANCE	0.0001
+
+
+	// Comparison
+
+/// The number of random samples used by compare()
+#define CBHAPRESSURETABLE_COMPARE_SAMPLES	100000
+
+
+/**
+ * A precomputed table of the pressures needed to move a cBHA arm segment to a
+ * relative position.
+ *
+ * The table samples rec::robotino::api2::CompactBHASimple::xy2pressure() on a
+ * regular grid over [-1, 1] x [-1, 1] once, and gives the pressures for any
+ * position by bilinear interpolation. Both arm segments use the same mapping,
+ * so one table serves both.
+ *
+ * The table is cached in CBHAPRESSURETABLE_CACHE_FILE. A loaded cache is
+ * checked against the API at a few grid points, and regenerated if the API has
+ * changed.
+ *
+ * See @link CbhaPressureTable.h @endlink for documentation of @c \#define
+ * parameters
+ */
+class CbhaPressureTable
+{
+ public:
+	/**
+	 * Constructs CbhaPressureTable, loading the table from the cache or
+	 * generating it
+	 */
+	CbhaPressureTable();
+
+	/**
+	 * Gets the pressures for a relative position.
+	 *
+	 * Positions outside of [-1, 1] are limited to the edge of the table.
+	 *
+	 * @param	x	X-value of the relative position
+	 * @param	y	Y-value of the relative position
+	 * @param	over	Output, the pressure of the over bellows
+	 * @param	left	Output, the pressure of the left bellows
+	 * @param	right	Output, the pressure of the right bellows
+	 */
+	void lookup( float x, float y, float * over, float * left, float * right ) const;
+
+	/**
+	 * Gets the pressures for a number of relative positions, for instance the
+	 * points of a trajectory.
+	 *
+	 * @param	x	The x-values of the positions
+	 * @param	y	The y-values of the positions
+	 * @param	count	The number of positions
+	 * @param	over	Output, the pressures of the over bellows
+	 * @param	left	Output, the pressures of the left bellows
+	 * @param	right	Output, the pressures of the right bellows
+	 */
+	void lookup(
+			const float * x,
+			const float * y,
+			unsigned int count,
+			float * over,
+			float * left,
+			float * right ) const;
+
+	/**
+	 * Compares the table to the API function on random positions, printing
+	 * the largest and average error and the time used by each.
+	 *
+	 * @param	out	The stream to print to
+	 */
+	void compare( std::ostream & out ) const;
+
+ private:
+	float
+	/// The pressures at each grid point, three values per point, row major
+	/// with x along the rows
+		table[ ( CBHAPRESSURETABLE_SIZE + 1 ) * ( CBHAPRESSURETABLE_SIZE + 1 ) * 3 ];
+
+	/**
+	 * Fills the table from the API function
+	 */
+	void generate();
+
+	/**
+	 * Loads the table from the cache file, and checks it against the API
+	 *
+	 * @return	@c true if a valid table was loaded
+	 */
+	bool load();
+
+	/**
+	 * Saves the table to the cache file
+	 *
+	 * @return	@c true if the table was saved
+	 */
+	bool save() const;
+};
+
+#endif
@@ -0,0 +1,124 @@
+/**
+ * @file	CbhaTrajectory.h
+ * @brief	Header file for the CbhaTrajectory class
+ */
+#ifndef CBHATRAJECTORY_H
+#define CBHATRAJECTORY_H
+
+#include <vector>
+#include <string>
+
+
+/// The number of pressures in each frame, all bellows of the cBHA
+#define CBHATRAJECTORY_CHANNELS	8
+/// The resolution of the stored pressures, in bar. Pressures are stored as
+/// 16 bit integers of this unit.
+#define CBHATRAJECTORY_RESOLUTION	0.001
+/// Identifies the file format, change if the format changes
+#define CBHATRAJECTORY_FILE_VERSION	1
+/// The most frames a loaded file may hold, 20 MB of frames, over 2.5 hours
+/// at 100 frames per second
+#define CBHATRAJECTORY_MAX_FRAMES	1000000
+
+
+/**
+ * A time indexed sequence of cBHA bellows pressures, for recording and
+ * playing back arm motions.
+ *
+ * Each frame holds a time, in milliseconds from the start of the trajectory,
+ * and the pressures of all bellows, stored as 16 bit integers in units of
+ * CBHATRAJECTORY_RESOLUTION. A frame takes 20 bytes.
+ *
+ * Pressures between frames are interpolated linearly. To make a step
+ * change, add two frames one millisecond apart.
+ *
+ * See @link CbhaTrajectory.h @endlink for documentation of @c \#define
+ * parameters
+ */
+class CbhaTrajectory
+{
+ public:
+	/**
+	 * Constructs an empty CbhaTrajectory
+	 */
+	CbhaTrajectory();
+
+	/**
+	 * Removes all frames
+	 */
+	void clear();
+
+	/**
+	 * Adds a frame at the end of the trajectory
+	 *
+	 * @param	time	The time of the frame, in milliseconds from the start.
+	 * Frames must be added in time order, earlier frames are ignored.
+	 * @param	pressures	The pressures of the bellows,
+	 * CBHATRAJECTORY_CHANNELS values, in bar
+	 *
+	 * @return	@c true if the frame was added
+	 */
+	bool addFrame( unsigned int time, const float * pressures );
+
+	/**
+	 * Gets the number of frames
+	 *
+	 * @return	The number of frames
+	 */
+	unsigned int frames() const;
+
+	/**
+	 * Gets the time of the last frame
+	 *
+	 * @return	The duration, in milliseconds
+	 */
+	unsigned int duration() const;
+
+	/**
+	 * Gets the interpolated pressures at a time.
+	 *
+	 * Times before the first frame give the first frame, and times after the
+	 * last frame give the last frame.
+	 *
+	 * @param	time	The time, in milliseconds from the start
+	 * @param	pressures	Output, CBHATRAJECTORY_CHANNELS values, in bar
+	 * @param	cursor	The frame to start searching from, updated to the
+	 * frame found. Keeping the cursor between calls with increasing times
+	 * makes playback constant time.
+	 *
+	 * @return	@c false if the trajectory is empty
+	 */
+	bool sample( unsigned int time, float * pressures, unsigned int & cursor ) const;
+
+	/**
+	 * Saves the trajectory to a file
+	 *
+	 * @param	filename	The file to write
+	 *
+	 * @return	@c true if the trajectory was saved
+	 */
+	bool save( const std::string & filename ) const;
+
+	/**
+	 * Loads a trajectory from a file, replacing the current frames. Files
+	 * whose size does not match their frame count, with more than
+	 * CBHATRAJECTORY_MAX_FRAMES frames, or with frames out of time order are
+	 * rejected, leaving the current frames unchanged.
+	 *
+	 * @param	filename	The file to read
+	 *
+	 * @return	@c true if the trajectory was loaded
+	 */
+	bool load( const std::string & filename );
+
+ private:
+	std::vector<unsigned int>
+	/// The time of each frame
+		times;
+
+	std::vector<unsigned short>
+	/// The pressures of each frame, CBHATRAJECTORY_CHANNELS values per frame
+		pressures;
+};
+
+#endif
@@ -0,0 +1,219 @@
+/**
+ * @file	LineExtractor.h
+ * @brief	Header file for the LineExtractor class
+ */
+#ifndef LINEEXTRACTOR_H
+#define LINEEXTRACTOR_H
+
+#include "../../geometry/Coordinate.h"
+
+#include <vector>
+
+
+	// Segmentation
+
+/// The maximum distance between two neighbouring points for them to be
+/// considered part of the same surface, in meters
+#define LINEEXTRACTOR_MAX_POINT_GAP	0.2
+/// The maximum distance from a point to a line for the point to be
+/// considered part of the line, in meters
+#define LINEEXTRACTOR_SPLIT_DISTANCE	0.03
+/// The minimum number of points needed to form a line
+#define LINEEXTRACTOR_MIN_POINTS	6
+/// The minimum length of a line, shorter lines are discarded, in meters
+#define LINEEXTRACTOR_MIN_LENGTH	0.15
+
+
+	// Corners
+
+/// The minimum angle between two lines for their meeting point to be
+/// considered a corner, in rad
+#define LINEEXTRACTOR_CORNER_MIN_ANGLE	0.8	// 0.8f ~= 45 degrees
+/// The maximum distance between the end points of two lines for them to be
+/// considered as meeting in a corner, in meters
+#define LINEEXTRACTOR_CORNER_MAX_GAP	0.15
+
+
+/**
+ * A line extracted from a scan, typically a wall.
+ *
+ * The line is given both by its end points and on normal form,
+ * x * cos( alpha ) + y * sin( alpha ) = rho.
+ */
+struct ScanLine
+{
+	/// The end points of the line
+	Coordinate start, end;
+	/// The direction of the line normal, in rad
+	float alpha;
+	/// The distance from origo to the line, in meters
+	float rho;
+	/// The number of scan points supporting the line
+	unsigned int points;
+};
+
+/**
+ * A corner where two extracted lines meet.
+ */
+struct ScanCorner
+{
+	/// The position of the corner
+	Coordinate position;
+	/// The angle between the two lines, in rad
+	float angle;
+	/// The indexes of the two lines in LineExtractor::lines()
+	unsigned int first, second;
+};
+
+
+/**
+ * Extracts lines and corners from LaserRangeFinder scans.
+ *
+ * Uses split-and-merge: each scan is divided into clusters of neighbouring
+ * points, clusters are recursively split at the point farthest from the line
+ * between its end points, and neighbouring segments are merged again if they
+ * fit a common line. Lines are fitted by total least squares using prefix
+ * sums, making each fit constant time.
+ *
+ * All buffers are kept between scans, so no allocations are made once the
+ * buffers have grown to the size of a scan. The resulting features are a
+ * few dozen lines and corners instead of several hundred beams.
+ *
+ * Coordinates are given relative to Robotinos center, in meters.
+ *
+ * See @link LineExtractor.h @endlink for documentation of @c \#define
+ * parameters
+ */
+class LineExtractor
+{
+ public:
+	/**
+	 * Constructs LineExtractor
+	 */
+	LineExtractor();
+
+	/**
+	 * Extracts lines and corners from a scan, replacing the previous result.
+	 * Ranges outside of [rangeMin, rangeMax] are ignored.
+	 *
+	 * @param	ranges	The measured ranges
+	 * @param	count	The number of ranges
+	 * @param	angleMin	The angle of the first range, in rad
+	 * @param	angleIncrement	The angle between two ranges, in rad
+	 * @param	rangeMin	The minimum valid range
+	 * @param	rangeMax	The maximum valid range
+	 * @param	offsetX	The distance from Robotinos center to the scanner,
+	 * along the x axis
+	 */
+	void extract(
+			const float * ranges,
+			unsigned int count,
+			float angleMin,
+			float angleIncrement,
+			float rangeMin,
+			float rangeMax,
+			float offsetX );
+
+	/**
+	 * Gets the lines extracted from the last scan
+	 *
+	 * @return	The extracted lines
+	 */
+	const std::vector<ScanLine> & lines() const;
+
+	/**
+	 * Gets the corners extracted from the last scan
+	 *
+	 * @return	The extracted corners
+	 */
+	const std::vector<ScanCorner> & corners() const;
+
+ private:
+	std::vector<float>
+	/// Precalculated cosine of each beam angle
+		beamCos,
+	/// Precalculated sine of each beam angle
+		beamSin,
+	/// X value of each valid point
+		px,
+	/// Y value of each valid point
+		py;
+
+	std::vector<double>
+	/// Prefix sums of x, y, x*x, y*y and x*y over the points, five values per
+	/// point, used for constant time line fitting
+		sums;
+
+	std::vector<unsigned int>
+	/// The first point of each cluster, with the end of the last cluster
+	/// appended
+		clusters,
+	/// Stack of point ranges waiting to be split, two values per range
+		splitStack,
+	/// Accepted point ranges, two values per range, in scan order
+		segments;
+
+	std::vector<ScanLine>
+	/// Lines extracted from the last scan
+		_lines;
+
+	std::vector<ScanCorner>
+	/// Corners extracted from the last scan
+		_corners;
+
+	float
+	/// The angle of the first beam the beam tables were calculated for
+		tableAngleMin,
+	/// The beam increment the beam tables were calculated for
+		tableAngleIncrement;
+
+	/**
+	 * Fits a line to a range of points by total least squares
+	 *
+	 * @param	first	The first point
+	 * @param	last	The last point
+	 * @param	alpha	Output, the direction of the line normal
+	 * @param	rho	Output, the distance from origo to the line
+	 */
+	void fit( unsigned int first, unsigned int last, float * alpha, float * rho ) const;
+
+	/**
+	 * Finds the point in a range farthest from a line.
+	 *
+	 * @param	first	The first point
+	 * @param	last	The last point
+	 * @param	alpha	The direction of the line normal
+	 * @param	rho	The distance from origo to the line
+	 * @param	distance	Output, the distance from the farthest point to the
+	 * line
+	 *
+	 * @return	The index of the farthest point
+	 */
+	unsigned int farthest(
+			unsigned int first,
+			unsigned int last,
+			float alpha,
+			float rho,
+			float * distance ) const;
+
+	/**
+	 * Splits a cluster of points into segments, appending them to @c segments
+	 *
+	 * @param	first	The first point of the cluster
+	 * @param	last	The last point of the cluster
+	 */
+	void split( unsigned int first, unsigned int last );
+
+	/**
+	 * Merges neighbouring segments fitting a common line and creates a
+	 * ScanLine from each remaining segment.
+	 */
+	void merge();
+
+	/**
+	 * Finds corners between consecutive lines.
+	 */
+	void findCorners();
+};
+
+#endif
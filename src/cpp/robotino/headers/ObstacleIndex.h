@@ -0,0 +1,169 @@
+/**
+ * @file	ObstacleIndex.h
+ * @brief	Header file for the ObstacleIndex class
+ */
+#ifndef OBSTACLEINDEX_H
+#define OBSTACLEINDEX_H
+
+
+	// Sources
+
+/// Source id for obstacles detected by the LaserRangeFinder
+#define OBSTACLEINDEX_SOURCE_LRF	0
+/// Source id for obstacles detected by the DistanceSensors
+#define OBSTACLEINDEX_SOURCE_DISTANCESENSORS	1
+/// The number of sources feeding the index
+#define OBSTACLEINDEX_SOURCE_COUNT	2
+
+
+	// Resolution
+
+/// The number of angular sectors the surroundings are divided into.
+/// 72 sectors gives a resolution of 5 degrees.
+#define OBSTACLEINDEX_SECTORS	72
+/// The number of levels needed in the range minimum table, must be
+/// floor( log2( OBSTACLEINDEX_SECTORS ) ) + 1
+#define OBSTACLEINDEX_LEVELS	7
+
+
+	// Metrics
+
+/// The distance reported for sectors without any obstacles, in meters
+#define OBSTACLEINDEX_NO_OBSTACLE	10.0
+/// The radius of Robotinos chassis, distances are given from the chassis, in
+/// meters
+#define OBSTACLEINDEX_ROBOT_RADIUS	0.185
+/// Half the width of the sector considered when checking clearance along a
+/// heading, in rad.
+#define OBSTACLEINDEX_CLEARANCE_HALF_ANGLE	0.4	// 0.4f ~= 23 degrees
+/// Milliseconds before data from a source is considered outdated and ignored
+#define OBSTACLEINDEX_SOURCE_MAX_AGE	500
+
+
+/**
+ * Polar index of the nearest obstacles around Robotino.
+ *
+ * The surroundings of Robotino are divided into OBSTACLEINDEX_SECTORS
+ * sectors, each holding the distance from the chassis to the nearest
+ * obstacle in that direction. Each sensor source fills its own set of
+ * sectors, the sources are merged when a source commits its data.
+ *
+ * On each commit a range minimum table is built over the merged sectors,
+ * making nearest() and clearance() constant time lookups regardless of the
+ * width of the queried sector. This makes them cheap enough to be called
+ * several times per cycle, for example by _OmniDrive when limiting speed.
+ *
+ * Angles are relative to Robotinos heading, in rad, with 0 pointing straight
+ * ahead and increasing counterclockwise.
+ *
+ * See @link ObstacleIndex.h @endlink for documentation of @c \#define
+ * parameters
+ */
+class ObstacleIndex
+{
+ public:
+	/**
+	 * Constructs ObstacleIndex, with all sectors clear of obstacles
+	 */
+	ObstacleIndex();
+
+	/**
+	 * Clears all sectors of a source, in preparation of a new set of data
+	 *
+	 * @param	source	The id of the source
+	 */
+	void clear( unsigned int source );
+
+	/**
+	 * Registers an obstacle for a source. If the sector already holds a
+	 * nearer obstacle, the nearest is kept.
+	 *
+	 * @param	source	The id of the source
+	 * @param	phi	The direction of the obstacle, in rad
+	 * @param	distance	The distance from the chassis to the obstacle, in
+	 * meters
+	 */
+	void insert( unsigned int source, float phi, float distance );
+
+	/**
+	 * Registers an obstacle covering all sectors between two directions for a
+	 * source.
+	 *
+	 * @param	source	The id of the source
+	 * @param	fromPhi	The start of the covered sector, in rad
+	 * @param	toPhi	The end of the covered sector (counterclockwise), in rad
+	 * @param	distance	The distance from the chassis to the obstacle, in
+	 * meters
+	 */
+	void insert( unsigned int source, float fromPhi, float toPhi, float distance );
+
+	/**
+	 * Marks the data of a source as complete, merges all sources and rebuilds
+	 * the lookup table. Sources which have not committed data during the
+	 * last OBSTACLEINDEX_SOURCE_MAX_AGE milliseconds are ignored.
+	 *
+	 * @param	source	The id of the source
+	 * @param	time	The current time in milliseconds
+	 */
+	void commit( unsigned int source, unsigned int time );
+
+	/**
+	 * Gets the distance to the nearest obstacle within a sector.
+	 *
+	 * @param	fromPhi	The start of the sector, in rad
+	 * @param	toPhi	The end of the sector (counterclockwise), in rad
+	 *
+	 * @return	The distance from the chassis to the nearest obstacle, in
+	 * meters, or OBSTACLEINDEX_NO_OBSTACLE if the sector is clear
+	 */
+	float nearest( float fromPhi, float toPhi );
+
+	/**
+	 * Gets the clearance along a heading, the distance to the nearest
+	 * obstacle within OBSTACLEINDEX_CLEARANCE_HALF_ANGLE of the heading.
+	 *
+	 * @param	heading	The heading to check, in rad
+	 *
+	 * @return	The clearance in meters
+	 */
+	float clearance( float heading );
+
+ private:
+	float
+	/// The nearest obstacle in each sector, as reported by each source
+		sourceSectors[ OBSTACLEINDEX_SOURCE_COUNT ][ OBSTACLEINDEX_SECTORS ],
+	/// Range minimum table, level k holds the minimum of the 2^k sectors
+	/// starting at each sector. Level 0 holds the merged sectors.
+		table[ OBSTACLEINDEX_LEVELS ][ OBSTACLEINDEX_SECTORS ];
+
+	unsigned int
+	/// The time each source last committed data
+		sourceTime[ OBSTACLEINDEX_SOURCE_COUNT ],
+	/// Precalculated floor( log2( n ) ) for the possible sector counts
+		log2Table[ OBSTACLEINDEX_SECTORS + 1 ];
+
+	bool
+	/// If a source has ever committed data
+		sourceCommitted[ OBSTACLEINDEX_SOURCE_COUNT ];
+
+	/**
+	 * Finds the sector containing a direction.
+	 *
+	 * @param	phi	The direction, in rad
+	 *
+	 * @return	The sector index
+	 */
+	unsigned int sector( float phi );
+
+	/**
+	 * Looks up the minimum of a non wrapping range of sectors.
+	 *
+	 * @param	first	The first sector of the range
+	 * @param	last	The last sector of the range, not less than first
+	 *
+	 * @return	The minimum distance within the range
+	 */
+	float rangeMinimum( unsigned int first, unsigned int last );
+};
+
+#endif
@@ -0,0 +1,253 @@
+/**
+ * @file	RingWindow.h
+ * @brief	Header file for the RingWindow class template
+ */
+#ifndef RINGWINDOW_H
+#define RINGWINDOW_H
+
+
+/**
+ * A sliding window over the N latest values, with running statistics.
+ *
+ * The window is a fixed capacity ring buffer, so no allocations are made
+ * after construction. The window is always full, pushing a value replaces
+ * the oldest one. Sum, mean and variance are updated incrementally, min and
+ * max are kept in monotonic queues. All operations are constant time
+ * (amortized for push).
+ *
+ * To avoid drift in the running sums, they are recalculated from the values
+ * each time the ring wraps around.
+ *
+ * @tparam	T	The value type, must be convertible to and from double
+ * @tparam	N	The number of values in the window
+ */
+template <typename T, unsigned int N>
+class RingWindow
+{
+ public:
+	/**
+	 * Constructs RingWindow, filled with the given value
+	 *
+	 * @param	value	The initial value of all elements
+	 */
+	RingWindow( T value = T() )
+	{
+		this->fill( value );
+	}
+
+	/**
+	 * Sets all values in the window, discarding the previous values
+	 *
+	 * @param	value	The value to fill the window with
+	 */
+	void fill( T value )
+	{
+		for ( unsigned int i = 0; i < N; i++ )
+			this->values[ i ] = value;
+
+		this->head = 0;
+		this->pushed = N;
+
+		this->minQueue[ 0 ] = value;
+		this->minPosition[ 0 ] = N - 1;
+		this->minFirst = 0;
+		this->minCount = 1;
+
+		this->maxQueue[ 0 ] = value;
+		this->maxPosition[ 0 ] = N - 1;
+		this->maxFirst = 0;
+		this->maxCount = 1;
+
+		this->recalculate();
+	}
+
+	/**
+	 * Adds a value to the window, replacing the oldest value
+	 *
+	 * @param	value	The value to add
+	 */
+	void push( T value )
+	{
+		T oldest = this->values[ this->head ];
+		this->values[ this->head ] = value;
+		this->head = ( this->head + 1 ) % N;
+
+		unsigned long position = this->pushed++;
+
+		if ( this->head == 0 )
+		{
+			this->recalculate();
+		}
+		else
+		{
+			this->_sum += (double) value - (double) oldest;
+			this->sumSquares += ( (double) value * value ) - ( (double) oldest * oldest );
+		}
+
+		// Drop values which have left the window from the front of the queues
+		if ( this->minPosition[ this->minFirst ] + N <= position )
+		{
+			this->minFirst = ( this->minFirst + 1 ) % N;
+			this->minCount--;
+		}
+		if ( this->maxPosition[ this->maxFirst ] + N <= position )
+		{
+			this->maxFirst = ( this->maxFirst + 1 ) % N;
+			this->maxCount--;
+		}
+
+		// Drop values which can no longer be the min or max from the back
+		while ( this->minCount > 0
+				&& ! ( this->minQueue[ ( this->minFirst + this->minCount - 1 ) % N ] < value ) )
+			this->minCount--;
+		while ( this->maxCount > 0
+				&& ! ( value < this->maxQueue[ ( this->maxFirst + this->maxCount - 1 ) % N ] ) )
+			this->maxCount--;
+
+		unsigned int back = ( this->minFirst + this->minCount++ ) % N;
+		this->minQueue[ back ] = value;
+		this->minPosition[ back ] = position;
+
+		back = ( this->maxFirst + this->maxCount++ ) % N;
+		this->maxQueue[ back ] = value;
+		this->maxPosition[ back ] = position;
+	}
+
+	/**
+	 * Gets the most recently added value
+	 *
+	 * @return	The latest value
+	 */
+	T latest() const
+	{
+		return this->values[ ( this->head + N - 1 ) % N ];
+	}
+
+	/**
+	 * Gets a value by its age
+	 *
+	 * @param	age	The age of the value, 0 being the latest
+	 *
+	 * @return	The value, or the oldest value if age is too large
+	 */
+	T at( unsigned int age ) const
+	{
+		if ( age >= N ) age = N - 1;
+		return this->values[ ( this->head + N - 1 - age ) % N ];
+	}
+
+	/**
+	 * Gets the number of values in the window
+	 *
+	 * @return	N
+	 */
+	unsigned int size() const
+	{
+		return N;
+	}
+
+	/**
+	 * Gets the sum of the values in the window
+	 *
+	 * @return	The sum
+	 */
+	double sum() const
+	{
+		return this->_sum;
+	}
+
+	/**
+	 * Gets the mean of the values in the window
+	 *
+	 * @return	The mean
+	 */
+	double mean() const
+	{
+		return this->_sum / N;
+	}
+
+	/**
+	 * Gets the (population) variance of the values in the window
+	 *
+	 * @return	The variance
+	 */
+	double variance() const
+	{
+		double mean = this->_sum / N;
+		double variance = ( this->sumSquares / N ) - ( mean * mean );
+
+		// Rounding may give a slightly negative result for constant values
+		return ( variance > 0.0 ) ? variance : 0.0;
+	}
+
+	/**
+	 * Gets the smallest value in the window
+	 *
+	 * @return	The min value
+	 */
+	T min() const
+	{
+		return this->minQueue[ this->minFirst ];
+	}
+
+	/**
+	 * Gets the largest value in the window
+	 *
+	 * @return	The max value
+	 */
+	T max() const
+	{
+		return this->maxQueue[ this->maxFirst ];
+	}
+
+ private:
+	T
+	/// The values, oldest at head
+		values[ N ],
+	/// Increasing queue of values which may become the min value
+		minQueue[ N ],
+	/// Decreasing queue of values which may become the max value
+		maxQueue[ N ];
+
+	unsigned long
+	/// The number of values pushed, used as the position of each value
+		pushed,
+	/// The position of each value in minQueue
+		minPosition[ N ],
+	/// The position of each value in maxQueue
+		maxPosition[ N ];
+
+	unsigned int
+	/// The index of the oldest value, where the next value is written
+		head,
+	/// The index of the front of minQueue
+		minFirst,
+	/// The number of values in minQueue
+		minCount,
+	/// The index of the front of maxQueue
+		maxFirst,
+	/// The number of values in maxQueue
+		maxCount;
+
+	double
+	/// The sum of the values
+		_sum,
+	/// The sum of the squared values
+		sumSquares;
+
+	/**
+	 * Recalculates the running sums from the values
+	 */
+	void recalculate()
+	{
+		this->_sum = 0.0;
+		this->sumSquares = 0.0;
+		for ( unsigned int i = 0; i < N; i++ )
+		{
+			this->_sum += this->values[ i ];
+			this->sumSquares += (double) this->values[ i ] * this->values[ i ];
+		}
+	}
+};
+
+#endif
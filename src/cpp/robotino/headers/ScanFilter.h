@@ -0,0 +1,152 @@
+/**
+ * @file	ScanFilter.h
+ * @brief	Header file for the ScanFilter class
+ */
+#ifndef SCANFILTER_H
+#define SCANFILTER_H
+
+#include <vector>
+
+
+	// Filters
+
+/// Marks ranges outside of [range_min, range_max] as invalid
+#define SCANFILTER_RANGE_GATE	0x01
+/// Replaces each range by the median of its neighbourhood
+#define SCANFILTER_MEDIAN	0x02
+/// Marks shadow (veiling) points, found between the edge of an object and
+/// the background, as invalid
+#define SCANFILTER_SHADOW	0x04
+/// Keeps only every SCANFILTER_DECIMATION'th range
+#define SCANFILTER_DECIMATE	0x08
+/// The filters enabled by default
+#define SCANFILTER_DEFAULT	( SCANFILTER_RANGE_GATE | SCANFILTER_MEDIAN | SCANFILTER_SHADOW )
+
+
+	// Parameters
+
+/// The value invalid ranges are set to. Negative, so it cannot be mistaken
+/// for a reading even if range_min is 0, test with ScanFilter::isValid().
+#define SCANFILTER_INVALID_RANGE	-1.0
+/// The number of ranges considered by the median filter, must be odd and no
+/// larger than SCANFILTER_MEDIAN_MAX_WINDOW
+#define SCANFILTER_MEDIAN_WINDOW	5
+/// The largest supported median window
+#define SCANFILTER_MEDIAN_MAX_WINDOW	15
+/// The minimum angle between a beam and the surface it hits, surfaces seen at
+/// a smaller angle are considered shadows, in rad
+#define SCANFILTER_SHADOW_MIN_ANGLE	0.17	// 0.17f ~= 10 degrees
+/// The default decimation factor
+#define SCANFILTER_DECIMATION	2
+
+
+/**
+ * A configurable chain of filters for LaserRangeFinder scans.
+ *
+ * The filters run in place on a buffer owned by the caller, which is meant to
+ * be reused between scans so no allocations are made per scan. The enabled
+ * filters run in the order: range gate, median, shadow, decimation.
+ *
+ * Invalid ranges are set to SCANFILTER_INVALID_RANGE. The range gate and
+ * shadow filters are written as branch free loops over the buffer, allowing
+ * the compiler to vectorise them.
+ *
+ * See @link ScanFilter.h @endlink for documentation of @c \#define parameters
+ */
+class ScanFilter
+{
+ public:
+	/**
+	 * Constructs ScanFilter with the SCANFILTER_DEFAULT filters enabled
+	 */
+	ScanFilter();
+
+	/**
+	 * Gets the enabled filters
+	 *
+	 * @return	The enabled filters as a combination of the SCANFILTER_ flags
+	 */
+	unsigned int filters();
+
+	/**
+	 * Sets the enabled filters
+	 *
+	 * @param	filters	A combination of the SCANFILTER_ flags
+	 */
+	void setFilters( unsigned int filters );
+
+	/**
+	 * Sets the median window size
+	 *
+	 * @param	window	The number of ranges considered, rounded up to an odd
+	 * number and limited to SCANFILTER_MEDIAN_MAX_WINDOW
+	 */
+	void setMedianWindow( unsigned int window );
+
+	/**
+	 * Sets the decimation factor, used if SCANFILTER_DECIMATE is enabled
+	 *
+	 * @param	factor	Only every factor'th range is kept
+	 */
+	void setDecimation( unsigned int factor );
+
+	/**
+	 * Runs the enabled filters on a scan, in place.
+	 *
+	 * @param	ranges	The ranges to filter, resized if decimated
+	 * @param	angleIncrement	The angle between two ranges, adjusted if
+	 * decimated
+	 * @param	rangeMin	The minimum valid range
+	 * @param	rangeMax	The maximum valid range
+	 */
+	void apply(
+			std::vector<float> & ranges,
+			float & angleIncrement,
+			float rangeMin,
+			float rangeMax );
+
+	/**
+	 * Checks if a filtered range is valid
+	 *
+	 * @param	range	The range
+	 *
+	 * @return	Boolean indicating if the range is not SCANFILTER_INVALID_RANGE
+	 */
+	static bool isValid( float range );
+
+ private:
+	unsigned int
+	/// The enabled filters
+		enabledFilters,
+	/// The number of ranges considered by the median filter
+		medianWindow,
+	/// The decimation factor
+		decimation;
+
+	std::vector<unsigned char>
+	/// Buffer marking shadow points, kept between scans
+		shadowMarks;
+
+	/**
+	 * Marks ranges outside of [rangeMin, rangeMax] as invalid
+	 */
+	void rangeGate( std::vector<float> & ranges, float rangeMin, float rangeMax );
+
+	/**
+	 * Replaces each valid range with the median of the valid ranges in its
+	 * neighbourhood
+	 */
+	void median( std::vector<float> & ranges, float rangeMin );
+
+	/**
+	 * Marks shadow points as invalid
+	 */
+	void shadow( std::vector<float> & ranges, float angleIncrement, float rangeMin );
+
+	/**
+	 * Keeps only every decimation'th range
+	 */
+	void decimate( std::vector<float> & ranges, float & angleIncrement );
+};
+
+#endif
@@ -6,13 +6,21 @@
 #define _COMPACTBHA_H
 
 #include "Axon.h"
+#include "CbhaKinematics.h"
+#include "CbhaPressureTable.h"
+#include "BellowsController.h"
+#include "CbhaPatternEngine.h"
+#include "CbhaTrajectory.h"
+#include "RingWindow.h"
 
 #include "../../geometry/Coordinate.h"
 #include "../../geometry/VolumeCoordinate.h"
 
 #include <rec/robotino/api2/CompactBHA.h>
 
-#include <list>
+#include <mutex>
+#include <ostream>
+#include <condition_variable>
 
 
 	// Bellows and stringpots mapping (facing Robotino)
@@ -58,7 +66,8 @@
 
 	// Data
 
-/// The number of delta values to keep and consider
+/// The number of delta values to keep and consider, one per Brain cycle
+/// (BRAIN_LOOP_TIME), see analyze()
 #define CBHA_DELTA_DEPTH	4
 
 
@@ -74,6 +83,44 @@
 #define CBHA_RELEASE_THRESHOLD	-0.005
 /// Necessary arm movement to register as touched 
 #define CBHA_TOUCHED_THRESHOLD	0.01
+/// Milliseconds the arm must hold an object still before a lift is taken
+/// as a deliver, so the arm settling after a grip is not taken for a lift
+#define CBHA_DELIVER_HOLD_MSECS	500
+
+
+	// Events, see waitForEvents()
+
+/// A touch has been detected
+#define CBHA_EVENT_TOUCH	0x01
+/// An object has been handed to the arm
+#define CBHA_EVENT_RECIEVE	0x02
+/// An object has been taken from the arm
+#define CBHA_EVENT_DELIVER	0x04
+/// The number of event types, each event being the bit 1 << i for an i
+/// below this
+#define CBHA_EVENT_COUNT	3
+/// Maximum age of the Kinect coordinate stored with a touch event, in
+/// milliseconds
+#define CBHA_TOUCH_COORD_MAX_AGE	100
+
+
+	// Pattern signals, see CbhaPatternEngine
+
+/// The largest difference between read and target pressure of the arm
+/// bellows
+#define CBHA_SIGNAL_PRESSURE_ERROR	0
+/// The largest average pressure delta of the arm bellows
+#define CBHA_SIGNAL_PRESSURE_MOTION	1
+/// The arm up/down motion, average over deltas of the over string pots
+#define CBHA_SIGNAL_DOWN	2
+/// The largest motion of a pair of inner and outer string pots, latest delta
+#define CBHA_SIGNAL_TOUCH	3
+/// 1 if a gripping action is allowed, 0 otherwise
+#define CBHA_SIGNAL_GRIP_READY	4
+/// 1 if a release action is allowed, 0 otherwise
+#define CBHA_SIGNAL_RELEASE_READY	5
+/// The number of signals
+#define CBHA_SIGNAL_COUNT	6
 
 
 	// Metrics
@@ -81,6 +128,11 @@
 /// The distance from the center of Robotino to the tip of gripper claw
 /// when the cBHA arm is in an "relaxed" position. In meters.
 #define CBHA_ARM_RELAXED_DISTANCE_FROM_CENTER	0.47
+/// If the gripper position is calculated from the string potentiometers by
+/// CbhaKinematics. The geometry of the model is not yet calibrated on the
+/// arm, so by default the measured CBHA_ARM_RELAXED_DISTANCE_FROM_CENTER is
+/// used instead, see gripperPosition().
+#define CBHA_USE_KINEMATICS	false
 
 
 	// Calibration
@@ -112,6 +164,10 @@
  * closed when it is pushed down, presumably by the weight of an object
  * handed to it. The compressor is enabled and disabled automatically based
  * on the neccessity of air pressure for the given target state.
+ * The arm bellows are driven toward their target pressures by a
+ * BellowsController, stepped on each pressure reading.
+ * Target pressures can be recorded and played back as a CbhaTrajectory,
+ * stepped on each Brain cycle.
  *
  * See @link _CompactBha.h @endlink for documentation of @c \#define parameters
  */
@@ -206,6 +262,14 @@ class _CompactBha : public rec::robotino::api2::CompactBHA, public Axon
 	/// @overload
 	void outerToCoordinate( Coordinate c );
 
+	/**
+	 * Gets the table used to find the pressures for a relative position of
+	 * an arm segment, allowing trajectories to be converted in batch.
+	 *
+	 * @return	A pointer to the CbhaPressureTable
+	 */
+	const CbhaPressureTable * armPressureTable();
+
 	/**
 	 * Return the cBHA arm to the initial position.
 	 *
@@ -220,6 +284,10 @@ class _CompactBha : public rec::robotino::api2::CompactBHA, public Axon
 	 * Control the speed of the cBHA arm by setting the max change in pressure
 	 * allowed per cycle.
 	 *
+	 * The bellows are controlled by BellowsController at the rate of the
+	 * pressure readings, the change per cycle is converted to a rate per
+	 * second using BRAIN_LOOP_TIME.
+	 *
 	 * @param	maxAdjustPerCycle	The maximum pressure change allowed per
 	 * cycle, in bar.
 	 */
@@ -229,10 +297,75 @@ class _CompactBha : public rec::robotino::api2::CompactBHA, public Axon
 	 * Waits for a touch event, then returns the corresponding Kinect
 	 * coordinate.
 	 *
+	 * The coordinate is read by the Brain thread when the touch is detected,
+	 * touches without a recent Kinect coordinate are ignored. While a thread
+	 * is waiting, touches do not trigger odometry calibration.
+	 *
 	 * @return	VolumeCoordinate from KinectReader
 	 */
 	VolumeCoordinate getTouchCoordinate();
 
+	/**
+	 * Starts watching for a touch without waiting, like getTouchCoordinate()
+	 * for callers that must not block, e.g. a Behaviour. While watched,
+	 * touches do not trigger odometry calibration. The watch is ended by
+	 * pollTouchCoordinate() returning true, or by unwatchTouch().
+	 *
+	 * @return	A ticket for pollTouchCoordinate()
+	 */
+	unsigned long watchTouch();
+
+	/**
+	 * Checks if a touch has been detected since watchTouch(), ending the
+	 * watch if so
+	 *
+	 * @param	ticket	The ticket returned by watchTouch()
+	 * @param	coordinate	Output, the Kinect coordinate of the touch
+	 *
+	 * @return	If a touch has been detected
+	 */
+	bool pollTouchCoordinate( unsigned long ticket, VolumeCoordinate & coordinate );
+
+	/**
+	 * Ends a watch started by watchTouch() before a touch was detected
+	 */
+	void unwatchTouch();
+
+	/**
+	 * Waits for one of the given events to be detected. Only events detected
+	 * after the call are considered.
+	 *
+	 * Must not be called from the Brain thread, as the events are detected
+	 * there.
+	 *
+	 * @param	events	The events to wait for, a combination of the
+	 * CBHA_EVENT_ flags
+	 * @param	timeoutMsecs	The maximum time to wait, 0 to wait
+	 * indefinitely
+	 *
+	 * @return	The events detected among the given events, 0 if timed out
+	 */
+	unsigned int waitForEvents( unsigned int events, unsigned int timeoutMsecs = 0 );
+
+	/**
+	 * Gets the position of the tip of the gripper claw. If
+	 * CBHA_USE_KINEMATICS, it is calculated from the string potentiometers by
+	 * CbhaKinematics, otherwise it is CBHA_ARM_RELAXED_DISTANCE_FROM_CENTER
+	 * straight ahead, at height 0.
+	 *
+	 * @return	The position relative to Robotinos center at floor level, in
+	 * meters
+	 */
+	VolumeCoordinate gripperPosition();
+
+	/**
+	 * Gets the horizontal distance from Robotinos center to the tip of the
+	 * gripper claw, see gripperPosition().
+	 *
+	 * @return	The distance, in meters
+	 */
+	float gripperReach();
+
 	/**
 	 * Calculates the sum of the absolutes of the differences between current
 	 * and target pressures of the bellows responsible for controlling the
@@ -242,6 +375,60 @@ class _CompactBha : public rec::robotino::api2::CompactBHA, public Axon
 	 */
 	float armTotalPressureDiff();
 
+	/**
+	 * Gets the read and target pressures of all bellows
+	 *
+	 * @param	read	Output, CBHA_BELLOWS_COUNT last read pressures
+	 * @param	target	Output, CBHA_BELLOWS_COUNT target pressures
+	 */
+	void bellowsPressures( float * read, float * target );
+
+	/**
+	 * Prints the settling time metrics of the arm bellows, see
+	 * BellowsController::metricsToString()
+	 *
+	 * @param	out	The stream to print to
+	 */
+	void settlingToString( std::ostream & out );
+
+	/**
+	 * Starts recording the target pressures of all bellows, one frame per
+	 * Brain cycle. Any previous recording is discarded.
+	 */
+	void startRecording();
+
+	/**
+	 * Stops recording.
+	 *
+	 * @return	The recorded trajectory
+	 */
+	CbhaTrajectory stopRecording();
+
+	/**
+	 * Starts playing a trajectory, replacing any trajectory being played.
+	 *
+	 * The target pressures are set from the trajectory on each Brain cycle,
+	 * timed from the first cycle after the call. When the trajectory ends, the
+	 * target pressures of its last frame are kept. Playback holds the arm
+	 * like a behaviour using BEHAVIOUR_ARM, and is stopped by
+	 * Brain::startBehaviour() and Brain::cancelBehaviours() for the arm.
+	 *
+	 * @param	trajectory	The trajectory to play, it is copied
+	 */
+	void play( const CbhaTrajectory & trajectory );
+
+	/**
+	 * Stops playing, the current target pressures are kept.
+	 */
+	void stopPlayback();
+
+	/**
+	 * Checks if a trajectory is being played
+	 *
+	 * @return	@c true if a trajectory is being played or about to start
+	 */
+	bool isPlaying();
+
 //	This function is a part of a functionality to observe deltas, it has done
 //	it's job, but is kept commented out as a convenience for future developers
 //	void resetDeltas();
@@ -260,6 +447,15 @@ class _CompactBha : public rec::robotino::api2::CompactBHA, public Axon
 	/// The last read foil potentiometer value
 		readFoilPot,
 
+	/// Array holding the pressures read at the previous Brain cycle, deltas
+	/// are taken against these once per cycle
+		cyclePressures[ CBHA_BELLOWS_COUNT ],
+	/// Array holding the string potentiometer values read at the previous
+	/// Brain cycle
+		cyclePots[ CBHA_STRINGPOTS_COUNT ],
+	/// The foil potentiometer value read at the previous Brain cycle
+		cycleFoilPot,
+
 //		largestPressureDelta,
 //		largestPotDelta,
 
@@ -267,13 +463,41 @@ class _CompactBha : public rec::robotino::api2::CompactBHA, public Axon
 	/// of motion for the cBHA arm		
 		maxArmSpeed;
 
-	std::list<float>
-	/// Array holding a number of lists containing delta values for pressures
+	/// Forward kinematics, updated on each string potentiometer reading
+	CbhaKinematics
+		kinematics;
+
+	/// Inverse kinematics, replacing calls to CompactBHASimple::xy2pressure()
+	CbhaPressureTable
+		pressureTable;
+
+	/// Closed loop control of the arm bellows, stepped on each pressure
+	/// reading
+	BellowsController
+		bellows;
+
+	/// Detects interaction patterns from the signals
+	CbhaPatternEngine
+		patterns;
+
+	/// The signals evaluated by the pattern engine, updated each cycle
+	float
+		signals[ CBHA_SIGNAL_COUNT ];
+
+	int
+	/// The pattern id of the recieve pattern (object is handed to the arm)
+		recievePattern,
+	/// The pattern id of the deliver pattern (object is taken from the arm)
+		deliverPattern,
+	/// The pattern id of the touch pattern
+		touchPattern;
+
+	RingWindow<float, CBHA_DELTA_DEPTH>
+	/// Array holding a window of delta values for each pressure
 		pressureDeltas[ CBHA_BELLOWS_COUNT ],
-	/// Array holding a number of lists containing delta values for the
-	/// potentiometers
+	/// Array holding a window of delta values for each potentiometer
 		potDeltas[ CBHA_STRINGPOTS_COUNT ],
-	/// List containing delta values for the foil potentiometer
+	/// Window of delta values for the foil potentiometer
 		foilPotDeltas;
 
 	bool
@@ -296,24 +520,52 @@ class _CompactBha : public rec::robotino::api2::CompactBHA, public Axon
 	/// If pressure is required to perform rotation
 		rotatePressureRequired,
 
-	/// If pressures have been updated during the last cycle
-		pressuresUpdated,
-	/// If string potentiometers have been updated during the last cycle
-		potsUpdated,
-	/// If the foil potentiometer has been updated during the last cycle
-		foilPotUpdated,
-
 	/// If a recieve event has been detected
 		recieveDetected,
 	/// If a deliver event has been detected
 		deliverDetected,
 	/// If a touch event has been detected
 		touchDetected,
-	
-	/// A function is waiting for a touch event
-		waitForTouch;
+
+	/// If target pressures are being recorded
+		recording,
+	/// If a trajectory is being played
+		playing,
+	/// If a trajectory is to be played from the next cycle
+		playbackPending;
+
+	/// Protects the trajectories and their states
+	std::mutex
+		trajectoryMutex;
+
+	CbhaTrajectory
+	/// The target pressures recorded
+		recordedTrajectory,
+	/// The trajectory being played
+		playbackTrajectory;
+
+	/// Protects the event counters and touch coordinate
+	std::mutex
+		eventMutex;
+
+	/// Notified when events are published
+	std::condition_variable
+		eventCondition;
+
+	unsigned long
+	/// The number of times each event has been detected, by the bit number
+	/// of its CBHA_EVENT_ flag
+		eventCounts[ CBHA_EVENT_COUNT ],
+	/// The number of touch coordinates stored
+		touchCoordinateCount;
+
+	/// The Kinect coordinate of the latest touch
+	VolumeCoordinate
+		touchCoordinate;
 
 	unsigned int
+	/// The number of threads waiting for, or watching for, a touch coordinate
+		touchWaiters,
 	/// The last time the pressures were updated
 		pressuresUpdateTime,
 	/// The last time the string potentiometers were updated
@@ -323,12 +575,20 @@ class _CompactBha : public rec::robotino::api2::CompactBHA, public Axon
 	/// The time when a gripping action will be completed
 		gripDoneTime,
 	/// The time when a relase action will be completed
-		releaseDoneTime;
+		releaseDoneTime,
+	/// The time the recording started
+		recordStartTime,
+	/// The time the playback started
+		playbackStartTime,
+	/// The current frame of the playback, see CbhaTrajectory::sample()
+		playbackCursor;
 
 	/**
 	 * Implementation of virtual function from rec::robotino::api2::CompactBHA.
 	 * Called by Brain::processEvents() when pressures have changed.
-	 * Stores delta values and new values.
+	 * Stores the new values and steps the bellows controller with them. The
+	 * deltas are taken once per cycle by analyze(), as processEvents() is
+	 * called several times per cycle.
 	 * See RobotinoAPI2 documentation for details.
 	 */
 	void pressuresChangedEvent( const float * pressures, unsigned int size );
@@ -345,7 +605,7 @@ class _CompactBha : public rec::robotino::api2::CompactBHA, public Axon
 	 * Implementation of virtual function from rec::robotino::api2::CompactBHA.
 	 * Called by Brain::processEvents() when string potentiometer values have
 	 * changed.
-	 * Stores delta values and new values.
+	 * Stores the new values and updates the kinematics.
 	 * See RobotinoAPI2 documentation for details.
 	 */
 	void stringPotsChangedEvent( const float * readings, unsigned int size );
@@ -353,7 +613,7 @@ class _CompactBha : public rec::robotino::api2::CompactBHA, public Axon
 	/**
 	 * Implementation of virtual function from rec::robotino::api2::CompactBHA.
 	 * Called by Brain::processEvents() when the foil potentiometer has changed.
-	 * Stores the last delta value and the new value.
+	 * Stores the new value.
 	 * See RobotinoAPI2 documentation for details.
 	 */
 	void foilPotChangedEvent( float value );
@@ -369,28 +629,43 @@ class _CompactBha : public rec::robotino::api2::CompactBHA, public Axon
 	void calibrateOdometry();
 
 	/**
-	 * Prints the latest set of delta values from the given array of lists.
+	 * Defines the interaction patterns detected by the pattern engine, see
+	 * CbhaPatterns::define()
+	 */
+	void definePatterns();
+
+	/**
+	 * Calculates the pattern signals from the latest readings, see
+	 * CbhaPatterns::signals()
+	 */
+	void updateSignals();
+
+	/**
+	 * Publishes the events detected during this cycle to waiting threads
+	 */
+	void publishEvents();
+
+	/**
+	 * Records the target pressures and sets them from the trajectory being
+	 * played, if any. Called from analyze() on each cycle.
+	 */
+	void stepTrajectories();
+
+	/**
+	 * Prints the latest set of delta values from the given array of windows.
 	 *
-	 * @param	array	The array containing the lists containing the values
+	 * @param	array	The array containing the windows containing the values
 	 * to be printed
 	 * @param	size	The size of the array
 	 * @param	precision	The desired precision of the output numbers
 	 * @param	width	The desired witdth of the output number fields
 	 */
 	void printLatestDeltas(
-			std::list<float> array[],
+			const RingWindow<float, CBHA_DELTA_DEPTH> array[],
 			unsigned int size,
 			unsigned int precision = 4,
 			unsigned int width = 6 ) const;
 
-	/**
-	 * Sums up the floats in a list.
-	 * This function is used when calculating the average of a set ov deltas.
-	 *
-	 * @param	list	The list to be considered
-	 */
-	double floatListSum( std::list<float> * list ) const;
-
 //	This function is a part of a functionality to observe deltas, it has done
 //	it's job, but is kept commented out as a convenience for future developers
 //	void delta( float pressure, float pot );
@@ -15,14 +15,33 @@
 ///	The number of distancesensors available
 #define DISTANCESENSORS_COUNT 9
 
+/// Readings above this distance are considered as no obstacle detected, in
+/// meters
+#define DISTANCESENSORS_MAX_RANGE	0.4
+/// Half the width of the histogram sector covered by each sensor, in rad.
+/// Half the angle between two sensors, so the sectors cover all directions.
+#define DISTANCESENSORS_SECTOR_HALF_ANGLE	0.349	// ~= pi / 9
+
+
+	// Smoothing
+
+/// Smoothing factor used when an obstacle comes closer, [0, 1]. Higher
+/// values follow new readings faster.
+#define DISTANCESENSORS_SMOOTHING_APPROACH	0.8
+/// Smoothing factor used when an obstacle moves away, [0, 1]. Kept lower than
+/// DISTANCESENSORS_SMOOTHING_APPROACH to release speed limits carefully.
+#define DISTANCESENSORS_SMOOTHING_RECEDE	0.3
+
 
 /**
  * Reimplementation of the DistanceSensorArray class from RobotinoAPI2
  *
- * In the current state, this class is just a basic implementation. It has no
- * advanced functionality like the other "Brainified" Robotino classes.
- * It does however provide access to the sensors data, and has a function to
- * calculate the Angle a sensor is pointing in.
+ * The readings are fused into a polar obstacle histogram with one sector per
+ * sensor. Each sector holds a temporally smoothed distance, reacting quickly
+ * to approaching obstacles and slowly to receding ones. The histogram is
+ * inserted into Brains ObstacleIndex on each update, giving Robotino obstacle
+ * awareness even without a LaserRangeFinder. The geometry of each sensor is
+ * calculated once, at construction.
  *
  * @todo Project suggestion: Use the distanceSensorArray to map detected
  * obstacles as Robotino drives. Use this map as basis for route planning
@@ -67,10 +86,31 @@ class _DistanceSensors : public Axon, public rec::robotino::api2::DistanceSensor
 	 */
 	Angle sensorAngle( unsigned int sensorNo );
 
+	/**
+	 * Gets the smoothed distance to the nearest obstacle in a direction, from
+	 * the obstacle histogram.
+	 *
+	 * @param	phi	The direction, in rad, relative to Robotinos heading
+	 *
+	 * @return	The smoothed distance of the sensor covering the direction,
+	 * DISTANCESENSORS_MAX_RANGE if no obstacle is detected
+	 */
+	float obstacleDistance( float phi );
+
  private:
 	float
 	/// Array storing the latest values
-		readDistances[ DISTANCESENSORS_COUNT ];
+		readDistances[ DISTANCESENSORS_COUNT ],
+	/// The obstacle histogram, the smoothed distance for each sensor
+		histogram[ DISTANCESENSORS_COUNT ],
+	/// The start of the sector covered by each sensor, in rad
+		sectorFrom[ DISTANCESENSORS_COUNT ],
+	/// The end of the sector covered by each sensor, in rad
+		sectorTo[ DISTANCESENSORS_COUNT ];
+
+	Angle
+	/// The angle of each sensor
+		sensorAngles[ DISTANCESENSORS_COUNT ];
 
 	bool
 	/// If the distances were updated in the last cycle
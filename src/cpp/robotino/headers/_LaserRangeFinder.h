@@ -6,14 +6,37 @@
 #define _LASERRANGEFINDER_H
 
 #include "Axon.h"
+#include "LineExtractor.h"
+#include "ScanFilter.h"
 
 #include <rec/robotino/api2/LaserRangeFinder.h>
 #include <rec/robotino/api2/LaserRangeFinderReadings.h>
 
+#include <mutex>
+#include <ostream>
+#include <vector>
+
+
+	// Mounting
+
+/// The distance from the center of Robotino to the LaserRangeFinder, along
+/// the x axis (straight ahead), in meters
+#define LASERRANGEFINDER_OFFSET_X	0.12
+
 
 /**
  * Reimplementation of the LaserRangeFinder class from RobotinoAPI2
  *
+ * Each new scan is cleaned once by a ScanFilter, the filtered ranges are
+ * shared by all consumers. The filtered scan is converted to Robotinos frame
+ * of reference and inserted into Brains ObstacleIndex. Lines (walls) and corners are extracted from
+ * each scan by a LineExtractor, giving a compact description of the
+ * surroundings for localisation and mapping.
+ *
+ * The scans are processed by the Brain thread. When a scan is done, the
+ * results are copied under a mutex, so the getters may be called from any
+ * thread and never see a scan half rewritten.
+ *
  * See @link _LaserRangeFinder.h @endlink for documentation of @c \#define
  * parameters
  */
@@ -43,15 +66,122 @@ class _LaserRangeFinder :
 	/**
 	 * Prints the latest readings
 	 *
-	 * @todo Ideally, this should return the string instead
+	 * @param	out	The stream to print to
+	 */
+	void readingsToString( std::ostream & out );
+
+	/**
+	 * Gets the filter chain applied to each scan, for configuration
+	 *
+	 * @return	Pointer to the ScanFilter
+	 */
+	ScanFilter * filter();
+
+	/**
+	 * Gets a copy of the filtered ranges of the latest scan. Invalid ranges
+	 * are set to SCANFILTER_INVALID_RANGE. May be called from any thread.
+	 *
+	 * @return	The filtered ranges
+	 */
+	std::vector<float> filteredRanges() const;
+
+	/**
+	 * Copies the filtered ranges of the latest scan together with their
+	 * angles, all from the same scan. Reuses the capacity of @a ranges, for
+	 * callers copying every scan. May be called from any thread.
+	 *
+	 * @param	ranges	Output, the filtered ranges
+	 * @param	angleMin	Output, the angle of the first range in rad
+	 * @param	angleIncrement	Output, the angle between two ranges in rad
+	 */
+	void filteredScan( std::vector<float> & ranges, float & angleMin, float & angleIncrement ) const;
+
+	/**
+	 * Gets the angle of the first of the filtered ranges. May be called from
+	 * any thread.
+	 *
+	 * @return	The angle in rad
+	 */
+	float filteredAngleMin() const;
+
+	/**
+	 * Gets the angle between two of the filtered ranges, which differs from
+	 * the scanners increment if the scan is decimated. May be called from
+	 * any thread.
+	 *
+	 * @return	The angle in rad
+	 */
+	float filteredAngleIncrement() const;
+
+	/**
+	 * Gets a copy of the lines extracted from the latest scan. May be called
+	 * from any thread.
+	 *
+	 * @return	The extracted lines, relative to Robotinos center
+	 */
+	std::vector<ScanLine> lines() const;
+
+	/**
+	 * Gets a copy of the corners extracted from the latest scan. May be
+	 * called from any thread.
+	 *
+	 * @return	The extracted corners, relative to Robotinos center
 	 */
-	void readingsToString();
+	std::vector<ScanCorner> corners() const;
+
+	/**
+	 * Prints the lines and corners extracted from the latest scan. May be
+	 * called from any thread.
+	 *
+	 * @param	out	The stream to print to
+	 */
+	void featuresToString( std::ostream & out );
 
  private:
 	rec::robotino::api2::LaserRangeFinderReadings
 	/// The last laserRangeFinderReadings object
 		latestReadings;
 
+	ScanFilter
+	/// The filter chain applied to each scan
+		scanFilter;
+
+	std::vector<float>
+	/// Buffer holding the filtered ranges of the scan being processed, kept
+	/// between scans. Only used by the Brain thread.
+		ranges,
+	/// Copy of the filtered ranges of the latest processed scan, protected by
+	/// scanMutex
+		publishedRanges;
+
+	float
+	/// The angle of the first filtered range
+		rangesAngleMin,
+	/// The angle between two filtered ranges
+		rangesAngleIncrement,
+	/// The angle of the first published range, protected by scanMutex
+		publishedAngleMin,
+	/// The angle between two published ranges, protected by scanMutex
+		publishedAngleIncrement;
+
+	mutable std::mutex
+	/// Protects the results published for other threads
+		scanMutex;
+
+	LineExtractor
+	/// Extracts lines and corners from the scans, only used by the Brain
+	/// thread
+		extractor;
+
+	std::vector<ScanLine>
+	/// Copy of the lines of the latest processed scan, protected by scanMutex
+		publishedLines;
+
+	std::vector<ScanCorner>
+	/// Copy of the corners of the latest processed scan, protected by
+	/// scanMutex
+		publishedCorners;
+
 	bool
 	/// If the readings were updated in the last cycle
 		readingsUpdated;
@@ -69,6 +199,24 @@ class _LaserRangeFinder :
 	 * See RobotinoAPI2 documentation for details.
 	 */
 	void scanEvent( const rec::robotino::api2::LaserRangeFinderReadings & scan );
+
+	/**
+	 * Copies the latest readings into the ranges buffer and runs the filter
+	 * chain on them.
+	 */
+	void filterReadings();
+
+	/**
+	 * Inserts the filtered ranges into Brains ObstacleIndex, replacing the
+	 * previous scan.
+	 */
+	void updateObstacles();
+
+	/**
+	 * Copies the results of the processed scan for the getters, under
+	 * scanMutex. Copy assignment reuses the capacity of the copies.
+	 */
+	void publishScan();
 };
 
 #endif
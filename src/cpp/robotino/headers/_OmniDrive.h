@@ -89,6 +89,17 @@ class AngularCoordinate;
 #define OMNIDRIVE_POINTING_TARGET_MIN_DISTANCE	0.0
 
 
+	// Obstacles
+
+/// The clearance along the direction of travel below which Robotino will not
+/// drive, in meters. Turning is still allowed.
+#define OMNIDRIVE_CLEARANCE_STOP_DISTANCE	0.05
+/// The clearance along the direction of travel below which speed will be
+/// limited, in meters. The speed limit is reduced linearly towards 0 at
+/// OMNIDRIVE_CLEARANCE_STOP_DISTANCE.
+#define OMNIDRIVE_CLEARANCE_SLOW_DISTANCE	0.5
+
+
 /**
  * Reimplementation of the OmniDrive class from RobotinoAPI2
  *
@@ -98,7 +109,8 @@ class AngularCoordinate;
  * easily drive Robotino to a destination just by providing the desired
  * coordinate. Other features include pointing at a coordinate, stopping at
  * a desired distance, smooth accelleration and both smooth and emergency
- * stopping.
+ * stopping. Speed is limited by the clearance reported by Brains
+ * ObstacleIndex, slowing Robotino down before the bumper is triggered.
  *
  * See @link _OmniDrive.h @endlink for documentation of @c \#define parameters
  */
@@ -220,6 +232,16 @@ class _OmniDrive : public Axon, public rec::robotino::api2::OmniDrive
 	 * @param omega		Desired rotation speed
 	 */
 	void setVelocity( float xSpeed, float ySpeed, float omega );
+
+	/**
+	 * Gets the speeds last set to Robotino, by the automatic driving system
+	 * or by setVelocity()
+	 *
+	 * @param	xSpeed	Output, the speed in x direction
+	 * @param	ySpeed	Output, the speed in y direction
+	 * @param	omega	Output, the rotation speed
+	 */
+	void velocity( float * xSpeed, float * ySpeed, float * omega );
 	
 
  private:
@@ -327,6 +349,12 @@ class _OmniDrive : public Axon, public rec::robotino::api2::OmniDrive
 	 * @return	A speed complying with the set options
 	 */
 	float softAccellerate( float newSpeed, float currentSpeed, bool rotation = false );
+
+	/**
+	 * Reduces the speeds in x and y direction if the clearance along the
+	 * direction of travel is too small. The direction of travel is kept.
+	 */
+	void limitByClearance();
 };
 
 #endif
@@ -0,0 +1,322 @@
+#include "CommandServer.h"
+#include "TcpSocket.h"
+
+#include <arpa/inet.h>
+#include <sys/uio.h>
+#include <string.h>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <mutex>
+
+
+CommandServer::CommandServer( std::string port, Reactor * pReactor )
+{
+	this->pReactor = pReactor;
+	this->stopping = false;
+	this->nextId = 1;
+	this->executed = 0;
+	this->late = 0;
+	this->rejected = 0;
+	this->totalUsecs = 0;
+	this->maxUsecs = 0;
+
+	this->pServer = new TcpSocket( const_cast<char *>( port.c_str() ) );
+	this->pReactor->add( this->pServer->serverDescriptor(), this );
+}
+
+CommandServer::~CommandServer()
+{
+	this->stop();
+
+	this->pReactor->remove( this->pServer->serverDescriptor() );
+
+	while ( ! this->connections.empty() )
+		this->disconnect( this->connections.begin()->first );
+
+	delete this->pServer;
+}
+
+bool
+CommandServer::next( Command & command )
+{
+	std::unique_lock<std::mutex> lock( this->mutex );
+
+	while ( this->commands.empty() && ! this->stopping )
+		this->queued.wait( lock );
+
+	if ( this->stopping ) return false;
+
+	command = this->commands.front();
+	this->commands.pop_front();
+	return true;
+}
+
+void
+CommandServer::reply( const Command & command, const std::string & status, const std::string & output )
+{
+	unsigned long long usecs = std::chrono::duration_cast<std::chrono::microseconds>(
+			std::chrono::steady_clock::now() - command.received ).count();
+
+	std::ostringstream reply;
+	reply << status << " " << usecs << "\n" << output;
+
+	std::lock_guard<std::mutex> lock( this->mutex );
+
+	this->executed++;
+	this->totalUsecs += usecs;
+	if ( usecs > this->maxUsecs ) this->maxUsecs = usecs;
+	if ( usecs > COMMANDSERVER_LATENCY_TARGET ) this->late++;
+
+	// The client may have disconnected, or been replaced by a new client
+	// on the same descriptor
+	for ( std::map<int, Client *>::iterator it = this->connections.begin(); it != this->connections.end(); ++it )
+	{
+		if ( it->second->id != command.client ) continue;
+		this->queueReply( it->first, it->second, reply.str() );
+		break;
+	}
+}
+
+void
+CommandServer::stop()
+{
+	{
+		std::lock_guard<std::mutex> lock( this->mutex );
+		this->stopping = true;
+	}
+	this->queued.notify_all();
+}
+
+void
+CommandServer::readable( int descriptor )
+{
+	if ( descriptor == this->pServer->serverDescriptor() )
+	{
+		this->acceptClients();
+		return;
+	}
+
+	Client * client = NULL;
+	{
+		std::lock_guard<std::mutex> lock( this->mutex );
+		std::map<int, Client *>::iterator it = this->connections.find( descriptor );
+		if ( it != this->connections.end() ) client = it->second;
+	}
+	if ( client == NULL ) return;
+
+	// Clients are only removed by the Reactor thread
+	if ( ! this->receive( client ) ) this->disconnect( descriptor );
+}
+
+void
+CommandServer::writable( int descriptor )
+{
+	if ( ! this->flush( descriptor ) ) this->disconnect( descriptor );
+}
+
+void
+CommandServer::serverToString( std::ostream & out )
+{
+	std::lock_guard<std::mutex> lock( this->mutex );
+
+	out
+		<< "CommandServer: " << this->connections.size() << " clients, "
+		<< this->commands.size() << " commands queued, "
+		<< this->executed << " executed, " << this->rejected << " busy" << std::endl;
+
+	if ( this->executed > 0 )
+		out
+			<< "  latency: mean " << ( this->totalUsecs / this->executed )
+			<< " us, max " << this->maxUsecs
+			<< " us, " << this->late << " over " << COMMANDSERVER_LATENCY_TARGET << " us" << std::endl;
+
+	for ( std::map<int, Client *>::iterator it = this->connections.begin(); it != this->connections.end(); ++it )
+		out
+			<< "  client " << it->second->id
+			<< ": commands " << it->second->commands
+			<< ", replies queued " << it->second->replies.size() << std::endl;
+}
+
+
+// Private functions
+
+void
+CommandServer::acceptClients()
+{
+	TcpSocket * socket;
+	while ( ( socket = this->pServer->acceptClient() ) != NULL )
+	{
+		Client * client = new Client();
+		client->socket = socket;
+		client->length = 0;
+		client->offset = 0;
+		client->writing = false;
+		client->commands = 0;
+
+		int descriptor = socket->descriptor();
+		{
+			std::lock_guard<std::mutex> lock( this->mutex );
+			if ( this->connections.size() >= COMMANDSERVER_MAX_CLIENTS )
+			{
+				std::cerr << "CommandServer: Too many clients, connection refused" << std::endl;
+				delete socket;
+				delete client;
+				continue;
+			}
+
+			client->id = this->nextId++;
+			this->connections[ descriptor ] = client;
+		}
+
+		if ( ! this->pReactor->add( descriptor, this ) )
+		{
+			this->disconnect( descriptor );
+			continue;
+		}
+
+		std::cerr << "CommandServer: Client " << client->id << " connected" << std::endl;
+	}
+}
+
+bool
+CommandServer::receive( Client * client )
+{
+	const char * data;
+
+	while ( true )
+	{
+		if ( client->length == 0 )
+		{
+			if ( ! client->socket->readBytes( data, COMMANDSERVER_HEADER_SIZE ) ) break;
+
+			uint32_t length;
+			memcpy( & length, data, COMMANDSERVER_HEADER_SIZE );
+			client->length = ntohl( length );
+
+			if ( client->length > COMMANDSERVER_MAX_COMMAND )
+			{
+				std::cerr << "CommandServer: Command of " << client->length << " bytes from client " << client->id << " too long" << std::endl;
+				return false;
+			}
+
+			// An empty frame carries no command
+			if ( client->length == 0 ) continue;
+		}
+
+		if ( ! client->socket->readBytes( data, client->length ) ) break;
+
+		Command command;
+		command.client = client->id;
+		command.text.assign( data, client->length );
+		command.received = std::chrono::steady_clock::now();
+		client->length = 0;
+
+		std::lock_guard<std::mutex> lock( this->mutex );
+		client->commands++;
+
+		if ( this->commands.size() >= COMMANDSERVER_QUEUE_SIZE )
+		{
+			this->rejected++;
+			this->queueReply( client->socket->descriptor(), client, "BUSY 0\n" );
+			continue;
+		}
+
+		this->commands.push_back( command );
+		this->queued.notify_one();
+	}
+
+	return client->socket->isConnected();
+}
+
+void
+CommandServer::queueReply( int descriptor, Client * client, const std::string & reply )
+{
+	uint32_t length = htonl( reply.size() );
+
+	std::string frame;
+	frame.reserve( COMMANDSERVER_HEADER_SIZE + reply.size() );
+	frame.append( reinterpret_cast<const char *>( & length ), COMMANDSERVER_HEADER_SIZE );
+	frame.append( reply );
+	client->replies.push_back( frame );
+
+	// A client with too many replies is disconnected by flush()
+	if ( ! client->writing )
+	{
+		client->writing = true;
+		this->pReactor->setWritable( descriptor, true );
+	}
+}
+
+bool
+CommandServer::flush( int descriptor )
+{
+	struct iovec vectors[ TCPSOCKET_WRITE_BATCH ];
+	unsigned int count = 0;
+
+	std::lock_guard<std::mutex> lock( this->mutex );
+	std::map<int, Client *>::iterator it = this->connections.find( descriptor );
+	if ( it == this->connections.end() ) return true;
+	Client * client = it->second;
+
+	if ( client->replies.size() > COMMANDSERVER_MAX_REPLIES )
+	{
+		std::cerr << "CommandServer: Client " << client->id << " is not reading its replies" << std::endl;
+		return false;
+	}
+
+	for ( ; count < client->replies.size() && count < TCPSOCKET_WRITE_BATCH; count++ )
+	{
+		const std::string & reply = client->replies[ count ];
+		size_t offset = ( count == 0 ) ? client->offset : 0;
+		vectors[ count ].iov_base = const_cast<char *>( reply.data() ) + offset;
+		vectors[ count ].iov_len = reply.size() - offset;
+	}
+
+	// The write does not block, so the lock is held while sending
+	long written = ( count > 0 ) ? client->socket->writeAvailable( vectors, count ) : 0;
+	if ( written == -1 ) return false;
+
+	// Remove the replies sent, keeping the position in a partly sent reply
+	size_t remaining = written;
+	while ( remaining > 0 )
+	{
+		size_t left = client->replies.front().size() - client->offset;
+		if ( remaining < left )
+		{
+			client->offset += remaining;
+			break;
+		}
+
+		remaining -= left;
+		client->replies.pop_front();
+		client->offset = 0;
+	}
+
+	if ( client->replies.empty() )
+	{
+		client->writing = false;
+		this->pReactor->setWritable( descriptor, false );
+	}
+
+	return true;
+}
+
+void
+CommandServer::disconnect( int descriptor )
+{
+	Client * client;
+	{
+		std::lock_guard<std::mutex> lock( this->mutex );
+		std::map<int, Client *>::iterator it = this->connections.find( descriptor );
+		if ( it == this->connections.end() ) return;
+		client = it->second;
+		this->connections.erase( it );
+	}
+
+	std::cerr << "CommandServer: Client " << client->id << " disconnected" << std::endl;
+
+	this->pReactor->remove( descriptor );
+	delete client->socket;
+	delete client;
+}
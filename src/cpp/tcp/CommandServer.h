@@ -0,0 +1,240 @@
+#ifndef COMMANDSERVER_H
+#define COMMANDSERVER_H
+
+#include "Reactor.h"
+
+#include <stdint.h>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <map>
+#include <mutex>
+#include <ostream>
+#include <string>
+
+class TcpSocket;
+
+/// The size of the length prefix of commands and replies, in bytes
+#define COMMANDSERVER_HEADER_SIZE	4
+/// The longest command accepted, a client sending a longer command is
+/// disconnected
+#define COMMANDSERVER_MAX_COMMAND	1024
+/// The maximum number of commands waiting to be executed, further commands
+/// are answered BUSY
+#define COMMANDSERVER_QUEUE_SIZE	64
+/// The maximum number of replies waiting to be sent to a client, a client
+/// not reading its replies is disconnected
+#define COMMANDSERVER_MAX_REPLIES	64
+/// The maximum number of clients, further connections are closed
+#define COMMANDSERVER_MAX_CLIENTS	8
+/// Microseconds from receiving a command until it has been executed, commands
+/// answered later are counted as late
+#define COMMANDSERVER_LATENCY_TARGET	2000
+
+
+/**
+ * A command received by a CommandServer
+ */
+struct Command
+{
+	/// The client sending the command
+	unsigned int client;
+	/// The command, like a line typed at the prompt
+	std::string text;
+	/// When the whole command had been received
+	std::chrono::steady_clock::time_point received;
+};
+
+/**
+ * Takes commands from any number of clients over TCP, for scripting the
+ * robot without a terminal.
+ *
+ * Commands and replies are framed by a COMMANDSERVER_HEADER_SIZE byte length
+ * in network byte order, followed by that many bytes of text, and empty
+ * frames are ignored. A client may send several commands without waiting
+ * for the replies, which come in the order of the commands, except that a
+ * command refused because COMMANDSERVER_QUEUE_SIZE commands are waiting is
+ * answered BUSY at once. Each reply is
+ *
+ *	<status> <microseconds>\n<output>
+ *
+ * where status is given by the executor, like OK or FAILED, or BUSY if the
+ * server was full, microseconds is the time from receiving the command
+ * until it had been executed, and output is any text written by the
+ * command. Commands arriving faster than they are executed are answered
+ * late rather than dropped, the latency of the answers is kept against
+ * COMMANDSERVER_LATENCY_TARGET.
+ *
+ * The Reactor thread receives the commands and queues them for an executor
+ * thread, which takes them in order with next() and answers them with
+ * reply(). The replies are sent by the Reactor thread.
+ */
+class CommandServer : public ReactorHandler
+{
+	public:
+		/**
+		 * Starts listening for clients on the Reactor
+		 *
+		 * @param	port	The port to listen on
+		 * @param	pReactor	The Reactor handling the connections
+		 *
+		 * @throws	std::runtime_error* if unable to listen on the port
+		 */
+		CommandServer( std::string port, Reactor * pReactor );
+
+		/**
+		 * Destructor, closes all connections. The Reactor must be stopped.
+		 */
+		~CommandServer();
+
+		/**
+		 * Waits for the next command from any client
+		 *
+		 * @param	command	Output, the command
+		 *
+		 * @return	@c false if stop() has been called
+		 */
+		bool next( Command & command );
+
+		/**
+		 * Queues the reply to a command taken by next(). Does not block on
+		 * the network, the reply is discarded if the client has
+		 * disconnected.
+		 *
+		 * @param	command	The command answered
+		 * @param	status	The status of the command, a single word
+		 * @param	output	Any text written by the command
+		 */
+		void reply( const Command & command, const std::string & status, const std::string & output );
+
+		/**
+		 * Makes next() return @c false, for stopping the executor thread
+		 */
+		void stop();
+
+		/**
+		 * Accepts clients, or receives commands from a client
+		 */
+		void readable( int descriptor );
+
+		/**
+		 * Sends the queued replies of a client
+		 */
+		void writable( int descriptor );
+
+		/**
+		 * Prints the clients and the latency of the commands executed
+		 *
+		 * @param	out	The stream to print to
+		 */
+		void serverToString( std::ostream & out );
+
+	private:
+		/**
+		 * A connected client and its queue of replies
+		 */
+		struct Client
+		{
+			/// The identifier given to commands, descriptors are reused
+			unsigned int id;
+			/// The connection
+			TcpSocket * socket;
+			/// Length of the command being received, 0 while waiting for
+			/// a header
+			uint32_t length;
+			/// Framed replies waiting to be sent, oldest first
+			std::deque<std::string> replies;
+			/// Bytes of the first queued reply already sent
+			size_t offset;
+			/// If the descriptor is watched for writing
+			bool writing;
+			/// Commands received
+			unsigned long long commands;
+		};
+
+		/// The listening socket
+		TcpSocket
+			* pServer;
+
+		/// The Reactor handling the connections
+		Reactor
+			* pReactor;
+
+		/// Protects the clients, the queue of commands and the statistics
+		std::mutex
+			mutex;
+
+		/// Signals the executor of new commands
+		std::condition_variable
+			queued;
+
+		/// The clients, by descriptor
+		std::map<int, Client *>
+			connections;
+
+		/// Commands waiting to be executed, oldest first
+		std::deque<Command>
+			commands;
+
+		/// Set by stop()
+		bool
+			stopping;
+
+		unsigned int
+		/// The identifier of the next client
+			nextId;
+
+		unsigned long long
+		/// Commands answered by the executor
+			executed,
+		/// Commands answered later than COMMANDSERVER_LATENCY_TARGET
+			late,
+		/// Commands answered BUSY
+			rejected,
+		/// Total microseconds from receiving to answering, for the mean
+			totalUsecs,
+		/// The longest microseconds from receiving to answering
+			maxUsecs;
+
+		/**
+		 * Accepts all waiting clients
+		 */
+		void acceptClients();
+
+		/**
+		 * Receives the complete commands of a client
+		 *
+		 * @param	client	The client
+		 *
+		 * @return	@c false if the connection was closed or failed, or the
+		 * 			client sent a too long command
+		 */
+		bool receive( Client * client );
+
+		/**
+		 * Frames a reply and queues it for a client, the mutex must be held
+		 *
+		 * @param	descriptor	The descriptor of the client
+		 * @param	client	The client
+		 * @param	reply	The reply, without the length
+		 */
+		void queueReply( int descriptor, Client * client, const std::string & reply );
+
+		/**
+		 * Sends as many queued replies to a client as the socket accepts
+		 *
+		 * @param	descriptor	The descriptor of the client
+		 *
+		 * @return	@c false if the connection failed
+		 */
+		bool flush( int descriptor );
+
+		/**
+		 * Disconnects a client and discards its replies
+		 *
+		 * @param	descriptor	The descriptor of the client
+		 */
+		void disconnect( int descriptor );
+};
+
+#endif
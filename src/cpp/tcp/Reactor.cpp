@@ -0,0 +1,226 @@
+#include "Reactor.h"
+
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+#include <stdint.h>
+#include <errno.h>
+#include <string.h>
+#include <iostream>
+#include <vector>
+#include <map>
+#include <mutex>
+#include <chrono>
+
+
+Reactor::Reactor()
+{
+	this->running = false;
+	this->stopping = false;
+
+	this->epollFD = epoll_create1( EPOLL_CLOEXEC );
+	this->wakeFD = eventfd( 0, EFD_NONBLOCK | EFD_CLOEXEC );
+
+	if ( this->epollFD == -1 || this->wakeFD == -1 )
+	{
+		std::cerr << "Reactor: Unable to create epoll instance: " << strerror( errno ) << std::endl;
+		return;
+	}
+
+	struct epoll_event event;
+	memset( & event, 0, sizeof( event ) );
+	event.events = EPOLLIN;
+	event.data.fd = this->wakeFD;
+	epoll_ctl( this->epollFD, EPOLL_CTL_ADD, this->wakeFD, & event );
+}
+
+Reactor::~Reactor()
+{
+	if ( this->wakeFD != -1 ) close( this->wakeFD );
+	if ( this->epollFD != -1 ) close( this->epollFD );
+}
+
+bool
+Reactor::add( int descriptor, ReactorHandler * handler, bool writable )
+{
+	std::lock_guard<std::mutex> lock( this->mutex );
+
+	struct epoll_event event;
+	memset( & event, 0, sizeof( event ) );
+	event.events = EPOLLIN | EPOLLRDHUP | ( writable ? EPOLLOUT : 0 );
+	event.data.fd = descriptor;
+
+	if ( epoll_ctl( this->epollFD, EPOLL_CTL_ADD, descriptor, & event ) == -1 )
+	{
+		std::cerr << "Reactor: Unable to add descriptor: " << strerror( errno ) << std::endl;
+		return false;
+	}
+
+	this->handlers[ descriptor ] = handler;
+	return true;
+}
+
+bool
+Reactor::setWritable( int descriptor, bool writable )
+{
+	std::lock_guard<std::mutex> lock( this->mutex );
+
+	struct epoll_event event;
+	memset( & event, 0, sizeof( event ) );
+	event.events = EPOLLIN | EPOLLRDHUP | ( writable ? EPOLLOUT : 0 );
+	event.data.fd = descriptor;
+
+	return ( epoll_ctl( this->epollFD, EPOLL_CTL_MOD, descriptor, & event ) == 0 );
+}
+
+void
+Reactor::remove( int descriptor )
+{
+	std::lock_guard<std::mutex> lock( this->mutex );
+
+	epoll_ctl( this->epollFD, EPOLL_CTL_DEL, descriptor, NULL );
+	this->handlers.erase( descriptor );
+}
+
+void
+Reactor::schedule( ReactorHandler * handler, unsigned int delayMsecs )
+{
+	{
+		std::lock_guard<std::mutex> lock( this->mutex );
+
+		this->removeTimer( handler );
+		this->timers.insert( std::make_pair(
+				std::chrono::steady_clock::now() + std::chrono::milliseconds( delayMsecs ),
+				handler ) );
+	}
+
+	this->wake();
+}
+
+void
+Reactor::cancel( ReactorHandler * handler )
+{
+	std::lock_guard<std::mutex> lock( this->mutex );
+	this->removeTimer( handler );
+}
+
+void
+Reactor::run()
+{
+	struct epoll_event events[ REACTOR_MAX_EVENTS ];
+	std::vector<ReactorHandler *> due;
+
+	this->running = true;
+
+	while ( ! this->stopping )
+	{
+		// Wait until the next timer is due, or indefinitely without timers
+		int waitMsecs = -1;
+		{
+			std::lock_guard<std::mutex> lock( this->mutex );
+			if ( ! this->timers.empty() )
+			{
+				std::chrono::steady_clock::duration remaining =
+					this->timers.begin()->first - std::chrono::steady_clock::now();
+				waitMsecs = ( remaining.count() > 0 )
+					? std::chrono::duration_cast<std::chrono::milliseconds>( remaining ).count() + 1
+					: 0;
+			}
+		}
+
+		int count = epoll_wait( this->epollFD, events, REACTOR_MAX_EVENTS, waitMsecs );
+		if ( count == -1 && errno != EINTR )
+		{
+			std::cerr << "Reactor: Wait failed: " << strerror( errno ) << std::endl;
+			break;
+		}
+
+		for ( int i = 0; i < count; i++ )
+		{
+			int descriptor = events[ i ].data.fd;
+
+			if ( descriptor == this->wakeFD )
+			{
+				uint64_t value;
+				while ( ::read( this->wakeFD, & value, sizeof( value ) ) > 0 );
+				continue;
+			}
+
+			// Look up the handler for each call, it may have been removed
+			// by an earlier call
+			ReactorHandler * handler;
+			if ( ( events[ i ].events & EPOLLOUT )
+					&& ( handler = this->handler( descriptor ) ) != NULL )
+				handler->writable( descriptor );
+			if ( ( events[ i ].events & ( EPOLLIN | EPOLLRDHUP | EPOLLHUP | EPOLLERR ) )
+					&& ( handler = this->handler( descriptor ) ) != NULL )
+				handler->readable( descriptor );
+		}
+
+		// Collect the timers that are due, and call them without the lock
+		due.clear();
+		{
+			std::lock_guard<std::mutex> lock( this->mutex );
+			std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+			while ( ! this->timers.empty() && this->timers.begin()->first <= now )
+			{
+				due.push_back( this->timers.begin()->second );
+				this->timers.erase( this->timers.begin() );
+			}
+		}
+		for ( unsigned int i = 0; i < due.size(); i++ )
+			due[ i ]->timeout();
+	}
+
+	// Cleared here rather than when starting, so a stop() called before
+	// run() still stops the loop
+	this->stopping = false;
+	this->running = false;
+}
+
+void
+Reactor::stop()
+{
+	this->stopping = true;
+	this->wake();
+}
+
+bool
+Reactor::isRunning()
+{
+	return this->running;
+}
+
+
+// Private functions
+
+void
+Reactor::wake()
+{
+	uint64_t value = 1;
+	if ( ::write( this->wakeFD, & value, sizeof( value ) ) == -1 && errno != EAGAIN )
+		std::cerr << "Reactor: Unable to wake loop: " << strerror( errno ) << std::endl;
+}
+
+ReactorHandler *
+Reactor::handler( int descriptor )
+{
+	std::lock_guard<std::mutex> lock( this->mutex );
+
+	std::map<int, ReactorHandler *>::iterator it = this->handlers.find( descriptor );
+	return ( it != this->handlers.end() ) ? it->second : NULL;
+}
+
+void
+Reactor::removeTimer( ReactorHandler * handler )
+{
+	std::multimap<std::chrono::steady_clock::time_point, ReactorHandler *>::iterator it =
+		this->timers.begin();
+	while ( it != this->timers.end() )
+	{
+		if ( it->second == handler )
+			this->timers.erase( it++ );
+		else
+			++it;
+	}
+}
@@ -0,0 +1,184 @@
+#ifndef REACTOR_H
+#define REACTOR_H
+
+#include <map>
+#include <mutex>
+#include <atomic>
+#include <chrono>
+
+/// The maximum number of descriptor events handled per wait
+#define REACTOR_MAX_EVENTS	16
+
+
+/**
+ * Interface for objects handling descriptors and timers of a Reactor
+ */
+class ReactorHandler
+{
+	public:
+		virtual ~ReactorHandler() {}
+
+		/**
+		 * Called by the Reactor thread when a descriptor added with
+		 * Reactor::add() has data to read, or has been closed by the peer.
+		 * The descriptor is level triggered, the handler should read until
+		 * the read would block.
+		 *
+		 * @param	descriptor	The readable descriptor
+		 */
+		virtual void readable( int descriptor ) = 0;
+
+		/**
+		 * Called by the Reactor thread when a descriptor watched for
+		 * writing can be written to, or a connect has completed, see
+		 * Reactor::setWritable()
+		 *
+		 * @param	descriptor	The writable descriptor
+		 */
+		virtual void writable( int descriptor ) {}
+
+		/**
+		 * Called by the Reactor thread when a timer set with
+		 * Reactor::schedule() expires
+		 */
+		virtual void timeout() {}
+};
+
+/**
+ * Single threaded event loop for network connections, multiplexing
+ * non-blocking descriptors and timers with epoll.
+ *
+ * Descriptors and timers are added from any thread, while all handler calls
+ * are made from the thread running run(). Handlers must not block, as they
+ * hold up every other connection on the Reactor.
+ */
+class Reactor
+{
+	public:
+		/**
+		 * Constructs the Reactor, creating the epoll instance
+		 */
+		Reactor();
+
+		/**
+		 * Destructor, closes the epoll instance. The loop must be stopped.
+		 */
+		~Reactor();
+
+		/**
+		 * Starts watching a descriptor for incoming data
+		 *
+		 * @param	descriptor	The descriptor, should be non-blocking
+		 * @param	handler	The handler called when the descriptor is
+		 * 					readable
+		 * @param	writable	If the descriptor is also watched for
+		 * 					writing, see setWritable()
+		 *
+		 * @return	Success of adding the descriptor
+		 */
+		bool add( int descriptor, ReactorHandler * handler, bool writable = false );
+
+		/**
+		 * Starts or stops watching a descriptor for writing. Watch while
+		 * a connect is in progress or while output is queued, as the
+		 * handler is called for as long as the descriptor is writable.
+		 *
+		 * @param	descriptor	The descriptor, already added
+		 * @param	writable	If the descriptor is watched for writing
+		 *
+		 * @return	Success of changing the watch
+		 */
+		bool setWritable( int descriptor, bool writable );
+
+		/**
+		 * Stops watching a descriptor. Must be called before the
+		 * descriptor is closed.
+		 *
+		 * @param	descriptor	The descriptor
+		 */
+		void remove( int descriptor );
+
+		/**
+		 * Schedules a call to the timeout() function of a handler,
+		 * replacing any call already scheduled for the handler
+		 *
+		 * @param	handler	The handler
+		 * @param	delayMsecs	The delay before the call, in milliseconds
+		 */
+		void schedule( ReactorHandler * handler, unsigned int delayMsecs );
+
+		/**
+		 * Cancels any scheduled call for a handler
+		 *
+		 * @param	handler	The handler
+		 */
+		void cancel( ReactorHandler * handler );
+
+		/**
+		 * Runs the event loop until stop() is called. The loop may be run
+		 * again after returning.
+		 */
+		void run();
+
+		/**
+		 * Signals the event loop to exit, may be called from any thread
+		 */
+		void stop();
+
+		/**
+		 * Checks if the event loop is running
+		 *
+		 * @return	Boolean indicating status
+		 */
+		bool isRunning();
+
+	private:
+		int
+		/// The epoll instance
+			epollFD,
+		/// Eventfd used to wake the loop when timers change or on stop
+			wakeFD;
+
+		std::atomic<bool>
+		/// If the loop is running
+			running,
+		/// Stop variable for the loop, set by stop() from any thread and
+		/// cleared when run() returns
+			stopping;
+
+		/// Protects the handlers and timers, and serializes changes to the
+		/// epoll instance
+		std::mutex
+			mutex;
+
+		/// The handlers of the watched descriptors
+		std::map<int, ReactorHandler *>
+			handlers;
+
+		/// The scheduled timeouts, ordered by due time
+		std::multimap<std::chrono::steady_clock::time_point, ReactorHandler *>
+			timers;
+
+		/**
+		 * Wakes the loop from waiting
+		 */
+		void wake();
+
+		/**
+		 * Finds the handler of a descriptor
+		 *
+		 * @param	descriptor	The descriptor
+		 *
+		 * @return	The handler, NULL if the descriptor has been removed
+		 */
+		ReactorHandler * handler( int descriptor );
+
+		/**
+		 * Removes any scheduled call for a handler, the mutex must be held
+		 *
+		 * @param	handler	The handler
+		 */
+		void removeTimer( ReactorHandler * handler );
+};
+
+#endif
@@ -6,6 +6,9 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <unistd.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <errno.h>
 #include <string.h>
 #include <string>
 #include <sstream>
@@ -35,6 +38,10 @@ TcpSocket::TcpSocket()
 {
 	this->isServer = false;
 	this->_isConnected = false;
+	this->socketFD = -1;
+	this->connectionFD = -1;
+	this->lastError = 0;
+	this->resetReadBuffer();
 }
 
 /**
@@ -46,13 +53,15 @@ TcpSocket::TcpSocket(char port[])
 {
 	isServer = true;
 	_isConnected = false;
+	socketFD = -1;
+	connectionFD = -1;
+	lastError = 0;
+	resetReadBuffer();
 
 	debug("Creating server");
 
 	struct addrinfo hints;
 	struct addrinfo *result, *rp;
-	struct sockaddr_storage _peer_addr;
-	this->peer_addr = &_peer_addr;
 
 	memset(&hints, 0, sizeof(struct addrinfo));
 	hints.ai_family = AF_UNSPEC;    /*  Allow IPv4 or IPv6 */
@@ -64,20 +73,20 @@ TcpSocket::TcpSocket(char port[])
 	hints.ai_next = NULL;
 	
 	int s = getaddrinfo(NULL, port, &hints, &result);
-	if (s != 0) {
-//		std::string errormsg
-//		throw new std::runtime_error( "getaddrinfo: " << gai_strerrror( s ) );
-//		fprintf(stderr, "getaddrinfo: %s\n", gai_strerror(s));
-		exit(EXIT_FAILURE);
-	}
+	if (s != 0)
+		throw new std::runtime_error(std::string("getaddrinfo: ") + gai_strerror(s));
 
 	for (rp = result; rp != NULL; rp = rp->ai_next) {
-		socketFD = socket(rp->ai_family, rp->ai_socktype,
+		socketFD = socket(rp->ai_family, rp->ai_socktype | SOCK_NONBLOCK | SOCK_CLOEXEC,
 		rp->ai_protocol);
 	
 		if (socketFD == -1)
 			continue;
 
+		// Allow restarting the server while old connections linger
+		int reuse = 1;
+		setsockopt(socketFD, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+
 		if (bind(socketFD, rp->ai_addr, rp->ai_addrlen) == 0)
 		{
 			debug("Bind success");
@@ -87,23 +96,18 @@ TcpSocket::TcpSocket(char port[])
 		::close(socketFD);
 	}
    
-	if (rp == NULL) {               /*  No address succeeded */
-		/// @todo throw exception instead of stderr+exit()
-		fprintf(stderr, "Could not bind\n");
-		exit(EXIT_FAILURE);
-	}
-		  
 	freeaddrinfo(result);           /*  No longer needed */
+
+	if (rp == NULL)                 /*  No address succeeded */
+		throw new std::runtime_error("Could not bind");
 	
 	if (listen(socketFD, 5) == -1)
 	{
-		/// @todo throw exception instead of stderr+exit()
-		fprintf(stderr, "Could not listen\n");
-		exit(EXIT_FAILURE);
+		::close(socketFD);
+		socketFD = -1;
+		throw new std::runtime_error("Could not listen");
 	}
 	debug("Listening");
-
-	peer_addr_len = sizeof(struct sockaddr_storage);
 }
 
 /**
@@ -111,10 +115,44 @@ TcpSocket::TcpSocket(char port[])
  * Based on getaddrinfo() manpage's example
  * server and client
  */
-void TcpSocket::client(char port[], char host[])
+void TcpSocket::client(const char port[], const char host[])
+{
+	if (!connectAsync(port, host))
+		throw new std::runtime_error(std::string("Could not connect: ") + strerror(lastError));
+
+	if (!_isConnected)
+	{
+		// Wait for the connection to complete, within the timeout
+		struct pollfd pending;
+		pending.fd = socketFD;
+		pending.events = POLLOUT;
+		pending.revents = 0;
+
+		int ready;
+		do
+			ready = poll(&pending, 1, TCPSOCKET_CONNECT_TIMEOUT);
+		while (ready == -1 && errno == EINTR);
+
+		if (ready == 0)
+		{
+			close();
+			throw new std::runtime_error("Could not connect: Timed out");
+		}
+
+		if (!finishConnect())
+			throw new std::runtime_error(std::string("Could not connect: ") + strerror(lastError));
+	}
+
+	setBlocking(true);
+}
+
+bool TcpSocket::connectAsync(std::string port, std::string host)
 {
 	isServer = false;
 	_isConnected = false;
+	lastError = 0;
+	close();
+	resetReadBuffer();
 
 	debug("Creating client");
 
@@ -129,78 +167,98 @@ void TcpSocket::client(char port[], char host[])
 	hints.ai_flags = 0;
 	hints.ai_protocol = 6;          /*  TCP protocol */
 
-	int s = getaddrinfo(host, port, &hints, &result);
+	int s = getaddrinfo(host.c_str(), port.c_str(), &hints, &result);
 	if (s != 0) {
 		fprintf(stderr, "getaddrinfo: %s\n", gai_strerror(s));
-		exit(EXIT_FAILURE);
+		lastError = EHOSTUNREACH;
+		return false;
 	}
 
-    for (rp = result; rp != NULL; rp = rp->ai_next)
+	for (rp = result; rp != NULL; rp = rp->ai_next)
 	{
-		socketFD = socket(rp->ai_family, rp->ai_socktype,
+		socketFD = socket(rp->ai_family, rp->ai_socktype | SOCK_NONBLOCK,
 		rp->ai_protocol);
 
 		if (socketFD == -1)
+		{
+			lastError = errno;
 			continue;
+		}
 
-		if (connect(socketFD, rp->ai_addr, rp->ai_addrlen) != -1)
+		if (connect(socketFD, rp->ai_addr, rp->ai_addrlen) == 0)
 		{
 			debug("Connected");
+			_isConnected = true;
 			break;					/* Success */
 		}
-													
+
+		if (errno == EINPROGRESS)
+		{
+			debug("Connecting");
+			break;					/* Completed by finishConnect() */
+		}
+
+		lastError = errno;
 		::close(socketFD);
+		socketFD = -1;
 	}
-	
-    if (rp == NULL) {               /*  No address succeeded */
-		/// @todo throw exception instead of stderr+exit()
-		fprintf(stderr, "Could not connect\n");
-		exit(EXIT_FAILURE);
+
+	freeaddrinfo(result);           /*  No longer needed */
+
+	if (rp == NULL) return false;   /*  No address succeeded */
+
+	connectionFD = socketFD;
+	return true;
+}
+
+bool TcpSocket::finishConnect()
+{
+	if (_isConnected) return true;
+
+	int error = 0;
+	socklen_t length = sizeof(error);
+	if (getsockopt(socketFD, SOL_SOCKET, SO_ERROR, &error, &length) == -1)
+		error = errno;
+
+	if (error != 0)
+	{
+		debug("Connect failed");
+		lastError = error;
+		close();
+		return false;
 	}
 
+	debug("Connected");
 	_isConnected = true;
+	return true;
+}
 
-	connectionFD = socketFD;
-		  
-	freeaddrinfo(result);           /*  No longer needed */
+int TcpSocket::error()
+{
+	return lastError;
 }
 
 TcpSocket::TcpSocket(char port[], char host[])
 {
+	socketFD = -1;
+	connectionFD = -1;
 	client( port, host);
 }
 
 TcpSocket::TcpSocket( std::string port, std::string server )
 {
-	int portSize = port.size();
-	char charPort[ portSize + 1];
-	int i = 0;
-	while ( i <= portSize )
-	{
-		charPort[ i ] = port[ i ];
-		i++;
-	}
-	charPort[ i ] = '\0';
-
-	int serverSize = server.size();
-	char charServer[ serverSize + 1];
-	i = 0;
-	while ( i <= serverSize )
-	{
-		charServer[ i ] = server[ i ];
-		i++;
-	}
-	charServer[ i ] = '\0';
+	socketFD = -1;
+	connectionFD = -1;
 
 	if ( DEBUG )
 	{
 		std::stringstream connection;
-		connection << charServer << ":" << charPort;
+		connection << server << ":" << port;
 
 		debug( "Connecting to: ", connection.str() );
 	}
 
-	client( charPort, charServer );
+	client( port.c_str(), server.c_str() );
 }
 
 
@@ -211,22 +269,66 @@ TcpSocket::TcpSocket( std::string port, std::string server )
  */
 bool TcpSocket::accept()
 {
-	do
+	while (true)
 	{
-		connectionFD = 
-			::accept(
-				socketFD,
-				(struct sockaddr *) &peer_addr,
-				&peer_addr_len);
-	} while (connectionFD == -1);
+		connectionFD = ::accept4(socketFD, NULL, NULL, SOCK_CLOEXEC);
+		if (connectionFD != -1) break;
+
+		if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR
+				&& errno != ECONNABORTED)
+		{
+			lastError = errno;
+			return false;
+		}
+
+		// Sleep until a connection is waiting
+		struct pollfd listening;
+		listening.fd = socketFD;
+		listening.events = POLLIN;
+		listening.revents = 0;
+		if (poll(&listening, 1, -1) == -1 && errno != EINTR)
+		{
+			lastError = errno;
+			return false;
+		}
+	}
 
 	debug("Connection accepted");
 	
 	_isConnected = true;
+	resetReadBuffer();
 	
 	return true;
 }
 
+TcpSocket * TcpSocket::acceptClient()
+{
+	int connection;
+	do
+		connection = ::accept4(socketFD, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC);
+	while (connection == -1 && (errno == EINTR || errno == ECONNABORTED));
+
+	if (connection == -1)
+	{
+		if (errno != EAGAIN && errno != EWOULDBLOCK) lastError = errno;
+		return NULL;
+	}
+
+	debug("Client accepted");
+
+	// A client shares the descriptor for both, as after connecting
+	TcpSocket * client = new TcpSocket();
+	client->socketFD = connection;
+	client->connectionFD = connection;
+	client->_isConnected = true;
+	return client;
+}
+
+int TcpSocket::serverDescriptor()
+{
+	return isServer ? socketFD : -1;
+}
+
 
 /**
  * @author	s171170 Lars Øyvind Hagland
@@ -244,12 +346,10 @@ bool TcpSocket::read(std::string& recepticle, std::string endTag)
 		noRead = 0,
 		endTagLength = 0;
 
-	std::stringstream
-		ss;
+	recepticle.clear();
 
 	while (true)
 	{
-		bzero(buffer, BUF_SIZE+1);
 		length = ::recv(connectionFD, buffer, BUF_SIZE, 0);
 
 		noRead++;
@@ -266,13 +366,10 @@ bool TcpSocket::read(std::string& recepticle, std::string endTag)
 		total += length;
 	
 		buffer[length] = '\0';
-		ss << buffer;
+		recepticle.append(buffer, length);
 
 		if (endTag.empty() || (noRead == 1 && length < BUF_SIZE))
-		{
-			recepticle.assign(ss.str());
 			break;
-		}
 
 		if (endTagLength == 0) endTagLength = endTag.size();
 		int i = 0;
@@ -282,8 +379,6 @@ bool TcpSocket::read(std::string& recepticle, std::string endTag)
 			i++;
 		}
 
-		recepticle.assign(ss.str());
-
 		if (endTagLength > 0)
 		{
 			i = recepticle.size() - i;
@@ -301,48 +396,152 @@ bool TcpSocket::read(std::string& recepticle, std::string endTag)
 }
 
 
-/**
- * @author	s171170 Lars Øyvind Hagland
- */
-bool TcpSocket::write(std::string& message)
+bool TcpSocket::readLine(const char*& line, unsigned int& length)
 {
-	debug("Writing to socket:", message);
-	int
-		pos = 0,
-		cut,
-		length = message.size(),
-		writeLen;
+	while (true)
+	{
+		// Return the next complete line, if any
+		char * lineEnd = (char *) memchr(readBuffer + readScan, '\n', readEnd - readScan);
+		if (lineEnd != NULL)
+		{
+			char * begin = readBuffer + readStart;
+			*lineEnd = '\0';
+			readStart = readScan = lineEnd - readBuffer + 1;
+
+			if (readDiscarding)
+			{
+				readDiscarding = false;
+				continue;
+			}
+
+			length = lineEnd - begin;
+			if (length > 0 && begin[length - 1] == '\r') begin[--length] = '\0';
+			line = begin;
+			return true;
+		}
+		readScan = readEnd;
+
+		// Make room for more data, moving the partial line to the start
+		if (readStart == readEnd)
+		{
+			readStart = readEnd = readScan = 0;
+		}
+		else if (readEnd == TCPSOCKET_READ_BUFFER_SIZE)
+		{
+			if (readStart == 0)
+			{
+				debug("Line too long, discarding");
+				readDiscarding = true;
+				readEnd = readScan = 0;
+			}
+			else
+			{
+				memmove(readBuffer, readBuffer + readStart, readEnd - readStart);
+				readEnd -= readStart;
+				readScan = readEnd;
+				readStart = 0;
+			}
+		}
+
+		if (!receive()) return false;
+	}
+}
+
+bool TcpSocket::readBytes(const char*& data, unsigned int size)
+{
+	if (size > TCPSOCKET_READ_BUFFER_SIZE) return false;
 
-	char
-		buffer[BUF_SIZE];
+	while (readEnd - readStart < size)
+	{
+		// Make room for the rest of the record
+		if (readStart == readEnd)
+		{
+			readStart = readEnd = readScan = 0;
+		}
+		else if (TCPSOCKET_READ_BUFFER_SIZE - readStart < size)
+		{
+			memmove(readBuffer, readBuffer + readStart, readEnd - readStart);
+			readEnd -= readStart;
+			readStart = 0;
+		}
+
+		if (!receive()) return false;
+	}
+
+	data = readBuffer + readStart;
+	readStart += size;
+	if (readScan < readStart) readScan = readStart;
+	return true;
+}
+
+
+bool TcpSocket::write(const std::string& message)
+{
+	return write(message.data(), message.size());
+}
 
+bool TcpSocket::write(const char* data, size_t length)
+{
+	debug("Writing to socket");
+
+	size_t pos = 0;
 	while (pos < length)
 	{
-		bzero(buffer, BUF_SIZE);
-		cut = ((pos + BUF_SIZE) < length) ?
-				BUF_SIZE :
-				length - pos;
+		ssize_t written = ::send(connectionFD, data + pos, length - pos, MSG_NOSIGNAL);
+		if (written == -1)
+		{
+			if (retryWrite()) continue;
+			return false;
+		}
+
+		pos += written;
+	}
+
+	debug("Write done");
+
+	return true;
+}
 
-		for (int i = 0; i < cut; i++) buffer[i] = message[pos + i];
+bool TcpSocket::writeFrames(const struct iovec* frames, unsigned int count)
+{
+	debug("Writing to socket");
 
-		writeLen = ::send(connectionFD, buffer, cut, 0);
-		
-		pos = cut;
+	struct iovec batch[TCPSOCKET_WRITE_BATCH];
+	unsigned int next = 0;
+	size_t offset = 0;
 
-		if (writeLen < 0)
+	while (next < count)
+	{
+		// Continue from the first unsent byte
+		unsigned int size = 0;
+		for (unsigned int i = next; i < count && size < TCPSOCKET_WRITE_BATCH; i++, size++)
 		{
-			/// @todo throw exception instead of stderr+exit()
-			fprintf(stderr, "Error writing to buffer\n");
-			exit(1);
+			size_t skip = (i == next) ? offset : 0;
+			batch[size].iov_base = (char*) frames[i].iov_base + skip;
+			batch[size].iov_len = frames[i].iov_len - skip;
 		}
 
-		if (writeLen != cut)
+		struct msghdr message;
+		memset(&message, 0, sizeof(message));
+		message.msg_iov = batch;
+		message.msg_iovlen = size;
+
+		ssize_t written = ::sendmsg(connectionFD, &message, MSG_NOSIGNAL);
+		if (written == -1)
 		{
-			fprintf(stderr,
-						"Could only write %i chars, %i tried\n",
-						writeLen, cut);
-			exit(1);
+			if (retryWrite()) continue;
+			return false;
 		}
+
+		// Skip the buffers sent, keeping the position in a partly sent one
+		size_t remaining = written;
+		while (next < count && remaining >= frames[next].iov_len - offset)
+		{
+			remaining -= frames[next].iov_len - offset;
+			offset = 0;
+			next++;
+		}
+		offset += remaining;
 	}
 
 	debug("Write done");
@@ -350,11 +549,49 @@ bool TcpSocket::write(std::string& message)
 	return true;
 }
 
+long TcpSocket::writeAvailable(const struct iovec* frames, unsigned int count)
+{
+	struct msghdr message;
+	memset(&message, 0, sizeof(message));
+	message.msg_iov = const_cast<struct iovec*>(frames);
+	message.msg_iovlen = (count < TCPSOCKET_WRITE_BATCH) ? count : TCPSOCKET_WRITE_BATCH;
+
+	ssize_t written;
+	do
+		written = ::sendmsg(connectionFD, &message, MSG_NOSIGNAL | MSG_DONTWAIT);
+	while (written == -1 && errno == EINTR);
+
+	if (written == -1)
+	{
+		if (errno == EAGAIN || errno == EWOULDBLOCK) return 0;
+
+		lastError = errno;
+		_isConnected = false;
+		return -1;
+	}
+
+	return written;
+}
+
 bool TcpSocket::isConnected()
 {
 	return this->_isConnected;
 }
 
+bool TcpSocket::setBlocking(bool blocking)
+{
+	int flags = fcntl(connectionFD, F_GETFL, 0);
+	if (flags == -1) return false;
+
+	flags = blocking ? (flags & ~O_NONBLOCK) : (flags | O_NONBLOCK);
+	return (fcntl(connectionFD, F_SETFL, flags) == 0);
+}
+
+int TcpSocket::descriptor()
+{
+	return connectionFD;
+}
+
 
 /**
  * @author	s171170 Lars Øyvind Hagland
@@ -362,11 +599,84 @@ bool TcpSocket::isConnected()
 bool TcpSocket::close()
 {
 	debug("Closing socket(s)");
-	if (isServer && _isConnected) ::close(connectionFD);
-	if (_isConnected && ::close(socketFD)) return true;
+	bool success = true;
+
+	// A client uses the same descriptor for both
+	if (isServer && connectionFD != -1 && ::close(connectionFD) != 0) success = false;
+	if (socketFD != -1 && ::close(socketFD) != 0) success = false;
+
+	socketFD = -1;
+	connectionFD = -1;
+	_isConnected = false;
+	return success;
+}
+
+
+bool TcpSocket::receive()
+{
+	while (true)
+	{
+		int received = ::recv(connectionFD, readBuffer + readEnd, TCPSOCKET_READ_BUFFER_SIZE - readEnd, 0);
+		if (received > 0)
+		{
+			readEnd += received;
+			return true;
+		}
+
+		if (received == 0)
+		{
+			debug("Connection closed by peer");
+			_isConnected = false;
+			return false;
+		}
+
+		if (errno == EINTR) continue;
+		if (errno == EAGAIN || errno == EWOULDBLOCK) return false;
+
+		fprintf(stderr, "Error reading from socket\n");
+		_isConnected = false;
+		return false;
+	}
+}
+
+bool TcpSocket::retryWrite()
+{
+	if (errno == EINTR) return true;
+
+	if (errno == EAGAIN || errno == EWOULDBLOCK)
+	{
+		// Wait for room in the outgoing buffer
+		struct pollfd connection;
+		connection.fd = connectionFD;
+		connection.events = POLLOUT;
+		connection.revents = 0;
+
+		int ready;
+		do
+			ready = poll(&connection, 1, TCPSOCKET_WRITE_TIMEOUT);
+		while (ready == -1 && errno == EINTR);
+
+		if (ready > 0) return true;
+
+		debug("Write timed out");
+		lastError = ETIMEDOUT;
+		return false;
+	}
+
+	debug("Write failed");
+	lastError = errno;
+	_isConnected = false;
 	return false;
 }
 
+void TcpSocket::resetReadBuffer()
+{
+	readStart = 0;
+	readEnd = 0;
+	readScan = 0;
+	readDiscarding = false;
+}
+
 
 /**
  * @author	s171170 Lars Øyvind Hagland
@@ -2,8 +2,23 @@
 #define TCPSOCKET
 
 #include <sys/socket.h>
+#include <sys/uio.h>
 #include <string>
 
+/// The size of the buffer used by readLine(), the longest line that can be
+/// read
+#define TCPSOCKET_READ_BUFFER_SIZE	4096
+
+/// Milliseconds a blocking connect waits before failing
+#define TCPSOCKET_CONNECT_TIMEOUT	3000
+
+/// Milliseconds write() waits for a non-blocking connection to accept more
+/// data before failing
+#define TCPSOCKET_WRITE_TIMEOUT	1000
+
+/// The maximum number of buffers passed to one system call by writeFrames()
+#define TCPSOCKET_WRITE_BATCH	64
+
 /**
  * API for tcp-socket server and client
  *
@@ -19,17 +34,24 @@ class TcpSocket
 		TcpSocket();
 
 		/**
-		 * Creates a tcp server and starts listening
+		 * Creates a tcp server and starts listening. The listening socket
+		 * is non-blocking, connections are taken either by accept() or by
+		 * acceptClient().
 		 *
 		 * @param	port[]	Port on which to listen
+		 *
+		 * @throws	std::runtime_error* if unable to listen on the port
 		 */
 		TcpSocket(char port[]);
 
 		/**
-		 * Connects to a tcp server
+		 * Connects to a tcp server, waiting at most
+		 * TCPSOCKET_CONNECT_TIMEOUT milliseconds
 		 *
 		 * @param	port[]	Port on which to connect
 		 * @param	host[]	Address of host to connect to
+		 *
+		 * @throws	std::runtime_error* if unable to connect
 		 */
 		TcpSocket(char port[], char host[]);
 
@@ -43,12 +65,63 @@ class TcpSocket
 
 		/**
 		 * Waits for and accepts incoming connection to server
-		 * instance
+		 * instance, sleeping in poll() until a connection arrives
 		 *
-		 * @return	Success when an accept has been tried
+		 * @return	Success of accepting, false if the listening
+		 * 			socket failed
 		 */
 		bool accept();
 
+		/**
+		 * Accepts one waiting connection to a server instance without
+		 * blocking, as a separate socket. Lets a server handle any
+		 * number of connections, call it until it returns NULL when
+		 * serverDescriptor() is readable.
+		 *
+		 * @return	The non-blocking connection, to be deleted by the
+		 * 			caller, NULL if no connection is waiting
+		 */
+		TcpSocket * acceptClient();
+
+		/**
+		 * Gets the listening descriptor of a server instance, for use
+		 * with a Reactor
+		 *
+		 * @return	The descriptor, -1 if not a server
+		 */
+		int serverDescriptor();
+
+		/**
+		 * Starts connecting to a tcp server without blocking, closing any
+		 * current connection. The connection is in progress until the
+		 * descriptor is writable, then finishConnect() must be called.
+		 *
+		 * @param	port	Port on which to connect
+		 * @param	host	Address of host to connect to. Names are
+		 * 					resolved before returning, use an IP
+		 * 					address to avoid blocking.
+		 *
+		 * @return	Success of starting the connection, error() gives
+		 * 			the reason of a failure
+		 */
+		bool connectAsync(std::string port, std::string host);
+
+		/**
+		 * Completes a connection started by connectAsync(), when the
+		 * descriptor is writable. The connection is non-blocking.
+		 *
+		 * @return	Success of connecting, error() gives the reason of
+		 * 			a failure
+		 */
+		bool finishConnect();
+
+		/**
+		 * Gets the error of the last failed connect
+		 *
+		 * @return	The errno value of the error, 0 if none
+		 */
+		int error();
+
 		/**
 		 * Read from incoming buffer into string
 		 *
@@ -63,14 +136,101 @@ class TcpSocket
 		bool read(std::string& recepticle, std::string endTag = "");
 
 		/**
-		 * Write string to outgoing buffer, splitting message
-		 * as neccesary
+		 * Read one line from the incoming buffer
+		 *
+		 * Data is recieved into an internal buffer, and complete lines
+		 * are returned in place from the buffer, without copying. Several
+		 * lines from one recieve are returned by consecutive calls
+		 * without recieving again, and lines split between recieves are
+		 * joined. Lines longer than the buffer are discarded.
+		 *
+		 * @param	line	Output, the line without the line break, null
+		 * 					terminated. Valid until the next call.
+		 * @param	length	Output, the length of the line
+		 *
+		 * @return	Success of reading, returns false if the
+		 * 			connection was closed or failed, or if the
+		 * 			socket is non-blocking and no complete line has
+		 * 			been recieved. Use isConnected() to tell these
+		 * 			apart.
+		 */
+		bool readLine(const char*& line, unsigned int& length);
+
+		/**
+		 * Read a fixed number of bytes from the incoming buffer, like a
+		 * binary record. Shares the buffer of readLine(), the two may
+		 * be mixed.
+		 *
+		 * @param	data	Output, the bytes in the buffer, not aligned.
+		 * 					Valid until the next call.
+		 * @param	size	The number of bytes, at most
+		 * 					TCPSOCKET_READ_BUFFER_SIZE
+		 *
+		 * @return	Success of reading, as for readLine()
+		 */
+		bool readBytes(const char*& data, unsigned int size);
+
+		/**
+		 * Sets the connection to blocking or non-blocking mode
+		 *
+		 * @param	blocking	If calls should block
+		 *
+		 * @return	Success of setting the mode
+		 */
+		bool setBlocking(bool blocking);
+
+		/**
+		 * Gets the descriptor of the connection, for use with a Reactor
+		 *
+		 * @return	The descriptor, -1 if not connected
+		 */
+		int descriptor();
+
+		/**
+		 * Write string to outgoing buffer, sent directly from the
+		 * string
+		 *
+		 * The whole message is sent, continuing after partial writes.
+		 * A non-blocking connection waits at most
+		 * TCPSOCKET_WRITE_TIMEOUT milliseconds for room in the outgoing
+		 * buffer. A closed connection does not raise SIGPIPE.
 		 *
 		 * @param	message	String to be sent
 		 *
-		 * @return	Success of sending
+		 * @return	Success of sending, error() gives the reason of a
+		 * 			failure. After a failure an unknown part of the
+		 * 			message has been sent.
 		 */
-		bool write(std::string& message);
+		bool write(const std::string& message);
+
+		/// @overload
+		bool write(const char* data, size_t length);
+
+		/**
+		 * Write several buffers, like framed messages, as one stream
+		 * without joining them, TCPSOCKET_WRITE_BATCH buffers per
+		 * system call. Sends everything, as write().
+		 *
+		 * @param	frames	The buffers, in order
+		 * @param	count	The number of buffers
+		 *
+		 * @return	Success of sending, as for write()
+		 */
+		bool writeFrames(const struct iovec* frames, unsigned int count);
+
+		/**
+		 * Write as much of several buffers as the outgoing buffer
+		 * accepts, without blocking. For event driven writers, like a
+		 * server watching the descriptor with a Reactor.
+		 *
+		 * @param	frames	The buffers, in order
+		 * @param	count	The number of buffers, at most
+		 * 					TCPSOCKET_WRITE_BATCH are written
+		 *
+		 * @return	The number of bytes written, 0 if the write would
+		 * 			block, -1 if the connection failed
+		 */
+		long writeAvailable(const struct iovec* frames, unsigned int count);
 
 		/**
 		 * Close connection
@@ -88,24 +248,58 @@ class TcpSocket
 
 		int
 			socketFD,
-			connectionFD;
-
-		void
-			* peer_addr;
+			connectionFD,
+			lastError;
 
+		/// Buffer of recieved data for readLine()
 		char
-			host[],
-			port[];
+			readBuffer[TCPSOCKET_READ_BUFFER_SIZE];
+
+		unsigned int
+		/// Start of the unread data in readBuffer
+			readStart,
+		/// End of the recieved data in readBuffer
+			readEnd,
+		/// Position in readBuffer to search for the next line break from
+			readScan;
+
+		/// If the rest of a too long line is to be discarded
+		bool
+			readDiscarding;
+
+		/**
+		 * Empties the buffer used by readLine()
+		 */
+		void resetReadBuffer();
 
-		socklen_t peer_addr_len;
+		/**
+		 * Recieves data at the end of the buffer used by readLine()
+		 *
+		 * @return	If data was recieved, false if the read would block
+		 * 			or the connection was closed or failed
+		 */
+		bool receive();
 
 		/**
-		 * Creates a tcp client and connects to host
+		 * Handles a failed write from errno, waiting at most
+		 * TCPSOCKET_WRITE_TIMEOUT milliseconds for room in the outgoing
+		 * buffer if the write would block
+		 *
+		 * @return	If the write should be retried, false if it failed
+		 * 			and lastError is set
+		 */
+		bool retryWrite();
+
+		/**
+		 * Creates a tcp client and connects to host, waiting at most
+		 * TCPSOCKET_CONNECT_TIMEOUT milliseconds
 		 *
 		 * @param	port[]	Port on host
 		 * @param	host[]	Host which to connect
+		 *
+		 * @throws	std::runtime_error* if unable to connect
 		 */
-		void client( char port[], char host[] );
+		void client( const char port[], const char host[] );
 			
 		/**
 		 * Function for easily displaying debug messages
@@ -0,0 +1,243 @@
+#include "TelemetryServer.h"
+#include "TcpSocket.h"
+
+#include <iostream>
+#include <string>
+#include <memory>
+#include <mutex>
+
+
+TelemetryServer::TelemetryServer( std::string port, Reactor * pReactor )
+{
+	this->pReactor = pReactor;
+	this->clientCount.store( 0 );
+	this->frames = 0;
+	this->refused = 0;
+
+	this->pServer = new TcpSocket( const_cast<char *>( port.c_str() ) );
+	this->pReactor->add( this->pServer->serverDescriptor(), this );
+}
+
+TelemetryServer::~TelemetryServer()
+{
+	this->pReactor->remove( this->pServer->serverDescriptor() );
+
+	while ( ! this->connections.empty() )
+		this->disconnect( this->connections.begin()->first );
+
+	delete this->pServer;
+}
+
+unsigned int
+TelemetryServer::clients()
+{
+	return this->clientCount.load( std::memory_order_relaxed );
+}
+
+void
+TelemetryServer::broadcast( const std::shared_ptr<const std::string> & frame )
+{
+	std::lock_guard<std::mutex> lock( this->mutex );
+
+	this->frames++;
+	for ( std::map<int, Client *>::iterator it = this->connections.begin(); it != this->connections.end(); ++it )
+	{
+		Client * client = it->second;
+
+		if ( client->queue.size() >= TELEMETRYSERVER_QUEUE_SIZE )
+		{
+			// Drop the oldest frame not partly sent or being sent, or the
+			// new frame if all are
+			unsigned int keep = client->sending;
+			if ( keep == 0 && client->offset > 0 ) keep = 1;
+
+			client->dropped++;
+			if ( keep >= client->queue.size() ) continue;
+			client->queue.erase( client->queue.begin() + keep );
+		}
+
+		client->queue.push_back( frame );
+
+		if ( ! client->writing )
+		{
+			client->writing = true;
+			this->pReactor->setWritable( it->first, true );
+		}
+	}
+}
+
+void
+TelemetryServer::readable( int descriptor )
+{
+	if ( descriptor == this->pServer->serverDescriptor() )
+	{
+		this->acceptClients();
+		return;
+	}
+
+	TcpSocket * socket = NULL;
+	{
+		std::lock_guard<std::mutex> lock( this->mutex );
+		std::map<int, Client *>::iterator it = this->connections.find( descriptor );
+		if ( it != this->connections.end() ) socket = it->second->socket;
+	}
+	if ( socket == NULL ) return;
+
+	// Clients are not expected to send anything
+	const char * line;
+	unsigned int length;
+	while ( socket->readLine( line, length ) );
+
+	if ( ! socket->isConnected() ) this->disconnect( descriptor );
+}
+
+void
+TelemetryServer::writable( int descriptor )
+{
+	if ( ! this->flush( descriptor ) ) this->disconnect( descriptor );
+}
+
+void
+TelemetryServer::serverToString( std::ostream & out )
+{
+	std::lock_guard<std::mutex> lock( this->mutex );
+
+	out
+		<< "TelemetryServer: " << this->connections.size() << " clients, "
+		<< this->frames << " frames, " << this->refused << " clients refused" << std::endl;
+
+	for ( std::map<int, Client *>::iterator it = this->connections.begin(); it != this->connections.end(); ++it )
+		out
+			<< "  client " << it->first
+			<< ": queued " << it->second->queue.size()
+			<< ", sent " << it->second->sent
+			<< ", dropped " << it->second->dropped << std::endl;
+}
+
+
+// Private functions
+
+void
+TelemetryServer::acceptClients()
+{
+	TcpSocket * socket;
+	while ( ( socket = this->pServer->acceptClient() ) != NULL )
+	{
+		if ( this->clientCount.load() >= TELEMETRYSERVER_MAX_CLIENTS )
+		{
+			std::cerr << "TelemetryServer: Too many clients, connection refused" << std::endl;
+			this->refused++;
+			delete socket;
+			continue;
+		}
+
+		Client * client = new Client();
+		client->socket = socket;
+		client->offset = 0;
+		client->sending = 0;
+		client->writing = false;
+		client->sent = 0;
+		client->dropped = 0;
+
+		int descriptor = socket->descriptor();
+		{
+			std::lock_guard<std::mutex> lock( this->mutex );
+			this->connections[ descriptor ] = client;
+			this->clientCount++;
+		}
+
+		if ( ! this->pReactor->add( descriptor, this ) )
+		{
+			this->disconnect( descriptor );
+			continue;
+		}
+
+		std::cerr << "TelemetryServer: Client connected" << std::endl;
+	}
+}
+
+bool
+TelemetryServer::flush( int descriptor )
+{
+	struct iovec vectors[ TELEMETRYSERVER_WRITE_BATCH ];
+	unsigned int count = 0;
+	Client * client;
+
+	// Collect the queued frames, the frames stay queued while sending
+	{
+		std::lock_guard<std::mutex> lock( this->mutex );
+		std::map<int, Client *>::iterator it = this->connections.find( descriptor );
+		if ( it == this->connections.end() ) return true;
+		client = it->second;
+
+		for ( ; count < client->queue.size() && count < TELEMETRYSERVER_WRITE_BATCH; count++ )
+		{
+			const std::string & frame = * client->queue[ count ];
+			size_t offset = ( count == 0 ) ? client->offset : 0;
+			vectors[ count ].iov_base = const_cast<char *>( frame.data() ) + offset;
+			vectors[ count ].iov_len = frame.size() - offset;
+		}
+
+		if ( count == 0 )
+		{
+			client->writing = false;
+			this->pReactor->setWritable( descriptor, false );
+			return true;
+		}
+		client->sending = count;
+	}
+
+	// Send without blocking broadcast(), clients are only removed by the
+	// Reactor thread
+	long written = client->socket->writeAvailable( vectors, count );
+
+	std::lock_guard<std::mutex> lock( this->mutex );
+	client->sending = 0;
+
+	if ( written == -1 ) return false;
+
+	// Remove the frames sent, keeping the position in a partly sent frame
+	size_t remaining = written;
+	while ( remaining > 0 )
+	{
+		size_t left = client->queue.front()->size() - client->offset;
+		if ( remaining < left )
+		{
+			client->offset += remaining;
+			break;
+		}
+
+		remaining -= left;
+		client->queue.pop_front();
+		client->offset = 0;
+		client->sent++;
+	}
+
+	if ( client->queue.empty() )
+	{
+		client->writing = false;
+		this->pReactor->setWritable( descriptor, false );
+	}
+
+	return true;
+}
+
+void
+TelemetryServer::disconnect( int descriptor )
+{
+	Client * client;
+	{
+		std::lock_guard<std::mutex> lock( this->mutex );
+		std::map<int, Client *>::iterator it = this->connections.find( descriptor );
+		if ( it == this->connections.end() ) return;
+		client = it->second;
+		this->connections.erase( it );
+		this->clientCount--;
+	}
+
+	std::cerr << "TelemetryServer: Client disconnected" << std::endl;
+
+	this->pReactor->remove( descriptor );
+	delete client->socket;
+	delete client;
+}
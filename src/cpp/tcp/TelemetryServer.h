@@ -0,0 +1,165 @@
+#ifndef TELEMETRYSERVER_H
+#define TELEMETRYSERVER_H
+
+#include "Reactor.h"
+
+#include <sys/uio.h>
+#include <atomic>
+#include <deque>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <string>
+
+class TcpSocket;
+
+/// The maximum number of frames queued for a client, the oldest frame is
+/// dropped when a new frame does not fit
+#define TELEMETRYSERVER_QUEUE_SIZE	8
+/// The maximum number of clients, further connections are closed
+#define TELEMETRYSERVER_MAX_CLIENTS	16
+/// The maximum number of frames sent by one system call, at most
+/// TCPSOCKET_WRITE_BATCH
+#define TELEMETRYSERVER_WRITE_BATCH	TELEMETRYSERVER_QUEUE_SIZE
+
+
+/**
+ * Streams frames of telemetry to any number of clients, like monitoring
+ * dashboards, without letting the clients slow down the producer.
+ *
+ * The producer (the Brain thread) hands each frame to broadcast() once, and
+ * the frame is shared by the queues of all clients without copying. Sending
+ * is done by the Reactor thread when a client is writable, several frames
+ * per system call with TcpSocket::writeAvailable(). Each queue holds at
+ * most TELEMETRYSERVER_QUEUE_SIZE frames: a client reading slower than
+ * frames are produced loses its oldest frames, while broadcast() never
+ * waits for the network.
+ *
+ * Clients do not send anything, any data received is discarded.
+ */
+class TelemetryServer : public ReactorHandler
+{
+	public:
+		/**
+		 * Starts listening for clients on the Reactor
+		 *
+		 * @param	port	The port to listen on
+		 * @param	pReactor	The Reactor handling the connections
+		 *
+		 * @throws	std::runtime_error* if unable to listen on the port
+		 */
+		TelemetryServer( std::string port, Reactor * pReactor );
+
+		/**
+		 * Destructor, closes all connections. The Reactor must be stopped.
+		 */
+		~TelemetryServer();
+
+		/**
+		 * Gets the number of connected clients, letting the producer skip
+		 * building frames nobody reads
+		 *
+		 * @return	The number of clients
+		 */
+		unsigned int clients();
+
+		/**
+		 * Queues a frame for all clients, dropping the oldest queued frame
+		 * of clients with full queues. Does not block on the network.
+		 *
+		 * @param	frame	The frame, shared by all clients and not to be
+		 * changed after the call
+		 */
+		void broadcast( const std::shared_ptr<const std::string> & frame );
+
+		/**
+		 * Accepts clients, or discards data from a client and detects when
+		 * it disconnects
+		 */
+		void readable( int descriptor );
+
+		/**
+		 * Sends the queued frames of a client
+		 */
+		void writable( int descriptor );
+
+		/**
+		 * Prints the clients, with their queued, sent and dropped frames
+		 *
+		 * @param	out	The stream to print to
+		 */
+		void serverToString( std::ostream & out );
+
+	private:
+		/**
+		 * A connected client and its queue of frames
+		 */
+		struct Client
+		{
+			/// The connection
+			TcpSocket * socket;
+			/// Frames waiting to be sent, oldest first
+			std::deque< std::shared_ptr<const std::string> > queue;
+			/// Bytes of the first queued frame already sent
+			size_t offset;
+			/// Frames at the front of the queue being sent by the Reactor,
+			/// not to be dropped
+			unsigned int sending;
+			/// If the descriptor is watched for writing
+			bool writing;
+			/// Frames sent
+			unsigned long long sent;
+			/// Frames dropped because the queue was full
+			unsigned long long dropped;
+		};
+
+		/// The listening socket
+		TcpSocket
+			* pServer;
+
+		/// The Reactor handling the connections
+		Reactor
+			* pReactor;
+
+		/// Protects the clients and their queues
+		std::mutex
+			mutex;
+
+		/// The clients, by descriptor
+		std::map<int, Client *>
+			connections;
+
+		/// The number of clients, read without locking
+		std::atomic<unsigned int>
+			clientCount;
+
+		unsigned long long
+		/// Frames broadcast
+			frames,
+		/// Clients refused because the server was full
+			refused;
+
+		/**
+		 * Accepts all waiting clients
+		 */
+		void acceptClients();
+
+		/**
+		 * Sends as many queued frames to a client as the socket accepts
+		 *
+		 * @param	descriptor	The descriptor of the client
+		 *
+		 * @return	@c false if the connection failed
+		 */
+		bool flush( int descriptor );
+
+		/**
+		 * Disconnects a client and discards its queue
+		 *
+		 * @param	descriptor	The descriptor of the client
+		 */
+		void disconnect( int descriptor );
+};
+
+#endif
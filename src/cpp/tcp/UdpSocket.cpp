@@ -0,0 +1,135 @@
+#include "UdpSocket.h"
+
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <netdb.h>
+#include <unistd.h>
+#include <errno.h>
+#include <string.h>
+#include <iostream>
+#include <string>
+
+
+UdpSocket::UdpSocket()
+{
+	this->socketFD = -1;
+	this->lastError = 0;
+
+	memset( this->messages, 0, sizeof( this->messages ) );
+	for ( unsigned int i = 0; i < UDPSOCKET_BATCH; i++ )
+	{
+		this->vectors[ i ].iov_base = this->buffers[ i ];
+		this->vectors[ i ].iov_len = UDPSOCKET_DATAGRAM_SIZE;
+		this->messages[ i ].msg_hdr.msg_iov = & this->vectors[ i ];
+		this->messages[ i ].msg_hdr.msg_iovlen = 1;
+	}
+}
+
+UdpSocket::~UdpSocket()
+{
+	this->close();
+}
+
+bool
+UdpSocket::connect( std::string port, std::string host )
+{
+	this->close();
+	this->lastError = 0;
+
+	struct addrinfo hints;
+	struct addrinfo * result, * rp;
+
+	memset( & hints, 0, sizeof( hints ) );
+	hints.ai_family = AF_UNSPEC;
+	hints.ai_socktype = SOCK_DGRAM;
+	hints.ai_protocol = IPPROTO_UDP;
+
+	int s = getaddrinfo( host.c_str(), port.c_str(), & hints, & result );
+	if ( s != 0 )
+	{
+		std::cerr << "UdpSocket: getaddrinfo: " << gai_strerror( s ) << std::endl;
+		this->lastError = EHOSTUNREACH;
+		return false;
+	}
+
+	for ( rp = result; rp != NULL; rp = rp->ai_next )
+	{
+		this->socketFD = socket( rp->ai_family, rp->ai_socktype | SOCK_NONBLOCK | SOCK_CLOEXEC, rp->ai_protocol );
+		if ( this->socketFD == -1 )
+		{
+			this->lastError = errno;
+			continue;
+		}
+
+		if ( ::connect( this->socketFD, rp->ai_addr, rp->ai_addrlen ) == 0 ) break;
+
+		this->lastError = errno;
+		this->close();
+	}
+
+	freeaddrinfo( result );
+	return ( this->socketFD != -1 );
+}
+
+bool
+UdpSocket::send( const char * data, unsigned int length )
+{
+	if ( this->socketFD == -1 ) return false;
+
+	if ( ::send( this->socketFD, data, length, MSG_NOSIGNAL ) == -1 )
+	{
+		this->lastError = errno;
+		return false;
+	}
+
+	return true;
+}
+
+unsigned int
+UdpSocket::receive()
+{
+	if ( this->socketFD == -1 ) return 0;
+
+	int count;
+	do
+		count = recvmmsg( this->socketFD, this->messages, UDPSOCKET_BATCH, MSG_DONTWAIT, NULL );
+	while ( count == -1 && errno == EINTR );
+
+	if ( count == -1 )
+	{
+		// Errors like ECONNREFUSED are reported once, the socket remains
+		// usable
+		if ( errno != EAGAIN && errno != EWOULDBLOCK ) this->lastError = errno;
+		return 0;
+	}
+
+	return count;
+}
+
+const char *
+UdpSocket::datagram( unsigned int index, unsigned int & length )
+{
+	length = this->messages[ index ].msg_len;
+	return this->buffers[ index ];
+}
+
+int
+UdpSocket::descriptor()
+{
+	return this->socketFD;
+}
+
+int
+UdpSocket::error()
+{
+	return this->lastError;
+}
+
+void
+UdpSocket::close()
+{
+	if ( this->socketFD == -1 ) return;
+
+	::close( this->socketFD );
+	this->socketFD = -1;
+}
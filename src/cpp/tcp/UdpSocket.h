@@ -0,0 +1,118 @@
+#ifndef UDPSOCKET_H
+#define UDPSOCKET_H
+
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <string>
+
+/// The maximum number of datagrams read by one receive()
+#define UDPSOCKET_BATCH	32
+/// The largest datagram received, longer datagrams are truncated
+#define UDPSOCKET_DATAGRAM_SIZE	512
+
+
+/**
+ * Non-blocking connected UDP socket, for loss tolerant streams where a late
+ * datagram must not hold back newer ones.
+ *
+ * The socket is connected to one peer, so only datagrams from the peer are
+ * received. Datagrams are received in batches with recvmmsg(), one system
+ * call for up to UDPSOCKET_BATCH datagrams.
+ */
+class UdpSocket
+{
+	public:
+		/**
+		 * Constructs an unconnected socket
+		 */
+		UdpSocket();
+
+		/**
+		 * Destructor, closes the socket
+		 */
+		~UdpSocket();
+
+		/**
+		 * Creates a non-blocking socket connected to a peer, closing any
+		 * current socket
+		 *
+		 * @param	port	Port of the peer
+		 * @param	host	Address of the peer. Names are resolved before
+		 * returning, use an IP address to avoid blocking.
+		 *
+		 * @return	Success of connecting, error() gives the reason of a
+		 * failure
+		 */
+		bool connect( std::string port, std::string host );
+
+		/**
+		 * Sends a datagram to the peer
+		 *
+		 * @param	data	The datagram
+		 * @param	length	The length of the datagram
+		 *
+		 * @return	Success of sending, false if it would block or failed
+		 */
+		bool send( const char * data, unsigned int length );
+
+		/**
+		 * Receives the datagrams waiting, at most UDPSOCKET_BATCH, without
+		 * blocking. The datagrams are valid until the next call.
+		 *
+		 * @return	The number of datagrams received, 0 if none are waiting
+		 * or on errors, see error()
+		 */
+		unsigned int receive();
+
+		/**
+		 * Gets a datagram received by the last receive()
+		 *
+		 * @param	index	The datagram, less than the number received
+		 * @param	length	Output, the length of the datagram
+		 *
+		 * @return	The datagram
+		 */
+		const char * datagram( unsigned int index, unsigned int & length );
+
+		/**
+		 * Gets the descriptor of the socket, for use with a Reactor
+		 *
+		 * @return	The descriptor, -1 if not connected
+		 */
+		int descriptor();
+
+		/**
+		 * Gets the error of the last failed operation, like ECONNREFUSED
+		 * when the peer has no socket on the port
+		 *
+		 * @return	The errno value, 0 if none
+		 */
+		int error();
+
+		/**
+		 * Closes the socket
+		 */
+		void close();
+
+	private:
+		int
+		/// The socket descriptor, -1 if closed
+			socketFD,
+		/// The errno of the last failed operation
+			lastError;
+
+		/// Buffers of the received datagrams
+		char
+			buffers[ UDPSOCKET_BATCH ][ UDPSOCKET_DATAGRAM_SIZE ];
+
+		/// Buffer descriptions for recvmmsg()
+		struct iovec
+			vectors[ UDPSOCKET_BATCH ];
+
+		/// Message headers for recvmmsg(), holding the received lengths
+		struct mmsghdr
+			messages[ UDPSOCKET_BATCH ];
+};
+
+#endif